@@ -7,6 +7,10 @@
 #include <JuceHeader.h>
 #include "MainComponent.h"
 #include "ProcessManager.h"
+#include "../rendering/FFmpegExecutor.h"
+#include "../rendering/EncoderCapabilities.h"
+#include "../rendering/RenderManagerCore.h"
+#include <iostream>
 
 class FFLUCEApplication : public juce::JUCEApplication
 {
@@ -17,7 +21,7 @@ public:
     const juce::String getApplicationVersion() override    { return ProjectInfo::versionString; }
     bool moreThanOneInstanceAllowed() override             { return true; }
 
-    void initialise(const juce::String& /*commandLine*/) override
+    void initialise(const juce::String& commandLine) override
     {
         // Set up file logging
         juce::File logsDirectory = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
@@ -37,6 +41,25 @@ public:
         juce::Logger::writeToLog("Version: " + getApplicationVersion());
         juce::Logger::writeToLog("----------------------------------------------------");
 
+        // Probe encoders now so the first render doesn't pay for it (cached per FFmpeg build)
+        FFmpegExecutor executor;
+        EncoderCapabilities::getInstance().probeInBackground(executor.getFFmpegPath());
+
+        // "--resume [directory]" finishes an interrupted render without opening a window
+        juce::StringArray arguments;
+        arguments.addTokens(commandLine, true);
+        arguments.removeEmptyStrings();
+
+        const int resumeIndex = arguments.indexOf("--resume");
+        if (resumeIndex >= 0)
+        {
+            const juce::String target = arguments[resumeIndex + 1].unquoted();
+            headlessRender = std::make_unique<HeadlessRender>(target.isNotEmpty() && !target.startsWith("--")
+                                                                  ? juce::File::getCurrentWorkingDirectory().getChildFile(target)
+                                                                  : juce::File());
+            return;
+        }
+
         mainWindow.reset(new MainWindow(getApplicationName()));
     }
 
@@ -47,6 +70,7 @@ public:
         juce::Logger::writeToLog("----------------------------------------------------");
 
         ProcessManager::getInstance().terminateAllProcesses();
+        headlessRender = nullptr;
         mainWindow = nullptr;
 
         juce::Logger::setCurrentLogger(nullptr);
@@ -94,8 +118,51 @@ public:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainWindow)
     };
 
+    /** Resumes a render from its journal and quits when it's done, with exit code 0 on success. */
+    class HeadlessRender : private juce::Timer
+    {
+    public:
+        explicit HeadlessRender(const juce::File& target)
+            : renderer(nullptr)
+        {
+            const auto print = [](const juce::String& message) { std::cout << message << std::endl; };
+
+            if (!renderer.resumeRendering(target, print, nullptr))
+            {
+                std::cerr << "Nothing to resume; see the session log for details" << std::endl;
+                finish(1);
+                return;
+            }
+
+            startTimer(500);
+        }
+
+    private:
+        void timerCallback() override
+        {
+            if (renderer.isRendering() && renderer.getState() != RenderTypes::RenderState::Cancelled)
+                return;
+
+            stopTimer();
+            const bool succeeded = renderer.getState() == RenderTypes::RenderState::Completed;
+            std::cout << renderer.getStatusMessage() << std::endl;
+            finish(succeeded ? 0 : 1);
+        }
+
+        static void finish(int exitCode)
+        {
+            juce::JUCEApplicationBase::setApplicationReturnValue(exitCode);
+            juce::JUCEApplicationBase::quit();
+        }
+
+        RenderManagerCore renderer;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HeadlessRender)
+    };
+
 private:
     std::unique_ptr<MainWindow> mainWindow;
+    std::unique_ptr<HeadlessRender> headlessRender;
     std::unique_ptr<juce::FileLogger> fileLogger;
 };
 
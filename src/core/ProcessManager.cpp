@@ -0,0 +1,228 @@
+#include "ProcessManager.h"
+
+#if ! JUCE_WINDOWS
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    ProcessManager::JobPolicy getDefaultPolicy(ProcessManager::JobClass jobClass)
+    {
+        ProcessManager::JobPolicy policy;
+
+        switch (jobClass)
+        {
+            case ProcessManager::JobClass::Stream:
+                // Full priority - the stream has to keep up with real time
+                policy.niceValue = 0;
+                policy.ioPriorityClass = 2;
+                policy.ioPriorityLevel = 0;
+                break;
+
+            case ProcessManager::JobClass::Preview:
+                policy.niceValue = 5;
+                policy.ioPriorityClass = 2;
+                policy.ioPriorityLevel = 4;
+                break;
+
+            case ProcessManager::JobClass::Render:
+            default:
+                // Soaks up whatever the stream and UI leave over
+                policy.niceValue = 10;
+                policy.ioPriorityClass = 2;
+                policy.ioPriorityLevel = 7;
+                break;
+        }
+
+        return policy;
+    }
+
+    // Parses a CPU list such as "0-3,6" into an affinity mask
+    juce::uint64 parseCpuList(const juce::String& list)
+    {
+        juce::uint64 mask = 0;
+
+        juce::StringArray ranges;
+        ranges.addTokens(list, ",", "");
+
+        for (const auto& range : ranges)
+        {
+            const juce::String trimmed = range.trim();
+            if (trimmed.isEmpty())
+                continue;
+
+            const int first = trimmed.upToFirstOccurrenceOf("-", false, false).getIntValue();
+            const int last = trimmed.containsChar('-') ? trimmed.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+
+            for (int cpu = juce::jmax(0, first); cpu <= juce::jmin(63, last); ++cpu)
+                mask |= (juce::uint64) 1 << cpu;
+        }
+
+        return mask;
+    }
+
+   #if JUCE_LINUX
+    // cgroupfs files must be written in place - File::replaceWithText() goes via a temp file
+    bool writeControlFile(const juce::File& file, const juce::String& value)
+    {
+        const int fd = ::open(file.getFullPathName().toRawUTF8(), O_WRONLY);
+        if (fd < 0)
+            return false;
+
+        const std::string text = value.toStdString();
+        const bool ok = ::write(fd, text.data(), text.size()) == (ssize_t) text.size();
+        ::close(fd);
+        return ok;
+    }
+   #endif
+
+    juce::File getJobPoliciesFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                   .getChildFile("FFLUCE")
+                   .getChildFile("job_policies.json");
+    }
+}
+
+//==============================================================================
+juce::String ProcessManager::getJobClassName(JobClass jobClass)
+{
+    switch (jobClass)
+    {
+        case JobClass::Stream:  return "stream";
+        case JobClass::Preview: return "preview";
+        case JobClass::Render:
+        default:                return "render";
+    }
+}
+
+void ProcessManager::registerProcessGroup(int processGroupId, const juce::String& description)
+{
+    juce::ScopedLock lock(criticalSection);
+    processGroups[processGroupId] = description;
+}
+
+void ProcessManager::unregisterProcessGroup(int processGroupId)
+{
+    juce::ScopedLock lock(criticalSection);
+    processGroups.erase(processGroupId);
+}
+
+int ProcessManager::terminateProcessGroups()
+{
+    juce::ScopedLock lock(criticalSection);
+    int count = 0;
+
+   #if ! JUCE_WINDOWS
+    for (const auto& [groupId, description] : processGroups)
+    {
+        juce::Logger::writeToLog("Terminating process group " + juce::String(groupId) + ": " + description);
+
+        if (::kill(-(pid_t) groupId, SIGKILL) == 0)
+            count++;
+    }
+   #endif
+
+    processGroups.clear();
+    return count;
+}
+
+//==============================================================================
+void ProcessManager::loadJobPolicies()
+{
+    if (jobPoliciesLoaded)
+        return;
+
+    jobPoliciesLoaded = true;
+
+    for (auto jobClass : { JobClass::Render, JobClass::Stream, JobClass::Preview })
+        jobPolicies[jobClass] = getDefaultPolicy(jobClass);
+
+    // Optional overrides, e.g. {"render": {"nice": 15, "cpus": "4-15", "cgroup": "/sys/fs/cgroup/.../render"}}
+    const juce::File file = getJobPoliciesFile();
+    if (!file.existsAsFile())
+        return;
+
+    const juce::var json = juce::JSON::parse(file.loadFileAsString());
+    if (!json.isObject())
+    {
+        juce::Logger::writeToLog("WARNING: Ignoring unreadable " + file.getFullPathName());
+        return;
+    }
+
+    for (auto& [jobClass, policy] : jobPolicies)
+    {
+        const juce::var entry = json.getProperty(getJobClassName(jobClass), juce::var());
+        if (!entry.isObject())
+            continue;
+
+        policy.niceValue = juce::jlimit(-20, 19, (int) entry.getProperty("nice", policy.niceValue));
+        policy.ioPriorityClass = juce::jlimit(0, 3, (int) entry.getProperty("ioClass", policy.ioPriorityClass));
+        policy.ioPriorityLevel = juce::jlimit(0, 7, (int) entry.getProperty("ioLevel", policy.ioPriorityLevel));
+        policy.cgroupPath = entry.getProperty("cgroup", policy.cgroupPath).toString();
+        policy.cgroupCpuWeight = juce::jlimit(0, 10000, (int) entry.getProperty("cpuWeight", policy.cgroupCpuWeight));
+        policy.cgroupIoWeight = juce::jlimit(0, 10000, (int) entry.getProperty("ioWeight", policy.cgroupIoWeight));
+
+        if (entry.hasProperty("cpus"))
+            policy.cpuAffinityMask = parseCpuList(entry.getProperty("cpus", juce::String()).toString());
+
+        juce::Logger::writeToLog("Job policy for " + getJobClassName(jobClass) + " loaded from " + file.getFileName());
+    }
+}
+
+ProcessManager::JobPolicy ProcessManager::getJobPolicy(JobClass jobClass)
+{
+    juce::ScopedLock lock(criticalSection);
+    loadJobPolicies();
+    return jobPolicies[jobClass];
+}
+
+void ProcessManager::setJobPolicy(JobClass jobClass, const JobPolicy& policy)
+{
+    juce::ScopedLock lock(criticalSection);
+    loadJobPolicies();
+    jobPolicies[jobClass] = policy;
+    preparedCgroups.erase(jobClass);
+}
+
+juce::File ProcessManager::prepareCgroup(JobClass jobClass)
+{
+    juce::ScopedLock lock(criticalSection);
+    loadJobPolicies();
+
+    auto prepared = preparedCgroups.find(jobClass);
+    if (prepared != preparedCgroups.end())
+        return prepared->second;
+
+    juce::File procsFile;
+    const JobPolicy& policy = jobPolicies[jobClass];
+    juce::ignoreUnused(policy);
+
+   #if JUCE_LINUX
+    if (policy.cgroupPath.isNotEmpty() && juce::File::isAbsolutePath(policy.cgroupPath))
+    {
+        const juce::File cgroup(policy.cgroupPath);
+
+        // Creating the group only works if the parent has been delegated to us
+        if (!cgroup.isDirectory())
+            cgroup.createDirectory();
+
+        // Weights only exist if the controllers are enabled for the parent; carry on without them
+        if (policy.cgroupCpuWeight > 0 && !writeControlFile(cgroup.getChildFile("cpu.weight"), juce::String(policy.cgroupCpuWeight)))
+            juce::Logger::writeToLog("WARNING: Could not set cpu.weight in " + policy.cgroupPath);
+        if (policy.cgroupIoWeight > 0 && !writeControlFile(cgroup.getChildFile("io.weight"), "default " + juce::String(policy.cgroupIoWeight)))
+            juce::Logger::writeToLog("WARNING: Could not set io.weight in " + policy.cgroupPath);
+
+        if (cgroup.getChildFile("cgroup.procs").existsAsFile() && cgroup.getChildFile("cgroup.procs").hasWriteAccess())
+            procsFile = cgroup.getChildFile("cgroup.procs");
+        else
+            juce::Logger::writeToLog("WARNING: cgroup " + policy.cgroupPath + " for " + getJobClassName(jobClass)
+                                     + " jobs is not writable, running without it");
+    }
+   #endif
+
+    preparedCgroups[jobClass] = procsFile;
+    return procsFile;
+}
@@ -1,13 +1,40 @@
 #pragma once
 #include <JuceHeader.h>
+#include <map>
 
 /**
  * Process management singleton that keeps track of all running external processes.
  * This ensures that all child processes (like FFmpeg) are properly terminated when the app exits.
+ *
+ * It also holds the scheduling policy for each class of job, so a long offline
+ * render can run alongside a live stream without starving it of CPU or disk.
  */
 class ProcessManager
 {
 public:
+    /** The kind of work a child process does. Each class has its own JobPolicy. */
+    enum class JobClass
+    {
+        Render,     // offline renders - throughput matters, latency doesn't
+        Stream,     // live streaming - must keep up with real time
+        Preview     // interactive previews
+    };
+
+    /**
+     * Scheduling settings applied to a child process as it is launched.
+     * Fields that don't apply on the current platform are ignored.
+     */
+    struct JobPolicy
+    {
+        int niceValue = 0;                  // -20 (highest priority) .. 19 (lowest)
+        int ioPriorityClass = 0;            // Linux ioprio: 1 realtime, 2 best-effort, 3 idle, 0 = leave alone
+        int ioPriorityLevel = 4;            // 0 (highest) .. 7 within the class
+        juce::uint64 cpuAffinityMask = 0;   // one bit per CPU, 0 = any CPU (Linux only)
+        juce::String cgroupPath;            // cgroup v2 directory to place the process in, empty = none
+        int cgroupCpuWeight = 0;            // written to cpu.weight when the cgroup is prepared, 0 = leave alone
+        int cgroupIoWeight = 0;             // written to io.weight, 0 = leave alone
+    };
+
     /** 
      * Gets the singleton instance 
      */
@@ -74,16 +101,58 @@ public:
         activeProcesses.clear();
         processDescriptions.clear();
         
+        count += terminateProcessGroups();
+        
         juce::Logger::writeToLog("Terminated " + juce::String(count) + " processes");
     }
 
+    /**
+     * Registers a process group led by a child we spawned ourselves (POSIX).
+     * terminateAllProcesses() kills the whole group.
+     */
+    void registerProcessGroup(int processGroupId, const juce::String& description = "");
+
+    /** Unregisters a process group once its leader has been reaped. */
+    void unregisterProcessGroup(int processGroupId);
+
+    /**
+     * Returns the policy for a job class. Defaults favour streaming over
+     * rendering and can be overridden in job_policies.json in the FFLUCE
+     * application data folder.
+     */
+    JobPolicy getJobPolicy(JobClass jobClass);
+
+    /** Replaces the policy for a job class for the rest of the session. */
+    void setJobPolicy(JobClass jobClass, const JobPolicy& policy);
+
+    /**
+     * Returns the cgroup.procs file processes of this class should join, creating
+     * the cgroup and writing its weights the first time. Returns an invalid file
+     * if no cgroup is configured or it can't be used (e.g. not delegated to us).
+     */
+    juce::File prepareCgroup(JobClass jobClass);
+
+    /** Name used for a job class in logs and job_policies.json. */
+    static juce::String getJobClassName(JobClass jobClass);
+
 private:
     ProcessManager() {} // Private constructor for singleton
     
+    int terminateProcessGroups();
+    void loadJobPolicies();
+    
     juce::Array<juce::ChildProcess*> activeProcesses;
     juce::HashMap<juce::ChildProcess*, juce::String> processDescriptions;
     juce::CriticalSection criticalSection;
     
+    // Process groups of children spawned via fork (leader pid -> description)
+    std::map<int, juce::String> processGroups;
+    
+    // Per-class scheduling policies, loaded on first use
+    std::map<JobClass, JobPolicy> jobPolicies;
+    std::map<JobClass, juce::File> preparedCgroups;
+    bool jobPoliciesLoaded = false;
+    
     // Make non-copyable
     ProcessManager(const ProcessManager&) = delete;
     ProcessManager& operator=(const ProcessManager&) = delete;
@@ -0,0 +1,299 @@
+#include "AlphaCompositor.h"
+#include <atomic>
+#include <cstring>
+
+#if JUCE_INTEL && (defined(__GNUC__) || defined(_MSC_VER))
+ #define FFLUCE_AVX2_KERNELS 1
+ #include <immintrin.h>
+ #if defined(__GNUC__)
+  #define FFLUCE_TARGET_AVX2 __attribute__((target("avx2")))
+ #else
+  #define FFLUCE_TARGET_AVX2
+ #endif
+#else
+ #define FFLUCE_AVX2_KERNELS 0
+#endif
+
+namespace
+{
+    // BT.709 limited range, applied to premultiplied 8-bit RGB
+    constexpr float inv255 = 1.0f / 255.0f;
+    constexpr float yScale = 219.0f / 255.0f;
+    constexpr float cScale = 224.0f / 255.0f;
+
+    constexpr float yR = yScale * 0.2126f;
+    constexpr float yG = yScale * 0.7152f;
+    constexpr float yB = yScale * 0.0722f;
+    constexpr float yOffset = 16.0f / 255.0f;
+
+    constexpr float uR = cScale * (-0.2126f / 1.8556f);
+    constexpr float uG = cScale * (-0.7152f / 1.8556f);
+    constexpr float uB = cScale * 0.5f;
+    constexpr float vR = cScale * 0.5f;
+    constexpr float vG = cScale * (-0.7152f / 1.5748f);
+    constexpr float vB = cScale * (-0.0722f / 1.5748f);
+    constexpr float cOffset = 128.0f / 255.0f;
+
+    std::atomic<bool> vectorKernelsEnabled { true };
+
+    // Both kernels round by adding a half and truncating, so they agree exactly
+    inline juce::uint8 toByte(float value)
+    {
+        return (juce::uint8) juce::jlimit(0, 255, (int) (value + 0.5f));
+    }
+
+    void blendLumaScalar(juce::uint8* luma, const juce::uint8* bgra, int start, int end)
+    {
+        for (int i = start; i < end; ++i)
+        {
+            const juce::uint8* p = bgra + 4 * i;
+            const float a = p[3];
+            float out = a * yOffset;
+            out = out + p[2] * yR;
+            out = out + p[1] * yG;
+            out = out + p[0] * yB;
+            out = out + luma[i] * (1.0f - a * inv255);
+            luma[i] = toByte(out);
+        }
+    }
+
+    void blendChromaScalar(juce::uint8* u, juce::uint8* v, const juce::uint8* row0, const juce::uint8* row1,
+                           int numPixels, int start, int end)
+    {
+        for (int j = start; j < end; ++j)
+        {
+            // An odd last column pairs with itself
+            const int left = 4 * (2 * j);
+            const int right = 4 * juce::jmin(2 * j + 1, numPixels - 1);
+
+            int sums[4];
+            for (int c = 0; c < 4; ++c)
+                sums[c] = row0[left + c] + row0[right + c] + row1[left + c] + row1[right + c];
+
+            const float b = sums[0] * 0.25f;
+            const float g = sums[1] * 0.25f;
+            const float r = sums[2] * 0.25f;
+            const float a = sums[3] * 0.25f;
+            const float keep = 1.0f - a * inv255;
+
+            float outU = a * cOffset;
+            outU = outU + r * uR;
+            outU = outU + g * uG;
+            outU = outU + b * uB;
+            outU = outU + u[j] * keep;
+
+            float outV = a * cOffset;
+            outV = outV + r * vR;
+            outV = outV + g * vG;
+            outV = outV + b * vB;
+            outV = outV + v[j] * keep;
+
+            u[j] = toByte(outU);
+            v[j] = toByte(outV);
+        }
+    }
+
+   #if FFLUCE_AVX2_KERNELS
+    FFLUCE_TARGET_AVX2 inline __m256 loadBytesAsFloats(const juce::uint8* source)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source))));
+    }
+
+    FFLUCE_TARGET_AVX2 inline __m256i channel(__m256i pixels, int shift)
+    {
+        return _mm256_and_si256(_mm256_srli_epi32(pixels, shift), _mm256_set1_epi32(0xff));
+    }
+
+    // Saturates two vectors of 8 ints to 16 bytes, in order
+    FFLUCE_TARGET_AVX2 inline void store16(juce::uint8* dest, __m256i first, __m256i second)
+    {
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(first, second), 0xD8);
+        const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm256_castsi256_si128(bytes));
+    }
+
+    // Saturates one vector of 8 ints to 8 bytes
+    FFLUCE_TARGET_AVX2 inline void store8(juce::uint8* dest, __m256i values)
+    {
+        const __m256i words = _mm256_packus_epi32(values, values);
+        const __m256i bytes = _mm256_packus_epi16(words, words);
+        const int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes));
+        const int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+        std::memcpy(dest, &low, 4);
+        std::memcpy(dest + 4, &high, 4);
+    }
+
+    /** Blends 16 pixels at a time; returns how many pixels it did. */
+    FFLUCE_TARGET_AVX2 int blendLumaAvx2(juce::uint8* luma, const juce::uint8* bgra, int numPixels)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f), scale = _mm256_set1_ps(inv255);
+        const __m256 offset = _mm256_set1_ps(yOffset), kR = _mm256_set1_ps(yR), kG = _mm256_set1_ps(yG), kB = _mm256_set1_ps(yB);
+
+        int i = 0;
+        for (; i + 16 <= numPixels; i += 16)
+        {
+            __m256i results[2];
+            for (int h = 0; h < 2; ++h)
+            {
+                const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgra + 4 * (i + 8 * h)));
+                const __m256 b = _mm256_cvtepi32_ps(channel(pixels, 0));
+                const __m256 g = _mm256_cvtepi32_ps(channel(pixels, 8));
+                const __m256 r = _mm256_cvtepi32_ps(channel(pixels, 16));
+                const __m256 a = _mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24));
+                const __m256 base = loadBytesAsFloats(luma + i + 8 * h);
+
+                __m256 out = _mm256_mul_ps(a, offset);
+                out = _mm256_add_ps(out, _mm256_mul_ps(r, kR));
+                out = _mm256_add_ps(out, _mm256_mul_ps(g, kG));
+                out = _mm256_add_ps(out, _mm256_mul_ps(b, kB));
+                out = _mm256_add_ps(out, _mm256_mul_ps(base, _mm256_sub_ps(one, _mm256_mul_ps(a, scale))));
+                results[h] = _mm256_cvttps_epi32(_mm256_add_ps(out, half));
+            }
+
+            store16(luma + i, results[0], results[1]);
+        }
+
+        return i;
+    }
+
+    /** Blends 8 chroma samples (16 pixels of two rows) at a time; returns how many samples it did. */
+    FFLUCE_TARGET_AVX2 int blendChromaAvx2(juce::uint8* u, juce::uint8* v, const juce::uint8* row0,
+                                           const juce::uint8* row1, int numPixels)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f), quarter = _mm256_set1_ps(0.25f);
+        const __m256 scale = _mm256_set1_ps(inv255), offset = _mm256_set1_ps(cOffset);
+        const __m256 kuR = _mm256_set1_ps(uR), kuG = _mm256_set1_ps(uG), kuB = _mm256_set1_ps(uB);
+        const __m256 kvR = _mm256_set1_ps(vR), kvG = _mm256_set1_ps(vG), kvB = _mm256_set1_ps(vB);
+
+        int j = 0;
+        for (; 2 * j + 16 <= numPixels; j += 8)
+        {
+            // Per channel, the two rows summed for pixels 0-7 and 8-15
+            __m256i sums[4][2];
+            for (int h = 0; h < 2; ++h)
+            {
+                const int pixel = 2 * j + 8 * h;
+                const __m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 4 * pixel));
+                const __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 4 * pixel));
+
+                for (int c = 0; c < 3; ++c)
+                    sums[c][h] = _mm256_add_epi32(channel(top, 8 * c), channel(bottom, 8 * c));
+                sums[3][h] = _mm256_add_epi32(_mm256_srli_epi32(top, 24), _mm256_srli_epi32(bottom, 24));
+            }
+
+            // hadd pairs neighbouring columns but interleaves the 128-bit lanes; the permute restores the order
+            __m256 averages[4];
+            for (int c = 0; c < 4; ++c)
+                averages[c] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_permute4x64_epi64(_mm256_hadd_epi32(sums[c][0], sums[c][1]), 0xD8)),
+                                            quarter);
+
+            const __m256 b = averages[0], g = averages[1], r = averages[2], a = averages[3];
+            const __m256 keep = _mm256_sub_ps(one, _mm256_mul_ps(a, scale));
+
+            __m256 outU = _mm256_mul_ps(a, offset);
+            outU = _mm256_add_ps(outU, _mm256_mul_ps(r, kuR));
+            outU = _mm256_add_ps(outU, _mm256_mul_ps(g, kuG));
+            outU = _mm256_add_ps(outU, _mm256_mul_ps(b, kuB));
+            outU = _mm256_add_ps(outU, _mm256_mul_ps(loadBytesAsFloats(u + j), keep));
+
+            __m256 outV = _mm256_mul_ps(a, offset);
+            outV = _mm256_add_ps(outV, _mm256_mul_ps(r, kvR));
+            outV = _mm256_add_ps(outV, _mm256_mul_ps(g, kvG));
+            outV = _mm256_add_ps(outV, _mm256_mul_ps(b, kvB));
+            outV = _mm256_add_ps(outV, _mm256_mul_ps(loadBytesAsFloats(v + j), keep));
+
+            store8(u + j, _mm256_cvttps_epi32(_mm256_add_ps(outU, half)));
+            store8(v + j, _mm256_cvttps_epi32(_mm256_add_ps(outV, half)));
+        }
+
+        return j;
+    }
+   #endif
+}
+
+size_t AlphaCompositor::YuvFrame::getSize(int width, int height)
+{
+    const size_t chroma = (size_t) ((width + 1) / 2) * (size_t) ((height + 1) / 2);
+    return (size_t) width * (size_t) height + 2 * chroma;
+}
+
+bool AlphaCompositor::hasVectorKernels()
+{
+   #if FFLUCE_AVX2_KERNELS
+    static const bool available = juce::SystemStats::hasAVX2();
+    return available && vectorKernelsEnabled.load(std::memory_order_relaxed);
+   #else
+    return false;
+   #endif
+}
+
+void AlphaCompositor::setVectorKernelsEnabled(bool shouldBeEnabled)
+{
+    vectorKernelsEnabled = shouldBeEnabled;
+}
+
+void AlphaCompositor::blend(YuvFrame& frame, const OverlayFrame& overlay, int x, int y)
+{
+    x &= ~1;
+    y &= ~1;
+
+    const int left = juce::jmax(0, x);
+    const int top = juce::jmax(0, y);
+    const int right = juce::jmin(frame.width, x + overlay.width);
+    const int bottom = juce::jmin(frame.height, y + overlay.height);
+    if (right <= left || bottom <= top)
+        return;
+
+    const int numPixels = right - left;
+    const size_t overlayStride = (size_t) overlay.width * 4;
+    auto overlayRow = [&](int row) { return overlay.data + (size_t) (row - y) * overlayStride + (size_t) (left - x) * 4; };
+
+    for (int row = top; row < bottom; ++row)
+        blendLumaRow(frame.getY() + (size_t) row * (size_t) frame.width + left, overlayRow(row), numPixels);
+
+    const size_t chromaWidth = (size_t) frame.getChromaWidth();
+    for (int row = top; row < bottom; row += 2)
+    {
+        // An odd last row pairs with itself
+        const juce::uint8* first = overlayRow(row);
+        const juce::uint8* second = row + 1 < bottom ? overlayRow(row + 1) : first;
+        const size_t offset = (size_t) (row / 2) * chromaWidth + (size_t) (left / 2);
+
+        blendChromaRow(frame.getU() + offset, frame.getV() + offset, first, second, numPixels);
+    }
+}
+
+void AlphaCompositor::premultiply(juce::uint8* bgra, size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        juce::uint8* p = bgra + 4 * i;
+        const int a = p[3];
+        if (a == 255)
+            continue;
+
+        for (int c = 0; c < 3; ++c)
+            p[c] = (juce::uint8) ((p[c] * a + 127) / 255);
+    }
+}
+
+void AlphaCompositor::blendLumaRow(juce::uint8* luma, const juce::uint8* bgra, int numPixels)
+{
+    int done = 0;
+   #if FFLUCE_AVX2_KERNELS
+    if (hasVectorKernels())
+        done = blendLumaAvx2(luma, bgra, numPixels);
+   #endif
+    blendLumaScalar(luma, bgra, done, numPixels);
+}
+
+void AlphaCompositor::blendChromaRow(juce::uint8* u, juce::uint8* v, const juce::uint8* bgraRow0,
+                                     const juce::uint8* bgraRow1, int numPixels)
+{
+    int done = 0;
+   #if FFLUCE_AVX2_KERNELS
+    if (hasVectorKernels())
+        done = blendChromaAvx2(u, v, bgraRow0, bgraRow1, numPixels);
+   #endif
+    blendChromaScalar(u, v, bgraRow0, bgraRow1, numPixels, done, (numPixels + 1) / 2);
+}
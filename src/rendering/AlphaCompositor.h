@@ -0,0 +1,64 @@
+#pragma once
+#include <JuceHeader.h>
+
+/**
+ * Blends premultiplied BGRA overlay frames onto planar YUV 4:2:0 frames in memory.
+ *
+ * Only the overlay's bounding box is touched, and the overlay is converted to
+ * BT.709 limited-range YUV while it is blended, so an overlay never needs a
+ * full-frame canvas or a YUVA copy. Rows go through AVX2 kernels when the CPU
+ * has them and through a scalar loop otherwise; both round the same way.
+ */
+class AlphaCompositor
+{
+public:
+    /** A frame in yuv420p layout, the way FFmpeg's rawvideo muxer writes it. */
+    struct YuvFrame
+    {
+        juce::uint8* data = nullptr;
+        int width = 0;
+        int height = 0;
+
+        static size_t getSize(int width, int height);
+
+        int getChromaWidth() const  { return (width + 1) / 2; }
+        int getChromaHeight() const { return (height + 1) / 2; }
+
+        juce::uint8* getY() const { return data; }
+        juce::uint8* getU() const { return data + (size_t) width * (size_t) height; }
+        juce::uint8* getV() const { return getU() + (size_t) getChromaWidth() * (size_t) getChromaHeight(); }
+    };
+
+    /** A frame of premultiplied BGRA pixels with packed rows. */
+    struct OverlayFrame
+    {
+        const juce::uint8* data = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    /**
+     * Draws the overlay with its top-left corner at (x, y). The position is
+     * rounded down to even numbers so the overlay lines up with the chroma
+     * samples, as FFmpeg's overlay filter does, and parts outside the frame are
+     * clipped.
+     */
+    static void blend(YuvFrame& frame, const OverlayFrame& overlay, int x, int y);
+
+    /** Converts straight BGRA pixels, as FFmpeg decodes them, to premultiplied alpha in place. */
+    static void premultiply(juce::uint8* bgra, size_t numPixels);
+
+    /** True if blend() runs the AVX2 kernels on this CPU. */
+    static bool hasVectorKernels();
+
+    /**
+     * Lets blend() use the AVX2 kernels when the CPU has them (the default).
+     * Disabling forces the scalar loop, e.g. to compare the two.
+     */
+    static void setVectorKernelsEnabled(bool shouldBeEnabled);
+
+private:
+    static void blendLumaRow(juce::uint8* luma, const juce::uint8* bgra, int numPixels);
+    static void blendChromaRow(juce::uint8* u, juce::uint8* v, const juce::uint8* bgraRow0,
+                               const juce::uint8* bgraRow1, int numPixels);
+};
@@ -23,6 +23,11 @@ void AudioRenderer::setLogCallback(std::function<void(const juce::String&)> call
     logCallback = callback;
 }
 
+void AudioRenderer::setCancellationToken(CancellationToken::Ptr token)
+{
+    cancellationToken = token;
+}
+
 bool AudioRenderer::renderAudio(const juce::File& outputFile,
                              double durationSeconds,
                              double fadeInDuration,
@@ -128,6 +133,16 @@ bool AudioRenderer::renderAudio(const juce::File& outputFile,
     // Process audio in chunks
     for (juce::int64 chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex)
     {
+        if (cancellationToken != nullptr && cancellationToken->isCancelled())
+        {
+            writer.reset();
+            outputFile.deleteFile();
+            
+            if (logCallback)
+                logCallback("Audio rendering cancelled at chunk " + juce::String(chunkIndex + 1) + " of " + juce::String(numChunks));
+            return false;
+        }
+        
         const juce::int64 startSample = chunkIndex * chunkSize;
         const int currentChunkSize = static_cast<int>(juce::jmin(static_cast<juce::int64>(chunkSize), 
                                                                   totalSamples - startSample));
@@ -4,6 +4,7 @@
 #include "../audio/FilePlayerAudioSource.h"
 #include "../audio/NoiseAudioSource.h"
 #include "RenderTypes.h"
+#include "CancellationToken.h"
 
 /**
  * Handles the rendering of audio from binaural, file, and noise sources.
@@ -31,6 +32,12 @@ public:
      */
     void setLogCallback(std::function<void(const juce::String&)> logCallback);
     
+    /**
+     * Sets the cancellation token checked between rendered chunks.
+     * @param token The render's token, or nullptr to detach
+     */
+    void setCancellationToken(CancellationToken::Ptr token);
+    
     /**
      * Renders audio to a file.
      * @param outputFile The file to save the audio to
@@ -100,5 +107,8 @@ private:
     // Log callback
     std::function<void(const juce::String&)> logCallback;
     
+    // Cancellation token of the current render
+    CancellationToken::Ptr cancellationToken;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioRenderer)
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "CancellationToken.h"
+
+void CancellationToken::cancel()
+{
+    std::map<int, std::function<void()>> toRun;
+
+    {
+        const juce::ScopedLock sl(callbackLock);
+
+        if (cancelled.load())
+            return;
+
+        cancelTimeMs.store(juce::Time::getMillisecondCounterHiRes());
+        cancelled.store(true, std::memory_order_release);
+        toRun.swap(callbacks);
+    }
+
+    // Run outside the lock so callbacks may touch the token themselves
+    for (auto& [id, callback] : toRun)
+        if (callback)
+            callback();
+}
+
+double CancellationToken::getMillisecondsSinceCancel() const
+{
+    if (!isCancelled())
+        return 0.0;
+
+    return juce::Time::getMillisecondCounterHiRes() - cancelTimeMs.load();
+}
+
+int CancellationToken::addCallback(std::function<void()> callback)
+{
+    {
+        const juce::ScopedLock sl(callbackLock);
+
+        if (!cancelled.load())
+        {
+            const int id = nextCallbackId++;
+            callbacks[id] = std::move(callback);
+            return id;
+        }
+    }
+
+    if (callback)
+        callback();
+
+    return 0;
+}
+
+void CancellationToken::removeCallback(int callbackId)
+{
+    const juce::ScopedLock sl(callbackLock);
+    callbacks.erase(callbackId);
+}
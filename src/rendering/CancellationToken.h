@@ -0,0 +1,64 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <map>
+#include <memory>
+
+/**
+ * Shared cancellation flag for one render.
+ *
+ * Created by whoever owns the render and handed to every component that loops
+ * or launches FFmpeg. Components poll isCancelled() in their loops; anything
+ * that blocks (e.g. waiting on a child process) registers a callback so it is
+ * woken immediately rather than at its next poll.
+ *
+ * Once cancelled a token stays cancelled - start a new render with a new token.
+ */
+class CancellationToken
+{
+public:
+    using Ptr = std::shared_ptr<CancellationToken>;
+
+    /** Longest a render may take from cancel() until every process it started is reaped. */
+    static constexpr double idleLatencyBudgetMs = 2000.0;
+
+    static Ptr create() { return std::make_shared<CancellationToken>(); }
+
+    CancellationToken() = default;
+
+    /**
+     * Requests cancellation and runs the registered callbacks. Safe to call from
+     * any thread and more than once; only the first call has an effect.
+     */
+    void cancel();
+
+    /** Returns true once cancel() has been called. */
+    bool isCancelled() const noexcept { return cancelled.load(std::memory_order_acquire); }
+
+    /**
+     * Milliseconds since cancel() was called (using the hi-res counter), or 0
+     * if the token hasn't been cancelled.
+     */
+    double getMillisecondsSinceCancel() const;
+
+    /**
+     * Registers a callback to run when the token is cancelled. If it already is,
+     * the callback runs immediately on the calling thread.
+     *
+     * @return An id to pass to removeCallback()
+     */
+    int addCallback(std::function<void()> callback);
+
+    /** Removes a callback registered with addCallback(). */
+    void removeCallback(int callbackId);
+
+private:
+    std::atomic<bool> cancelled { false };
+    std::atomic<double> cancelTimeMs { 0.0 };
+
+    juce::CriticalSection callbackLock;
+    std::map<int, std::function<void()>> callbacks;
+    int nextCallbackId = 1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CancellationToken)
+};
@@ -108,6 +108,10 @@ bool ClipProcessor::prepareVideoClips(const std::vector<RenderTypes::VideoClipIn
     // Process each clip
     for (size_t i = 0; i < sourceClips.size(); ++i)
     {
+        // Failed clips are skipped below, so stop explicitly rather than skipping the rest one by one
+        if (ffmpegExecutor->isCancellationRequested())
+            return false;
+
         const auto& clipInfo = sourceClips[i];
         
         if (logCallback)
@@ -125,10 +129,6 @@ bool ClipProcessor::prepareVideoClips(const std::vector<RenderTypes::VideoClipIn
         juce::String prefix = clipInfo.isIntroClip ? "intro" : "loop";
         juce::File outputFile = tempDirectory.getChildFile(prefix + "_clip_" + juce::String(i) + ".mp4");
         
-        // Build FFmpeg command
-        juce::String encodingParams = buildEncodingParams(useNvidiaAcceleration ? tempNvidiaParams : tempCpuParams,
-                                                         useNvidiaAcceleration);
-        
         // Validate duration before building command
         if (clipInfo.duration <= 0.001) {
             if (logCallback)
@@ -139,57 +139,30 @@ bool ClipProcessor::prepareVideoClips(const std::vector<RenderTypes::VideoClipIn
         if (logCallback)
             logCallback("Processing clip with duration: " + juce::String(clipInfo.duration, 3) + " seconds");
             
-        juce::String command = ffmpegExecutor->getFFmpegPath();
-        command += " -y";                                // Overwrite output
-        command += " -i \"" + clipInfo.file.getFullPathName() + "\"";
-        command += " -t " + juce::String(clipInfo.duration, 3); // Exact duration with fixed precision
-        command += " ";
-        command += encodingParams;
-        command += " -pix_fmt yuv420p";                  // Ensure compatibility with players
-        command += " -an";                               // No audio for clips
-        command += " -movflags +faststart";              // Optimize for web streaming
-        command += " \"" + outputFile.getFullPathName() + "\"";
-        
-        // Execute the command
-        bool commandSucceeded = false;
-        
-        if (!ffmpegExecutor->executeCommand(command, 0.0, 1.0))
+        // Build FFmpeg command for whichever encoder and flags this attempt uses
+        auto buildCommand = [&](const FallbackPolicy::JobOptions& options)
         {
-            if (logCallback)
-                logCallback("ERROR: Failed to process clip " + clipInfo.file.getFileName());
-            
-            // If NVENC failed, try with CPU as fallback
-            if (useNvidiaAcceleration)
-            {
-                if (logCallback)
-                    logCallback("  NVENC failed, trying CPU encoding as fallback");
-                
-                juce::String cpuEncoding = buildEncodingParams(tempCpuParams, false);
-                
-                command = ffmpegExecutor->getFFmpegPath();
-                command += " -y";                                // Overwrite output
-                command += " -i \"" + clipInfo.file.getFullPathName() + "\"";
-                command += " -t " + juce::String(clipInfo.duration, 3); // Exact duration with fixed precision
-                command += " ";
-                command += cpuEncoding;
-                command += " -pix_fmt yuv420p";                   // Ensure compatibility with players
-                command += " -an";                                // No audio for clips
-                command += " -movflags +faststart";               // Optimize for web streaming
-                command += " \"" + outputFile.getFullPathName() + "\"";
-                    
-                if (logCallback)
-                    logCallback("  Trying CPU fallback with duration: " + juce::String(clipInfo.duration, 3));
-                
-                commandSucceeded = ffmpegExecutor->executeCommand(command, 0.0, 1.0);
-                
-                if (!commandSucceeded && logCallback)
-                    logCallback("ERROR: CPU fallback also failed for clip " + clipInfo.file.getFileName());
-            }
-        }
-        else
-        {
-            commandSucceeded = true;
-        }
+            juce::String command = ffmpegExecutor->getFFmpegPath();
+            command += " -y";                                // Overwrite output
+            if (options.tolerantDecode)
+                command += " " + options.getInputFlags();
+            command += " -i \"" + clipInfo.file.getFullPathName() + "\"";
+            command += " -t " + juce::String(clipInfo.duration, 3); // Exact duration with fixed precision
+            command += " ";
+            command += buildEncodingParams(options.useGpuEncoder ? tempNvidiaParams : tempCpuParams,
+                                           options.useGpuEncoder);
+            command += " -pix_fmt yuv420p";                  // Ensure compatibility with players
+            command += " -an";                               // No audio for clips
+            command += " -movflags +faststart";              // Optimize for web streaming
+            if (options.getOutputFlags().isNotEmpty())
+                command += " " + options.getOutputFlags();
+            command += " \"" + outputFile.getFullPathName() + "\"";
+            return command;
+        };
+        
+        // Execute the command, falling back (e.g. NVENC -> CPU) as the policy decides
+        const bool commandSucceeded = ffmpegExecutor->executeWithFallback(buildCommand, useNvidiaAcceleration, outputFile,
+                                                                          "Clip " + clipInfo.file.getFileName(), 0.0, 1.0);
         
         // Verify the output file was created correctly
         if (commandSucceeded && outputFile.existsAsFile() && outputFile.getSize() > 0)
@@ -0,0 +1,269 @@
+#include "DiskBudget.h"
+
+namespace
+{
+    constexpr juce::int64 defaultReserveMegabytes = 1024;
+
+    juce::String getFileKey(const juce::File& file)
+    {
+        return file.getFullPathName();
+    }
+
+    juce::String describeBytes(juce::int64 bytes)
+    {
+        return juce::File::descriptionOfSizeInBytes(juce::jmax((juce::int64) 0, bytes));
+    }
+}
+
+DiskBudget::DiskBudget()
+{
+    const juce::String reserveOverride = juce::SystemStats::getEnvironmentVariable("FFLUCE_DISK_RESERVE_MB", {});
+    const juce::int64 megabytes = reserveOverride.isNotEmpty() ? reserveOverride.getLargeIntValue() : defaultReserveMegabytes;
+    reserveBytes = juce::jmax((juce::int64) 0, megabytes) * 1024 * 1024;
+}
+
+void DiskBudget::setRates(double intermediateBytesPerSecond, double deliveryBytesPerSecond)
+{
+    intermediateRate = juce::jmax(0.0, intermediateBytesPerSecond);
+    deliveryRate = juce::jmax(0.0, deliveryBytesPerSecond);
+}
+
+juce::int64 DiskBudget::predictBytes(RenderGraph::TaskType type, double mediaSeconds) const
+{
+    const bool deliveryEncoded = type == RenderGraph::TaskType::Encode
+                              || type == RenderGraph::TaskType::Mux;
+
+    return (juce::int64) (juce::jmax(0.0, mediaSeconds) * (deliveryEncoded ? deliveryRate : intermediateRate));
+}
+
+double DiskBudget::parseBitrate(const juce::String& encodeArgs)
+{
+    juce::StringArray tokens;
+    tokens.addTokens(encodeArgs, " ", "\"");
+    tokens.removeEmptyStrings();
+
+    for (const juce::String option : { "-maxrate", "-b:v" })
+    {
+        const int index = tokens.indexOf(option);
+        if (index < 0 || index + 1 >= tokens.size())
+            continue;
+
+        const juce::String value = tokens[index + 1].trim();
+        double multiplier = 1.0;
+        switch (value.getLastCharacter())
+        {
+            case 'k': case 'K': multiplier = 1.0e3; break;
+            case 'm': case 'M': multiplier = 1.0e6; break;
+            case 'g': case 'G': multiplier = 1.0e9; break;
+            default: break;
+        }
+
+        const double bitsPerSecond = value.getDoubleValue() * multiplier;
+        if (bitsPerSecond > 0.0)
+            return bitsPerSecond;
+    }
+
+    return 0.0;
+}
+
+//==============================================================================
+bool DiskBudget::plan(const RenderGraph& graph, const juce::File& tempDirectory, juce::String& error)
+{
+    volumes.clear();
+    placements.clear();
+    remainingReaders.clear();
+
+    volumes.push_back({ tempDirectory, tempDirectory.getBytesFreeOnVolume() - reserveBytes });
+
+    juce::StringArray spillPaths;
+   #if JUCE_WINDOWS
+    spillPaths.addTokens(juce::SystemStats::getEnvironmentVariable("FFLUCE_SPILL_DIRS", {}), ";", "");
+   #else
+    spillPaths.addTokens(juce::SystemStats::getEnvironmentVariable("FFLUCE_SPILL_DIRS", {}), ":", "");
+   #endif
+
+    for (const auto& path : spillPaths)
+    {
+        if (path.isEmpty() || !juce::File::isAbsolutePath(path))
+            continue;
+
+        // A directory of our own, so cleanupSpills() can't touch anybody else's files
+        const juce::File directory = juce::File(path).getChildFile("ffluce_spill_" + tempDirectory.getFileName());
+        if (directory.createDirectory().wasOk())
+            volumes.push_back({ directory, directory.getBytesFreeOnVolume() - reserveBytes });
+    }
+
+    // Every file a task reads before it can go, counting only readers that will run
+    for (int taskId : graph.getTopologicalOrder())
+    {
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        if (task.state == RenderGraph::TaskState::Skip)
+            continue;
+
+        for (const auto& input : task.inputs)
+            if (graph.getProducer(input) >= 0)
+                ++remainingReaders[getFileKey(input)];
+    }
+
+    // Replay the graph one task at a time, as the scheduler would with a single worker
+    std::map<juce::String, std::pair<juce::int64, int>> live;   // file path -> size, volume
+    std::vector<juce::int64> used(volumes.size(), 0);
+    std::map<juce::String, int> readers = remainingReaders;
+
+    for (int taskId : graph.getTopologicalOrder())
+    {
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        if (task.state == RenderGraph::TaskState::Skip || task.outputs.isEmpty())
+            continue;
+
+        const juce::int64 bytesPerOutput = task.outputBytes / task.outputs.size();
+
+        for (const auto& output : task.outputs)
+        {
+            // The delivered file goes wherever the user asked for it
+            if (!output.isAChildOf(tempDirectory))
+            {
+                const juce::int64 available = output.getParentDirectory().getBytesFreeOnVolume() - reserveBytes;
+                if (bytesPerOutput > available)
+                {
+                    error = output.getFileName() + " needs about " + describeBytes(bytesPerOutput) + " but its volume has "
+                            + describeBytes(available) + " free";
+                    return false;
+                }
+                continue;
+            }
+
+            size_t volume = 0;
+            while (volume < volumes.size() && used[volume] + bytesPerOutput > volumes[volume].freeBytes)
+                ++volume;
+
+            if (volume == volumes.size())
+            {
+                error = "the render needs about " + describeBytes(used[0] + bytesPerOutput) + " of scratch space by "
+                        + task.name + " but " + tempDirectory.getFullPathName() + " has "
+                        + describeBytes(volumes[0].freeBytes) + " free"
+                        + (volumes.size() > 1 ? " and the spill directories are full too" : " (set FFLUCE_SPILL_DIRS to spill elsewhere)");
+                return false;
+            }
+
+            if (volume > 0)
+                placements[getFileKey(output)] = (int) volume;
+
+            used[volume] += bytesPerOutput;
+            volumes[volume].peakBytes = juce::jmax(volumes[volume].peakBytes, used[volume]);
+            live[getFileKey(output)] = { bytesPerOutput, (int) volume };
+        }
+
+        for (const auto& input : task.inputs)
+        {
+            auto reader = readers.find(getFileKey(input));
+            if (reader == readers.end() || --reader->second > 0)
+                continue;
+
+            auto file = live.find(reader->first);
+            if (file != live.end())
+            {
+                used[(size_t) file->second.second] -= file->second.first;
+                live.erase(file);
+            }
+        }
+    }
+
+    return true;
+}
+
+juce::String DiskBudget::describe() const
+{
+    juce::String text;
+    text << "Disk budget: " << describeBytes(intermediateRate) << "/s of media for intermediates, "
+         << describeBytes(deliveryRate) << "/s for delivery encodes\n";
+
+    for (size_t i = 0; i < volumes.size(); ++i)
+        text << (i == 0 ? "  temp  " : "  spill ") << volumes[i].directory.getFullPathName()
+             << ": peak " << describeBytes(volumes[i].peakBytes) << " of " << describeBytes(volumes[i].freeBytes) << " available\n";
+
+    for (const auto& [path, volume] : placements)
+        text << "  " << juce::File(path).getFileName() << " -> " << volumes[(size_t) volume].directory.getFullPathName() << "\n";
+
+    return text;
+}
+
+//==============================================================================
+void DiskBudget::attach(RenderGraph& graph)
+{
+    for (int taskId = 0; taskId < graph.getNumTasks(); ++taskId)
+    {
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        if (task.state == RenderGraph::TaskState::Skip)
+            continue;
+
+        auto run = task.run;
+        graph.setTaskRunner(taskId, task.state, task.estimatedSeconds,
+                            [this, &task, run]
+                            {
+                                if (!prepareOutputs(task) || !run())
+                                    return false;
+                                releaseInputs(task);
+                                return true;
+                            });
+    }
+}
+
+bool DiskBudget::prepareOutputs(const RenderGraph::Task& task)
+{
+    for (const auto& output : task.outputs)
+    {
+        auto placement = placements.find(getFileKey(output));
+        if (placement == placements.end())
+            continue;
+
+        const juce::File target = volumes[(size_t) placement->second].directory.getChildFile(output.getFileName());
+        target.deleteFile();
+
+        // FFmpeg writes through the link; a step that replaces the file just keeps it local
+        if (!target.createSymbolicLink(output, true))
+        {
+            if (logCallback)
+                logCallback("WARNING: Could not spill " + output.getFileName() + " to " + target.getParentDirectory().getFullPathName());
+            continue;
+        }
+
+        const juce::ScopedLock sl(lock);
+        spilledFiles.add(target);
+    }
+
+    return true;
+}
+
+void DiskBudget::releaseInputs(const RenderGraph::Task& task)
+{
+    juce::Array<juce::File> finished;
+    {
+        const juce::ScopedLock sl(lock);
+        for (const auto& input : task.inputs)
+        {
+            auto reader = remainingReaders.find(getFileKey(input));
+            if (reader != remainingReaders.end() && --reader->second == 0)
+                finished.add(input);
+        }
+    }
+
+    for (const auto& file : finished)
+    {
+        if (file.isSymbolicLink())
+            file.getLinkedTarget().deleteFile();
+        file.deleteFile();
+    }
+}
+
+void DiskBudget::cleanupSpills()
+{
+    const juce::ScopedLock sl(lock);
+
+    for (const auto& file : spilledFiles)
+        file.deleteFile();
+    spilledFiles.clear();
+
+    for (size_t i = 1; i < volumes.size(); ++i)
+        volumes[i].directory.deleteRecursively();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RenderGraph.h"
+#include <functional>
+#include <map>
+#include <vector>
+
+/**
+ * Scratch-space accounting for a render graph.
+ *
+ * Before anything runs, plan() walks the graph in dependency order with each
+ * task's predicted output size (RenderGraph::setOutputBytes), freeing every
+ * intermediate once its last consumer is done, to find the peak the temp
+ * volume has to hold. A render that can't fit fails there instead of hours
+ * later with ENOSPC.
+ *
+ * When the temp volume is short, outputs are spilled to the spill directories
+ * (FFLUCE_SPILL_DIRS, separated like PATH, e.g. a tmpfs and then a second disk)
+ * in order: the file is created there and symlinked into the temp directory,
+ * so the render steps keep using the paths they planned with.
+ *
+ * While the graph runs, attach() makes every task delete its inputs as soon as
+ * the last task reading them has finished.
+ */
+class DiskBudget
+{
+public:
+    /** Reads FFLUCE_SPILL_DIRS and FFLUCE_DISK_RESERVE_MB (free space to leave, 1024 by default). */
+    DiskBudget();
+
+    void setLogCallback(std::function<void(const juce::String&)> callback) { logCallback = std::move(callback); }
+
+    /** Sets the bytes per second of media written by lossless and by delivery-encoded tasks. */
+    void setRates(double intermediateBytesPerSecond, double deliveryBytesPerSecond);
+
+    /** Predicted size of a task's outputs for the given seconds of media. */
+    juce::int64 predictBytes(RenderGraph::TaskType type, double mediaSeconds) const;
+
+    /**
+     * Simulates the resolved graph, decides which outputs to spill and checks
+     * that every volume has room.
+     * @param error Set to what doesn't fit
+     * @return false if the render would run out of space
+     */
+    bool plan(const RenderGraph& graph, const juce::File& tempDirectory, juce::String& error);
+
+    /** Returns the prediction and placements for logs and dry runs. */
+    juce::String describe() const;
+
+    /**
+     * Wraps every task of the graph so that spilled outputs are linked into
+     * place before it runs and inputs nobody reads any more are deleted after.
+     */
+    void attach(RenderGraph& graph);
+
+    /** Deletes whatever is left in the spill directories. */
+    void cleanupSpills();
+
+    /** Parses -maxrate, or failing that -b:v, from encoder arguments; 0 if neither is set. */
+    static double parseBitrate(const juce::String& encodeArgs);
+
+private:
+    struct Volume
+    {
+        juce::File directory;
+        juce::int64 freeBytes = 0;
+        juce::int64 peakBytes = 0;
+    };
+
+    bool prepareOutputs(const RenderGraph::Task& task);
+    void releaseInputs(const RenderGraph::Task& task);
+
+    double intermediateRate = 0.0;
+    double deliveryRate = 0.0;
+    juce::int64 reserveBytes = 0;
+
+    std::vector<Volume> volumes;                    // the temp directory first, then the spill directories
+    std::map<juce::String, int> placements;         // file path -> volume index, for spilled files only
+    std::map<juce::String, int> remainingReaders;   // file path -> tasks yet to read it
+
+    juce::CriticalSection lock;
+    juce::Array<juce::File> spilledFiles;
+
+    std::function<void(const juce::String&)> logCallback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiskBudget)
+};
@@ -0,0 +1,627 @@
+#include "EncoderCapabilities.h"
+#include "IntermediateFormat.h"
+
+#if JUCE_WINDOWS
+ #define NOMINMAX
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+#endif
+
+namespace
+{
+    // Bump when the probe itself changes so old caches are ignored
+    constexpr int probeVersion = 4;
+
+    constexpr int testFrameCount = 120;
+    constexpr int testTimeoutMs = 30000;
+
+    // Intermediates are timed at delivery size; noise keeps the lossless codecs
+    // from compressing the test pattern far better than real footage
+    constexpr int intermediateFrameCount = 60;
+    const juce::String intermediateSource = "testsrc2=size=1920x1080:rate=30,noise=alls=8:allf=t";
+
+    constexpr int diskTestBytes = 256 * 1024 * 1024;
+    constexpr int diskChunkBytes = 4 * 1024 * 1024;
+
+    juce::String getLastLine(const juce::String& output, const juce::String& fallback)
+    {
+        juce::StringArray lines;
+        lines.addLines(output.trim());
+        return lines.size() > 0 ? lines[lines.size() - 1] : fallback;
+    }
+
+    // For listing commands: these finish quickly but can print more than a pipe
+    // buffer, so drain the output before waiting
+    juce::String runAndCapture(const juce::StringArray& args)
+    {
+        juce::ChildProcess process;
+        if (!process.start(args))
+            return {};
+
+        juce::String output = process.readAllProcessOutput();
+        process.waitForProcessToFinish(5000);
+        return output;
+    }
+
+    // For test encodes: output is limited to errors, but a broken driver can hang,
+    // so wait with a timeout and kill on expiry
+    bool runWithTimeout(const juce::StringArray& args, int timeoutMs, juce::String& output)
+    {
+        juce::ChildProcess process;
+        if (!process.start(args))
+        {
+            output = "failed to launch FFmpeg";
+            return false;
+        }
+
+        if (!process.waitForProcessToFinish(timeoutMs))
+        {
+            process.kill();
+            output = "test encode timed out";
+            return false;
+        }
+
+        output = process.readAllProcessOutput();
+        return process.getExitCode() == 0;
+    }
+
+    // Extra arguments some hardware encoders need to accept frames from the lavfi source
+    juce::StringArray getEncoderSetupArgs(const juce::String& encoderName)
+    {
+        if (encoderName.endsWith("_vaapi"))
+            return { "-vaapi_device", "/dev/dri/renderD128", "-vf", "format=nv12,hwupload" };
+
+        if (encoderName.endsWith("_qsv"))
+            return { "-pix_fmt", "nv12" };
+
+        return { "-pix_fmt", "yuv420p" };
+    }
+}
+
+//==============================================================================
+const EncoderCapabilities::EncoderResult* EncoderCapabilities::Report::find(const juce::String& encoderName) const
+{
+    for (const auto& result : encoders)
+        if (result.name == encoderName)
+            return &result;
+
+    return nullptr;
+}
+
+bool EncoderCapabilities::Report::isListed(const juce::String& encoderName) const
+{
+    auto* result = find(encoderName);
+    return result != nullptr && result->listed;
+}
+
+bool EncoderCapabilities::Report::isWorking(const juce::String& encoderName) const
+{
+    auto* result = find(encoderName);
+    return result != nullptr && result->working;
+}
+
+const EncoderCapabilities::IntermediateResult* EncoderCapabilities::Report::findIntermediate(const juce::String& profileName) const
+{
+    for (const auto& result : intermediates)
+        if (result.name == profileName)
+            return &result;
+
+    return nullptr;
+}
+
+double EncoderCapabilities::Report::getFramesPerSecond(const juce::String& encoderName) const
+{
+    auto* result = find(encoderName);
+    return result != nullptr ? result->framesPerSecond : 0.0;
+}
+
+//==============================================================================
+juce::StringArray EncoderCapabilities::getCandidateEncoders()
+{
+    return { "libx264", "libx265", "libsvtav1", "h264_nvenc", "h264_vaapi", "h264_qsv" };
+}
+
+void EncoderCapabilities::setLogCallback(std::function<void(const juce::String&)> callback)
+{
+    juce::ScopedLock sl(probeLock);
+    logCallback = callback;
+}
+
+void EncoderCapabilities::log(const juce::String& message) const
+{
+    if (logCallback)
+        logCallback(message);
+    else
+        juce::Logger::writeToLog("[CAPABILITIES] " + message);
+}
+
+EncoderCapabilities::Report EncoderCapabilities::getReport(const juce::String& ffmpegPath)
+{
+    juce::ScopedLock sl(probeLock);
+
+    if (hasReport && reportPath == ffmpegPath)
+        return currentReport;
+
+    const juce::File binary = resolveExecutable(ffmpegPath);
+    const juce::String binaryHash = binary.existsAsFile()
+        ? juce::SHA256(binary).toHexString()
+        : juce::String("unresolved:" + ffmpegPath);
+
+    Report report;
+    if (loadCache(binaryHash, report))
+    {
+        log("Loaded encoder capabilities from cache (probed " + report.probedAt.toString(true, true) + ")");
+    }
+    else
+    {
+        report = runProbe(ffmpegPath, binaryHash);
+        saveCache(report);
+    }
+
+    currentReport = report;
+    reportPath = ffmpegPath;
+    hasReport = true;
+    return currentReport;
+}
+
+EncoderCapabilities::Report EncoderCapabilities::refresh(const juce::String& ffmpegPath)
+{
+    {
+        juce::ScopedLock sl(probeLock);
+        hasReport = false;
+        getCacheFile().deleteFile();
+    }
+
+    {
+        juce::ScopedLock sl(diskLock);
+        diskBandwidths.clear();
+        getDiskCacheFile().deleteFile();
+    }
+
+    return getReport(ffmpegPath);
+}
+
+void EncoderCapabilities::probeInBackground(const juce::String& ffmpegPath)
+{
+    juce::Thread::launch([ffmpegPath]
+    {
+        EncoderCapabilities::getInstance().getReport(ffmpegPath);
+    });
+}
+
+//==============================================================================
+EncoderCapabilities::Report EncoderCapabilities::runProbe(const juce::String& ffmpegPath, const juce::String& binaryHash)
+{
+    Report report;
+    report.ffmpegHash = binaryHash;
+    report.probedAt = juce::Time::getCurrentTime();
+
+    log("Probing FFmpeg encoder capabilities: " + ffmpegPath);
+
+    const juce::String encoderList = runAndCapture({ ffmpegPath, "-hide_banner", "-encoders" });
+
+    juce::StringArray listedEncoders;
+    {
+        juce::StringArray lines;
+        lines.addLines(encoderList);
+
+        // Encoder lines look like " V....D libx264    libx264 H.264 / AVC ..."
+        for (const auto& line : lines)
+        {
+            juce::StringArray tokens;
+            tokens.addTokens(line.trim(), " ", "");
+            tokens.removeEmptyStrings();
+
+            if (tokens.size() >= 2 && tokens[0].length() == 6 && tokens[0].startsWithChar('V'))
+                listedEncoders.add(tokens[1]);
+        }
+    }
+
+    const juce::String hwaccelList = runAndCapture({ ffmpegPath, "-hide_banner", "-hwaccels" });
+    {
+        juce::StringArray lines;
+        lines.addLines(hwaccelList);
+
+        bool inList = false;
+        for (const auto& line : lines)
+        {
+            const juce::String trimmed = line.trim();
+            if (trimmed.startsWithIgnoreCase("Hardware acceleration methods"))
+                inList = true;
+            else if (inList && trimmed.isNotEmpty())
+                report.hardwareAccelerators.add(trimmed);
+        }
+    }
+
+    for (const auto& name : getCandidateEncoders())
+    {
+        EncoderResult result;
+
+        if (listedEncoders.contains(name))
+        {
+            result = probeEncoder(ffmpegPath, name);
+        }
+        else
+        {
+            result.name = name;
+            result.failureReason = "not compiled into this FFmpeg build";
+        }
+
+        log("  " + name + ": " + (result.working
+                                    ? "working, " + juce::String(result.framesPerSecond, 1) + " fps"
+                                    : "unavailable (" + result.failureReason + ")"));
+        report.encoders.push_back(result);
+    }
+
+    if (report.hardwareAccelerators.size() > 0)
+        log("  hwaccels: " + report.hardwareAccelerators.joinIntoString(", "));
+
+    for (const auto& profile : IntermediateFormat::getProfiles())
+    {
+        const IntermediateResult result = probeIntermediate(ffmpegPath, profile.name, profile.codecArgs, profile.extension);
+
+        log("  intermediate " + profile.name + ": " + (result.working
+                                                       ? juce::String(result.framesPerSecond, 1) + " fps round trip, "
+                                                             + juce::File::descriptionOfSizeInBytes((juce::int64) result.bytesPerFrame) + "/frame"
+                                                       : "unavailable (" + result.failureReason + ")"));
+        report.intermediates.push_back(result);
+    }
+
+    report.cudaFilters = probeCudaFilters(ffmpegPath, report, report.cudaFailureReason);
+    log("  CUDA filters: " + (report.cudaFilters ? juce::String("working") : "unavailable (" + report.cudaFailureReason + ")"));
+
+    return report;
+}
+
+EncoderCapabilities::EncoderResult EncoderCapabilities::probeEncoder(const juce::String& ffmpegPath, const juce::String& encoderName)
+{
+    EncoderResult result;
+    result.name = encoderName;
+    result.listed = true;
+
+    juce::StringArray args { ffmpegPath, "-hide_banner", "-nostdin", "-loglevel", "error", "-y",
+                             "-f", "lavfi", "-i", "testsrc2=size=1280x720:rate=30",
+                             "-frames:v", juce::String(testFrameCount) };
+    args.addArray(getEncoderSetupArgs(encoderName));
+    args.addArray({ "-c:v", encoderName, "-f", "null", "-" });
+
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+    juce::String output;
+    const bool ok = runWithTimeout(args, testTimeoutMs, output);
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+
+    if (!ok)
+    {
+        result.failureReason = getLastLine(output, "test encode failed");
+        return result;
+    }
+
+    result.working = true;
+    result.framesPerSecond = elapsedSeconds > 0.0 ? testFrameCount / elapsedSeconds : 0.0;
+    return result;
+}
+
+EncoderCapabilities::IntermediateResult EncoderCapabilities::probeIntermediate(const juce::String& ffmpegPath,
+                                                                               const juce::String& profileName,
+                                                                               const juce::String& codecArgs,
+                                                                               const juce::String& extension)
+{
+    IntermediateResult result;
+    result.name = profileName;
+
+    const juce::File testFile = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                    .getNonexistentChildFile("ffluce_intermediate_probe", extension, false);
+
+    juce::StringArray encodeArgs { ffmpegPath, "-hide_banner", "-nostdin", "-loglevel", "error", "-y",
+                                   "-f", "lavfi", "-i", intermediateSource,
+                                   "-frames:v", juce::String(intermediateFrameCount), "-pix_fmt", "yuv420p" };
+    encodeArgs.addTokens(codecArgs, " ", "\"");
+    encodeArgs.removeEmptyStrings();
+    encodeArgs.add(testFile.getFullPathName());
+
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+    juce::String output;
+    bool ok = runWithTimeout(encodeArgs, testTimeoutMs, output);
+
+    if (ok)
+    {
+        result.bytesPerFrame = (double) testFile.getSize() / intermediateFrameCount;
+        ok = runWithTimeout({ ffmpegPath, "-hide_banner", "-nostdin", "-loglevel", "error",
+                              "-i", testFile.getFullPathName(), "-f", "null", "-" },
+                            testTimeoutMs, output);
+    }
+
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    testFile.deleteFile();
+
+    if (!ok)
+    {
+        result.failureReason = getLastLine(output, "test encode failed");
+        return result;
+    }
+
+    result.working = true;
+    result.framesPerSecond = elapsedSeconds > 0.0 ? intermediateFrameCount / elapsedSeconds : 0.0;
+    return result;
+}
+
+bool EncoderCapabilities::probeCudaFilters(const juce::String& ffmpegPath, const Report& report, juce::String& failureReason)
+{
+    // Without these the graph can't start, and a GPU-less machine gets the CPU profile
+    if (!report.hardwareAccelerators.contains("cuda"))
+    {
+        failureReason = "no cuda hwaccel in this FFmpeg build";
+        return false;
+    }
+
+    if (!report.isWorking("h264_nvenc"))
+    {
+        failureReason = "h264_nvenc is not working";
+        return false;
+    }
+
+    // Every filter the GPU profile uses, on uploaded frames, straight into the encoder
+    const juce::String graph = "[0:v]format=yuv420p,hwupload_cuda,scale_cuda=1280:720:format=yuv420p[a];"
+                               "[1:v]format=yuv420p,hwupload_cuda,scale_cuda=1280:720:format=yuv420p[b];"
+                               "[a][b]xfade_cuda=transition=fade:duration=0.5:offset=0.25[x];"
+                               "[2:v]format=yuva420p,hwupload_cuda[o];"
+                               "[x][o]overlay_cuda=x=0:y=0:eof_action=pass[v]";
+
+    juce::String output;
+    if (!runWithTimeout({ ffmpegPath, "-hide_banner", "-nostdin", "-loglevel", "error", "-y",
+                          "-init_hw_device", "cuda=cu", "-filter_hw_device", "cu",
+                          "-f", "lavfi", "-i", "testsrc2=size=640x360:rate=30:duration=1",
+                          "-f", "lavfi", "-i", "testsrc2=size=640x360:rate=30:duration=1",
+                          "-f", "lavfi", "-i", "color=black@0.5:size=320x180:rate=30:duration=1",
+                          "-filter_complex", graph, "-map", "[v]", "-c:v", "h264_nvenc", "-f", "null", "-" },
+                        testTimeoutMs, output))
+    {
+        failureReason = getLastLine(output, "CUDA filter test failed");
+        return false;
+    }
+
+    return true;
+}
+
+double EncoderCapabilities::getDiskBandwidth(const juce::File& directory)
+{
+    juce::ScopedLock sl(diskLock);
+
+    const juce::String volume = getVolumeKey(directory);
+    const juce::File cacheFile = getDiskCacheFile();
+
+    if (diskBandwidths.empty())
+    {
+        const juce::var json = juce::JSON::parse(cacheFile.loadFileAsString());
+        if (auto* volumes = json.getDynamicObject())
+            for (const auto& entry : volumes->getProperties())
+                diskBandwidths[entry.name.toString()] = (double) entry.value;
+    }
+
+    const auto cached = diskBandwidths.find(volume);
+    if (cached != diskBandwidths.end())
+        return cached->second;
+
+    const double bytesPerSecond = measureDiskBandwidth(directory);
+    log("Disk write speed of " + directory.getFullPathName() + ": "
+        + juce::File::descriptionOfSizeInBytes((juce::int64) bytesPerSecond) + "/s");
+
+    // A failed measurement isn't cached, so the next render tries again
+    if (bytesPerSecond <= 0.0)
+        return 0.0;
+
+    diskBandwidths[volume] = bytesPerSecond;
+
+    auto* root = new juce::DynamicObject();
+    juce::var rootVar(root);
+    for (const auto& entry : diskBandwidths)
+        root->setProperty(juce::Identifier(entry.first), entry.second);
+
+    cacheFile.getParentDirectory().createDirectory();
+    cacheFile.replaceWithText(juce::JSON::toString(rootVar));
+    return bytesPerSecond;
+}
+
+double EncoderCapabilities::measureDiskBandwidth(const juce::File& directory)
+{
+    const juce::File testFile = directory.getNonexistentChildFile("ffluce_disk_probe", ".bin", false);
+
+    juce::MemoryBlock chunk((size_t) diskChunkBytes);
+    juce::Random::getSystemRandom().fillBitsRandomly(chunk.getData(), chunk.getSize());
+
+    // The timer stops only once the data is on the disk; a flush alone would
+    // measure the page cache
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+    bool ok = false;
+
+   #if JUCE_WINDOWS
+    HANDLE handle = CreateFileW(testFile.getFullPathName().toWideCharPointer(), GENERIC_WRITE, 0, nullptr,
+                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        ok = true;
+        for (int written = 0; ok && written < diskTestBytes; written += diskChunkBytes)
+        {
+            DWORD bytesWritten = 0;
+            ok = WriteFile(handle, chunk.getData(), (DWORD) chunk.getSize(), &bytesWritten, nullptr)
+                 && bytesWritten == (DWORD) chunk.getSize();
+        }
+
+        ok = FlushFileBuffers(handle) && ok;
+        CloseHandle(handle);
+    }
+   #else
+    const int fd = ::open(testFile.getFullPathName().toRawUTF8(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd >= 0)
+    {
+        ok = true;
+        for (int written = 0; ok && written < diskTestBytes; written += diskChunkBytes)
+            ok = ::write(fd, chunk.getData(), chunk.getSize()) == (ssize_t) chunk.getSize();
+
+        ok = ::fsync(fd) == 0 && ok;
+        ::close(fd);
+    }
+   #endif
+
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    testFile.deleteFile();
+
+    return ok && elapsedSeconds > 0.0 ? diskTestBytes / elapsedSeconds : 0.0;
+}
+
+juce::String EncoderCapabilities::getVolumeKey(const juce::File& directory)
+{
+   #if JUCE_WINDOWS
+    return "volume_" + juce::String::toHexString(directory.getVolumeSerialNumber());
+   #else
+    struct stat info;
+    if (::stat(directory.getFullPathName().toRawUTF8(), &info) == 0)
+        return "device_" + juce::String::toHexString((juce::int64) info.st_dev);
+
+    // Unreadable directories are keyed by path, so they still aren't measured twice
+    return "path_" + directory.getFullPathName();
+   #endif
+}
+
+//==============================================================================
+juce::File EncoderCapabilities::getCacheFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("FFLUCE")
+               .getChildFile("encoder_capabilities.json");
+}
+
+juce::File EncoderCapabilities::getDiskCacheFile()
+{
+    return getCacheFile().getSiblingFile("disk_bandwidth.json");
+}
+
+juce::File EncoderCapabilities::resolveExecutable(const juce::String& ffmpegPath)
+{
+    if (juce::File::isAbsolutePath(ffmpegPath))
+        return juce::File(ffmpegPath);
+
+    // Bare name: look it up on PATH the same way the shell would
+   #if JUCE_WINDOWS
+    const juce::String separator = ";";
+   #else
+    const juce::String separator = ":";
+   #endif
+
+    juce::StringArray directories;
+    directories.addTokens(juce::SystemStats::getEnvironmentVariable("PATH", {}), separator, "");
+
+    for (const auto& directory : directories)
+    {
+        if (directory.isEmpty() || !juce::File::isAbsolutePath(directory))
+            continue;
+
+        const juce::File candidate = juce::File(directory).getChildFile(ffmpegPath);
+        if (candidate.existsAsFile())
+            return candidate;
+    }
+
+    return {};
+}
+
+bool EncoderCapabilities::loadCache(const juce::String& binaryHash, Report& report) const
+{
+    const juce::File cacheFile = getCacheFile();
+    if (!cacheFile.existsAsFile())
+        return false;
+
+    const juce::var json = juce::JSON::parse(cacheFile.loadFileAsString());
+    if (!json.isObject()
+        || (int) json.getProperty("version", 0) != probeVersion
+        || json.getProperty("ffmpegHash", juce::String()).toString() != binaryHash)
+        return false;
+
+    report = {};
+    report.ffmpegHash = binaryHash;
+    report.probedAt = juce::Time((juce::int64) json.getProperty("probedAt", 0));
+
+    if (auto* hwaccels = json.getProperty("hwaccels", juce::var()).getArray())
+        for (const auto& accel : *hwaccels)
+            report.hardwareAccelerators.add(accel.toString());
+
+    if (auto* encoders = json.getProperty("encoders", juce::var()).getArray())
+    {
+        for (const auto& entry : *encoders)
+        {
+            EncoderResult result;
+            result.name = entry.getProperty("name", juce::String()).toString();
+            result.listed = (bool) entry.getProperty("listed", false);
+            result.working = (bool) entry.getProperty("working", false);
+            result.framesPerSecond = (double) entry.getProperty("fps", 0.0);
+            result.failureReason = entry.getProperty("failureReason", juce::String()).toString();
+            report.encoders.push_back(result);
+        }
+    }
+
+    if (auto* intermediates = json.getProperty("intermediates", juce::var()).getArray())
+    {
+        for (const auto& entry : *intermediates)
+        {
+            IntermediateResult result;
+            result.name = entry.getProperty("name", juce::String()).toString();
+            result.working = (bool) entry.getProperty("working", false);
+            result.framesPerSecond = (double) entry.getProperty("fps", 0.0);
+            result.bytesPerFrame = (double) entry.getProperty("bytesPerFrame", 0.0);
+            result.failureReason = entry.getProperty("failureReason", juce::String()).toString();
+            report.intermediates.push_back(result);
+        }
+    }
+
+    report.cudaFilters = (bool) json.getProperty("cudaFilters", false);
+    report.cudaFailureReason = json.getProperty("cudaFailureReason", juce::String()).toString();
+
+    return !report.encoders.empty();
+}
+
+void EncoderCapabilities::saveCache(const Report& report) const
+{
+    auto* root = new juce::DynamicObject();
+    juce::var rootVar(root);
+
+    root->setProperty("version", probeVersion);
+    root->setProperty("ffmpegHash", report.ffmpegHash);
+    root->setProperty("probedAt", report.probedAt.toMilliseconds());
+    root->setProperty("hwaccels", report.hardwareAccelerators);
+
+    juce::Array<juce::var> encoders;
+    for (const auto& result : report.encoders)
+    {
+        auto* entry = new juce::DynamicObject();
+        juce::var entryVar(entry);
+        entry->setProperty("name", result.name);
+        entry->setProperty("listed", result.listed);
+        entry->setProperty("working", result.working);
+        entry->setProperty("fps", result.framesPerSecond);
+        entry->setProperty("failureReason", result.failureReason);
+        encoders.add(entryVar);
+    }
+    root->setProperty("encoders", encoders);
+
+    juce::Array<juce::var> intermediates;
+    for (const auto& result : report.intermediates)
+    {
+        auto* entry = new juce::DynamicObject();
+        juce::var entryVar(entry);
+        entry->setProperty("name", result.name);
+        entry->setProperty("working", result.working);
+        entry->setProperty("fps", result.framesPerSecond);
+        entry->setProperty("bytesPerFrame", result.bytesPerFrame);
+        entry->setProperty("failureReason", result.failureReason);
+        intermediates.add(entryVar);
+    }
+    root->setProperty("intermediates", intermediates);
+    root->setProperty("cudaFilters", report.cudaFilters);
+    root->setProperty("cudaFailureReason", report.cudaFailureReason);
+
+    const juce::File cacheFile = getCacheFile();
+    cacheFile.getParentDirectory().createDirectory();
+    cacheFile.replaceWithText(juce::JSON::toString(rootVar));
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <vector>
+
+/**
+ * One-time probe of what the installed FFmpeg build can actually do on this machine.
+ *
+ * Listing an encoder in `ffmpeg -encoders` only says it was compiled in, not that
+ * the GPU/driver behind it works, so each candidate encoder gets a short test
+ * encode and its throughput is measured. Each IntermediateFormat profile is timed
+ * the same way (encode and decode back).
+ * With a working NVENC and the cuda hwaccel, a short graph of the CUDA filters
+ * (scale_cuda, xfade_cuda, overlay_cuda) decides whether whole renders can keep
+ * their frames on the GPU.
+ * The results are cached on disk keyed by the SHA-256 of the FFmpeg binary, so
+ * the probe only reruns when FFmpeg changes. Disk write speed belongs to a volume
+ * rather than the binary, so it is measured separately and cached per volume.
+ *
+ * Usage:
+ *     auto report = EncoderCapabilities::getInstance().getReport(ffmpegPath);
+ *     if (report.isWorking("h264_nvenc")) ...
+ */
+class EncoderCapabilities
+{
+public:
+    /** Result of probing a single encoder. */
+    struct EncoderResult
+    {
+        juce::String name;
+        bool listed = false;             // present in `ffmpeg -encoders`
+        bool working = false;            // the test encode succeeded
+        double framesPerSecond = 0.0;    // measured throughput of the test encode
+        juce::String failureReason;
+    };
+
+    /** Result of timing one intermediate format profile. */
+    struct IntermediateResult
+    {
+        juce::String name;
+        bool working = false;
+        double framesPerSecond = 0.0;    // encode and decode back, at 1080p
+        double bytesPerFrame = 0.0;      // size of the test file per frame
+        juce::String failureReason;
+    };
+
+    /** Everything learned from one probe run. */
+    struct Report
+    {
+        juce::String ffmpegHash;
+        juce::Time probedAt;
+        juce::StringArray hardwareAccelerators;   // from `ffmpeg -hwaccels`
+        std::vector<EncoderResult> encoders;
+        std::vector<IntermediateResult> intermediates;
+        bool cudaFilters = false;                 // the CUDA filter test graph ran into h264_nvenc
+        juce::String cudaFailureReason;
+
+        const EncoderResult* find(const juce::String& encoderName) const;
+        const IntermediateResult* findIntermediate(const juce::String& profileName) const;
+        bool isListed(const juce::String& encoderName) const;
+        bool isWorking(const juce::String& encoderName) const;
+        double getFramesPerSecond(const juce::String& encoderName) const;
+    };
+
+    static EncoderCapabilities& getInstance()
+    {
+        static EncoderCapabilities instance;
+        return instance;
+    }
+
+    /** The encoders that get a test encode. */
+    static juce::StringArray getCandidateEncoders();
+
+    /**
+     * Returns the capability report for the given FFmpeg binary. The first call
+     * loads the on-disk cache or runs the probe; later calls return the stored
+     * report. If a probe is already running on another thread this waits for it.
+     */
+    Report getReport(const juce::String& ffmpegPath);
+
+    /** Discards the cached report and probes again. */
+    Report refresh(const juce::String& ffmpegPath);
+
+    /**
+     * Sequential write speed of the volume holding the directory, in bytes per
+     * second. Measured by writing a test file there and syncing it to the disk,
+     * so the page cache can't flatter it; the result is cached per volume.
+     * Returns 0 if the measurement failed.
+     */
+    double getDiskBandwidth(const juce::File& directory);
+
+    /** Starts the probe on a background thread so it is ready before the first render. */
+    void probeInBackground(const juce::String& ffmpegPath);
+
+    /** Sets a callback for receiving log messages. */
+    void setLogCallback(std::function<void(const juce::String&)> logCallback);
+
+private:
+    EncoderCapabilities() = default;
+
+    Report runProbe(const juce::String& ffmpegPath, const juce::String& binaryHash);
+    EncoderResult probeEncoder(const juce::String& ffmpegPath, const juce::String& encoderName);
+    IntermediateResult probeIntermediate(const juce::String& ffmpegPath, const juce::String& profileName,
+                                         const juce::String& codecArgs, const juce::String& extension);
+    static double measureDiskBandwidth(const juce::File& directory);
+    static juce::String getVolumeKey(const juce::File& directory);
+    static bool probeCudaFilters(const juce::String& ffmpegPath, const Report& report, juce::String& failureReason);
+    bool loadCache(const juce::String& binaryHash, Report& report) const;
+    void saveCache(const Report& report) const;
+    void log(const juce::String& message) const;
+
+    static juce::File getCacheFile();
+    static juce::File getDiskCacheFile();
+    static juce::File resolveExecutable(const juce::String& ffmpegPath);
+
+    juce::CriticalSection probeLock;      // held for the whole probe so callers wait for it
+    bool hasReport = false;
+    juce::String reportPath;
+    Report currentReport;
+    std::function<void(const juce::String&)> logCallback;
+
+    juce::CriticalSection diskLock;       // held while measuring so a volume is only measured once
+    std::map<juce::String, double> diskBandwidths;    // volume key -> bytes per second
+
+    EncoderCapabilities(const EncoderCapabilities&) = delete;
+    EncoderCapabilities& operator=(const EncoderCapabilities&) = delete;
+};
@@ -11,9 +11,13 @@
  */
 
 #include "FFmpegExecutor.h"
+#include "EncoderCapabilities.h"
 
 namespace
 {
+    // How much of a command's output is kept for classifying failures
+    constexpr int maxOutputTailLines = 40;
+
     double parseFractionString(const juce::String& fraction)
     {
         auto value = fraction.trim();
@@ -32,25 +36,145 @@ namespace
 
         return value.getDoubleValue();
     }
+
+    // Reads the value following "key=" in an FFmpeg stats line, e.g. "fps= 42" or "speed=1.23x"
+    juce::String extractStatValue(const juce::String& line, const juce::String& key)
+    {
+        const int keyPos = line.indexOf(key + "=");
+        if (keyPos < 0)
+            return {};
+
+        return line.substring(keyPos + key.length() + 1).trimStart()
+                   .upToFirstOccurrenceOf(" ", false, false).trim();
+    }
+
+    // Returns the video encoder selected by the last -c:v in a command, if any
+    juce::String findEncoderName(const juce::String& command)
+    {
+        const juce::StringArray args = FFmpegProcess::tokenizeCommand(command);
+        juce::String encoder;
+
+        for (int i = 0; i + 1 < args.size(); ++i)
+            if (args[i] == "-c:v" || args[i] == "-vcodec")
+                encoder = args[i + 1];
+
+        return encoder;
+    }
+
+    // FFmpeg commands in this codebase always end with the output path
+    juce::File findOutputFile(const juce::String& command)
+    {
+        const juce::StringArray args = FFmpegProcess::tokenizeCommand(command);
+        if (args.isEmpty())
+            return {};
+
+        const juce::String last = args[args.size() - 1];
+        if (last.startsWith("-") || !juce::File::isAbsolutePath(last))
+            return {};
+
+        return juce::File(last);
+    }
+
+    // Splits FFmpeg output into lines and keeps the latest encoder statistics
+    struct OutputStatsParser
+    {
+        double fps = 0.0;
+        double speed = 0.0;
+        double mediaSeconds = 0.0;
+        int outputWidth = 0;
+        int outputHeight = 0;
+
+        // Returns the complete lines contained in the new text
+        juce::StringArray consume(const juce::String& text)
+        {
+            pending += text;
+
+            juce::StringArray lines;
+            for (;;)
+            {
+                const int breakPos = pending.indexOfAnyOf("\r\n");
+                if (breakPos < 0)
+                    break;
+
+                const juce::String line = pending.substring(0, breakPos);
+                pending = pending.substring(breakPos + 1);
+
+                if (line.isNotEmpty())
+                {
+                    parseLine(line);
+                    lines.add(line);
+                }
+            }
+
+            return lines;
+        }
+
+        void flush()
+        {
+            if (pending.isNotEmpty())
+                parseLine(pending);
+            pending.clear();
+        }
+
+    private:
+        void parseLine(const juce::String& line)
+        {
+            if (line.startsWith("Output #"))
+            {
+                inOutputSection = true;
+            }
+            else if (inOutputSection && outputWidth == 0 && line.contains("Video:"))
+            {
+                // e.g. "Stream #0:0: Video: h264, yuv420p(progressive), 1920x1080, q=-1--1, 30 fps"
+                juce::StringArray tokens;
+                tokens.addTokens(line, " ,", "");
+                for (const auto& token : tokens)
+                {
+                    const juce::String width = token.upToFirstOccurrenceOf("x", false, false);
+                    const juce::String height = token.fromFirstOccurrenceOf("x", false, false);
+                    if (width.isNotEmpty() && height.isNotEmpty()
+                        && width.containsOnly("0123456789") && height.containsOnly("0123456789"))
+                    {
+                        outputWidth = width.getIntValue();
+                        outputHeight = height.getIntValue();
+                        break;
+                    }
+                }
+            }
+
+            if (line.contains("time="))
+            {
+                const juce::String fpsValue = extractStatValue(line, "fps");
+                if (fpsValue.isNotEmpty())
+                    fps = fpsValue.getDoubleValue();
+
+                const juce::String speedValue = extractStatValue(line, "speed");
+                if (speedValue.isNotEmpty())
+                    speed = speedValue.getDoubleValue();
+            }
+        }
+
+        juce::String pending;
+        bool inOutputSection = false;
+    };
 }
 
 //==============================================================================
 FFmpegExecutor::FFmpegExecutor()
-    : shouldCancel(false),
-      currentProgress(0.0),
+    : currentProgress(0.0),
       externalProgressActive(false),
       externalProgressStart(0.0),
       externalProgressEnd(1.0),
       externalEstimatedDuration(-1.0)
 {
     // Initialize the atomic progress counter to 0
-    // The shouldCancel flag is also initialized to false
 }
 
 //==============================================================================
 FFmpegExecutor::~FFmpegExecutor()
 {
     // Make sure any running processes are terminated when this object is destroyed
+    setCancellationToken(nullptr);
     cancelExecution();
 }
 
@@ -93,11 +217,12 @@ void FFmpegExecutor::setSessionLogDirectory(const juce::File& directory)
     sessionLogDirectory = juce::File();
     sessionAggregateLogFile = juce::File();
     sessionCommandIndex = 0;
+    telemetry.endSession();
     
     if (!directory.isDirectory())
     {
         juce::File dir = directory;
-        if (!dir.exists())
+        if (dir != juce::File() && !dir.exists())
             dir.createDirectory();
         
         if (!dir.isDirectory())
@@ -115,6 +240,31 @@ void FFmpegExecutor::setSessionLogDirectory(const juce::File& directory)
         sessionAggregateLogFile.deleteFile();
     
     sessionLoggingEnabled = sessionLogDirectory.isDirectory();
+    
+    if (sessionLoggingEnabled)
+        telemetry.beginSession(sessionLogDirectory);
+}
+
+void FFmpegExecutor::setTelemetryStage(const juce::String& stageName)
+{
+    juce::ScopedLock sl(logDirectoryLock);
+    
+    if (stageName.isEmpty())
+        telemetryStages.erase(juce::Thread::getCurrentThreadId());
+    else
+        telemetryStages[juce::Thread::getCurrentThreadId()] = stageName;
+}
+
+void FFmpegExecutor::setCommandProgressEnabled(bool shouldReport)
+{
+    commandProgressEnabled.store(shouldReport);
+}
+
+void FFmpegExecutor::reportProgress(double value)
+{
+    currentProgress.store(value);
+    if (progressCallback)
+        progressCallback(value);
 }
 
 //==============================================================================
@@ -150,8 +300,23 @@ void FFmpegExecutor::writeToAggregateLog(const juce::String& message)
 //==============================================================================
 bool FFmpegExecutor::executeCommand(const juce::String& command, double progressStart, double progressEnd)
 {
+    CommandResult result;
+    return runCommand(command, progressStart, progressEnd, result);
+}
+
+bool FFmpegExecutor::runCommand(const juce::String& command, double progressStart, double progressEnd, CommandResult& result)
+{
+    // Don't start new work for a render that has been cancelled
+    if (isCancellationRequested())
+    {
+        result.cancelled = true;
+        writeToAggregateLog("#--- [" + juce::Time::getCurrentTime().toString(true, true) + "] SKIPPED (render cancelled) " + command);
+        return false;
+    }
+    
     const juce::Time startTime = juce::Time::getCurrentTime();
     const juce::String startTimeString = startTime.toString(true, true);
+    const double startTicks = juce::Time::getMillisecondCounterHiRes();
     
     int commandLogIndex = -1;
     juce::File commandLogFile = getNextCommandLogFile(commandLogIndex);
@@ -159,6 +324,20 @@ bool FFmpegExecutor::executeCommand(const juce::String& command, double progress
     juce::String commandIndexLabel = (commandLogIndex > 0)
         ? juce::String::formatted("#%03d", commandLogIndex)
         : juce::String("#---");
+
+    RenderTelemetry::CommandRecord record;
+    record.index = commandLogIndex;
+    record.command = command;
+    record.startTime = startTime;
+    record.encoder = findEncoderName(command);
+    record.outputFile = findOutputFile(command);
+    record.machine = RenderTelemetry::getMachineId();
+    {
+        juce::ScopedLock sl(logDirectoryLock);
+        auto stage = telemetryStages.find(juce::Thread::getCurrentThreadId());
+        if (stage != telemetryStages.end())
+            record.stage = stage->second;
+    }
     
     if (commandLogFile != juce::File())
     {
@@ -176,8 +355,17 @@ bool FFmpegExecutor::executeCommand(const juce::String& command, double progress
     
     writeToAggregateLog(commandIndexLabel + " [" + startTimeString + "] START " + command);
     
-    activeProcess = std::make_unique<juce::ChildProcess>();
-    shouldCancel.store(false);
+    // Several commands may run at once (see RenderGraphScheduler), so each owns its process
+    // and only registers it for cancelExecution()
+    auto activeProcess = std::make_unique<FFmpegProcess>();
+    const int cancelGenerationAtStart = cancelGeneration.load();
+    const ScopedProcessRegistration registration(*this, *activeProcess);
+    const bool reportCommandProgress = commandProgressEnabled.load();
+
+    // Worked out before the process starts, so probing doesn't hold up its output
+    double commandDuration = 0.0;
+    if (reportCommandProgress && !(externalProgressActive && externalEstimatedDuration > 0.0))
+        commandDuration = estimateCommandDuration(command);
 
     if (commandLogStream && commandLogStream->openedOk())
         commandLogStream->writeText("Process starting...\n", false, false, nullptr);
@@ -222,20 +410,142 @@ bool FFmpegExecutor::executeCommand(const juce::String& command, double progress
         estimatedTotalDuration = externalEstimatedDuration;
 
     // Set initial progress value
-    currentProgress.store(effectiveStart);
-    if (progressCallback)
-        progressCallback(effectiveStart);
+    if (reportCommandProgress)
+    {
+        currentProgress.store(effectiveStart);
+        if (progressCallback)
+            progressCallback(effectiveStart);
+    }
     
     // Initialize progress tracking
     double lastReportedSeconds = 0.0;
     int progressCheckCounter = 0;
     bool isFirstProgress = true;
+    OutputStatsParser statsParser;
+    juce::StringArray outputTail;
+
+    // Handles one chunk of process output: logs it, then updates stats and progress
+    auto consumeOutput = [&](const char* buffer)
+    {
+        try {
+            // Try to create a string with explicit UTF-8 encoding
+            const juce::String output = juce::String(juce::CharPointer_UTF8(buffer));
+            
+            if (commandLogStream && commandLogStream->openedOk())
+            {
+                juce::String sanitizedOutput = output.replace("\r", "\n");
+                commandLogStream->writeText(sanitizedOutput, false, false, nullptr);
+            }
+            
+            for (const auto& line : statsParser.consume(output))
+            {
+                // Keep the last lines around so a failure can be classified afterwards
+                outputTail.add(line);
+                if (outputTail.size() > maxOutputTailLines)
+                    outputTail.remove(0);
+
+                // Look for progress information
+                const double seconds = parseFFmpegProgress(line);
+                
+                if (seconds > 0.0)
+                    statsParser.mediaSeconds = seconds;
+
+                if (seconds > 0.0 && reportCommandProgress)
+                {
+                    // Use the command's own length, and a default only if that's unknown too
+                    if (estimatedTotalDuration <= 0.0)
+                        estimatedTotalDuration = commandDuration > 0.0 ? commandDuration : 120.0;
+                        
+                    // Calculate progress
+                    double percentage = juce::jmin(0.95, seconds / estimatedTotalDuration);
+                    double mappedProgress = effectiveStart + (effectiveEnd - effectiveStart) * percentage;
+                    
+                    // Update progress in memory and UI
+                    currentProgress.store(mappedProgress);
+                    
+                    if (progressCallback && (isFirstProgress ||
+                        (seconds - lastReportedSeconds) > 1.0 ||
+                        ++progressCheckCounter % 10 == 0))
+                    {
+                        progressCallback(mappedProgress);
+                        lastReportedSeconds = seconds;
+                        isFirstProgress = false;
+                    }
+                }
+            }
+        }
+        catch (const std::exception&) { }
+        catch (...) { }
+    };
+
+    // Reads everything the process has written so far, so FFmpeg never blocks on a full pipe
+    auto drainOutput = [&]()
+    {
+        try {
+            char buffer[4096];
+            for (;;)
+            {
+                const int bytesRead = activeProcess->readProcessOutput(buffer, sizeof(buffer) - 1);
+                if (bytesRead <= 0)
+                    break;
+
+                buffer[bytesRead] = 0; // Ensure null termination
+                consumeOutput(buffer);
+            }
+        }
+        catch (const std::exception&) { }
+        catch (...) { }
+    };
+
+    // Fills in the fields only known once the process has gone away and files the record
+    auto finishRecord = [&](int exitCode, bool cancelled)
+    {
+        result.exitCode = exitCode;
+        result.cancelled = cancelled;
+        result.outputTail = outputTail;
+
+        const auto usage = activeProcess->getResourceUsage();
+
+        record.wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTicks) / 1000.0;
+        record.exitCode = exitCode;
+        record.cancelled = cancelled;
+        record.encoderFps = statsParser.fps;
+        record.encoderSpeed = statsParser.speed;
+        record.mediaSeconds = statsParser.mediaSeconds;
+        record.outputWidth = statsParser.outputWidth;
+        record.outputHeight = statsParser.outputHeight;
+
+        if (usage.valid)
+        {
+            record.userCpuSeconds = usage.userCpuSeconds;
+            record.systemCpuSeconds = usage.systemCpuSeconds;
+            record.peakResidentKb = usage.peakResidentKb;
+            record.bytesRead = usage.bytesRead;
+            record.bytesWritten = usage.bytesWritten;
+        }
+
+        if (record.outputFile.existsAsFile())
+            record.outputBytes = record.outputFile.getSize();
+
+        if (commandLogStream && commandLogStream->openedOk())
+        {
+            juce::String summary = "Wall time: " + juce::String(record.wallSeconds, 3) + " s";
+            if (usage.valid)
+                summary += ", CPU: " + juce::String(record.userCpuSeconds, 2) + " s user / "
+                         + juce::String(record.systemCpuSeconds, 2) + " s sys, peak RSS: "
+                         + juce::String(record.peakResidentKb) + " KB";
+            commandLogStream->writeText(summary + "\n", false, false, nullptr);
+            commandLogStream->flush();
+        }
+
+        telemetry.addRecord(record);
+    };
     
     // Main process monitoring loop
     try {
         while (activeProcess && activeProcess->isRunning())
         {
-            if (shouldCancel.load())
+            if (cancelGeneration.load() != cancelGenerationAtStart || isCancellationRequested())
             {
                 if (commandLogStream && commandLogStream->openedOk())
                 {
@@ -244,111 +554,29 @@ bool FFmpegExecutor::executeCommand(const juce::String& command, double progress
                 }
                 writeToAggregateLog(commandIndexLabel + " [" + juce::Time::getCurrentTime().toString(true, true) + "] CANCELLED");
                 activeProcess->kill();
+                
+                // Give the kill a moment to land so the process is reaped and its usage captured
+                for (int waitCount = 0; waitCount < 200 && activeProcess->isRunning(); ++waitCount)
+                    juce::Thread::sleep(10);
+                
+                finishRecord(-1, true);
                 return false;
             }
             
-            try {
-                // Read output with proper UTF-8 handling but don't display in UI
-                char buffer[1024];
-                const int bytesRead = activeProcess->readProcessOutput(buffer, sizeof(buffer) - 1);
-                
-                if (bytesRead > 0)
-                {
-                    // Process for progress information silently
-                    buffer[bytesRead] = 0; // Ensure null termination
-                    juce::String output;
-                    
-                    try {
-                        // Try to create a string with explicit UTF-8 encoding
-                        output = juce::String(juce::CharPointer_UTF8(buffer));
-                        
-                        if (commandLogStream && commandLogStream->openedOk())
-                        {
-                            juce::String sanitizedOutput = output.replace("\r", "\n");
-                            commandLogStream->writeText(sanitizedOutput, false, false, nullptr);
-                        }
-                        
-                        // Use time-based progress estimation as fallback
-                        juce::StringArray lines;
-                        lines.addLines(output);
-                        
-                        for (const auto& line : lines)
-                        {
-                            // Look for progress information
-                            if (line.contains("time="))
-                            {
-                                // Extract the time value directly without using a helper method
-                                int timePos = line.indexOf("time=");
-                                if (timePos >= 0)
-                                {
-                                    timePos += 5; // Skip "time="
-                                    
-                                    int endPos = line.indexOfChar(' ', timePos);
-                                    if (endPos < 0)
-                                        endPos = line.length();
-                                        
-                                    juce::String timeStr = line.substring(timePos, endPos).trim();
-                                    double seconds = 0.0;
-                                    
-                                    if (timeStr.contains(":"))
-                                    {
-                                        // Format is HH:MM:SS.ms - parse manually
-                                        juce::StringArray parts;
-                                        parts.addTokens(timeStr, ":", "");
-                                        
-                                        if (parts.size() >= 3)
-                                        {
-                                            seconds = parts[0].getDoubleValue() * 3600.0 +
-                                                     parts[1].getDoubleValue() * 60.0 +
-                                                     parts[2].getDoubleValue();
-                                        }
-                                    }
-                                    else
-                                    {
-                                        seconds = timeStr.getDoubleValue();
-                                    }
-                                    
-                                    if (seconds > 0.0)
-                                    {
-                                        // Use a default estimated duration if we don't have one
-                                        if (estimatedTotalDuration <= 0.0)
-                                            estimatedTotalDuration = 120.0;
-                                            
-                                        // Calculate progress
-                                        double percentage = juce::jmin(0.95, seconds / estimatedTotalDuration);
-                                        double mappedProgress = effectiveStart + (effectiveEnd - effectiveStart) * percentage;
-                                        
-                                        // Update progress in memory and UI
-                                        currentProgress.store(mappedProgress);
-                                        
-                                        if (progressCallback && (isFirstProgress ||
-                                            (seconds - lastReportedSeconds) > 1.0 ||
-                                            ++progressCheckCounter % 10 == 0))
-                                        {
-                                            progressCallback(mappedProgress);
-                                            lastReportedSeconds = seconds;
-                                            isFirstProgress = false;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    catch (const std::exception&) { }
-                    catch (...) { }
-                }
-            }
-            catch (const std::exception&) { }
-            catch (...) { }
+            drainOutput();
             
-            // Sleep to avoid consuming too much CPU
-            juce::Thread::sleep(100);
+            // Wait before polling again; a cancel wakes us early
+            wakeEvent.wait(100);
         }
     }
     catch (const std::exception&) { }
     catch (...) { }
 
-    if (shouldCancel.load())
+    // Pick up whatever was written between the last poll and the exit
+    drainOutput();
+    statsParser.flush();
+
+    if (cancelGeneration.load() != cancelGenerationAtStart || isCancellationRequested())
     {
         if (commandLogStream && commandLogStream->openedOk())
         {
@@ -357,6 +585,7 @@ bool FFmpegExecutor::executeCommand(const juce::String& command, double progress
         }
         writeToAggregateLog(commandIndexLabel + " [" + juce::Time::getCurrentTime().toString(true, true) + "] CANCELLED_AFTER_EXIT");
         activeProcess->kill();
+        finishRecord(-1, true);
         return false;
     }
     
@@ -385,28 +614,117 @@ bool FFmpegExecutor::executeCommand(const juce::String& command, double progress
         commandLogStream->writeText("Exit code: " + juce::String(exitCode) + "\n", false, false, nullptr);
         commandLogStream->flush();
     }
-    writeToAggregateLog(commandIndexLabel + " [" + finishTimeString + "] END exitCode=" + juce::String(exitCode));
+    finishRecord(exitCode, false);
+    writeToAggregateLog(commandIndexLabel + " [" + finishTimeString + "] END exitCode=" + juce::String(exitCode)
+                        + " wall=" + juce::String(record.wallSeconds, 2) + "s");
     
     // Set progress to 100% (end value) upon completion
-    currentProgress.store(effectiveEnd);
-    if (progressCallback)
-        progressCallback(effectiveEnd);
+    if (reportCommandProgress)
+    {
+        currentProgress.store(effectiveEnd);
+        if (progressCallback)
+            progressCallback(effectiveEnd);
+    }
     
     // Return true if the process completed successfully (exit code 0)
     return exitCode == 0;
 }
 
+bool FFmpegExecutor::executeWithFallback(const FallbackPolicy::CommandBuilder& buildCommand,
+                                         bool preferGpuEncoder,
+                                         const juce::File& outputFile,
+                                         const juce::String& description,
+                                         double progressStart,
+                                         double progressEnd)
+{
+    FallbackPolicy::JobOptions options = fallbackPolicy.getInitialOptions(preferGpuEncoder);
+
+    if (preferGpuEncoder && !options.useGpuEncoder && logCallback)
+        logCallback(description + ": using CPU encoder (GPU encoder failed earlier in this render)");
+
+    for (;;)
+    {
+        CommandResult result;
+        if (runCommand(buildCommand(options), progressStart, progressEnd, result))
+            return true;
+
+        const auto failure = (result.cancelled || isCancellationRequested())
+                                 ? FallbackPolicy::FailureKind::Cancelled
+                                 : FallbackPolicy::classifyFailure(result.exitCode, result.outputTail);
+
+        FallbackPolicy::Strategy next;
+        if (failure == FallbackPolicy::FailureKind::Cancelled || !fallbackPolicy.chooseNext(failure, options, next))
+        {
+            if (failure != FallbackPolicy::FailureKind::Cancelled && logCallback)
+                logCallback("ERROR: " + description + " failed (" + FallbackPolicy::getFailureName(failure)
+                            + "), no fallback left");
+            return false;
+        }
+
+        if (logCallback)
+            logCallback("WARNING: " + description + " failed (" + FallbackPolicy::getFailureName(failure)
+                        + "); retrying with " + FallbackPolicy::getStrategyName(next));
+
+        // Only the failed step is repeated; don't let it append to or trip over its own partial output
+        if (outputFile != juce::File() && outputFile.existsAsFile())
+            outputFile.deleteFile();
+
+        options.apply(next);
+    }
+}
+
 //==============================================================================
 void FFmpegExecutor::cancelExecution()
 {
-    // Set the cancellation flag to signal the monitoring thread
-    shouldCancel.store(true);
+    // Every command that started before this counts as cancelled
+    ++cancelGeneration;
     
-    // If a process is currently running, kill it directly
-    if (activeProcess != nullptr && activeProcess->isRunning())
+    // Kill whatever is running right now
     {
-        activeProcess->kill();
+        juce::ScopedLock sl(lock);
+        for (auto* process : activeProcesses)
+            process->kill();
     }
+    
+    wakeEvent.signal();
+}
+
+void FFmpegExecutor::setCancellationToken(CancellationToken::Ptr token)
+{
+    juce::ScopedLock sl(lock);
+    
+    if (cancellationToken != nullptr)
+        cancellationToken->removeCallback(cancellationCallbackId);
+    
+    cancellationToken = token;
+    cancellationCallbackId = 0;
+    
+    if (cancellationToken != nullptr)
+        cancellationCallbackId = cancellationToken->addCallback([this] { cancelExecution(); });
+}
+
+bool FFmpegExecutor::isCancellationRequested() const
+{
+    juce::ScopedLock sl(lock);
+    return cancellationToken != nullptr && cancellationToken->isCancelled();
+}
+
+FFmpegExecutor::ScopedProcessRegistration::ScopedProcessRegistration(FFmpegExecutor& e, FFmpegProcess& p)
+    : executor(e), process(p), cancelGenerationAtStart(e.cancelGeneration.load())
+{
+    juce::ScopedLock sl(executor.lock);
+    executor.activeProcesses.add(&process);
+}
+
+FFmpegExecutor::ScopedProcessRegistration::~ScopedProcessRegistration()
+{
+    juce::ScopedLock sl(executor.lock);
+    executor.activeProcesses.removeFirstMatchingValue(&process);
+}
+
+bool FFmpegExecutor::ScopedProcessRegistration::wasCancelled() const
+{
+    return executor.cancelGeneration.load() != cancelGenerationAtStart || executor.isCancellationRequested();
 }
 
 //==============================================================================
@@ -421,6 +739,72 @@ juce::String FFmpegExecutor::executeCommandAndGetOutput(const juce::String& comm
     return UTF8String::readAllProcessOutput(&process);
 }
 
+bool FFmpegExecutor::runProbe(const juce::String& command, juce::String& output, int timeoutMs)
+{
+    output.clear();
+    if (isCancellationRequested())
+        return false;
+
+    FFmpegProcess process(ProcessManager::JobClass::Render, "FFprobe");
+    const ScopedProcessRegistration registration(*this, process);
+    if (!process.start(command))
+        return false;
+
+    juce::MemoryOutputStream collected;
+    const double deadline = juce::Time::getMillisecondCounterHiRes() + timeoutMs;
+    char buffer[65536];
+
+    for (;;)
+    {
+        // Read eagerly: a packet list fills the pipe long before the probe finishes
+        const int bytes = process.readProcessOutput(buffer, (int) sizeof(buffer));
+        if (bytes > 0)
+        {
+            collected.write(buffer, (size_t) bytes);
+            continue;
+        }
+
+        if (!process.isRunning())
+            break;
+
+        if (registration.wasCancelled() || juce::Time::getMillisecondCounterHiRes() > deadline)
+        {
+            process.kill();
+            while (process.isRunning())
+                juce::Thread::sleep(1);
+            return false;
+        }
+
+        juce::Thread::sleep(1);
+    }
+
+    // Whatever was written between the last read and the exit
+    for (int bytes; (bytes = process.readProcessOutput(buffer, (int) sizeof(buffer))) > 0;)
+        collected.write(buffer, (size_t) bytes);
+
+    output = collected.toUTF8();
+    return !registration.wasCancelled() && process.getExitCode() == 0;
+}
+
+double FFmpegExecutor::estimateCommandDuration(const juce::String& command)
+{
+    const juce::StringArray args = FFmpegProcess::tokenizeCommand(command);
+
+    double duration = 0.0;
+    for (int i = 0; i + 1 < args.size(); ++i)
+        if (args[i] == "-t")
+            duration = args[i + 1].getDoubleValue();
+
+    if (duration > 0.0)
+        return duration;
+
+    const int input = args.indexOf("-i");
+    if (input >= 0 && input + 1 < args.size() && juce::File::isAbsolutePath(args[input + 1]))
+        return getFileDuration(juce::File(args[input + 1]));
+
+    return 0.0;
+}
+
 //==============================================================================
 juce::String FFmpegExecutor::getFFmpegPath()
 {
@@ -508,35 +892,9 @@ bool FFmpegExecutor::checkFFmpegAvailability()
 //==============================================================================
 bool FFmpegExecutor::isNVENCAvailable()
 {
-    // Create a child process to check for NVENC availability
-    juce::ChildProcess process;
-    
-    // Platform-specific command to check for NVENC encoders
-    juce::String command;
-    
-    #if JUCE_WINDOWS
-    // Windows: use findstr instead of grep
-    command = "cmd.exe /c \"" + getFFmpegPath() + " -hide_banner -encoders | findstr nvenc\"";
-    #else
-    // Unix-like: use grep
-    command = getFFmpegPath() + " -hide_banner -encoders | grep nvenc";
-    #endif
-    
-    // Execute the command
-    if (process.start(command))
-    {
-        // Wait for the process to finish (with 2-second timeout)
-        process.waitForProcessToFinish(2000);
-        
-        // Read the output using our UTF8String utility for proper handling
-        juce::String output = UTF8String::readAllProcessOutput(&process);
-        
-        // Check if NVENC is mentioned
-        return output.contains("nvenc");
-    }
-    
-    // If the process didn't run or no NVENC encoders found, return false
-    return false;
+    // Being listed in -encoders doesn't mean the GPU/driver works, so rely on the
+    // cached test encode instead of grepping the encoder list
+    return EncoderCapabilities::getInstance().getReport(getFFmpegPath()).isWorking("h264_nvenc");
 }
 
 //==============================================================================
@@ -609,6 +967,25 @@ FFmpegExecutor::VideoStreamInfo FFmpegExecutor::getVideoStreamInfo(const juce::F
     return info;
 }
 
+int FFmpegExecutor::getVideoFrameCount(const juce::File& file)
+{
+    if (!file.existsAsFile())
+        return -1;
+
+    const juce::String sanitizedPath = file.getFullPathName().replaceCharacter('\\', '/');
+    const juce::String command = getFFprobePath() +
+        " -v error -select_streams v:0 -count_packets -show_entries stream=nb_read_packets "
+        "-of csv=p=0 \"" + sanitizedPath + "\"";
+
+    // Counting has to read the whole file, so allow far longer than a header probe
+    juce::String output;
+    if (!runProbe(command, output, 120000))
+        return -1;
+
+    output = output.trim();
+    return output.containsOnly("0123456789") && output.isNotEmpty() ? output.getIntValue() : -1;
+}
+
 //==============================================================================
 double FFmpegExecutor::parseFFmpegProgress(const juce::String& line)
 {
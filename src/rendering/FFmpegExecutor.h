@@ -1,5 +1,10 @@
 #pragma once
 #include <JuceHeader.h>
+#include "FFmpegProcess.h"
+#include "RenderTelemetry.h"
+#include "CancellationToken.h"
+#include "FallbackPolicy.h"
+#include <map>
 
 //==============================================================================
 /**
@@ -14,6 +19,7 @@
  * - Error handling and logging
  * - Querying file durations via FFprobe
  * - Checking for FFmpeg/NVENC availability
+ * - Recording per-command performance telemetry
  */
 
 /**
@@ -141,11 +147,12 @@ public:
  * The FFmpegExecutor class handles all interaction with FFmpeg as an external process.
  * 
  * This class is responsible for:
- * 1. Running FFmpeg commands via ChildProcess
+ * 1. Running FFmpeg commands via FFmpegProcess
  * 2. Monitoring progress and reporting via callbacks
  * 3. Parsing FFmpeg output for progress information
  * 4. Detecting file durations using FFprobe
  * 5. Checking for FFmpeg/NVENC availability
+ * 6. Recording wall/CPU time, memory and I/O for every command (see RenderTelemetry)
  * 
  * @note This class doesn't directly interact with video/audio data - it only
  *       runs FFmpeg commands and reports results. The actual video/audio processing
@@ -195,12 +202,34 @@ public:
     
     /**
      * Sets the directory where FFmpeg command output should be recorded.
-     * A per-command log file plus an aggregate log will be created in this directory.
+     * A per-command log file plus an aggregate log will be created in this directory,
+     * along with the telemetry records (commands.jsonl) and a Chrome trace (trace.json).
      */
     void setSessionLogDirectory(const juce::File& directory);
     
+    /**
+     * Labels the commands that follow with the pipeline stage that issued them.
+     * The label is stored in each telemetry record and used to group the timing report.
+     * Labels are per thread, so parallel tasks can each label their own commands;
+     * pass an empty string to clear the calling thread's label.
+     */
+    void setTelemetryStage(const juce::String& stageName);
+    
+    /**
+     * Turns the per-command progress estimate off while several commands run at
+     * once; whoever runs them reports overall progress via reportProgress().
+     */
+    void setCommandProgressEnabled(bool shouldReport);
+    
+    /** Publishes an overall progress value (0.0-1.0) to getCurrentProgress() and the callback. */
+    void reportProgress(double value);
+    
+    /** Returns the telemetry collected for the current log session. */
+    RenderTelemetry& getTelemetry() { return telemetry; }
+    
     /**
      * Executes an FFmpeg command as a child process with progress monitoring.
+     * Safe to call from several threads at once.
      * 
      * This is the core method that runs FFmpeg and monitors its output for progress.
      * It maps the raw progress of the FFmpeg process (0.0-1.0) to the specified
@@ -213,6 +242,32 @@ public:
      */
     bool executeCommand(const juce::String& command, double progressStart = 0.0, double progressEnd = 1.0);
     
+    /**
+     * Executes one job, retrying it according to the FallbackPolicy when it fails.
+     * 
+     * The builder is called for every attempt with the options to use (GPU or CPU
+     * encoder, single thread, tolerant decoding). Only this job is retried, so
+     * callers keep everything they produced before it; the partial output of a
+     * failed attempt is deleted before the next one starts.
+     * 
+     * @param buildCommand     Returns the complete command line for a set of options
+     * @param preferGpuEncoder Whether the first attempt should use the GPU encoder
+     * @param outputFile       The job's output, removed between attempts (may be empty)
+     * @param description      Short name for the job used in log messages
+     * @param progressStart    The starting progress value to report
+     * @param progressEnd      The ending progress value to report
+     * @return                 true once an attempt succeeds, false if the matrix ran out or the render was cancelled
+     */
+    bool executeWithFallback(const FallbackPolicy::CommandBuilder& buildCommand,
+                             bool preferGpuEncoder,
+                             const juce::File& outputFile,
+                             const juce::String& description,
+                             double progressStart = 0.0,
+                             double progressEnd = 1.0);
+    
+    /** Returns the retry policy shared by every job run through this executor. */
+    FallbackPolicy& getFallbackPolicy() { return fallbackPolicy; }
+    
     /**
      * Executes a command and returns its output as a string.
      *
@@ -225,9 +280,22 @@ public:
     juce::String executeCommandAndGetOutput(const juce::String& command);
     
     /**
-     * Cancels the currently running FFmpeg process.
+     * Runs a probe that may read a whole file (ffprobe packet lists and counts) and
+     * collects its output. Unlike executeCommandAndGetOutput() it runs as a render job:
+     * under the Render job class, killed by cancelExecution() and the render's token,
+     * and killed if it runs longer than the timeout.
+     *
+     * @param command   The command line to execute
+     * @param output    Receives the process output (stdout and stderr)
+     * @param timeoutMs Longest the probe may run
+     * @return          false if it was cancelled, timed out, couldn't start or failed
+     */
+    bool runProbe(const juce::String& command, juce::String& output, int timeoutMs);
+    
+    /**
+     * Cancels the currently running FFmpeg processes.
      * 
-     * This will set the cancellation flag and kill the process if it's running.
+     * Every command running when this is called is killed and returns false.
      */
     void cancelExecution();
     
@@ -236,6 +304,44 @@ public:
      */
     void cancelCurrentCommand() { cancelExecution(); }
     
+    /**
+     * Attaches the cancellation token of the current render. Once the token is
+     * cancelled the running process group is killed straight away and
+     * executeCommand() refuses to start anything new, so loops issuing many
+     * commands stop at the next call instead of running to completion.
+     * 
+     * @param token The render's token, or nullptr to detach
+     */
+    void setCancellationToken(CancellationToken::Ptr token);
+    
+    /**
+     * Returns true if the attached cancellation token has been cancelled.
+     */
+    bool isCancellationRequested() const;
+    
+    /**
+     * Registers a process started outside executeCommand(), such as a decoder whose
+     * frames are read directly, so cancelExecution() and the render's token kill it
+     * like the executor's own commands. The registration lasts as long as this object,
+     * which must not outlive the process.
+     */
+    class ScopedProcessRegistration
+    {
+    public:
+        ScopedProcessRegistration(FFmpegExecutor& executor, FFmpegProcess& process);
+        ~ScopedProcessRegistration();
+        
+        /** True if a cancel has been requested since the registration was made. */
+        bool wasCancelled() const;
+        
+    private:
+        FFmpegExecutor& executor;
+        FFmpegProcess& process;
+        const int cancelGenerationAtStart;
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedProcessRegistration)
+    };
+    
     /**
      * Gets the path to the FFmpeg executable.
      * 
@@ -258,9 +364,10 @@ public:
     bool checkFFmpegAvailability();
     
     /**
-     * Checks if NVIDIA hardware encoding (NVENC) is available.
+     * Checks if NVIDIA hardware encoding (NVENC) is available. Uses the
+     * EncoderCapabilities probe, so this only spawns FFmpeg the first time.
      * 
-     * @return true if NVENC is available, false otherwise
+     * @return true if an h264_nvenc test encode succeeded, false otherwise
      */
     bool isNVENCAvailable();
     
@@ -293,6 +400,16 @@ public:
      */
     VideoStreamInfo getVideoStreamInfo(const juce::File& file);
     
+    /**
+     * Counts the packets of the first video stream, which is its frame count.
+     * Reads the whole file but doesn't decode it; runs through runProbe(), so a
+     * cancelled render stops it.
+     *
+     * @param file The video file to inspect
+     * @return     The number of frames, or -1 if unavailable
+     */
+    int getVideoFrameCount(const juce::File& file);
+    
     /**
      * Parses an FFmpeg progress line to extract the progress percentage.
      * 
@@ -313,23 +430,48 @@ public:
     double getCurrentProgress() const { return currentProgress; }
     
 private:
+    /** Outcome of one command, used to classify failures */
+    struct CommandResult
+    {
+        int exitCode = -1;
+        bool cancelled = false;
+        juce::StringArray outputTail;
+    };
+    
+    bool runCommand(const juce::String& command, double progressStart, double progressEnd, CommandResult& result);
+    
+    /** Media seconds a command will produce: its -t, else the length of its first input, else 0. */
+    double estimateCommandDuration(const juce::String& command);
     juce::File getNextCommandLogFile(int& outIndex);
     void writeToAggregateLog(const juce::String& message);
     
     //==========================================================================
     // JUCE-related members
     
-    /** The active FFmpeg child process being monitored */
-    std::unique_ptr<juce::ChildProcess> activeProcess;
+    /** The FFmpeg child processes currently being monitored, owned by their executeCommand() calls */
+    juce::Array<FFmpegProcess*> activeProcesses;
     
     /** Thread-safe mutex for protecting shared state */
-    juce::CriticalSection lock;
+    mutable juce::CriticalSection lock;
+    
+    /** Token of the render this executor is working for, and our callback on it */
+    CancellationToken::Ptr cancellationToken;
+    int cancellationCallbackId { 0 };
+    
+    /** Signalled on cancel so the monitoring loop wakes without waiting out its poll */
+    juce::WaitableEvent wakeEvent;
+    
+    /** Decides how failed jobs are retried; sticky downgrades last until reset() */
+    FallbackPolicy fallbackPolicy;
     
     //==========================================================================
     // Threading and state members
     
-    /** Flag to indicate if the current process should be cancelled */
-    std::atomic<bool> shouldCancel;
+    /** Bumped by cancelExecution(); a command started under an older value has been cancelled */
+    std::atomic<int> cancelGeneration { 0 };
+    
+    /** False while a coordinator reports progress for several concurrent commands */
+    std::atomic<bool> commandProgressEnabled { true };
     
     /** Current progress value, atomic for thread safety */
     std::atomic<double> currentProgress {0.0};
@@ -350,6 +492,10 @@ private:
     juce::File sessionAggregateLogFile;
     bool sessionLoggingEnabled { false };
     int sessionCommandIndex { 0 };
+    
+    // Per-command performance records for the current session
+    RenderTelemetry telemetry;
+    std::map<juce::Thread::ThreadID, juce::String> telemetryStages;
 
     // Optional external progress window to map multiple FFmpeg calls onto a single global bar
     bool externalProgressActive;
@@ -0,0 +1,411 @@
+#include "FFmpegProcess.h"
+
+#if ! JUCE_WINDOWS
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <unistd.h>
+ #include <sys/resource.h>
+ #include <sys/wait.h>
+ #include <string>
+ #include <vector>
+#endif
+
+#if JUCE_LINUX
+ #include <sched.h>
+ #include <sys/syscall.h>
+#endif
+
+#if ! JUCE_WINDOWS
+namespace
+{
+    /**
+     * A job policy resolved into plain values before fork(), so that applying
+     * it in the child needs nothing but system calls.
+     */
+    struct ChildSchedulingSettings
+    {
+        int niceValue = 0;
+       #if JUCE_LINUX
+        int ioPriority = 0;             // encoded ioprio value, 0 = leave alone
+        bool hasAffinity = false;
+        cpu_set_t affinity;
+        std::string cgroupProcsPath;    // empty = stay in our cgroup
+       #endif
+    };
+
+    ChildSchedulingSettings resolveSchedulingSettings(ProcessManager::JobClass jobClass)
+    {
+        auto& manager = ProcessManager::getInstance();
+        const auto policy = manager.getJobPolicy(jobClass);
+
+        ChildSchedulingSettings settings;
+        settings.niceValue = policy.niceValue;
+
+       #if JUCE_LINUX
+        constexpr int ioprioClassShift = 13;
+        if (policy.ioPriorityClass > 0)
+            settings.ioPriority = (policy.ioPriorityClass << ioprioClassShift) | policy.ioPriorityLevel;
+
+        CPU_ZERO(&settings.affinity);
+        if (policy.cpuAffinityMask != 0)
+        {
+            for (int cpu = 0; cpu < 64; ++cpu)
+                if ((policy.cpuAffinityMask >> cpu) & 1)
+                    CPU_SET(cpu, &settings.affinity);
+
+            settings.hasAffinity = true;
+        }
+
+        const juce::File procsFile = manager.prepareCgroup(jobClass);
+        if (procsFile != juce::File())
+            settings.cgroupProcsPath = procsFile.getFullPathName().toStdString();
+       #endif
+
+        return settings;
+    }
+
+    // Runs in the forked child before exec: system calls only, failures are ignored
+    void applySchedulingSettings(const ChildSchedulingSettings& settings)
+    {
+        if (settings.niceValue != 0)
+            ::setpriority(PRIO_PROCESS, 0, settings.niceValue);
+
+       #if JUCE_LINUX
+        constexpr int ioprioWhoProcess = 1;
+        if (settings.ioPriority != 0)
+            ::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, settings.ioPriority);
+
+        if (settings.hasAffinity)
+            ::sched_setaffinity(0, sizeof(cpu_set_t), &settings.affinity);
+
+        // Writing "0" to cgroup.procs moves the writing process
+        if (!settings.cgroupProcsPath.empty())
+        {
+            const int fd = ::open(settings.cgroupProcsPath.c_str(), O_WRONLY);
+            if (fd >= 0)
+            {
+                const ssize_t written = ::write(fd, "0", 1);
+                (void) written;
+                ::close(fd);
+            }
+        }
+       #endif
+    }
+}
+#endif
+
+//==============================================================================
+juce::StringArray FFmpegProcess::tokenizeCommand(const juce::String& command)
+{
+    // Work on the UTF-8 bytes directly - quotes and whitespace are ASCII, so any
+    // multi-byte characters in file names pass through untouched.
+    const std::string text = command.toStdString();
+
+    juce::StringArray args;
+    std::string current;
+    bool inQuotes = false;
+    bool hasToken = false;
+
+    for (char c : text)
+    {
+        if (c == '"')
+        {
+            inQuotes = !inQuotes;
+            hasToken = true;
+        }
+        else if (!inQuotes && (c == ' ' || c == '\t' || c == '\r' || c == '\n'))
+        {
+            if (hasToken)
+                args.add(juce::String::fromUTF8(current.c_str(), (int) current.size()));
+
+            current.clear();
+            hasToken = false;
+        }
+        else
+        {
+            current += c;
+            hasToken = true;
+        }
+    }
+
+    if (hasToken)
+        args.add(juce::String::fromUTF8(current.c_str(), (int) current.size()));
+
+    return args;
+}
+
+#if JUCE_WINDOWS
+
+//==============================================================================
+FFmpegProcess::FFmpegProcess(ProcessManager::JobClass jobClassToUse, const juce::String& descriptionToUse)
+    : jobClass(jobClassToUse),
+      description(descriptionToUse)
+{
+}
+
+FFmpegProcess::~FFmpegProcess()
+{
+    ProcessManager::getInstance().unregisterProcess(&process);
+
+    if (process.isRunning())
+        process.kill();
+}
+
+bool FFmpegProcess::start(const juce::String& command)
+{
+    if (!process.start(command))
+        return false;
+
+    ProcessManager::getInstance().registerProcess(&process, description);
+    return true;
+}
+
+bool FFmpegProcess::isRunning()
+{
+    return process.isRunning();
+}
+
+int FFmpegProcess::readProcessOutput(void* destBuffer, int numBytesToRead)
+{
+    return process.readProcessOutput(destBuffer, numBytesToRead);
+}
+
+bool FFmpegProcess::kill()
+{
+    return process.kill();
+}
+
+int FFmpegProcess::getExitCode() const
+{
+    return (int) process.getExitCode();
+}
+
+#else
+
+//==============================================================================
+FFmpegProcess::FFmpegProcess(ProcessManager::JobClass jobClassToUse, const juce::String& descriptionToUse)
+    : jobClass(jobClassToUse),
+      description(descriptionToUse)
+{
+}
+
+FFmpegProcess::~FFmpegProcess()
+{
+    {
+        const juce::ScopedLock sl(stateLock);
+        if (childPid > 0 && !finished)
+        {
+            killProcessGroup();
+            reap(true);
+        }
+    }
+
+    if (outputPipe >= 0)
+        ::close(outputPipe);
+}
+
+bool FFmpegProcess::start(const juce::String& command)
+{
+    const juce::StringArray args = tokenizeCommand(command);
+    if (args.isEmpty())
+        return false;
+
+    // Build argv before forking - the child must not allocate
+    std::vector<std::string> storage;
+    for (const auto& arg : args)
+        storage.push_back(arg.toStdString());
+
+    std::vector<char*> argv;
+    for (auto& arg : storage)
+        argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    const ChildSchedulingSettings scheduling = resolveSchedulingSettings(jobClass);
+
+    // Keep the pipe out of any other children spawned concurrently. pipe2 sets the flag
+    // atomically; where it's missing, another thread's fork can slip in before fcntl
+    int pipeHandles[2] = {};
+   #if JUCE_LINUX
+    if (::pipe2(pipeHandles, O_CLOEXEC) != 0)
+        return false;
+   #else
+    if (::pipe(pipeHandles) != 0)
+        return false;
+
+    ::fcntl(pipeHandles[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(pipeHandles[1], F_SETFD, FD_CLOEXEC);
+   #endif
+
+    const pid_t pid = ::fork();
+
+    if (pid < 0)
+    {
+        ::close(pipeHandles[0]);
+        ::close(pipeHandles[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        // Child: lead a new process group so kill() also takes out anything FFmpeg spawns
+        ::setpgid(0, 0);
+        applySchedulingSettings(scheduling);
+
+        // stdout and stderr both go to the pipe, stdin is detached
+        ::dup2(pipeHandles[1], STDOUT_FILENO);
+        ::dup2(pipeHandles[1], STDERR_FILENO);
+
+        const int devNull = ::open("/dev/null", O_RDONLY);
+        if (devNull >= 0)
+        {
+            ::dup2(devNull, STDIN_FILENO);
+            ::close(devNull);
+        }
+
+        ::execvp(argv[0], argv.data());
+        ::_exit(127);
+    }
+
+    // Also set the group from the parent side, so it is in place before we could
+    // possibly try to kill it (whichever of the two calls runs second is a no-op)
+    ::setpgid(pid, pid);
+
+    ::close(pipeHandles[1]);
+    ::fcntl(pipeHandles[0], F_SETFL, ::fcntl(pipeHandles[0], F_GETFL) | O_NONBLOCK);
+
+    ProcessManager::getInstance().registerProcessGroup((int) pid,
+                                                       description + " [" + ProcessManager::getJobClassName(jobClass) + "]");
+
+    const juce::ScopedLock sl(stateLock);
+    childPid = (int) pid;
+    outputPipe = pipeHandles[0];
+    finished = false;
+    exitCode = -1;
+    usage = {};
+    return true;
+}
+
+bool FFmpegProcess::isRunning()
+{
+    const juce::ScopedLock sl(stateLock);
+
+    if (childPid <= 0 || finished)
+        return false;
+
+    // Check for exit without reaping, so the /proc entry is still there to read
+    siginfo_t info {};
+    if (::waitid(P_PID, (id_t) childPid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0)
+        return true;
+
+    sampleIoCounters();
+    reap(true);
+    return false;
+}
+
+void FFmpegProcess::sampleIoCounters()
+{
+   #if JUCE_LINUX
+    const juce::String path = "/proc/" + juce::String(childPid) + "/io";
+    const int fd = ::open(path.toRawUTF8(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    char buffer[512] = {};
+    const ssize_t bytes = ::read(fd, buffer, sizeof(buffer) - 1);
+    ::close(fd);
+
+    if (bytes <= 0)
+        return;
+
+    juce::StringArray lines;
+    lines.addLines(juce::String::fromUTF8(buffer, (int) bytes));
+
+    for (const auto& line : lines)
+    {
+        if (line.startsWith("rchar:"))
+            usage.bytesRead = line.fromFirstOccurrenceOf(":", false, false).trim().getLargeIntValue();
+        else if (line.startsWith("wchar:"))
+            usage.bytesWritten = line.fromFirstOccurrenceOf(":", false, false).trim().getLargeIntValue();
+    }
+   #endif
+}
+
+void FFmpegProcess::reap(bool blocking)
+{
+    int status = 0;
+    struct rusage resources {};
+    const pid_t result = ::wait4((pid_t) childPid, &status, blocking ? 0 : WNOHANG, &resources);
+
+    finished = true;
+
+    // Once reaped the pid can be reused, so it must no longer be killed as a group
+    ProcessManager::getInstance().unregisterProcessGroup(childPid);
+
+    if (result != (pid_t) childPid)
+        return;
+
+    if (WIFEXITED(status))
+        exitCode = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        exitCode = 128 + WTERMSIG(status);
+
+    usage.valid = true;
+    usage.userCpuSeconds = (double) resources.ru_utime.tv_sec + (double) resources.ru_utime.tv_usec / 1.0e6;
+    usage.systemCpuSeconds = (double) resources.ru_stime.tv_sec + (double) resources.ru_stime.tv_usec / 1.0e6;
+
+   #if JUCE_MAC
+    usage.peakResidentKb = (juce::int64) resources.ru_maxrss / 1024;   // bytes on macOS
+   #else
+    usage.peakResidentKb = (juce::int64) resources.ru_maxrss;          // kilobytes on Linux
+   #endif
+
+    // Block counts are a coarse fallback when /proc isn't available
+    if (usage.bytesRead < 0)
+        usage.bytesRead = (juce::int64) resources.ru_inblock * 512;
+    if (usage.bytesWritten < 0)
+        usage.bytesWritten = (juce::int64) resources.ru_oublock * 512;
+}
+
+int FFmpegProcess::readProcessOutput(void* destBuffer, int numBytesToRead)
+{
+    if (outputPipe < 0 || numBytesToRead <= 0)
+        return 0;
+
+    const ssize_t bytes = ::read(outputPipe, destBuffer, (size_t) numBytesToRead);
+    return bytes > 0 ? (int) bytes : 0;
+}
+
+bool FFmpegProcess::kill()
+{
+    const juce::ScopedLock sl(stateLock);
+
+    if (childPid <= 0 || finished)
+        return false;
+
+    return killProcessGroup();
+}
+
+bool FFmpegProcess::killProcessGroup()
+{
+    // The group id is the child's pid; fall back to the single process if the
+    // group couldn't be created
+    if (::kill(-(pid_t) childPid, SIGKILL) == 0)
+        return true;
+
+    return ::kill((pid_t) childPid, SIGKILL) == 0;
+}
+
+int FFmpegProcess::getExitCode() const
+{
+    const juce::ScopedLock sl(stateLock);
+    return exitCode;
+}
+
+#endif
+
+//==============================================================================
+FFmpegProcess::ResourceUsage FFmpegProcess::getResourceUsage() const
+{
+    const juce::ScopedLock sl(stateLock);
+    return usage;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <JuceHeader.h>
+#include "../core/ProcessManager.h"
+
+/**
+ * A child process used for running FFmpeg jobs.
+ *
+ * On POSIX systems the process is spawned directly with fork/execvp so that
+ * it can be reaped with wait4(), which gives us the CPU time and peak memory
+ * of the job. On Windows this wraps juce::ChildProcess and resource usage is
+ * reported as unavailable.
+ *
+ * stdout and stderr are merged into a single pipe, mirroring the
+ * juce::ChildProcess behaviour the rest of the pipeline was written against.
+ *
+ * On POSIX the child leads its own process group, and kill() signals the
+ * whole group so no helper processes outlive a cancelled job. The group is
+ * registered with ProcessManager, and the child is given the scheduling policy
+ * (nice, I/O priority, CPU affinity, cgroup) of its job class before exec.
+ */
+class FFmpegProcess
+{
+public:
+    /** Resource usage of a finished process. */
+    struct ResourceUsage
+    {
+        bool valid = false;              // false when the platform can't report usage
+        double userCpuSeconds = 0.0;
+        double systemCpuSeconds = 0.0;
+        juce::int64 peakResidentKb = -1;
+        juce::int64 bytesRead = -1;      // -1 when unavailable
+        juce::int64 bytesWritten = -1;   // -1 when unavailable
+    };
+
+    /**
+     * @param jobClass    Selects the scheduling policy the process runs under
+     * @param description Shown in ProcessManager logs
+     */
+    explicit FFmpegProcess(ProcessManager::JobClass jobClass = ProcessManager::JobClass::Render,
+                           const juce::String& description = "FFmpeg");
+
+    /** Kills the process if it is still running. */
+    ~FFmpegProcess();
+
+    /**
+     * Starts the command.
+     *
+     * The command line is split the same way the rest of the code builds it:
+     * whitespace separates arguments and double quotes group an argument.
+     *
+     * @param command The complete command line
+     * @return        true if the process was started
+     */
+    bool start(const juce::String& command);
+
+    /**
+     * Returns true while the process is running. Once the process has exited
+     * this reaps it and captures the exit code and resource usage.
+     */
+    bool isRunning();
+
+    /**
+     * Reads any output that is available without blocking.
+     *
+     * @return The number of bytes read, or 0 if nothing was available
+     */
+    int readProcessOutput(void* destBuffer, int numBytesToRead);
+
+    /** Kills the process (and, on POSIX, everything in its process group). */
+    bool kill();
+
+    /** Returns the exit code once the process has finished. */
+    int getExitCode() const;
+
+    /** Returns the resource usage captured when the process was reaped. */
+    ResourceUsage getResourceUsage() const;
+
+    /**
+     * Splits a command line into arguments, removing the double quotes that
+     * group arguments containing spaces.
+     */
+    static juce::StringArray tokenizeCommand(const juce::String& command);
+
+private:
+   #if JUCE_WINDOWS
+    juce::ChildProcess process;
+   #else
+    void sampleIoCounters();
+    void reap(bool blocking);
+    bool killProcessGroup();
+
+    int childPid = -1;
+    int outputPipe = -1;
+    bool finished = false;
+   #endif
+
+    ProcessManager::JobClass jobClass;
+    juce::String description;
+    int exitCode = -1;
+    ResourceUsage usage;
+    juce::CriticalSection stateLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FFmpegProcess)
+};
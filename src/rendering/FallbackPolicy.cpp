@@ -0,0 +1,186 @@
+#include "FallbackPolicy.h"
+
+namespace
+{
+    using FailureKind = FallbackPolicy::FailureKind;
+    using Strategy = FallbackPolicy::Strategy;
+
+    /** One row of the fallback matrix. */
+    struct FallbackRule
+    {
+        FailureKind failure;
+        std::vector<Strategy> strategies;   // tried in order, skipping any already applied
+        bool sticky;                        // later jobs start with the strategy that got past this
+    };
+
+    // The fallback matrix. Failures without a row (cancelled, disk full, missing
+    // input) are not retried - running the same job again can't fix them.
+    const std::vector<FallbackRule>& getFallbackMatrix()
+    {
+        static const std::vector<FallbackRule> matrix = {
+            { FailureKind::EncoderUnavailable, { Strategy::CpuEncoder },                                             true  },
+            { FailureKind::OutOfMemory,        { Strategy::SingleThread, Strategy::CpuEncoder },                     true  },
+            { FailureKind::CorruptInput,       { Strategy::TolerantDecode, Strategy::SingleThread },                 false },
+            { FailureKind::Unknown,            { Strategy::CpuEncoder, Strategy::TolerantDecode, Strategy::SingleThread }, false },
+        };
+        return matrix;
+    }
+
+    bool containsAny(const juce::String& text, std::initializer_list<const char*> patterns)
+    {
+        for (auto* pattern : patterns)
+            if (text.containsIgnoreCase(pattern))
+                return true;
+
+        return false;
+    }
+}
+
+//==============================================================================
+juce::String FallbackPolicy::JobOptions::getInputFlags() const
+{
+    return tolerantDecode ? "-fflags +genpts+discardcorrupt -err_detect ignore_err" : "";
+}
+
+juce::String FallbackPolicy::JobOptions::getOutputFlags() const
+{
+    juce::String flags;
+
+    if (tolerantDecode)
+        flags << "-vsync cfr -avoid_negative_ts make_zero";
+
+    if (singleThread)
+        flags << (flags.isEmpty() ? "" : " ") << "-threads 1";
+
+    return flags;
+}
+
+bool FallbackPolicy::JobOptions::has(Strategy strategy) const
+{
+    switch (strategy)
+    {
+        case Strategy::CpuEncoder:     return !useGpuEncoder;
+        case Strategy::SingleThread:   return singleThread;
+        case Strategy::TolerantDecode: return tolerantDecode;
+    }
+
+    return false;
+}
+
+void FallbackPolicy::JobOptions::apply(Strategy strategy)
+{
+    switch (strategy)
+    {
+        case Strategy::CpuEncoder:     useGpuEncoder = false; break;
+        case Strategy::SingleThread:   singleThread = true; break;
+        case Strategy::TolerantDecode: tolerantDecode = true; break;
+    }
+}
+
+//==============================================================================
+FallbackPolicy::FailureKind FallbackPolicy::classifyFailure(int exitCode, const juce::StringArray& outputTail)
+{
+    if (exitCode == 0)
+        return FailureKind::None;
+
+    const juce::String text = outputTail.joinIntoString("\n");
+
+    // NVENC first: its session limit is reported as "out of memory (10)"
+    if (containsAny(text, { "OpenEncodeSessionEx failed", "No capable devices found", "No NVENC capable devices",
+                            "Cannot load libnvidia-encode", "Cannot load nvEncodeAPI", "Cannot load nvcuda",
+                            "Driver does not support the required nvenc API", "minimum required Nvidia driver",
+                            "InitializeEncoder failed", "Unknown encoder" }))
+        return FailureKind::EncoderUnavailable;
+
+    if (exitCode == -28 || containsAny(text, { "No space left on device" }))
+        return FailureKind::DiskFull;
+
+    // 137 = killed by SIGKILL, which is what the kernel OOM killer sends
+    if (exitCode == 137 || containsAny(text, { "Cannot allocate memory", "Out of memory", "CUDA_ERROR_OUT_OF_MEMORY" }))
+        return FailureKind::OutOfMemory;
+
+    if (containsAny(text, { "No such file or directory" }))
+        return FailureKind::MissingInput;
+
+    if (containsAny(text, { "Invalid data found when processing input", "moov atom not found", "error while decoding",
+                            "Invalid NAL unit", "non-existing PPS", "corrupt", "Header missing", "Packet mismatch" }))
+        return FailureKind::CorruptInput;
+
+    return FailureKind::Unknown;
+}
+
+juce::String FallbackPolicy::getFailureName(FailureKind failure)
+{
+    switch (failure)
+    {
+        case FailureKind::None:               return "none";
+        case FailureKind::Cancelled:          return "cancelled";
+        case FailureKind::EncoderUnavailable: return "encoder unavailable";
+        case FailureKind::OutOfMemory:        return "out of memory";
+        case FailureKind::DiskFull:           return "disk full";
+        case FailureKind::CorruptInput:       return "corrupt input";
+        case FailureKind::MissingInput:       return "missing input";
+        case FailureKind::Unknown:            return "unknown error";
+    }
+
+    return "unknown error";
+}
+
+juce::String FallbackPolicy::getStrategyName(Strategy strategy)
+{
+    switch (strategy)
+    {
+        case Strategy::CpuEncoder:     return "CPU encoder";
+        case Strategy::SingleThread:   return "single thread";
+        case Strategy::TolerantDecode: return "tolerant decode";
+    }
+
+    return {};
+}
+
+//==============================================================================
+FallbackPolicy::JobOptions FallbackPolicy::getInitialOptions(bool preferGpuEncoder) const
+{
+    const juce::ScopedLock sl(lock);
+
+    JobOptions options;
+    options.useGpuEncoder = preferGpuEncoder && stickyOptions.useGpuEncoder;
+    options.singleThread = stickyOptions.singleThread;
+    options.tolerantDecode = stickyOptions.tolerantDecode;
+    return options;
+}
+
+bool FallbackPolicy::chooseNext(FailureKind failure, const JobOptions& options, Strategy& next)
+{
+    for (const auto& rule : getFallbackMatrix())
+    {
+        if (rule.failure != failure)
+            continue;
+
+        for (auto strategy : rule.strategies)
+        {
+            if (options.has(strategy))
+                continue;
+
+            if (rule.sticky)
+            {
+                const juce::ScopedLock sl(lock);
+                stickyOptions.apply(strategy);
+            }
+
+            next = strategy;
+            return true;
+        }
+
+        return false;
+    }
+
+    return false;
+}
+
+void FallbackPolicy::reset()
+{
+    const juce::ScopedLock sl(lock);
+    stickyOptions = {};
+    stickyOptions.useGpuEncoder = true;
+}
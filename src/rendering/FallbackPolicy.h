@@ -0,0 +1,94 @@
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+
+/**
+ * Decides how to retry a failed FFmpeg job.
+ *
+ * A failure is classified from the exit code and the tail of FFmpeg's output,
+ * then the fallback matrix (see FallbackPolicy.cpp) says which strategies to
+ * try next for that kind of failure. Strategies are cumulative: a job that has
+ * already moved to the CPU encoder keeps it when it next drops to one thread.
+ *
+ * Some downgrades are sticky. Once NVENC has reported it is out of sessions or
+ * unusable, every later job in the render starts on the CPU instead of failing
+ * on the GPU first.
+ */
+class FallbackPolicy
+{
+public:
+    /** Why an FFmpeg job failed. */
+    enum class FailureKind
+    {
+        None,
+        Cancelled,
+        EncoderUnavailable,     // NVENC session limit, no device, driver/library missing
+        OutOfMemory,
+        DiskFull,
+        CorruptInput,
+        MissingInput,
+        Unknown
+    };
+
+    /** A change to how a job is run. */
+    enum class Strategy
+    {
+        CpuEncoder,             // swap the GPU encoder for the CPU one
+        SingleThread,           // -threads 1, least memory and most deterministic
+        TolerantDecode          // regenerate timestamps and skip over decode errors
+    };
+
+    /** How a job should be built for the current attempt. */
+    struct JobOptions
+    {
+        bool useGpuEncoder = false;
+        bool singleThread = false;
+        bool tolerantDecode = false;
+
+        /** Flags that belong before the first -i. */
+        juce::String getInputFlags() const;
+
+        /** Flags that belong just before the output file. */
+        juce::String getOutputFlags() const;
+
+        bool has(Strategy strategy) const;
+        void apply(Strategy strategy);
+    };
+
+    /** Builds the complete command line for a given set of options. */
+    using CommandBuilder = std::function<juce::String(const JobOptions&)>;
+
+    FallbackPolicy() { reset(); }
+
+    /** Classifies a failure from the exit code and the last lines FFmpeg printed. */
+    static FailureKind classifyFailure(int exitCode, const juce::StringArray& outputTail);
+
+    static juce::String getFailureName(FailureKind failure);
+    static juce::String getStrategyName(Strategy strategy);
+
+    /**
+     * Returns the options the first attempt of a new job should use, including
+     * any sticky downgrades from earlier failures.
+     */
+    JobOptions getInitialOptions(bool preferGpuEncoder) const;
+
+    /**
+     * Picks the next strategy for a job that failed with the given options.
+     *
+     * @param failure The classified failure
+     * @param options The options of the attempt that failed
+     * @param next    Receives the strategy to apply
+     * @return        false if the matrix has nothing left to try
+     */
+    bool chooseNext(FailureKind failure, const JobOptions& options, Strategy& next);
+
+    /** Clears sticky downgrades, e.g. at the start of a new render. */
+    void reset();
+
+private:
+    juce::CriticalSection lock;
+    JobOptions stickyOptions;   // downgrades every new job starts with
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FallbackPolicy)
+};
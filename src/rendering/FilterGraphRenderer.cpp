@@ -0,0 +1,456 @@
+#include "FilterGraphRenderer.h"
+#include <cmath>
+
+namespace
+{
+    constexpr juce::int64 defaultMemoryBudgetMegabytes = 4096;
+    constexpr int defaultMaxInputs = 48;
+
+    juce::String seconds(double value)
+    {
+        return juce::String(value, 6);
+    }
+
+    juce::String quotePath(const juce::File& file)
+    {
+        return "\"" + file.getFullPathName() + "\"";
+    }
+}
+
+FilterGraphRenderer::FilterGraphRenderer(FFmpegExecutor* executor)
+    : ffmpegExecutor(executor)
+{
+    const juce::int64 megabytes = juce::SystemStats::getEnvironmentVariable("FFLUCE_FILTERGRAPH_MEMORY_MB", {}).getLargeIntValue();
+    memoryBudget = (megabytes > 0 ? megabytes : defaultMemoryBudgetMegabytes) * 1024 * 1024;
+
+    const int inputs = juce::SystemStats::getEnvironmentVariable("FFLUCE_FILTERGRAPH_MAX_INPUTS", {}).getIntValue();
+    maxInputs = inputs > 0 ? inputs : defaultMaxInputs;
+}
+
+//==============================================================================
+bool FilterGraphRenderer::compile(const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                                  const std::vector<RenderTypes::VideoClipInfo>& loopClips,
+                                  const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
+                                  const juce::File& audioFile,
+                                  double targetDuration,
+                                  const Settings& settings,
+                                  const juce::File& outputFile,
+                                  juce::String& reason)
+{
+    inputArguments.clear();
+    filters.clear();
+    outputArguments.clear();
+    numLabels = 0;
+    compiled = false;
+    cuda = settings.cudaFilters;
+    deviceArguments = cuda ? "-init_hw_device cuda=cu -filter_hw_device cu" : juce::String();
+
+    if (loopClips.empty()) {
+        reason = "there are no loop clips";
+        return false;
+    }
+
+    std::vector<ClipSource> intro, loop;
+    for (const auto& info : introClips) {
+        intro.emplace_back();
+        if (!resolveClip(info, intro.back(), reason))
+            return false;
+    }
+    for (const auto& info : loopClips) {
+        loop.emplace_back();
+        if (!resolveClip(info, loop.back(), reason))
+            return false;
+    }
+
+    // xfade needs matching frame rates, so everything is resampled to the first loop clip's
+    const auto info = ffmpegExecutor->getVideoStreamInfo(loop.front().file);
+    frameRate = info.fps;
+    frameWidth = info.width;
+    frameHeight = info.height;
+    if (frameRate <= 0.0 || info.width <= 0 || info.height <= 0) {
+        reason = "the loop clips could not be probed";
+        return false;
+    }
+
+    // Crossfades as the file-based pipeline applies them: each clip's crossfade leads
+    // into the next one, the last intro clip's into the first loop clip, and the last
+    // loop clip's only between loop repeats (and only when there are several loop clips)
+    const double introCrossfade = intro.empty() ? 0.0 : intro.back().crossfade;
+    const double loopCrossfade = loop.back().crossfade > 0.001 ? loop.back().crossfade : 0.0;
+    const double headCutCrossfade = loop.size() > 1 ? loopCrossfade : 0.0;
+
+    // The head: intro clips straight into the loop clips, ending where the first repeat starts
+    std::vector<ClipSource> headClips = intro;
+    headClips.insert(headClips.end(), loop.begin(), loop.end());
+
+    std::vector<double> headCrossfades;
+    for (size_t i = 0; i + 1 < intro.size(); ++i)
+        headCrossfades.push_back(intro[i].crossfade);
+    if (!intro.empty())
+        headCrossfades.push_back(introCrossfade);
+    for (size_t i = 0; i + 1 < loop.size(); ++i)
+        headCrossfades.push_back(loop[i].crossfade);
+
+    Stream head;
+    if (!chainClips(headClips, headCrossfades, head, reason))
+        return false;
+
+    const double headDuration = head.duration - headCutCrossfade;
+    if (headCutCrossfade > 0.0) {
+        const juce::String cut = makeLabel("head");
+        filters.add("[" + head.label + "]trim=end=" + seconds(headDuration) + ",setpts=PTS-STARTPTS[" + cut + "]");
+        head = { cut, headDuration };
+    }
+
+    // One loop period: the loop clips again, entered through the loop-to-loop crossfade
+    Stream timeline = head;
+    juce::int64 memoryUsed = 0;
+    const double remaining = targetDuration - headDuration;
+
+    if (remaining > 0.001)
+    {
+        std::vector<double> loopCrossfades;
+        for (size_t i = 0; i + 1 < loop.size(); ++i)
+            loopCrossfades.push_back(loop[i].crossfade);
+
+        Stream period;
+        if (!chainClips(loop, loopCrossfades, period, reason))
+            return false;
+
+        if (loopCrossfade > 0.0 && loop.size() > 1)
+        {
+            const ClipSource& last = loop.back();
+            if (loopCrossfade >= last.duration) {
+                reason = "the loop crossfade is longer than the last loop clip";
+                return false;
+            }
+
+            const Stream tail = addClip(last, last.duration - loopCrossfade, loopCrossfade);
+            const juce::String entered = makeLabel("period");
+            filters.add("[" + tail.label + "][" + period.label + "]" + xfade(loopCrossfade, 0.0) + "[" + entered + "]");
+            period.label = entered;
+        }
+        else if (loopCrossfade > 0.0)
+        {
+            const juce::String entered = makeLabel("period");
+            filters.add("[" + period.label + "]trim=start=" + seconds(loopCrossfade) + ",setpts=PTS-STARTPTS[" + entered + "]");
+            period = { entered, period.duration - loopCrossfade };
+        }
+
+        const int repetitions = (int) std::ceil(remaining / period.duration);
+        const int periodFrames = (int) std::ceil(period.duration * frameRate) + 2;
+        memoryUsed += (juce::int64) periodFrames * info.width * info.height * 3 / 2;
+
+        if (memoryUsed > memoryBudget) {
+            reason = "a loop period needs " + juce::File::descriptionOfSizeInBytes(memoryUsed)
+                     + " in memory, over the " + juce::File::descriptionOfSizeInBytes(memoryBudget) + " budget";
+            return false;
+        }
+
+        const juce::String repeated = makeLabel("repeats");
+        filters.add("[" + period.label + "]loop=loop=" + juce::String(repetitions - 1) + ":size="
+                    + juce::String(periodFrames) + ":start=0[" + repeated + "]");
+
+        const juce::String joined = makeLabel("timeline");
+        filters.add("[" + head.label + "][" + repeated + "]concat=n=2:v=1:a=0[" + joined + "]");
+        timeline = { joined, headDuration + repetitions * period.duration };
+    }
+
+    const juce::String exact = makeLabel("timeline");
+    filters.add("[" + timeline.label + "]trim=duration=" + seconds(targetDuration) + ",setpts=PTS-STARTPTS[" + exact + "]");
+    timeline = { exact, targetDuration };
+
+    for (const auto& overlay : overlayClips)
+        if (!addOverlay(overlay, timeline, targetDuration, memoryUsed, reason))
+            return false;
+
+    if (cuda)
+    {
+        // There is no fade_cuda; crossfading from and to black does the same on the GPU
+        auto black = [this](double duration)
+        {
+            const juce::String label = makeLabel("black");
+            filters.add("color=c=black:s=" + juce::String(frameWidth) + "x" + juce::String(frameHeight) + ":r="
+                        + juce::String(frameRate, 6) + ":d=" + seconds(duration)
+                        + ",format=yuv420p,hwupload_cuda,settb=AVTB[" + label + "]");
+            return label;
+        };
+
+        if (settings.fadeInDuration > 0.001)
+        {
+            const juce::String faded = makeLabel("timeline");
+            filters.add("[" + black(settings.fadeInDuration) + "][" + timeline.label + "]"
+                        + xfade(settings.fadeInDuration, 0.0) + "[" + faded + "]");
+            timeline.label = faded;
+        }
+
+        if (settings.fadeOutDuration > 0.001)
+        {
+            const juce::String faded = makeLabel("timeline");
+            filters.add("[" + timeline.label + "][" + black(settings.fadeOutDuration) + "]"
+                        + xfade(settings.fadeOutDuration, juce::jmax(0.0, targetDuration - settings.fadeOutDuration))
+                        + "[" + faded + "]");
+            timeline.label = faded;
+        }
+
+        filters.add("[" + timeline.label + "]null[vout]");
+    }
+    else
+    {
+        juce::StringArray fades;
+        if (settings.fadeInDuration > 0.001)
+            fades.add("fade=in:st=0:d=" + seconds(settings.fadeInDuration));
+        if (settings.fadeOutDuration > 0.001)
+            fades.add("fade=out:st=" + seconds(juce::jmax(0.0, targetDuration - settings.fadeOutDuration))
+                      + ":d=" + seconds(settings.fadeOutDuration));
+        fades.add("format=yuv420p");
+        filters.add("[" + timeline.label + "]" + fades.joinIntoString(",") + "[vout]");
+    }
+
+    const int audioInput = addInput({}, audioFile);
+    filters.add("[" + juce::String(audioInput) + ":a]" + settings.audioFilter + "[aout]");
+
+    if (inputArguments.size() > maxInputs) {
+        reason = juce::String(inputArguments.size()) + " inputs, over the limit of " + juce::String(maxInputs);
+        return false;
+    }
+
+    outputArguments = "-map \"[vout]\" -map \"[aout]\" " + settings.videoEncodeArgs
+                      + " -c:a aac -ar 48000 -b:a 384k"
+                      + " -t " + seconds(targetDuration)
+                      + " -movflags +faststart " + quotePath(outputFile);
+
+    if (logCallback)
+        logCallback("Compiled single-pass " + juce::String(cuda ? "CUDA" : "CPU") + " filtergraph: "
+                    + juce::String(inputArguments.size()) + " inputs, "
+                    + juce::String(filters.size()) + " filter chains, "
+                    + juce::File::descriptionOfSizeInBytes(memoryUsed) + " of frame buffers");
+
+    compiled = true;
+    return true;
+}
+
+juce::String FilterGraphRenderer::describe() const
+{
+    if (!compiled)
+        return "Filtergraph has not been compiled\n";
+
+    return ffmpegExecutor->getFFmpegPath() + " -y " + (cuda ? deviceArguments + " " : juce::String())
+           + inputArguments.joinIntoString(" ") + " -filter_complex_script <script> " + outputArguments + "\n\n"
+           + filters.joinIntoString(";\n") + "\n";
+}
+
+bool FilterGraphRenderer::run(const juce::File& tempDirectory)
+{
+    if (!compiled)
+        return false;
+
+    const juce::File script = tempDirectory.getChildFile("timeline_filtergraph.txt");
+    if (!script.replaceWithText(filters.joinIntoString(";\n"))) {
+        if (logCallback) logCallback("ERROR: Failed to write filtergraph script");
+        return false;
+    }
+
+    const juce::String command = ffmpegExecutor->getFFmpegPath() + " -y " + (cuda ? deviceArguments + " " : juce::String())
+                                 + inputArguments.joinIntoString(" ") + " -filter_complex_script " + quotePath(script) + " " + outputArguments;
+
+    ffmpegExecutor->setTelemetryStage("filtergraph");
+    const bool succeeded = ffmpegExecutor->executeCommand(command, 0.0, 1.0);
+    ffmpegExecutor->setTelemetryStage({});
+
+    script.deleteFile();
+    return succeeded;
+}
+
+//==============================================================================
+int FilterGraphRenderer::addInput(const juce::String& options, const juce::File& file)
+{
+    inputArguments.add((options.isNotEmpty() ? options + " " : juce::String()) + "-i " + quotePath(file));
+    return inputArguments.size() - 1;
+}
+
+juce::String FilterGraphRenderer::makeLabel(const juce::String& prefix)
+{
+    return prefix + juce::String(numLabels++);
+}
+
+juce::String FilterGraphRenderer::xfade(double duration, double offset) const
+{
+    return juce::String(cuda ? "xfade_cuda" : "xfade") + "=transition=fade:duration=" + seconds(duration)
+           + ":offset=" + seconds(offset);
+}
+
+FilterGraphRenderer::Stream FilterGraphRenderer::addClip(const ClipSource& clip, double start, double duration)
+{
+    // Input seeking decodes from the keyframe before the start but emits nothing earlier,
+    // so this is the same range conformClip cuts, without writing it out
+    const juce::String seek = "-ss " + seconds(clip.start + start) + " -t " + seconds(duration);
+    const juce::String label = makeLabel("clip");
+
+    if (cuda)
+    {
+        // Decoded into device memory; scale_cuda brings every clip to the same size and format
+        const int input = addInput("-hwaccel cuda -hwaccel_device cu -hwaccel_output_format cuda " + seek, clip.file);
+        filters.add("[" + juce::String(input) + ":v]fps=" + juce::String(frameRate, 6)
+                    + ",scale_cuda=" + juce::String(frameWidth) + ":" + juce::String(frameHeight)
+                    + ":format=yuv420p,settb=AVTB,setpts=PTS-STARTPTS[" + label + "]");
+        return { label, duration };
+    }
+
+    const int input = addInput(seek, clip.file);
+    filters.add("[" + juce::String(input) + ":v]fps=" + juce::String(frameRate, 6)
+                + ",format=yuv420p,settb=AVTB,setpts=PTS-STARTPTS[" + label + "]");
+    return { label, duration };
+}
+
+bool FilterGraphRenderer::chainClips(const std::vector<ClipSource>& clips, const std::vector<double>& crossfades,
+                                     Stream& result, juce::String& reason)
+{
+    result = addClip(clips.front(), 0.0, clips.front().duration);
+
+    for (size_t i = 1; i < clips.size(); ++i)
+    {
+        const Stream next = addClip(clips[i], 0.0, clips[i].duration);
+        const double crossfade = crossfades[i - 1];
+        const juce::String joined = makeLabel("chain");
+
+        if (crossfade > 0.001)
+        {
+            if (crossfade >= next.duration || crossfade >= result.duration) {
+                reason = "a crossfade is longer than the clip it fades from or into";
+                return false;
+            }
+
+            filters.add("[" + result.label + "][" + next.label + "]" + xfade(crossfade, result.duration - crossfade)
+                        + "[" + joined + "]");
+            result = { joined, result.duration + next.duration - crossfade };
+        }
+        else
+        {
+            filters.add("[" + result.label + "][" + next.label + "]concat=n=2:v=1:a=0[" + joined + "]");
+            result = { joined, result.duration + next.duration };
+        }
+    }
+
+    return true;
+}
+
+bool FilterGraphRenderer::addOverlay(const RenderTypes::OverlayClipInfo& overlay, Stream& base, double targetDuration,
+                                     juce::int64& memoryUsed, juce::String& reason)
+{
+    // Jittered, windowed or varied appearances are compiled by OverlaySchedule
+    if (overlay.hasSchedule())
+    {
+        reason = "scheduled overlay " + overlay.file.getFileName() + " needs OverlayProcessor";
+        return false;
+    }
+
+    // Same appearances as OverlayProcessor: whole appearances only, each starting from
+    // the overlay's first frame
+    const double fileDuration = ffmpegExecutor->getFileDuration(overlay.file);
+    double appearance = overlay.duration > 0.0 ? overlay.duration : fileDuration;
+    if (fileDuration > 0.0)
+        appearance = juce::jmin(appearance, fileDuration);
+
+    if (appearance <= 0.01 || overlay.startTimeSecs + appearance > targetDuration + 0.0005)
+    {
+        if (logCallback) logCallback("Overlay " + overlay.file.getFileName() + " never appears; leaving it out");
+        return true;
+    }
+
+    const double start = overlay.startTimeSecs;
+    const bool repeats = overlay.frequencySecs > 0.0;
+
+    // Between appearances overlay_cuda would keep drawing the last frame
+    if (repeats && cuda) {
+        reason = "repeating overlay " + overlay.file.getFileName() + " needs the CPU overlay filter";
+        return false;
+    }
+    const double frequency = repeats ? overlay.frequencySecs : appearance;
+    const int appearances = repeats ? (int) std::floor((targetDuration + 0.0005 - start - appearance) / frequency) + 1 : 1;
+    const double lastEnd = start + (appearances - 1) * frequency + appearance;
+    const int appearanceFrames = juce::jmax(1, (int) std::round(appearance * frameRate));
+
+    // A whole-file appearance repeats by looping the input; a shorter one has to be held
+    // in memory by the loop filter
+    const bool loopsWholeFile = repeats && std::abs(appearance - fileDuration) < 1.0 / frameRate;
+    // Fitted inside the timeline's frame at even sizes, as OverlayProcessor sizes its sprites,
+    // and scaled before the loop filter so it holds frames at that size
+    juce::String chain = "fps=" + juce::String(frameRate, 6)
+                       + ",scale=" + juce::String(frameWidth) + ":" + juce::String(frameHeight)
+                       + ":force_original_aspect_ratio=decrease:force_divisible_by=2,format=rgba";
+
+    if (repeats && !loopsWholeFile)
+    {
+        memoryUsed += (juce::int64) appearanceFrames * frameWidth * frameHeight * 4;
+        if (memoryUsed > memoryBudget) {
+            reason = "overlay " + overlay.file.getFileName() + " needs more than the frame buffer budget";
+            return false;
+        }
+        chain += ",trim=end_frame=" + juce::String(appearanceFrames)
+               + ",loop=loop=-1:size=" + juce::String(appearanceFrames) + ":start=0";
+    }
+    else if (!repeats)
+    {
+        chain += ",trim=end_frame=" + juce::String(appearanceFrames);
+    }
+
+    // Frame n of the looped overlay belongs to appearance floor(n / frames)
+    chain += ",setpts='(" + seconds(start) + "+floor(N/" + juce::String(appearanceFrames) + ")*" + seconds(frequency)
+           + "+mod(N," + juce::String(appearanceFrames) + ")/" + juce::String(frameRate, 6) + ")/TB'";
+
+    const int input = addInput(loopsWholeFile ? "-stream_loop -1" : juce::String(), overlay.file);
+    const juce::String overlayLabel = makeLabel("overlay");
+
+    if (cuda)
+    {
+        // Scaled on the CPU and uploaded once; the overlay passes the timeline through outside its frames
+        chain = chain.replace("format=rgba", "format=yuva420p") + ",hwupload_cuda";
+        filters.add("[" + juce::String(input) + ":v]" + chain + "[" + overlayLabel + "]");
+
+        const juce::String composited = makeLabel("timeline");
+        filters.add("[" + base.label + "][" + overlayLabel + "]overlay_cuda=x=(W-w)/2:y=(H-h)/2:eof_action=pass["
+                    + composited + "]");
+        base.label = composited;
+        return true;
+    }
+
+    filters.add("[" + juce::String(input) + ":v]" + chain + "[" + overlayLabel + "]");
+
+    const juce::String enable = "between(t," + seconds(start) + "," + seconds(lastEnd) + ")*lt(mod(t-" + seconds(start)
+                              + "," + seconds(frequency) + ")," + seconds(appearance) + ")";
+
+    const juce::String composited = makeLabel("timeline");
+    filters.add("[" + base.label + "][" + overlayLabel + "]overlay=x=(W-w)/2:y=(H-h)/2:format=auto:eof_action=pass"
+                + ":enable='" + enable + "'[" + composited + "]");
+    base.label = composited;
+    return true;
+}
+
+bool FilterGraphRenderer::resolveClip(const RenderTypes::VideoClipInfo& info, ClipSource& clip, juce::String& reason)
+{
+    if (!info.file.existsAsFile()) {
+        reason = info.file.getFileName() + " does not exist";
+        return false;
+    }
+
+    // The clamping conformClip applies
+    const double sourceDuration = ffmpegExecutor->getFileDuration(info.file);
+    clip.file = info.file;
+    clip.start = (std::isfinite(info.startTime) && info.startTime > 0.0 && info.startTime < sourceDuration - 0.001)
+                     ? info.startTime : 0.0;
+
+    double duration = info.duration;
+    if (!std::isfinite(duration) || duration <= 0.0 || duration > sourceDuration)
+        duration = sourceDuration;
+
+    clip.duration = juce::jmin(duration, juce::jmax(0.0, sourceDuration - clip.start));
+    clip.crossfade = info.crossfade;
+
+    if (clip.duration <= 0.01) {
+        reason = info.file.getFileName() + " has no usable duration";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RenderTypes.h"
+#include "FFmpegExecutor.h"
+#include <functional>
+#include <vector>
+
+/**
+ * Renders a whole timeline with one FFmpeg command.
+ *
+ * The intro, loop, crossfade, overlay and fade plan that TimelineAssembler
+ * builds out of dozens of lossless intermediates is compiled into a single
+ * filtergraph instead, so every source frame is decoded once and every output
+ * frame encoded once:
+ *
+ *   - intro and loop clips are chained with xfade (concat where a crossfade is
+ *     zero) into the head, which ends where the first loop repeat begins
+ *   - the repeated loop period is a second decode of the loop clips, led by the
+ *     loop-to-loop crossfade, and is repeated with the loop filter
+ *   - overlays are retimed with setpts and drawn with enable expressions
+ *   - fades, the exact target duration and the audio chain are applied last
+ *
+ * The loop filter keeps one loop period in memory, and looped overlays keep one
+ * appearance, so compile() refuses timelines that would exceed the memory
+ * budget or the input limit. The caller then uses the file-based pipeline.
+ *
+ * With Settings::cudaFilters the graph is built for NVIDIA instead: clips are
+ * decoded with -hwaccel cuda into device memory, normalised with scale_cuda,
+ * joined with xfade_cuda, overlays are uploaded once and drawn with
+ * overlay_cuda, and the fades are xfade_cuda to a black source, so frames stay
+ * on the GPU until h264_nvenc. Repeating overlays need the enable option that
+ * overlay_cuda lacks; compile() refuses them and the caller uses the CPU graph.
+ */
+class FilterGraphRenderer
+{
+public:
+    /** Everything about the output that the timeline itself doesn't say. */
+    struct Settings
+    {
+        juce::String videoEncodeArgs;   // delivery encoder, pixel format and profile
+        juce::String audioFilter;       // fades and loudness normalisation for the audio
+        double fadeInDuration = 0.0;
+        double fadeOutDuration = 0.0;
+        bool cudaFilters = false;       // NVIDIA profile; videoEncodeArgs must take CUDA frames
+    };
+
+    explicit FilterGraphRenderer(FFmpegExecutor* executor);
+
+    void setLogCallback(std::function<void(const juce::String&)> callback) { logCallback = std::move(callback); }
+
+    /**
+     * Builds the command and filtergraph for a timeline.
+     * @param reason Set to why the timeline can't be rendered in one pass
+     * @return true if run() can render it
+     */
+    bool compile(const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                 const std::vector<RenderTypes::VideoClipInfo>& loopClips,
+                 const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
+                 const juce::File& audioFile,
+                 double targetDuration,
+                 const Settings& settings,
+                 const juce::File& outputFile,
+                 juce::String& reason);
+
+    /** Returns the compiled command and filtergraph, for logs and dry runs. */
+    juce::String describe() const;
+
+    /**
+     * Runs the compiled command. The filtergraph is written to a script file in
+     * the temp directory, so its length isn't limited by the command line.
+     */
+    bool run(const juce::File& tempDirectory);
+
+private:
+    /** A normalised video stream and the seconds it lasts. */
+    struct Stream
+    {
+        juce::String label;
+        double duration = 0.0;
+    };
+
+    struct ClipSource
+    {
+        juce::File file;
+        double start = 0.0;
+        double duration = 0.0;
+        double crossfade = 0.0;
+    };
+
+    int addInput(const juce::String& options, const juce::File& file);
+    juce::String makeLabel(const juce::String& prefix);
+    juce::String xfade(double duration, double offset) const;
+    Stream addClip(const ClipSource& clip, double start, double duration);
+    bool chainClips(const std::vector<ClipSource>& clips, const std::vector<double>& crossfades,
+                    Stream& result, juce::String& reason);
+    bool addOverlay(const RenderTypes::OverlayClipInfo& overlay, Stream& base, double targetDuration,
+                    juce::int64& memoryUsed, juce::String& reason);
+    bool resolveClip(const RenderTypes::VideoClipInfo& info, ClipSource& clip, juce::String& reason);
+
+    FFmpegExecutor* ffmpegExecutor;
+
+    // Compiled command
+    juce::String deviceArguments;       // CUDA device for decoders and uploads
+    juce::StringArray inputArguments;
+    juce::StringArray filters;
+    juce::String outputArguments;
+    int numLabels = 0;
+    double frameRate = 0.0;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    bool cuda = false;
+    bool compiled = false;
+
+    // Limits; FFLUCE_FILTERGRAPH_MEMORY_MB and FFLUCE_FILTERGRAPH_MAX_INPUTS override them
+    juce::int64 memoryBudget;
+    int maxInputs;
+
+    std::function<void(const juce::String&)> logCallback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FilterGraphRenderer)
+};
@@ -0,0 +1,340 @@
+#include "IntermediateCache.h"
+#include <algorithm>
+
+namespace
+{
+    // Bump when intermediates change in a way their recipes don't capture
+    const juce::String keyVersion = "ffluce-intermediate-v1";
+
+    const juce::String stampFileName = ".last_used";
+    const juce::String partialSuffix = ".partial";
+
+    constexpr juce::int64 defaultBudgetMegabytes = 20 * 1024;
+
+    // Files up to this size are hashed whole, larger ones are sampled
+    constexpr juce::int64 fullHashLimit = 64 * 1024 * 1024;
+    constexpr int sampleBytes = 1024 * 1024;
+
+    // Hash of samples from the start, middle and end of a large file
+    juce::String hashSamples(const juce::File& file, juce::int64 size)
+    {
+        juce::MemoryBlock samples;
+        juce::FileInputStream stream(file);
+        if (stream.openedOk())
+        {
+            juce::MemoryBlock buffer((size_t) sampleBytes);
+            for (const juce::int64 position : { (juce::int64) 0, size / 2, size - sampleBytes })
+            {
+                stream.setPosition(position);
+                const int bytesRead = stream.read(buffer.getData(), sampleBytes);
+                if (bytesRead > 0)
+                    samples.append(buffer.getData(), (size_t) bytesRead);
+            }
+        }
+
+        return juce::SHA256(samples).toHexString();
+    }
+}
+
+IntermediateCache::IntermediateCache()
+{
+    const juce::String directoryOverride = juce::SystemStats::getEnvironmentVariable("FFLUCE_CACHE_DIR", {});
+    directory = directoryOverride.isNotEmpty() && juce::File::isAbsolutePath(directoryOverride)
+        ? juce::File(directoryOverride)
+        : juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+              .getChildFile("FFLUCE")
+              .getChildFile("intermediate_cache");
+
+    const juce::String budgetOverride = juce::SystemStats::getEnvironmentVariable("FFLUCE_CACHE_SIZE_MB", {});
+    const juce::int64 megabytes = budgetOverride.isNotEmpty() ? budgetOverride.getLargeIntValue() : defaultBudgetMegabytes;
+    sizeBudget = juce::jmax((juce::int64) 0, megabytes) * 1024 * 1024;
+}
+
+void IntermediateCache::setLogCallback(std::function<void(const juce::String&)> callback)
+{
+    const juce::ScopedLock sl(lock);
+    logCallback = std::move(callback);
+}
+
+void IntermediateCache::setDirectory(const juce::File& newDirectory)
+{
+    const juce::ScopedLock sl(lock);
+    directory = newDirectory;
+}
+
+juce::File IntermediateCache::getDirectory() const
+{
+    const juce::ScopedLock sl(lock);
+    return directory;
+}
+
+void IntermediateCache::setSizeBudget(juce::int64 bytes)
+{
+    const juce::ScopedLock sl(lock);
+    sizeBudget = juce::jmax((juce::int64) 0, bytes);
+}
+
+juce::int64 IntermediateCache::getSizeBudget() const
+{
+    const juce::ScopedLock sl(lock);
+    return sizeBudget;
+}
+
+//==============================================================================
+juce::String IntermediateCache::makeKey(const juce::StringArray& parts)
+{
+    return juce::SHA256(parts.joinIntoString("\n").toUTF8()).toHexString();
+}
+
+juce::String IntermediateCache::fingerprintFile(const juce::File& file)
+{
+    if (!file.existsAsFile())
+        return "missing:" + file.getFullPathName();
+
+    const juce::int64 size = file.getSize();
+    const juce::int64 modified = file.getLastModificationTime().toMilliseconds();
+    const juce::String memoKey = file.getFullPathName() + "|" + juce::String(size) + "|" + juce::String(modified);
+
+    {
+        const juce::ScopedLock sl(fingerprintLock);
+        auto known = fingerprints.find(memoKey);
+        if (known != fingerprints.end())
+            return known->second;
+    }
+
+    // Sampling can't see an edit in the middle of a clip that keeps its size,
+    // so the modification time is part of the fingerprint too
+    const juce::String fingerprint = size <= fullHashLimit
+        ? hashFileContent(file)
+        : "sampled:" + juce::String(size) + ":" + juce::String(modified) + ":" + hashSamples(file, size);
+
+    const juce::ScopedLock sl(fingerprintLock);
+    fingerprints[memoKey] = fingerprint;
+    return fingerprint;
+}
+
+juce::String IntermediateCache::hashFileContent(const juce::File& file)
+{
+    const juce::int64 size = file.getSize();
+
+    if (size <= fullHashLimit)
+        return "sha256:" + juce::SHA256(file).toHexString();
+
+    return "sampled:" + juce::String(size) + ":" + hashSamples(file, size);
+}
+
+std::vector<juce::String> IntermediateCache::computeKeys(const RenderGraph& graph)
+{
+    std::vector<juce::String> keys((size_t) graph.getNumTasks());
+
+    for (int taskId : graph.getTopologicalOrder())
+    {
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        if (task.recipe.isEmpty())
+            continue;
+
+        juce::StringArray parts;
+        parts.add(keyVersion);
+        parts.add(RenderGraph::getTaskTypeName(task.type));
+        parts.add(task.recipe);
+
+        for (const auto& output : task.outputs)
+            parts.add("out:" + output.getFileName());
+
+        bool cacheable = true;
+        for (const auto& input : task.inputs)
+        {
+            const int producer = graph.getProducer(input);
+            if (producer < 0)
+            {
+                parts.add("in:" + fingerprintFile(input));
+            }
+            else if (keys[(size_t) producer].isNotEmpty())
+            {
+                parts.add("in:" + keys[(size_t) producer] + "/" + input.getFileName());
+            }
+            else
+            {
+                cacheable = false;
+                break;
+            }
+        }
+
+        if (cacheable)
+            keys[(size_t) taskId] = makeKey(parts);
+    }
+
+    return keys;
+}
+
+//==============================================================================
+bool IntermediateCache::contains(const juce::String& key) const
+{
+    return key.isNotEmpty() && getEntryDirectory(key).isDirectory();
+}
+
+bool IntermediateCache::restore(const juce::String& key, const juce::Array<juce::File>& outputs)
+{
+    const juce::File entry = getEntryDirectory(key);
+    if (key.isEmpty() || !entry.isDirectory())
+        return false;
+
+    for (const auto& output : outputs)
+    {
+        const juce::File cached = entry.getChildFile(output.getFileName());
+
+        if (!cached.existsAsFile())
+        {
+            output.deleteFile();
+            continue;
+        }
+
+        if (!cached.copyFileTo(output))
+        {
+            if (logCallback)
+                logCallback("ERROR: Failed to restore " + output.getFileName() + " from the intermediate cache");
+            return false;
+        }
+    }
+
+    touch(entry);
+
+    if (logCallback)
+        logCallback("Restored from intermediate cache: " + outputs.getFirst().getFileName()
+                    + (outputs.size() > 1 ? " (+" + juce::String(outputs.size() - 1) + " more)" : juce::String()));
+    return true;
+}
+
+bool IntermediateCache::store(const juce::String& key, const juce::Array<juce::File>& outputs)
+{
+    if (key.isEmpty() || !isEnabled() || contains(key))
+        return false;
+
+    juce::int64 entrySize = 0;
+    for (const auto& output : outputs)
+        if (output.existsAsFile())
+            entrySize += output.getSize();
+
+    if (entrySize > getSizeBudget() / 2)
+    {
+        if (logCallback)
+            logCallback("Not caching " + outputs.getFirst().getFileName() + ": "
+                        + juce::File::descriptionOfSizeInBytes(entrySize) + " is over half the cache budget");
+        return false;
+    }
+
+    // Copy into a private directory first so nobody can restore a half-written entry
+    const juce::File entry = getEntryDirectory(key);
+    const juce::File partial = entry.getSiblingFile(key + partialSuffix + juce::String::toHexString(juce::Random::getSystemRandom().nextInt()));
+
+    if (!partial.createDirectory().wasOk())
+        return false;
+
+    for (const auto& output : outputs)
+    {
+        if (output.existsAsFile() && !output.copyFileTo(partial.getChildFile(output.getFileName())))
+        {
+            partial.deleteRecursively();
+            if (logCallback)
+                logCallback("WARNING: Failed to copy " + output.getFileName() + " into the intermediate cache");
+            return false;
+        }
+    }
+
+    touch(partial);
+
+    // Another job may have stored the same entry meanwhile; theirs is as good as ours
+    if (!partial.moveFileTo(entry))
+    {
+        partial.deleteRecursively();
+        return contains(key);
+    }
+
+    return true;
+}
+
+void IntermediateCache::evictToBudget()
+{
+    struct EntryInfo
+    {
+        juce::File directory;
+        juce::int64 size;
+        juce::Time lastUsed;
+    };
+
+    std::vector<EntryInfo> entries;
+    juce::int64 totalSize = 0;
+
+    for (const auto& entry : getEntries())
+    {
+        const juce::File stamp = entry.getChildFile(stampFileName);
+        const juce::Time lastUsed = stamp.existsAsFile() ? stamp.getLastModificationTime() : entry.getLastModificationTime();
+        const juce::int64 size = getDirectorySize(entry);
+
+        entries.push_back({ entry, size, lastUsed });
+        totalSize += size;
+    }
+
+    const juce::int64 budget = getSizeBudget();
+    if (totalSize <= budget)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const EntryInfo& a, const EntryInfo& b) { return a.lastUsed < b.lastUsed; });
+
+    int evicted = 0;
+    for (const auto& entry : entries)
+    {
+        if (totalSize <= budget)
+            break;
+
+        if (entry.directory.deleteRecursively())
+        {
+            totalSize -= entry.size;
+            ++evicted;
+        }
+    }
+
+    if (logCallback)
+        logCallback("Intermediate cache: evicted " + juce::String(evicted) + " entries, "
+                    + juce::File::descriptionOfSizeInBytes(totalSize) + " of "
+                    + juce::File::descriptionOfSizeInBytes(budget) + " used");
+}
+
+juce::int64 IntermediateCache::getTotalSize() const
+{
+    juce::int64 total = 0;
+    for (const auto& entry : getEntries())
+        total += getDirectorySize(entry);
+    return total;
+}
+
+//==============================================================================
+juce::File IntermediateCache::getEntryDirectory(const juce::String& key) const
+{
+    return getDirectory().getChildFile(key);
+}
+
+juce::Array<juce::File> IntermediateCache::getEntries() const
+{
+    juce::Array<juce::File> entries;
+
+    for (const auto& child : getDirectory().findChildFiles(juce::File::findDirectories, false))
+        if (!child.getFileName().contains(partialSuffix))
+            entries.add(child);
+
+    return entries;
+}
+
+juce::int64 IntermediateCache::getDirectorySize(const juce::File& entry)
+{
+    juce::int64 size = 0;
+    for (const auto& file : entry.findChildFiles(juce::File::findFiles, false))
+        size += file.getSize();
+    return size;
+}
+
+void IntermediateCache::touch(const juce::File& entry)
+{
+    entry.getChildFile(stampFileName).replaceWithText(juce::Time::getCurrentTime().toISO8601(true));
+}
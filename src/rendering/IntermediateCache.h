@@ -0,0 +1,97 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RenderGraph.h"
+#include <functional>
+#include <map>
+#include <vector>
+
+/**
+ * Persistent, content-addressed store for render intermediates.
+ *
+ * An entry is a directory named after its key that holds the files one job
+ * produced. The key is a SHA-256 hash of everything that decides those files:
+ * the job's recipe (its parameters and output names) and the content of its
+ * inputs. Where an input is itself an intermediate, the key of the job that
+ * produced it stands in for its content, so changing a source clip or a
+ * setting invalidates exactly the jobs downstream of it and nothing else.
+ *
+ * Entries are evicted least recently used first once the cache grows past its
+ * size budget. Eviction only happens in evictToBudget(), which the renderer
+ * calls after a render, so entries a render planned to restore stay put.
+ */
+class IntermediateCache
+{
+public:
+    /**
+     * Uses FFLUCE_CACHE_DIR and FFLUCE_CACHE_SIZE_MB when they are set, otherwise
+     * a 20 GB cache in the application data directory. A budget of 0 disables it.
+     */
+    IntermediateCache();
+
+    void setLogCallback(std::function<void(const juce::String&)> callback);
+
+    void setDirectory(const juce::File& newDirectory);
+    juce::File getDirectory() const;
+
+    void setSizeBudget(juce::int64 bytes);
+    juce::int64 getSizeBudget() const;
+
+    bool isEnabled() const { return getSizeBudget() > 0; }
+
+    /** Hashes the parts into a cache key. */
+    static juce::String makeKey(const juce::StringArray& parts);
+
+    /**
+     * Fingerprints a file the cache didn't produce (a source clip, an overlay).
+     * Small files are hashed whole; large ones by size, modification time and
+     * samples from their start, middle and end. Results are remembered until
+     * the file changes.
+     */
+    juce::String fingerprintFile(const juce::File& file);
+
+    /**
+     * Hashes a file's content the same way, without its modification time and
+     * without remembering the result, for files that get copied or touched.
+     */
+    static juce::String hashFileContent(const juce::File& file);
+
+    /**
+     * Computes the key of every task in a resolved graph, in task id order.
+     * Tasks without a recipe, or downstream of one, get an empty key.
+     */
+    std::vector<juce::String> computeKeys(const RenderGraph& graph);
+
+    bool contains(const juce::String& key) const;
+
+    /**
+     * Copies an entry's files over the given outputs. Outputs the entry has no
+     * file for are deleted, since the job that was cached didn't write them.
+     */
+    bool restore(const juce::String& key, const juce::Array<juce::File>& outputs);
+
+    /** Copies the outputs that exist into a new entry. Entries over half the budget are not kept. */
+    bool store(const juce::String& key, const juce::Array<juce::File>& outputs);
+
+    /** Deletes least recently used entries until the cache fits its budget. */
+    void evictToBudget();
+
+    /** Returns the combined size of all entries in bytes. */
+    juce::int64 getTotalSize() const;
+
+private:
+    juce::File getEntryDirectory(const juce::String& key) const;
+    juce::Array<juce::File> getEntries() const;
+    static juce::int64 getDirectorySize(const juce::File& entry);
+    static void touch(const juce::File& entry);
+
+    mutable juce::CriticalSection lock;
+    juce::File directory;
+    juce::int64 sizeBudget = 0;
+
+    juce::CriticalSection fingerprintLock;
+    std::map<juce::String, juce::String> fingerprints;     // path|size|mtime -> fingerprint
+
+    std::function<void(const juce::String&)> logCallback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(IntermediateCache)
+};
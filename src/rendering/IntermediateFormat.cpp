@@ -0,0 +1,113 @@
+#include "IntermediateFormat.h"
+
+namespace
+{
+    // A profile must beat H.264 by this much to be worth its larger files
+    constexpr double switchThreshold = 1.15;
+
+    // The probe's bytes per frame are for 1080p test footage at 30 fps; real clips
+    // vary, so leave room when checking the temp volume
+    constexpr double assumedFrameRate = 30.0;
+    constexpr double spaceSafetyFactor = 2.0;
+}
+
+std::vector<IntermediateFormat> IntermediateFormat::getProfiles()
+{
+    return {
+        { "h264",    "-c:v libx264 -preset ultrafast -qp 0",                                     ".mp4", "-movflags +faststart" },
+        { "ffv1",    "-c:v ffv1 -level 3 -coder 1 -context 0 -g 1 -slices 16 -slicecrc 0 -threads 0", ".mkv", {} },
+        { "utvideo", "-c:v utvideo -pred median -threads 0",                                     ".mkv", {} },
+        { "raw",     "-c:v rawvideo",                                                            ".nut", {} }
+    };
+}
+
+IntermediateFormat IntermediateFormat::getDefault()
+{
+    return getProfiles().front();
+}
+
+bool IntermediateFormat::findProfile(const juce::String& profileName, IntermediateFormat& result)
+{
+    for (const auto& profile : getProfiles())
+    {
+        if (profile.name.equalsIgnoreCase(profileName))
+        {
+            result = profile;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+double IntermediateFormat::getEffectiveFramesPerSecond(const EncoderCapabilities::Report& report, const juce::String& profileName,
+                                                       double diskBytesPerSecond)
+{
+    const auto* result = report.findIntermediate(profileName);
+    if (result == nullptr || !result->working || result->framesPerSecond <= 0.0)
+        return 0.0;
+
+    // Every intermediate frame is written once and read back about once
+    if (diskBytesPerSecond <= 0.0 || result->bytesPerFrame <= 0.0)
+        return result->framesPerSecond;
+
+    const double diskFramesPerSecond = diskBytesPerSecond / (2.0 * result->bytesPerFrame);
+    return juce::jmin(result->framesPerSecond, diskFramesPerSecond);
+}
+
+IntermediateFormat IntermediateFormat::choose(const EncoderCapabilities::Report& report,
+                                              double timelineSeconds,
+                                              const juce::File& tempDirectory,
+                                              juce::String& reason)
+{
+    const juce::String requested = juce::SystemStats::getEnvironmentVariable("FFLUCE_INTERMEDIATE_FORMAT", "auto").trim();
+
+    if (!requested.equalsIgnoreCase("auto"))
+    {
+        IntermediateFormat profile;
+        if (findProfile(requested, profile))
+        {
+            reason = "requested by FFLUCE_INTERMEDIATE_FORMAT";
+            return profile;
+        }
+
+        reason = "unknown FFLUCE_INTERMEDIATE_FORMAT '" + requested + "'";
+        return getDefault();
+    }
+
+    IntermediateFormat best = getDefault();
+
+    if (report.intermediates.empty())
+    {
+        reason = "no probe results";
+        return best;
+    }
+
+    const double diskBytesPerSecond = EncoderCapabilities::getInstance().getDiskBandwidth(tempDirectory);
+    const double defaultFps = getEffectiveFramesPerSecond(report, best.name, diskBytesPerSecond);
+    double bestFps = defaultFps;
+
+    const juce::int64 freeBytes = tempDirectory.getBytesFreeOnVolume();
+
+    for (const auto& profile : getProfiles())
+    {
+        const double fps = getEffectiveFramesPerSecond(report, profile.name, diskBytesPerSecond);
+        if (profile.isH264() || fps <= bestFps * (best.isH264() ? switchThreshold : 1.0))
+            continue;
+
+        // The final sequence alone is as long as the timeline
+        const auto* result = report.findIntermediate(profile.name);
+        const double neededBytes = result->bytesPerFrame * assumedFrameRate * timelineSeconds * spaceSafetyFactor;
+        if (freeBytes > 0 && neededBytes > (double) freeBytes)
+            continue;
+
+        best = profile;
+        bestFps = fps;
+    }
+
+    reason = juce::String(bestFps, 1) + " fps effective";
+    if (!best.isH264())
+        reason << " vs " << juce::String(defaultFps, 1) << " fps for h264";
+
+    return best;
+}
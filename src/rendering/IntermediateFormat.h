@@ -0,0 +1,63 @@
+#pragma once
+#include <JuceHeader.h>
+#include "EncoderCapabilities.h"
+#include <vector>
+
+/**
+ * Codec, container and threading used for the lossless intermediates that the
+ * render steps pass between each other.
+ *
+ * Lossless H.264 in MP4 is compact but slow to encode and decode at high
+ * resolutions, and MP4 timestamps are what sends concatenation down its
+ * regenerated-timestamp fallback. The intra-only profiles trade disk space for
+ * speed and keep exact timestamps in MKV or NUT:
+ *
+ *   - h264     libx264 -qp 0 in MP4 (NVENC lossless for conforming when enabled)
+ *   - ffv1     FFV1 level 3, sliced for threading, in MKV
+ *   - utvideo  UTVideo in MKV
+ *   - raw      uncompressed video in NUT
+ *
+ * FFLUCE_INTERMEDIATE_FORMAT names a profile, or "auto" (the default) to pick
+ * the one the capability probe measured fastest on this machine.
+ */
+struct IntermediateFormat
+{
+    juce::String name;
+    juce::String codecArgs;     // -c:v, codec options and threading
+    juce::String extension;     // FFmpeg picks the container from it
+    juce::String muxerArgs;     // container options
+
+    bool isH264() const { return name == "h264"; }
+
+    /** Every frame is a keyframe, so any frame boundary is a clean cut point. */
+    bool isIntraOnly() const { return !isH264(); }
+
+    /** All profiles, the default first. */
+    static std::vector<IntermediateFormat> getProfiles();
+
+    /** Lossless H.264 in MP4, which every FFmpeg build supports. */
+    static IntermediateFormat getDefault();
+
+    static bool findProfile(const juce::String& profileName, IntermediateFormat& result);
+
+    /**
+     * Frames per second a profile sustains on this machine: the slower of its
+     * measured encode+decode speed and the disk writing and reading its frames
+     * back. Returns 0 if the profile didn't work in the probe.
+     * @param diskBytesPerSecond Write speed of the temp volume, or 0 if unknown
+     */
+    static double getEffectiveFramesPerSecond(const EncoderCapabilities::Report& report, const juce::String& profileName,
+                                              double diskBytesPerSecond);
+
+    /**
+     * Picks the profile for a render. Automatic selection skips profiles whose
+     * intermediates for the whole timeline wouldn't fit on the temp volume, and
+     * keeps H.264 unless another profile is clearly faster. Disk speed is measured
+     * on the temp directory's own volume.
+     * @param reason Set to a short explanation for the log
+     */
+    static IntermediateFormat choose(const EncoderCapabilities::Report& report,
+                                     double timelineSeconds,
+                                     const juce::File& tempDirectory,
+                                     juce::String& reason);
+};
@@ -0,0 +1,72 @@
+#include "IntermediateManifest.h"
+#include <algorithm>
+
+void IntermediateManifest::clear()
+{
+    const juce::ScopedLock sl(lock);
+    clips.clear();
+    durations.clear();
+}
+
+void IntermediateManifest::addClip(const Clip& clip)
+{
+    const juce::ScopedLock sl(lock);
+    auto& list = clips[clip.type];
+
+    auto position = std::lower_bound(list.begin(), list.end(), clip.index,
+                                     [](const Clip& existing, int index) { return existing.index < index; });
+    if (position != list.end() && position->index == clip.index)
+        *position = clip;
+    else
+        list.insert(position, clip);
+}
+
+bool IntermediateManifest::findClip(const juce::String& type, int index, Clip& clip) const
+{
+    const juce::ScopedLock sl(lock);
+    auto list = clips.find(type);
+    if (list == clips.end())
+        return false;
+
+    auto position = std::lower_bound(list->second.begin(), list->second.end(), index,
+                                     [](const Clip& existing, int i) { return existing.index < i; });
+    if (position == list->second.end() || position->index != index)
+        return false;
+
+    clip = *position;
+    return true;
+}
+
+bool IntermediateManifest::getLastClip(const juce::String& type, Clip& clip) const
+{
+    const juce::ScopedLock sl(lock);
+    auto list = clips.find(type);
+    if (list == clips.end() || list->second.empty())
+        return false;
+
+    clip = list->second.back();
+    return true;
+}
+
+int IntermediateManifest::getNumClips(const juce::String& type) const
+{
+    const juce::ScopedLock sl(lock);
+    auto list = clips.find(type);
+    return list == clips.end() ? 0 : (int) list->second.size();
+}
+
+void IntermediateManifest::setDuration(const juce::File& file, double seconds)
+{
+    if (seconds <= 0.0)
+        return;
+
+    const juce::ScopedLock sl(lock);
+    durations[file.getFullPathName()] = seconds;
+}
+
+double IntermediateManifest::getDuration(const juce::File& file) const
+{
+    const juce::ScopedLock sl(lock);
+    auto duration = durations.find(file.getFullPathName());
+    return duration == durations.end() ? -1.0 : duration->second;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <vector>
+
+/**
+ * What the timeline steps have produced so far, kept in memory for one render.
+ *
+ * Every conformed clip is registered with its type, index, file and crossfade
+ * lengths, and every intermediate whose length is known (measured once after
+ * conforming, or the exact length a trim was asked for) has its duration
+ * recorded. Later steps look clips and durations up here instead of scanning
+ * the temp directory or probing files again, so timelines with hundreds of
+ * short loop clips don't pay an ffprobe per clip per step.
+ *
+ * Render graph workers update it concurrently.
+ */
+class IntermediateManifest
+{
+public:
+    struct Clip
+    {
+        juce::String type;              // "intro" or "loop"
+        int index = 0;
+        juce::File file;                // conformed clip in the temp directory
+        double crossfadeIn = 0.0;       // crossfade with the previous clip
+        double crossfadeOut = 0.0;      // crossfade with the next clip
+    };
+
+    /** Forgets everything; called at the start of each render. */
+    void clear();
+
+    /** Registers a conformed clip, replacing any earlier one of the same type and index. */
+    void addClip(const Clip& clip);
+
+    /** Returns false if no clip of that type and index was registered. */
+    bool findClip(const juce::String& type, int index, Clip& clip) const;
+
+    /** The registered clip of a type with the highest index; false if there is none. */
+    bool getLastClip(const juce::String& type, Clip& clip) const;
+
+    int getNumClips(const juce::String& type) const;
+
+    /** Records the length of an intermediate file. */
+    void setDuration(const juce::File& file, double seconds);
+
+    /** Recorded length of a file, or -1 if it isn't known. */
+    double getDuration(const juce::File& file) const;
+
+private:
+    mutable juce::CriticalSection lock;
+    std::map<juce::String, std::vector<Clip>> clips;    // type -> clips ordered by index
+    std::map<juce::String, double> durations;           // full path -> seconds
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(IntermediateManifest)
+};
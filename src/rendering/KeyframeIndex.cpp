@@ -0,0 +1,155 @@
+#include "KeyframeIndex.h"
+#include "FFmpegExecutor.h"
+#include <algorithm>
+#include <map>
+
+namespace
+{
+    // Copying fewer frames than this share of the cut isn't worth the extra commands
+    constexpr double minimumCopyShare = 0.5;
+
+    // A packet list reads the whole file; this only catches a probe that has hung
+    constexpr int probeTimeoutMs = 10 * 60 * 1000;
+
+    juce::CriticalSection indexLock;
+    std::map<juce::String, std::shared_ptr<const KeyframeIndex>> indexes;   // path|size|mtime -> index
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndex::forFile(FFmpegExecutor& executor, const juce::File& file)
+{
+    if (!file.existsAsFile() || executor.isCancellationRequested())
+        return nullptr;
+
+    const juce::String key = file.getFullPathName() + "|" + juce::String(file.getSize()) + "|"
+                             + juce::String(file.getLastModificationTime().toMilliseconds());
+    {
+        const juce::ScopedLock sl(indexLock);
+        auto existing = indexes.find(key);
+        if (existing != indexes.end())
+            return existing->second;
+    }
+
+    const juce::String command = executor.getFFprobePath()
+        + " -v error -select_streams v:0 -show_entries packet=pts_time,flags -of csv=p=0 \""
+        + file.getFullPathName().replaceCharacter('\\', '/') + "\"";
+
+    juce::String output;
+    if (!executor.runProbe(command, output, probeTimeoutMs) || executor.isCancellationRequested())
+        return nullptr;
+
+    std::shared_ptr<KeyframeIndex> index(new KeyframeIndex());
+    if (!index->parse(output))
+        return nullptr;
+
+    const juce::ScopedLock sl(indexLock);
+    indexes[key] = index;
+    return index;
+}
+
+void KeyframeIndex::clearCache()
+{
+    const juce::ScopedLock sl(indexLock);
+    indexes.clear();
+}
+
+bool KeyframeIndex::parse(const juce::String& probeOutput)
+{
+    juce::StringArray lines;
+    lines.addLines(probeOutput);
+
+    std::vector<std::pair<double, bool>> frames;
+    for (const auto& line : lines)
+    {
+        const juce::String trimmed = line.trim();
+        const int comma = trimmed.indexOfChar(',');
+        if (comma <= 0 || trimmed.startsWith("N/A"))
+            continue;
+
+        const double time = trimmed.substring(0, comma).getDoubleValue();
+        if (!frames.empty() && time < frames.back().first)
+            presentationOrder = false;
+
+        frames.emplace_back(time, trimmed.substring(comma + 1).containsChar('K'));
+    }
+
+    if (frames.size() < 2)
+        return false;
+
+    std::sort(frames.begin(), frames.end());
+    const double firstTime = frames.front().first;
+
+    for (const auto& [time, isKeyframe] : frames)
+    {
+        frameTimes.push_back(time - firstTime);
+        keyframes.push_back(isKeyframe);
+        numKeyframes += isKeyframe ? 1 : 0;
+    }
+
+    std::vector<double> gaps;
+    for (size_t i = 1; i < frameTimes.size(); ++i)
+        gaps.push_back(frameTimes[i] - frameTimes[i - 1]);
+    std::nth_element(gaps.begin(), gaps.begin() + (long) gaps.size() / 2, gaps.end());
+    frameDuration = gaps[gaps.size() / 2];
+
+    return frameDuration > 0.0;
+}
+
+int KeyframeIndex::findFrame(double seconds) const
+{
+    // A quarter frame of slack absorbs rounding in the times we are given
+    const double time = seconds - 0.25 * frameDuration;
+    return (int) (std::lower_bound(frameTimes.begin(), frameTimes.end(), time) - frameTimes.begin());
+}
+
+bool KeyframeIndex::planCut(double startSeconds, double durationSeconds, Cut& cut) const
+{
+    if (!presentationOrder || durationSeconds <= 0.0)
+        return false;
+
+    const int first = findFrame(juce::jmax(0.0, startSeconds));
+    const int end = findFrame(startSeconds + durationSeconds);
+    if (end <= first)
+        return false;
+
+    // The copy runs from the first keyframe in the cut to the last one, or to the end of the file
+    int copyStart = first;
+    while (copyStart < end && !keyframes[(size_t) copyStart])
+        ++copyStart;
+
+    int copyEnd = end;
+    if (end < getNumFrames())
+        while (copyEnd > copyStart && !keyframes[(size_t) copyEnd])
+            --copyEnd;
+
+    if (copyEnd - copyStart < minimumCopyShare * (end - first))
+        return false;
+
+    cut.startTime = frameTimes[(size_t) first];
+    cut.copyStartTime = frameTimes[(size_t) copyStart];
+    cut.copyEndTime = copyEnd < getNumFrames() ? frameTimes[(size_t) copyEnd] : getEndTime();
+    cut.headFrames = copyStart - first;
+    cut.copyFrames = copyEnd - copyStart;
+    cut.tailFrames = end - copyEnd;
+    return true;
+}
+
+double KeyframeIndex::findKeyframeBefore(double seconds) const
+{
+    int frame = juce::jmin(findFrame(seconds), getNumFrames() - 1);
+    if (frame > 0 && frameTimes[(size_t) frame] > seconds + 0.25 * frameDuration)
+        --frame;
+
+    while (frame > 0 && !keyframes[(size_t) frame])
+        --frame;
+
+    return frameTimes[(size_t) juce::jmax(0, frame)];
+}
+
+double KeyframeIndex::findKeyframeAfter(double seconds) const
+{
+    int frame = findFrame(seconds);
+    while (frame < getNumFrames() && !keyframes[(size_t) frame])
+        ++frame;
+
+    return frame < getNumFrames() ? frameTimes[(size_t) frame] : getEndTime();
+}
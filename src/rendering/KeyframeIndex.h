@@ -0,0 +1,84 @@
+#pragma once
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+class FFmpegExecutor;
+
+/**
+ * Presentation time and keyframe flag of every video frame in a file, read with
+ * one packet-level ffprobe pass (no decoding).
+ *
+ * The trim steps use it for smart cutting: the whole GOPs inside a cut are
+ * stream copied and only the partial GOPs at its edges are re-encoded. With an
+ * intra-only intermediate (FFV1, UTVideo, raw) every frame is a keyframe and a
+ * cut becomes a plain stream copy.
+ */
+class KeyframeIndex
+{
+public:
+    /** How a cut splits into re-encoded head, copied middle and re-encoded tail. */
+    struct Cut
+    {
+        double startTime = 0.0;         // first frame of the cut
+        double copyStartTime = 0.0;     // first keyframe inside the cut
+        double copyEndTime = 0.0;       // keyframe (or end of file) the copy stops before
+        int headFrames = 0;
+        int copyFrames = 0;
+        int tailFrames = 0;
+
+        int getNumFrames() const { return headFrames + copyFrames + tailFrames; }
+    };
+
+    /**
+     * Returns the index of a file, probing it the first time it is asked for.
+     * Indexes are shared between threads and remembered per path, size and
+     * modification time. The probe runs through the executor, so cancelling the
+     * render stops it. Returns nullptr if the file can't be probed or the render
+     * was cancelled.
+     */
+    static std::shared_ptr<const KeyframeIndex> forFile(FFmpegExecutor& executor, const juce::File& file);
+
+    /**
+     * Forgets every remembered index. Called when a render ends, as most indexes
+     * are of its intermediates, which are deleted with its temp directory.
+     * Indexes still held by callers stay valid.
+     */
+    static void clearCache();
+
+    int getNumFrames() const { return (int) frameTimes.size(); }
+    double getFrameDuration() const { return frameDuration; }
+    bool isIntraOnly() const { return numKeyframes == getNumFrames(); }
+
+    /**
+     * Plans the smart cut of [startSeconds, startSeconds + durationSeconds).
+     * @return false if no whole GOP lies inside the cut, or the frames aren't
+     *         stored in presentation order (B-frames), so copying can't help
+     */
+    bool planCut(double startSeconds, double durationSeconds, Cut& cut) const;
+
+    /** Time of the last keyframe shown at or before the given time. */
+    double findKeyframeBefore(double seconds) const;
+
+    /** Time of the first keyframe shown at or after the given time, or the end of the file. */
+    double findKeyframeAfter(double seconds) const;
+
+    /** Time just past the last frame. */
+    double getEndTime() const { return frameTimes.back() + frameDuration; }
+
+private:
+    KeyframeIndex() = default;
+
+    bool parse(const juce::String& probeOutput);
+
+    /** Index of the first frame shown at or after the given time. */
+    int findFrame(double seconds) const;
+
+    std::vector<double> frameTimes;     // seconds from the first frame, ascending
+    std::vector<bool> keyframes;        // parallel to frameTimes
+    int numKeyframes = 0;
+    double frameDuration = 0.0;
+    bool presentationOrder = true;      // packets are stored in the order they are shown
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KeyframeIndex)
+};
@@ -1,7 +1,156 @@
 #include "OverlayProcessor.h"
+#include "KeyframeIndex.h"
+#include "AlphaCompositor.h"
+#include "FFmpegProcess.h"
+#include "OverlaySchedule.h"
+#include <algorithm>
+#include <map>
+
+#if ! JUCE_WINDOWS
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <signal.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+#endif
 
 namespace
 {
+    // Slack when deciding whether an appearance fits inside a span or the timeline
+    constexpr double appearanceTolerance = 0.0005;
+
+    // Copied gaps shorter than this between two spans aren't worth the extra pieces
+    constexpr double minimumCopySeconds = 2.0;
+
+    // Above this share of the timeline, one pass over everything is cheaper than spans
+    constexpr double maximumSparseShare = 0.5;
+
+    // Assumed for a base video that can't be probed
+    constexpr int defaultWidth = 1920;
+    constexpr int defaultHeight = 1080;
+    constexpr double defaultFrameRate = 30.0;
+
+    // Sprites are stored losslessly with alpha
+    const juce::String spriteArgs = "-c:v ffv1 -level 3 -g 1 -slices 4 -pix_fmt bgra -threads 0";
+
+    // The native compositor holds every sprite frame of a pass in memory
+    constexpr size_t nativeSpriteBudget = (size_t) 1024 * 1024 * 1024;
+
+    // Gives NTSC rates as exact fractions, so piped frames keep the base's timestamps
+    juce::String frameRateArgument(double fps)
+    {
+        const double ntsc = std::round(fps * 1.001);
+        if (std::abs(fps - ntsc * 1000.0 / 1001.0) < 0.001 && std::abs(fps - std::round(fps)) > 0.001)
+            return juce::String((int) ntsc * 1000) + "/1001";
+
+        return std::abs(fps - std::round(fps)) < 0.001 ? juce::String((int) std::round(fps)) : juce::String(fps, 6);
+    }
+
+    /**
+     * The start of appearance number index (an expression) among starts[lo, hi), as a
+     * balanced if() tree. Past the last appearance the start keeps growing, so the
+     * overlay's timestamps never run backwards.
+     */
+    juce::String buildStartLookup(const std::vector<double>& starts, double duration, int lo, int hi, const juce::String& index)
+    {
+        if (hi - lo == 1)
+        {
+            if (hi < (int) starts.size())
+                return juce::String(starts[(size_t) lo], 6);
+
+            return "(" + juce::String(starts[(size_t) lo], 6) + "+(" + index + "-" + juce::String(lo) + ")*"
+                 + juce::String(duration + 1.0, 6) + ")";
+        }
+
+        const int mid = (lo + hi) / 2;
+        return "if(lt(" + index + "," + juce::String(mid) + ")," + buildStartLookup(starts, duration, lo, mid, index) + ","
+             + buildStartLookup(starts, duration, mid, hi, index) + ")";
+    }
+
+    /** Whether t lies inside one of the appearances starts[lo, hi), as a balanced if() tree. */
+    juce::String buildActiveTest(const std::vector<double>& starts, double duration, int lo, int hi)
+    {
+        if (hi - lo == 1)
+            return "gte(t," + juce::String(starts[(size_t) lo], 6) + ")*lt(t," + juce::String(starts[(size_t) lo] + duration, 6) + ")";
+
+        const int mid = (lo + hi) / 2;
+        return "if(lt(t," + juce::String(starts[(size_t) mid], 6) + ")," + buildActiveTest(starts, duration, lo, mid) + ","
+             + buildActiveTest(starts, duration, mid, hi) + ")";
+    }
+
+   #if ! JUCE_WINDOWS
+    /**
+     * Creates a FIFO, opens its read end and starts an FFmpeg command writing raw frames
+     * into it. FFmpegProcess merges stdout and stderr, so frames can't come through its
+     * pipe. Returns the read end, non-blocking, or -1.
+     */
+    int startFrameReader(FFmpegProcess& process, const juce::String& command, const juce::File& fifo)
+    {
+        fifo.deleteFile();
+        if (::mkfifo(fifo.getFullPathName().toRawUTF8(), 0600) != 0)
+            return -1;
+
+        // Opening the read end without blocking succeeds before the writer has opened its own
+        const int fd = ::open(fifo.getFullPathName().toRawUTF8(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0)
+            return -1;
+
+        if (!process.start(command + " -y \"" + fifo.getFullPathName() + "\""))
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Reads until the buffer is full or the writer has exited and the FIFO is drained; returns the bytes read
+    size_t readFully(int fd, FFmpegProcess& writer, juce::uint8* dest, size_t numBytes)
+    {
+        size_t total = 0;
+        while (total < numBytes)
+        {
+            const ssize_t chunk = ::read(fd, dest + total, juce::jmin(numBytes - total, (size_t) (1 << 20)));
+            if (chunk > 0)
+            {
+                total += (size_t) chunk;
+                continue;
+            }
+
+            if (chunk < 0 && errno == EINTR)
+                continue;
+
+            if (chunk < 0 && errno == EAGAIN)
+            {
+                pollfd ready { fd, POLLIN, 0 };
+                ::poll(&ready, 1, 10);
+                continue;
+            }
+
+            // End of file: either the writer hasn't opened the FIFO yet, or it has closed it
+            if (chunk < 0 || !writer.isRunning())
+                break;
+            juce::Thread::sleep(1);
+        }
+        return total;
+    }
+
+    bool writeFully(int fd, const juce::uint8* source, size_t numBytes)
+    {
+        while (numBytes > 0)
+        {
+            const ssize_t written = ::write(fd, source, numBytes);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            source += written;
+            numBytes -= (size_t) written;
+        }
+        return true;
+    }
+   #endif
+
     juce::String sanitizeEncodingParams(const juce::String& input,
                                         bool useNvenc,
                                         const juce::String& fallback)
@@ -70,7 +219,9 @@ namespace
 
 OverlayProcessor::OverlayProcessor(FFmpegExecutor* ffmpegExecutor)
     : ffmpegExecutor(ffmpegExecutor),
-      useNvidiaAcceleration(false)
+      useNvidiaAcceleration(false),
+      sparseOverlays(juce::SystemStats::getEnvironmentVariable("FFLUCE_SPARSE_OVERLAYS", "1") != "0"),
+      nativeCompositor(juce::SystemStats::getEnvironmentVariable("FFLUCE_NATIVE_COMPOSITOR", "0") == "1")
 {
 }
 
@@ -106,7 +257,8 @@ bool OverlayProcessor::processOverlays(const juce::File& baseVideoFile,
                                     const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
                                     double totalDuration,
                                     const juce::File& tempDirectory,
-                                    const juce::File& outputFile)
+                                    const juce::File& outputFile,
+                                    const IntermediateFormat* intermediateOutput)
 {
     if (logCallback)
         logCallback("Processing " + juce::String(overlayClips.size()) + " overlay clips");
@@ -117,7 +269,7 @@ bool OverlayProcessor::processOverlays(const juce::File& baseVideoFile,
     // Trim base video if longer than target duration
     if (baseDuration > totalDuration + 0.1)
     {
-        trimmedBaseVideo = tempDirectory.getChildFile("trimmed_base_video.mp4");
+        trimmedBaseVideo = tempDirectory.getChildFile("trimmed_base_video" + baseVideoFile.getFileExtension());
 
         juce::String trimCommand =
             ffmpegExecutor->getFFmpegPath() +
@@ -128,8 +280,50 @@ bool OverlayProcessor::processOverlays(const juce::File& baseVideoFile,
         if (!ffmpegExecutor->executeCommand(trimCommand))
             trimmedBaseVideo = baseVideoFile;
     }
-    
-    if (overlayClips.empty())
+
+    // Overlays are sized and sprites timed for the base actually being rendered
+    auto base = ffmpegExecutor->getVideoStreamInfo(trimmedBaseVideo);
+    if (base.width <= 0 || base.height <= 0)
+    {
+        base.width = defaultWidth;
+        base.height = defaultHeight;
+    }
+    if (base.fps <= 0.0)
+        base.fps = defaultFrameRate;
+    baseStream = base;
+
+    // Every appearance of every clip, after jitter, windows, variants and concurrency rules
+    const auto appearances = OverlaySchedule::compile(overlayClips, totalDuration,
+                                                      [this](const RenderTypes::OverlayClipInfo& overlay, const juce::File& file)
+                                                      { return getAppearanceDuration(overlay, file); });
+
+    // One track per clip and file, drawn from its list of start times
+    std::map<std::pair<int, int>, std::vector<double>> trackStarts;
+    std::map<std::pair<int, int>, double> trackDurations;
+    for (const auto& appearance : appearances)
+    {
+        trackStarts[{ appearance.clip, appearance.variant }].push_back(appearance.start);
+        trackDurations[{ appearance.clip, appearance.variant }] = appearance.duration;
+    }
+
+    for (int clip = 0; clip < (int) overlayClips.size(); ++clip)
+    {
+        const auto track = trackStarts.lower_bound({ clip, 0 });
+        if ((track == trackStarts.end() || track->first.first != clip) && logCallback)
+            logCallback("Overlay timing produced zero appearances inside target duration - leaving out "
+                        + overlayClips[(size_t) clip].file.getFileName());
+    }
+
+    std::vector<OverlayTiming> timings;
+    for (const auto& [track, starts] : trackStarts)
+    {
+        OverlayTiming timing;
+        planTrack(OverlaySchedule::getFile(overlayClips[(size_t) track.first], track.second),
+                  trackDurations[track], starts, base, timing);
+        timings.push_back(timing);
+    }
+
+    if (timings.empty())
     {
         juce::String copyCommand =
             ffmpegExecutor->getFFmpegPath() +
@@ -139,230 +333,746 @@ bool OverlayProcessor::processOverlays(const juce::File& baseVideoFile,
         return ffmpegExecutor->executeCommand(copyCommand);
     }
 
-    juce::File currentInput = trimmedBaseVideo;
+    juce::Array<juce::File> sprites;
+    useSprites(timings, tempDirectory, sprites);
 
-    for (size_t i = 0; i < overlayClips.size(); ++i)
+    auto deleteSprites = [&sprites]
     {
-        const auto& overlay = overlayClips[i];
-        
-        juce::File overlayOutput = tempDirectory.getChildFile("overlay_step_" + juce::String(i) + ".mp4");
-        if (i == overlayClips.size() - 1)
-            overlayOutput = outputFile;
-
-        double startTime = overlay.startTimeSecs;
-        double frequency = overlay.frequencySecs;
-        double requestedDuration = overlay.duration;
+        for (const auto& sprite : sprites)
+            sprite.deleteFile();
+    };
 
-        const double overlayFileDuration = ffmpegExecutor->getFileDuration(overlay.file);
-        double overlayIterationDuration = requestedDuration > 0.0 ? requestedDuration : overlayFileDuration;
-        if (overlayFileDuration > 0.0 && overlayIterationDuration > overlayFileDuration)
-            overlayIterationDuration = overlayFileDuration;
+    if (intermediateOutput != nullptr && sparseOverlays)
+    {
+        bool attempted = false;
+        if (renderSparse(trimmedBaseVideo, timings, totalDuration, tempDirectory, outputFile, *intermediateOutput, attempted))
+        {
+            deleteSprites();
+            return true;
+        }
 
-        if (overlayIterationDuration <= 0.01)
+        if (attempted)
         {
+            if (ffmpegExecutor->isCancellationRequested())
+            {
+                deleteSprites();
+                return false;
+            }
+
             if (logCallback)
-                logCallback("WARNING: Overlay duration is invalid; skipping overlay application for this clip");
+                logCallback("WARNING: Sparse overlay pass failed; drawing overlays over the whole timeline");
+            outputFile.deleteFile();
+        }
+    }
 
-            juce::String copyCommand =
-                ffmpegExecutor->getFFmpegPath() +
-                " -y -i \"" + currentInput.getFullPathName() + "\" -c copy \"" + overlayOutput.getFullPathName() + "\"";
+    const bool success = renderOverlayPass(trimmedBaseVideo, timings, 0.0, totalDuration, tempDirectory,
+                                           outputFile, intermediateOutput);
+    deleteSprites();
 
-            if (!ffmpegExecutor->executeCommand(copyCommand))
-                return false;
+    if (!success && logCallback)
+        logCallback("ERROR: Overlay processing failed");
 
-            if (i < overlayClips.size() - 1)
-                currentInput = overlayOutput;
+    return success;
+}
 
-            continue;
-        }
+double OverlayProcessor::getAppearanceDuration(const RenderTypes::OverlayClipInfo& overlay, const juce::File& file) const
+{
+    const double overlayFileDuration = ffmpegExecutor->getFileDuration(file);
+    double overlayIterationDuration = overlay.duration > 0.0 ? overlay.duration : overlayFileDuration;
+    if (overlayFileDuration > 0.0 && overlayIterationDuration > overlayFileDuration)
+        overlayIterationDuration = overlayFileDuration;
+
+    if (overlayIterationDuration <= 0.01)
+    {
+        if (logCallback)
+            logCallback("WARNING: Overlay duration is invalid; skipping overlay " + file.getFileName());
+        return 0.0;
+    }
 
-        juce::Array<double> appearanceStarts;
-        juce::Array<double> appearanceDurations;
-        double currentStart = startTime;
-        const double effectiveFrequency = frequency > 0.0 ? frequency : overlayIterationDuration;
-        const double tolerance = 0.0005;
+    return overlayIterationDuration;
+}
 
-        while (currentStart + overlayIterationDuration <= totalDuration + tolerance)
+void OverlayProcessor::planTrack(const juce::File& file, double duration, const std::vector<double>& starts,
+                                 const FFmpegExecutor::VideoStreamInfo& base, OverlayTiming& timing) const
+{
+    // Frame counts, not times, decide what each loop of the input shows, so nothing drifts
+    // over thousands of appearances
+    const auto index = KeyframeIndex::forFile(*ffmpegExecutor, file);
+    const auto stream = ffmpegExecutor->getVideoStreamInfo(file);
+    const double overlayFps = index != nullptr && index->getFrameDuration() > 0.0
+                                  ? 1.0 / index->getFrameDuration()
+                                  : juce::jmax(1.0, stream.fps);
+
+    // Fitted inside the base frame keeping its aspect ratio, as overlays are authored for the
+    // full frame; the alpha work then covers only the overlay's own area
+    const int nativeWidth = stream.width > 0 ? stream.width : base.width;
+    const int nativeHeight = stream.height > 0 ? stream.height : base.height;
+    const double fit = juce::jmin((double) base.width / nativeWidth, (double) base.height / nativeHeight);
+    timing.width = juce::jmax(2, (int) (nativeWidth * fit) & ~1);
+    timing.height = juce::jmax(2, (int) (nativeHeight * fit) & ~1);
+    timing.scaled = stream.width == timing.width && stream.height == timing.height;
+
+    // Frames past the base rate would only be dropped by the overlay filter
+    timing.spriteFps = juce::jmin(overlayFps, base.fps);
+
+    timing.file = file;
+    timing.starts = starts;
+    timing.duration = duration;
+    timing.fps = overlayFps;
+    timing.fileFrames = index != nullptr ? index->getNumFrames()
+                                         : juce::jmax(1, (int) std::round(ffmpegExecutor->getFileDuration(file) * overlayFps));
+    timing.appearanceFrames = juce::jlimit(1, timing.fileFrames, (int) std::round(duration * overlayFps));
+
+    // Evenly spaced appearances are drawn with arithmetic instead of a lookup
+    timing.period = 0.0;
+    if (starts.size() > 1)
+    {
+        const double gap = starts[1] - starts[0];
+        bool even = true;
+        for (size_t i = 2; i < starts.size() && even; ++i)
+            even = std::abs(starts[i] - starts[i - 1] - gap) < 1.0e-6;
+        if (even)
+            timing.period = gap;
+    }
+
+    if (logCallback)
+        logCallback("Overlay " + file.getFileName() + ": " + juce::String(timing.getNumAppearances()) + " appearances of "
+                    + juce::String(duration, 3) + "s" + (starts.size() > 1 && timing.period <= 0.0 ? ", scheduled" : ""));
+}
+
+void OverlayProcessor::useSprites(std::vector<OverlayTiming>& timings, const juce::File& tempDirectory,
+                                  juce::Array<juce::File>& sprites)
+{
+    struct Sprite
+    {
+        juce::File file;
+        int frames = 0;
+        double fps = 0.0;
+    };
+
+    const bool cacheEnabled = intermediateCache != nullptr && intermediateCache->isEnabled();
+    std::map<juce::String, Sprite> made;    // key -> sprite, for overlays used more than once
+
+    for (auto& timing : timings)
+    {
+        // Everything that decides the sprite's pixels and frame count
+        const juce::String key = IntermediateCache::makeKey({ "overlay-sprite", spriteArgs,
+                                                              cacheEnabled ? intermediateCache->fingerprintFile(timing.file)
+                                                                           : timing.file.getFullPathName(),
+                                                              juce::String(timing.appearanceFrames),
+                                                              juce::String(timing.fps, 6),
+                                                              juce::String(timing.spriteFps, 6),
+                                                              juce::String(timing.width) + "x" + juce::String(timing.height) });
+
+        // Resampled sprites may come out a frame either side of the nominal count
+        const bool resample = timing.spriteFps < timing.fps - 0.01;
+        const int expectedFrames = resample ? juce::jmax(1, (int) std::round(timing.appearanceFrames * timing.spriteFps / timing.fps))
+                                            : timing.appearanceFrames;
+
+        Sprite sprite;
+        auto existing = made.find(key);
+        if (existing != made.end())
+        {
+            sprite = existing->second;
+        }
+        else
         {
-            appearanceStarts.add(currentStart);
-            appearanceDurations.add(overlayIterationDuration);
+            sprite.file = tempDirectory.getChildFile("overlay_sprite_" + key.substring(0, 16) + ".mkv");
+            bool restored = cacheEnabled && intermediateCache->contains(key) && intermediateCache->restore(key, { sprite.file });
 
-            if (frequency <= 0.0)
-                break;
+            if (!restored)
+            {
+                juce::String filter;
+                if (!timing.scaled)
+                    filter << "scale=" << timing.width << ":" << timing.height << ",";
+                if (resample)
+                    filter << "fps=" << juce::String(timing.spriteFps, 6) << ",";
+                filter << "format=bgra";
+
+                const juce::String command = ffmpegExecutor->getFFmpegPath()
+                    + " -y -i \"" + timing.file.getFullPathName() + "\""
+                    + " -vf \"" + filter + "\""
+                    + " -frames:v " + juce::String(expectedFrames)
+                    + " " + spriteArgs + " -an \"" + sprite.file.getFullPathName() + "\"";
+
+                if (!ffmpegExecutor->executeCommand(command))
+                    sprite.file.deleteFile();
+            }
+
+            // A sprite short of frames would shift every later appearance
+            const auto index = KeyframeIndex::forFile(*ffmpegExecutor, sprite.file);
+            sprite.frames = index != nullptr ? index->getNumFrames() : 0;
+            sprite.fps = resample ? timing.spriteFps : timing.fps;
+
+            if (sprite.frames <= 0 || std::abs(sprite.frames - expectedFrames) > (resample ? 1 : 0))
+            {
+                if (logCallback)
+                    logCallback("WARNING: Couldn't render a sprite of " + timing.file.getFileName() + "; scaling it in the overlay pass");
+                sprite.file.deleteFile();
+                made[key] = Sprite();
+                continue;
+            }
+
+            if (restored)
+            {
+                if (logCallback)
+                    logCallback("Overlay sprite of " + timing.file.getFileName() + " restored from cache");
+            }
+            else if (cacheEnabled)
+            {
+                intermediateCache->store(key, { sprite.file });
+            }
 
-            currentStart += effectiveFrequency;
+            sprites.add(sprite.file);
+            made[key] = sprite;
         }
 
-        if (appearanceStarts.isEmpty())
-        {
-            if (logCallback)
-                logCallback("Overlay timing produced zero appearances inside target duration - passing video through");
+        if (sprite.frames <= 0)
+            continue;
 
-            juce::String copyCommand =
-                ffmpegExecutor->getFFmpegPath() +
-                " -y -i \"" + currentInput.getFullPathName() + "\" -c copy \"" + overlayOutput.getFullPathName() + "\"";
+        timing.file = sprite.file;
+        timing.fileFrames = sprite.frames;
+        timing.appearanceFrames = sprite.frames;
+        timing.fps = sprite.fps;
+        timing.scaled = true;
+    }
+}
 
-            if (!ffmpegExecutor->executeCommand(copyCommand))
-                return false;
+juce::String OverlayProcessor::buildOverlayGraph(const std::vector<OverlayTiming>& timings, double offset, double length,
+                                                 juce::StringArray& inputs, juce::StringArray& filters) const
+{
+    // Every overlay is one looped input, retimed onto its appearances and drawn with an
+    // enable expression, so the base is decoded and encoded once for all of them
+    const double windowEnd = offset + length;
+    juce::String baseLabel = "0:v";
+
+    for (const auto& timing : timings)
+    {
+        const int first = (int) (std::lower_bound(timing.starts.begin(), timing.starts.end(), offset - appearanceTolerance)
+                                 - timing.starts.begin());
 
-            if (i < overlayClips.size() - 1)
-                currentInput = overlayOutput;
+        int count = 0;
+        while (first + count < timing.getNumAppearances()
+               && timing.starts[(size_t) (first + count)] + timing.duration <= windowEnd + appearanceTolerance)
+            ++count;
 
+        if (count == 0)
             continue;
+
+        const bool repeats = count > 1;
+        const juce::String appearance = "floor(N/" + juce::String(timing.appearanceFrames) + ")";
+        juce::String appearanceStart, enable;
+
+        if (!repeats || timing.period > 0.0)
+        {
+            const double startTime = juce::jmax(0.0, timing.starts[(size_t) first] - offset);
+            const double period = repeats ? timing.period : timing.duration;
+            const double lastEnd = startTime + (count - 1) * period + timing.duration;
+
+            appearanceStart = juce::String(startTime, 6) + "+" + appearance + "*" + juce::String(period, 6);
+            enable = "between(t," + juce::String(startTime, 6) + "," + juce::String(lastEnd, 6) + ")*lt(mod(t-"
+                   + juce::String(startTime, 6) + "," + juce::String(period, 6) + "),"
+                   + juce::String(timing.duration, 6) + ")";
         }
+        else
+        {
+            // Scheduled appearances are looked up with balanced if() trees, log2(count) deep
+            std::vector<double> starts;
+            for (int i = first; i < first + count; ++i)
+                starts.push_back(juce::jmax(0.0, timing.starts[(size_t) i] - offset));
 
+            appearanceStart = buildStartLookup(starts, timing.duration, 0, count, appearance);
+            enable = buildActiveTest(starts, timing.duration, 0, count);
+        }
 
-        const double overlayFps = juce::jmax(1.0, ffmpegExecutor->getVideoStreamInfo(overlay.file).fps);
-        const int overlayFrameCount = overlayFileDuration > 0.0 ? (int)std::round(overlayFileDuration * overlayFps) : 0;
+        juce::String chain;
+        if (repeats && timing.appearanceFrames < timing.fileFrames)
+            chain << "select='lt(mod(n," << timing.fileFrames << ")," << timing.appearanceFrames << ")',";
+        else if (!repeats)
+            chain << "trim=end_frame=" << timing.appearanceFrames << ",";
+
+        // Frame N of the selected frames belongs to appearance floor(N / appearanceFrames)
+        if (!timing.scaled)
+            chain << "scale=" << timing.width << ":" << timing.height << ",";
+        chain << "format=rgba"
+              << ",setpts='(" << appearanceStart
+              << "+mod(N," << timing.appearanceFrames << ")/" << juce::String(timing.fps, 6) << ")/TB'";
+
+        const int input = inputs.size() + 1;
+        inputs.add(juce::String(repeats ? "-stream_loop -1 " : "") + "-i \"" + timing.file.getFullPathName() + "\"");
+
+        const juce::String overlayLabel = "ov" + juce::String(input);
+        filters.add("[" + juce::String(input) + ":v]" + chain + "[" + overlayLabel + "]");
+
+        const juce::String composited = "v" + juce::String(input);
+        filters.add("[" + baseLabel + "][" + overlayLabel + "]overlay=x=(W-w)/2:y=(H-h)/2:format=auto:eof_action=pass"
+                    + ":enable='" + enable + "'[" + composited + "]");
+        baseLabel = composited;
+    }
 
-        juce::File initialOverlayInput = currentInput;
-        juce::File sequentialInput = currentInput;
-        const int appearanceCount = appearanceStarts.size();
-        const bool isFinalOverlayClip = (i == overlayClips.size() - 1);
+    return filters.isEmpty() ? juce::String() : baseLabel;
+}
 
-        // Always pre-render overlay timeline segments with alpha (QTRLE/ARGB), then overlay once.
-        auto buildOverlaySegment = [&](double /*start*/, double duration, int idx, juce::File& outFile) -> bool
-        {
-            outFile = tempDirectory.getChildFile("overlay_seg_" + juce::String(i) + "_" + juce::String(idx) + ".mov");
+bool OverlayProcessor::renderOverlayPass(const juce::File& baseVideoFile, const std::vector<OverlayTiming>& timings,
+                                         double offset, double length, const juce::File& tempDirectory,
+                                         const juce::File& outputFile, const IntermediateFormat* intermediateOutput)
+{
+    if (nativeCompositor)
+    {
+        if (renderNativePass(baseVideoFile, timings, offset, length, tempDirectory, outputFile, intermediateOutput))
+            return true;
 
-            juce::String loopPrefix;
-            if (overlayFrameCount > 0 && duration > overlayFileDuration + 0.001)
-            {
-                const double repetitionSeconds = overlayFileDuration > 0.0 ? overlayFileDuration : duration;
-                const double repeatsNeeded = duration / repetitionSeconds;
-                const int loopCount = (int)std::ceil(repeatsNeeded);
-                loopPrefix = "loop=loop=" + juce::String(loopCount) + ":size=" + juce::String(overlayFrameCount) + ":start=0,";
-            }
+        if (ffmpegExecutor->isCancellationRequested())
+            return false;
+
+        outputFile.deleteFile();
+        if (logCallback)
+            logCallback("Native compositor unavailable for this pass; using the overlay filter");
+    }
+
+    juce::StringArray overlayInputs;
+    juce::StringArray filters;
+    const juce::String outputLabel = buildOverlayGraph(timings, offset, length, overlayInputs, filters);
+
+    if (outputLabel.isEmpty())
+    {
+        if (logCallback)
+            logCallback("ERROR: No overlay appears between " + juce::String(offset, 3) + "s and " + juce::String(offset + length, 3) + "s");
+        return false;
+    }
 
-            juce::String filter =
-                "[0:v]" + juce::String(loopPrefix) +
-                "trim=start=0:end=" + juce::String(duration, 6) +
-                ",setpts=PTS-STARTPTS,scale=1920:1080:force_original_aspect_ratio=decrease,format=rgba[ov];"
-                "color=color=black:s=1920x1080:d=" + juce::String(duration, 6) + "[baseorig];"
-                "[baseorig]format=rgba,colorchannelmixer=aa=0[base];"
-                "[base][ov]overlay=x=(W-w)/2:y=(H-h)/2:format=auto,format=argb[out]";
-
-            juce::String cmd = ffmpegExecutor->getFFmpegPath();
-            cmd += " -y";
-            cmd += " -i \"" + overlay.file.getFullPathName() + "\"";
-            cmd += " -filter_complex \"" + filter + "\"";
-            cmd += " -map \"[out]\"";
-            cmd += " -t " + juce::String(duration, 6);
-            cmd += " -c:v qtrle -pix_fmt argb -an \"" + outFile.getFullPathName() + "\"";
-
-            return ffmpegExecutor->executeCommand(cmd, 0.0, 1.0);
-        };
-
-        auto buildGapSegment = [&](double duration, int idx, juce::File& outFile) -> bool
+    // The graph is written to a script, so many overlays don't hit the command line limit
+    const juce::File script = tempDirectory.getChildFile(outputFile.getFileNameWithoutExtension() + "_filtergraph.txt");
+    if (!script.replaceWithText(filters.joinIntoString(";\n")))
+    {
+        if (logCallback)
+            logCallback("ERROR: Failed to write overlay filtergraph script");
+        return false;
+    }
+
+    auto buildOverlayCommand = [&](const FallbackPolicy::JobOptions& options)
+    {
+        juce::String overlayCmd = ffmpegExecutor->getFFmpegPath();
+        overlayCmd += " -y";
+        if (options.tolerantDecode)
+            overlayCmd += " " + options.getInputFlags();
+        if (offset > 0.0)
+            overlayCmd += " -ss " + juce::String(offset, 6);
+        overlayCmd += " -i \"" + baseVideoFile.getFullPathName() + "\"";
+        overlayCmd += " " + overlayInputs.joinIntoString(" ");
+        overlayCmd += " -filter_complex_script \"" + script.getFullPathName() + "\"";
+        overlayCmd += " -map \"[" + outputLabel + "]\"";
+        overlayCmd += " -t " + juce::String(length, 6);
+        if (intermediateOutput != nullptr)
+            overlayCmd += " " + intermediateOutput->codecArgs;
+        else
+            overlayCmd += " " + (options.useGpuEncoder ? finalNvidiaParams : finalCpuParams);
+        overlayCmd += " -pix_fmt yuv420p -an";
+        if (intermediateOutput != nullptr && intermediateOutput->muxerArgs.isNotEmpty())
+            overlayCmd += " " + intermediateOutput->muxerArgs;
+        if (options.getOutputFlags().isNotEmpty())
+            overlayCmd += " " + options.getOutputFlags();
+        overlayCmd += " \"" + outputFile.getFullPathName() + "\"";
+        return overlayCmd;
+    };
+
+    // Intermediates use the same encoder as every other intermediate, never the GPU one
+    const juce::String description = "Overlay pass for " + juce::String(overlayInputs.size()) + " overlays, "
+                                   + juce::String(offset, 3) + "s-" + juce::String(offset + length, 3) + "s";
+
+    const bool success = ffmpegExecutor->executeWithFallback(buildOverlayCommand,
+                                                             intermediateOutput == nullptr && useNvidiaAcceleration,
+                                                             outputFile, description, 0.0, 1.0);
+    script.deleteFile();
+    return success;
+}
+
+bool OverlayProcessor::renderNativePass(const juce::File& baseVideoFile, const std::vector<OverlayTiming>& timings,
+                                        double offset, double length, const juce::File& tempDirectory,
+                                        const juce::File& outputFile, const IntermediateFormat* intermediateOutput)
+{
+   #if JUCE_WINDOWS
+    juce::ignoreUnused(baseVideoFile, timings, offset, length, tempDirectory, outputFile, intermediateOutput);
+    return false;
+   #else
+    size_t spriteBytes = 0;
+    for (const auto& timing : timings)
+    {
+        if (!timing.scaled)
+            return false;
+        spriteBytes += (size_t) timing.width * (size_t) timing.height * 4 * (size_t) timing.appearanceFrames;
+    }
+
+    if (spriteBytes > nativeSpriteBudget)
+    {
+        if (logCallback)
+            logCallback("Overlay sprites need " + juce::File::descriptionOfSizeInBytes((juce::int64) spriteBytes)
+                        + ", more than the native compositor holds in memory");
+        return false;
+    }
+
+    const juce::String ffmpegPath = ffmpegExecutor->getFFmpegPath();
+
+    // Decoders write into FIFOs, and are registered so a cancel kills them with everything else
+    const juce::File spriteFifo = tempDirectory.getChildFile(outputFile.getFileNameWithoutExtension() + "_sprite.fifo");
+    const juce::File baseFifo = tempDirectory.getChildFile(outputFile.getFileNameWithoutExtension() + "_base.fifo");
+
+    // Every sprite frame, premultiplied, as the kernels want them
+    std::vector<std::vector<juce::uint8>> spritePixels;
+    std::vector<int> spriteFrames;
+    for (const auto& timing : timings)
+    {
+        const size_t frameBytes = (size_t) timing.width * (size_t) timing.height * 4;
+        std::vector<juce::uint8> pixels(frameBytes * (size_t) timing.appearanceFrames);
+
+        FFmpegProcess spriteDecoder(ProcessManager::JobClass::Render, "Overlay sprite decode");
+        const FFmpegExecutor::ScopedProcessRegistration registration(*ffmpegExecutor, spriteDecoder);
+
+        const int spriteFd = startFrameReader(spriteDecoder, ffmpegPath + " -v error -nostdin -i \"" + timing.file.getFullPathName() + "\""
+                                                              + " -frames:v " + juce::String(timing.appearanceFrames)
+                                                              + " -f rawvideo -pix_fmt bgra", spriteFifo);
+        if (spriteFd < 0)
         {
-            outFile = tempDirectory.getChildFile("overlay_gap_" + juce::String(i) + "_" + juce::String(idx) + ".mov");
-            juce::String cmd = ffmpegExecutor->getFFmpegPath();
-            cmd += " -y -f lavfi -i color=color=black:s=1920x1080:d=" + juce::String(duration, 6);
-            cmd += " -vf format=rgba,colorchannelmixer=aa=0";
-            cmd += " -c:v qtrle -pix_fmt argb -an \"" + outFile.getFullPathName() + "\"";
-            return ffmpegExecutor->executeCommand(cmd, 0.0, 1.0);
-        };
-
-        juce::Array<juce::File> segments;
-        double cursor = 0.0;
-        for (int idx = 0; idx < appearanceCount; ++idx)
+            spriteFifo.deleteFile();
+            return false;
+        }
+
+        const int frames = (int) (readFully(spriteFd, spriteDecoder, pixels.data(), pixels.size()) / frameBytes);
+        ::close(spriteFd);
+        spriteFifo.deleteFile();
+        if (frames == 0 || registration.wasCancelled())
+            return false;
+
+        AlphaCompositor::premultiply(pixels.data(), (size_t) frames * (size_t) timing.width * (size_t) timing.height);
+        spritePixels.push_back(std::move(pixels));
+        spriteFrames.push_back(frames);
+    }
+
+    // The same appearances, at the same sprite frames, as the overlay filter would draw
+    auto findSpriteFrame = [&](const OverlayTiming& timing, double time, int numFrames)
+    {
+        const auto next = std::upper_bound(timing.starts.begin(), timing.starts.end(), time + appearanceTolerance);
+        if (next == timing.starts.begin())
+            return -1;
+
+        const double appearanceStart = *(next - 1);
+        if (appearanceStart < offset - appearanceTolerance
+            || appearanceStart + timing.duration > offset + length + appearanceTolerance)
+            return -1;
+
+        const double into = time - appearanceStart;
+        if (into < -appearanceTolerance || into >= timing.duration)
+            return -1;
+
+        return juce::jlimit(0, numFrames - 1, (int) std::floor(into * timing.fps + 1.0e-6));
+    };
+
+    const int width = baseStream.width;
+    const int height = baseStream.height;
+
+    FFmpegProcess decoder(ProcessManager::JobClass::Render, "Overlay base decode");
+    const FFmpegExecutor::ScopedProcessRegistration decoderRegistration(*ffmpegExecutor, decoder);
+
+    const int baseFd = startFrameReader(decoder, ffmpegPath + " -v error -nostdin"
+                                                 + (offset > 0.0 ? " -ss " + juce::String(offset, 6) : juce::String())
+                                                 + " -i \"" + baseVideoFile.getFullPathName() + "\""
+                                                 + " -t " + juce::String(length, 6)
+                                                 + " -f rawvideo -pix_fmt yuv420p", baseFifo);
+    if (baseFd < 0)
+    {
+        baseFifo.deleteFile();
+        return false;
+    }
+
+    auto stopDecoder = [&]
+    {
+        ::close(baseFd);
+        decoder.kill();
+        while (decoder.isRunning())
+            juce::Thread::sleep(1);
+        baseFifo.deleteFile();
+    };
+
+    // The encoder reads the frames from a FIFO, since FFmpegProcess has no stdin
+    const juce::File fifo = tempDirectory.getChildFile(outputFile.getFileNameWithoutExtension() + "_frames.fifo");
+    fifo.deleteFile();
+    if (::mkfifo(fifo.getFullPathName().toRawUTF8(), 0600) != 0)
+    {
+        stopDecoder();
+        return false;
+    }
+
+    juce::String encodeArgs = intermediateOutput != nullptr ? intermediateOutput->codecArgs : finalCpuParams;
+    encodeArgs << " -pix_fmt yuv420p -an";
+    if (intermediateOutput != nullptr && intermediateOutput->muxerArgs.isNotEmpty())
+        encodeArgs << " " << intermediateOutput->muxerArgs;
+
+    FFmpegProcess encoder(ProcessManager::JobClass::Render, "Overlay encode");
+    const FFmpegExecutor::ScopedProcessRegistration encoderRegistration(*ffmpegExecutor, encoder);
+    if (!encoder.start(ffmpegPath + " -y -v error -nostdin -f rawvideo -pix_fmt yuv420p"
+                       + " -s " + juce::String(width) + "x" + juce::String(height)
+                       + " -r " + frameRateArgument(baseStream.fps)
+                       + " -i \"" + fifo.getFullPathName() + "\""
+                       + " -t " + juce::String(length, 6) + " " + encodeArgs
+                       + " \"" + outputFile.getFullPathName() + "\""))
+    {
+        stopDecoder();
+        fifo.deleteFile();
+        return false;
+    }
+
+    // Opening a FIFO for writing fails until the encoder has opened it for reading
+    int fd = -1;
+    for (int attempt = 0; fd < 0 && attempt < 1000 && encoder.isRunning(); ++attempt)
+    {
+        fd = ::open(fifo.getFullPathName().toRawUTF8(), O_WRONLY | O_NONBLOCK);
+        if (fd < 0)
+            juce::Thread::sleep(10);
+    }
+
+    juce::String encoderOutput;
+    auto drainEncoder = [&]
+    {
+        char buffer[4096];
+        int bytes;
+        while ((bytes = encoder.readProcessOutput(buffer, (int) sizeof(buffer))) > 0)
+            encoderOutput = (encoderOutput + juce::String::fromUTF8(buffer, bytes)).getLastCharacters(2000);
+    };
+
+    bool streamed = fd >= 0;
+    juce::int64 frameIndex = 0;
+
+    if (streamed)
+    {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+        // An encoder that dies mid-write must fail the pass, not raise SIGPIPE in the app
+        sigset_t pipeSignal, previousMask;
+        sigemptyset(&pipeSignal);
+        sigaddset(&pipeSignal, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousMask);
+
+        std::vector<juce::uint8> frame(AlphaCompositor::YuvFrame::getSize(width, height));
+        AlphaCompositor::YuvFrame yuv { frame.data(), width, height };
+
+        while (readFully(baseFd, decoder, frame.data(), frame.size()) == frame.size())
         {
-            const double start = appearanceStarts[idx];
-            const double dur = appearanceDurations[idx];
+            const double time = offset + (double) frameIndex / baseStream.fps;
 
-            const double gap = start - cursor;
-            if (gap > 0.0001)
+            for (size_t i = 0; i < timings.size(); ++i)
             {
-                juce::File gapFile;
-                if (!buildGapSegment(gap, segments.size(), gapFile))
-                    return false;
-                segments.add(gapFile);
-                cursor += gap;
+                const auto& timing = timings[i];
+                const int spriteFrame = findSpriteFrame(timing, time, spriteFrames[i]);
+                if (spriteFrame < 0)
+                    continue;
+
+                const size_t frameBytes = (size_t) timing.width * (size_t) timing.height * 4;
+                const AlphaCompositor::OverlayFrame overlay { spritePixels[i].data() + (size_t) spriteFrame * frameBytes,
+                                                              timing.width, timing.height };
+                AlphaCompositor::blend(yuv, overlay, (width - timing.width) / 2, (height - timing.height) / 2);
             }
 
-            juce::File segFile;
-            if (!buildOverlaySegment(start, dur, segments.size(), segFile))
-                return false;
-            segments.add(segFile);
-            cursor += dur;
-        }
+            if (!writeFully(fd, frame.data(), frame.size()))
+            {
+                streamed = false;
+                break;
+            }
 
-        const double tailGap = totalDuration - cursor;
-        if (tailGap > 0.0001)
-        {
-            juce::File gapFile;
-            if (!buildGapSegment(tailGap, segments.size(), gapFile))
-                return false;
-            segments.add(gapFile);
+            drainEncoder();
+            ++frameIndex;
+
+            if ((frameIndex & 31) == 0 && decoderRegistration.wasCancelled())
+            {
+                streamed = false;
+                break;
+            }
         }
 
-        juce::File concatList = tempDirectory.getChildFile("overlay_timeline_concat_" + juce::String(i) + ".txt");
+        ::close(fd);
+
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE))
         {
-            juce::FileOutputStream out(concatList);
-            if (!out.openedOk())
-                return false;
-            for (const auto& f : segments)
-                out.writeText("file '" + f.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
-            out.flush();
+            int signal = 0;
+            sigwait(&pipeSignal, &signal);
         }
+        pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+    }
+
+    stopDecoder();
+
+    if (!streamed)
+        encoder.kill();
+    while (encoder.isRunning())
+    {
+        drainEncoder();
+        if (encoderRegistration.wasCancelled())
+            encoder.kill();
+        juce::Thread::sleep(10);
+    }
+    drainEncoder();
+    fifo.deleteFile();
+
+    // A decoder that stopped early would leave the pass short
+    const juce::int64 expectedFrames = (juce::int64) std::round(length * baseStream.fps);
+    const bool success = streamed && encoder.getExitCode() == 0 && outputFile.existsAsFile()
+                      && std::abs(frameIndex - expectedFrames) <= 1;
 
-        juce::File overlayTimeline = tempDirectory.getChildFile("overlay_timeline_" + juce::String(i) + ".mov");
-        juce::String concatCmd = ffmpegExecutor->getFFmpegPath() +
-            " -y -f concat -safe 0 -i \"" + concatList.getFullPathName() + "\" " +
-            "-c:v qtrle -pix_fmt argb -an \"" + overlayTimeline.getFullPathName() + "\"";
+    if (logCallback)
+    {
+        if (success)
+            logCallback("Native compositor: " + juce::String(frameIndex) + " frames blended ("
+                        + (AlphaCompositor::hasVectorKernels() ? "AVX2" : "scalar") + ")");
+        else if (!ffmpegExecutor->isCancellationRequested())
+            logCallback("WARNING: Native compositor stopped after " + juce::String(frameIndex) + " of "
+                        + juce::String(expectedFrames) + " frames" + (encoderOutput.isNotEmpty() ? ": " + encoderOutput.trim() : juce::String()));
+    }
+
+    return success;
+   #endif
+}
+
+bool OverlayProcessor::renderSparse(const juce::File& baseVideoFile, const std::vector<OverlayTiming>& timings,
+                                    double totalDuration, const juce::File& tempDirectory, const juce::File& outputFile,
+                                    const IntermediateFormat& intermediateOutput, bool& attempted)
+{
+    attempted = false;
 
-        if (!ffmpegExecutor->executeCommand(concatCmd, 0.0, 1.0))
+    // Every frame of an intra-only base is a keyframe, so span edges are frame edges and
+    // the full-length packet probe would read the whole file for nothing
+    std::shared_ptr<const KeyframeIndex> index;
+    double frameDuration = 1.0 / baseStream.fps;
+    if (!intermediateOutput.isIntraOnly())
+    {
+        index = KeyframeIndex::forFile(*ffmpegExecutor, baseVideoFile);
+        if (index == nullptr)
             return false;
+        frameDuration = index->getFrameDuration();
+    }
 
-        juce::File passOutput = isFinalOverlayClip ? overlayOutput
-                                                   : tempDirectory.getChildFile("overlay_single_pass_" + juce::String(i) + ".mp4");
+    auto keyframeBefore = [&](double seconds)
+    {
+        return index != nullptr ? index->findKeyframeBefore(seconds)
+                                : std::floor(seconds / frameDuration + 1.0e-6) * frameDuration;
+    };
+    auto keyframeAfter = [&](double seconds)
+    {
+        return index != nullptr ? index->findKeyframeAfter(seconds)
+                                : std::ceil(seconds / frameDuration - 1.0e-6) * frameDuration;
+    };
+
+    std::vector<std::pair<double, double>> appearances;
+    for (const auto& timing : timings)
+        for (const double start : timing.starts)
+            appearances.emplace_back(start, start + timing.duration);
+    std::sort(appearances.begin(), appearances.end());
+
+    // Spans start and end on keyframes of the base, so the copied parts between them
+    // decode on their own; spans with only a short copy between them are joined
+    std::vector<std::pair<double, double>> spans;
+    for (const auto& [start, end] : appearances)
+    {
+        const double spanStart = keyframeBefore(start);
+        const double spanEnd = juce::jmin(keyframeAfter(end), totalDuration);
 
-        juce::String overlayCmd = ffmpegExecutor->getFFmpegPath();
-        overlayCmd += " -y";
-        overlayCmd += " -i \"" + sequentialInput.getFullPathName() + "\"";
-        overlayCmd += " -i \"" + overlayTimeline.getFullPathName() + "\"";
-        overlayCmd += " -filter_complex \"[0:v][1:v]overlay=x=(W-w)/2:y=(H-h)/2:format=auto\"";
-        overlayCmd += " -t " + juce::String(totalDuration);
-        overlayCmd += " " + (useNvidiaAcceleration ? finalNvidiaParams : finalCpuParams);
-        overlayCmd += " -pix_fmt yuv420p -an";
-        overlayCmd += " \"" + passOutput.getFullPathName() + "\"";
+        if (!spans.empty() && spanStart <= spans.back().second + minimumCopySeconds)
+            spans.back().second = juce::jmax(spans.back().second, spanEnd);
+        else
+            spans.emplace_back(spanStart, spanEnd);
+    }
+
+    double encodedSeconds = 0.0;
+    for (const auto& [start, end] : spans)
+        encodedSeconds += end - start;
+
+    if (encodedSeconds > maximumSparseShare * totalDuration)
+    {
+        if (logCallback)
+            logCallback("Overlays cover " + juce::String(encodedSeconds, 1) + "s of " + juce::String(totalDuration, 1)
+                        + "s; drawing them over the whole timeline");
+        return false;
+    }
+
+    attempted = true;
+    if (logCallback)
+        logCallback("Sparse overlays: re-encoding " + juce::String((int) spans.size()) + " spans ("
+                    + juce::String(encodedSeconds, 1) + "s), stream copying " + juce::String(totalDuration - encodedSeconds, 1) + "s");
 
-        bool success = ffmpegExecutor->executeCommand(overlayCmd, 0.0, 1.0);
+    const juce::File concatList = tempDirectory.getChildFile("overlay_spans_concat.txt");
+    juce::Array<juce::File> spanFiles;
+    auto cleanUp = [&]
+    {
+        for (const auto& spanFile : spanFiles)
+            spanFile.deleteFile();
+        concatList.deleteFile();
+    };
+
+    const juce::String basePath = baseVideoFile.getFullPathName().replace("\\", "/");
+    juce::String list;
+    double cursor = 0.0;
 
-        if (!success && useNvidiaAcceleration)
+    auto addBase = [&](double from, double to)
+    {
+        list << "file '" << basePath << "'\n";
+        if (from > 0.0)
+            list << "inpoint " << juce::String(from, 6) << "\n";
+        if (to > 0.0)
+            list << "outpoint " << juce::String(to, 6) << "\n";
+    };
+
+    for (const auto& [start, end] : spans)
+    {
+        if (ffmpegExecutor->isCancellationRequested())
         {
-            if (logCallback)
-                logCallback("WARNING: Overlay encoding failed with NVENC; retrying with CPU settings");
-            overlayCmd = ffmpegExecutor->getFFmpegPath();
-            overlayCmd += " -y";
-            overlayCmd += " -i \"" + sequentialInput.getFullPathName() + "\"";
-            overlayCmd += " -i \"" + overlayTimeline.getFullPathName() + "\"";
-            overlayCmd += " -filter_complex \"[0:v][1:v]overlay=x=(W-w)/2:y=(H-h)/2:format=auto\"";
-            overlayCmd += " -t " + juce::String(totalDuration);
-            overlayCmd += " " + finalCpuParams;
-            overlayCmd += " -pix_fmt yuv420p -an";
-            overlayCmd += " \"" + passOutput.getFullPathName() + "\"";
-
-            success = ffmpegExecutor->executeCommand(overlayCmd, 0.0, 1.0);
+            cleanUp();
+            return false;
         }
 
-        for (const auto& f : segments)
-            if (f.existsAsFile()) f.deleteFile();
-        if (concatList.existsAsFile()) concatList.deleteFile();
-        if (!isFinalOverlayClip && overlayTimeline.existsAsFile()) overlayTimeline.deleteFile();
+        const juce::File spanFile = tempDirectory.getChildFile("overlay_span_" + juce::String(spanFiles.size())
+                                                               + intermediateOutput.extension);
+        spanFiles.add(spanFile);
 
-        if (!success)
+        if (!renderOverlayPass(baseVideoFile, timings, start, end - start, tempDirectory, spanFile, &intermediateOutput))
         {
-            if (logCallback)
-                logCallback("ERROR: Overlay processing failed for " + overlay.file.getFileName());
+            cleanUp();
             return false;
         }
 
-        if (sequentialInput != passOutput && sequentialInput != initialOverlayInput && sequentialInput.existsAsFile())
-            sequentialInput.deleteFile();
+        if (start > cursor + appearanceTolerance)
+            addBase(cursor, start);
+        list << "file '" << spanFile.getFullPathName().replace("\\", "/") << "'\n";
+        cursor = end;
+    }
 
-        if (i < overlayClips.size() - 1)
-            currentInput = overlayOutput;
+    if (cursor < totalDuration - appearanceTolerance)
+        addBase(cursor, 0.0);
+
+    if (!concatList.replaceWithText(list))
+    {
+        if (logCallback)
+            logCallback("ERROR: Failed to write overlay span list");
+        cleanUp();
+        return false;
+    }
+
+    const juce::String concatCommand = ffmpegExecutor->getFFmpegPath()
+        + " -y -f concat -safe 0 -i \"" + concatList.getFullPathName() + "\""
+        + " -map 0:v -c copy -an -t " + juce::String(totalDuration, 6)
+        + (intermediateOutput.muxerArgs.isNotEmpty() ? " " + intermediateOutput.muxerArgs : juce::String())
+        + " \"" + outputFile.getFullPathName() + "\"";
+
+    const bool joined = ffmpegExecutor->executeCommand(concatCommand);
+    cleanUp();
+
+    // A copy that cut on the wrong frame would shift every later frame; check before trusting it
+    const double producedDuration = joined ? ffmpegExecutor->getFileDuration(outputFile) : -1.0;
+    if (std::abs(producedDuration - totalDuration) > 2.0 * frameDuration + appearanceTolerance)
+    {
+        if (logCallback && joined)
+            logCallback("WARNING: Sparse overlay output is " + juce::String(producedDuration, 3) + "s, expected "
+                        + juce::String(totalDuration, 3) + "s");
+        return false;
     }
 
     return true;
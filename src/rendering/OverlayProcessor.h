@@ -2,9 +2,33 @@
 #include <JuceHeader.h>
 #include "RenderTypes.h"
 #include "FFmpegExecutor.h"
+#include "IntermediateFormat.h"
+#include "IntermediateCache.h"
+#include <vector>
 
 /**
  * Handles the processing and application of overlay clips to the main timeline.
+ *
+ * All overlays are drawn in one FFmpeg pass over the base video. Their
+ * appearances come from OverlaySchedule; each overlay file is a looped input
+ * whose frames are retimed onto its appearances and drawn with an enable
+ * expression, so no per-appearance or full-length alpha intermediates are
+ * written and the base is encoded only once.
+ *
+ * When the output is an intermediate, overlays that cover a small part of the
+ * timeline are applied sparsely: only the keyframe-aligned spans around their
+ * appearances are re-encoded and the rest of the base is stream copied.
+ *
+ * Each overlay is first rendered once into a sprite: the frames of one
+ * appearance at the size it is drawn at (fitted inside the probed base frame,
+ * not a full-frame canvas) and at no more than the base frame rate, in
+ * lossless FFV1 with alpha.
+ * Sprites are kept in the IntermediateCache, so later renders and projects
+ * using the same overlay read them back instead of scaling it again.
+ *
+ * With the native compositor enabled, a pass decodes the base to raw frames,
+ * blends the sprites in-process with AlphaCompositor and pipes the frames to
+ * the encoder, falling back to FFmpeg's overlay filter if that can't be done.
  */
 class OverlayProcessor
 {
@@ -22,6 +46,12 @@ public:
      */
     void setLogCallback(std::function<void(const juce::String&)> logCallback);
     
+    /**
+     * Sets the cache used to reuse overlay sprites across renders.
+     * @param cache The cache to use, or nullptr to render them for every render
+     */
+    void setIntermediateCache(IntermediateCache* cache) { intermediateCache = cache; }
+    
     /**
      * Sets the encoding parameters.
      * @param useNvidiaAcceleration Whether to use NVIDIA acceleration
@@ -36,6 +66,18 @@ public:
                           const juce::String& finalNvidiaParams,
                           const juce::String& finalCpuParams);
     
+    /**
+     * Enables or disables sparse overlays (on by default, FFLUCE_SPARSE_OVERLAYS=0 turns
+     * them off). Without them every frame of the base is decoded and re-encoded.
+     */
+    void setSparseOverlays(bool shouldBeSparse) { sparseOverlays = shouldBeSparse; }
+
+    /**
+     * Enables or disables the in-process compositor (off by default until it has seen
+     * more footage; FFLUCE_NATIVE_COMPOSITOR=1 turns it on). Only available on POSIX.
+     */
+    void setNativeCompositor(bool shouldUseNative) { nativeCompositor = shouldUseNative; }
+
     /**
      * Processes overlay clips and applies them to the main timeline.
      * @param baseVideoFile The base video file to apply overlays to
@@ -43,15 +85,88 @@ public:
      * @param totalDuration The total duration of the video in seconds
      * @param tempDirectory The directory to store temporary files
      * @param outputFile The file to save the output to
+     * @param intermediateOutput If set, the output is written in this intermediate format
+     *                           (the format of the base) instead of the delivery encode,
+     *                           which lets spans without overlays be stream copied
      * @return true if the operation was successful, false otherwise
      */
     bool processOverlays(const juce::File& baseVideoFile,
                         const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
                         double totalDuration,
                         const juce::File& tempDirectory,
-                        const juce::File& outputFile);
+                        const juce::File& outputFile,
+                        const IntermediateFormat* intermediateOutput = nullptr);
     
 private:
+    /** When one overlay file appears and which of its frames each appearance shows. */
+    struct OverlayTiming
+    {
+        juce::File file;
+        std::vector<double> starts;     // of the appearances, ascending and not overlapping
+        double period = 0.0;            // between starts when they are evenly spaced, otherwise 0
+        double duration = 0.0;          // of each appearance
+        int fileFrames = 0;
+        int appearanceFrames = 0;
+        double fps = 0.0;
+        int width = 0;                  // size it is drawn at, centred on the base
+        int height = 0;
+        double spriteFps = 0.0;         // rate its sprite is rendered at
+        bool scaled = false;            // file is already width x height
+
+        int getNumAppearances() const { return (int) starts.size(); }
+    };
+
+    /** Seconds one appearance of a clip's file lasts, or 0 (logging why) if it can't be shown. */
+    double getAppearanceDuration(const RenderTypes::OverlayClipInfo& overlay, const juce::File& file) const;
+
+    /**
+     * Fills in the timing of one overlay file from its scheduled appearances.
+     * @param base Size and frame rate of the video the overlay is drawn over
+     */
+    void planTrack(const juce::File& file, double duration, const std::vector<double>& starts,
+                   const FFmpegExecutor::VideoStreamInfo& base, OverlayTiming& timing) const;
+
+    /**
+     * Points each timing at the sprite of its overlay, restoring it from the cache or
+     * rendering it. Overlays whose sprite can't be made keep their source file.
+     * @param sprites Receives the sprite files written to the temp directory
+     */
+    void useSprites(std::vector<OverlayTiming>& timings, const juce::File& tempDirectory,
+                    juce::Array<juce::File>& sprites);
+
+    /**
+     * Builds the graph drawing the appearances that lie wholly inside [offset, offset + length)
+     * over input 0, in the time of that window. Overlay inputs are added to inputs.
+     * @return the label of the composited video, or an empty string if nothing appears
+     */
+    juce::String buildOverlayGraph(const std::vector<OverlayTiming>& timings, double offset, double length,
+                                   juce::StringArray& inputs, juce::StringArray& filters) const;
+
+    /** Draws the overlays over [offset, offset + length) of the base into outputFile. */
+    bool renderOverlayPass(const juce::File& baseVideoFile, const std::vector<OverlayTiming>& timings,
+                           double offset, double length, const juce::File& tempDirectory,
+                           const juce::File& outputFile, const IntermediateFormat* intermediateOutput);
+
+    /**
+     * Draws the overlays over [offset, offset + length) of the base with AlphaCompositor,
+     * reading raw frames from one FFmpeg process and piping the result into another.
+     * @return false, leaving the caller to use the overlay filter, if an overlay isn't a
+     *         sprite, the sprites don't fit in memory, or any process fails
+     */
+    bool renderNativePass(const juce::File& baseVideoFile, const std::vector<OverlayTiming>& timings,
+                          double offset, double length, const juce::File& tempDirectory,
+                          const juce::File& outputFile, const IntermediateFormat* intermediateOutput);
+
+    /**
+     * Re-encodes only the keyframe-aligned spans around the appearances and stream copies
+     * the rest of the base. Sets attempted to false, without writing anything, when the
+     * spans would cover too much of the timeline to be worth it.
+     */
+    bool renderSparse(const juce::File& baseVideoFile, const std::vector<OverlayTiming>& timings,
+                      double totalDuration, const juce::File& tempDirectory, const juce::File& outputFile,
+                      const IntermediateFormat& intermediateOutput, bool& attempted);
+
+
     /**
      * Prepares a single overlay clip for use.
      * @param overlayClip The overlay clip to prepare
@@ -70,6 +185,18 @@ private:
     juce::String tempCpuParams;
     juce::String finalNvidiaParams;
     juce::String finalCpuParams;
+
+    // Whether intermediate outputs re-encode only the spans with overlays
+    bool sparseOverlays;
+
+    // Whether passes blend in-process instead of with the overlay filter
+    bool nativeCompositor;
+
+    // Size and frame rate of the base of the current render
+    FFmpegExecutor::VideoStreamInfo baseStream;
+    
+    // Cache for overlay sprites; owned by RenderManagerCore
+    IntermediateCache* intermediateCache = nullptr;
     
     // Log callback
     std::function<void(const juce::String&)> logCallback;
@@ -0,0 +1,167 @@
+#include "OverlaySchedule.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    // Slack when checking whether an appearance fits inside the timeline or a window
+    constexpr double tolerance = 0.0005;
+
+    bool isInsideWindow(const RenderTypes::OverlayClipInfo& clip, double start, double end)
+    {
+        if (clip.activeWindows.empty())
+            return true;
+
+        for (const auto& window : clip.activeWindows)
+            if (start >= window.getStart() - tolerance && end <= window.getEnd() + tolerance)
+                return true;
+
+        return false;
+    }
+
+    int pickVariant(juce::Random& random, const std::vector<double>& weights, double totalWeight)
+    {
+        if (weights.size() == 1)
+            return 0;
+
+        double choice = random.nextDouble() * totalWeight;
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            if (weights[i] > 0.0 && choice < weights[i])
+                return (int) i;
+            choice -= weights[i];
+        }
+
+        // Rounding can leave the choice just past the last weight
+        for (size_t i = weights.size(); i-- > 0;)
+            if (weights[i] > 0.0)
+                return (int) i;
+
+        return 0;
+    }
+
+    // Most appearances on screen at once during [start, end), among those accepted so far
+    int findPeakOverlap(const std::vector<OverlaySchedule::Appearance>& accepted, double longest, double start, double end)
+    {
+        auto first = std::lower_bound(accepted.begin(), accepted.end(), start - longest,
+                                      [](const OverlaySchedule::Appearance& a, double time) { return a.start < time; });
+
+        std::vector<std::pair<double, int>> events;
+        for (auto it = first; it != accepted.end() && it->start < end; ++it)
+        {
+            if (it->getEnd() <= start)
+                continue;
+
+            events.emplace_back(juce::jmax(start, it->start), 1);
+            events.emplace_back(juce::jmin(end, it->getEnd()), -1);
+        }
+
+        // Ends sort before starts at the same time, so touching appearances don't count as overlapping
+        std::sort(events.begin(), events.end());
+
+        int current = 0, peak = 0;
+        for (const auto& event : events)
+        {
+            current += event.second;
+            peak = juce::jmax(peak, current);
+        }
+        return peak;
+    }
+}
+
+std::vector<OverlaySchedule::Appearance> OverlaySchedule::compile(const std::vector<RenderTypes::OverlayClipInfo>& clips,
+                                                                  double totalDuration,
+                                                                  const DurationLookup& getAppearanceDuration)
+{
+    std::vector<Appearance> accepted;
+    double longest = 0.0;
+
+    for (int c = 0; c < (int) clips.size(); ++c)
+    {
+        const auto& clip = clips[(size_t) c];
+        const int numFiles = 1 + (int) clip.variants.size();
+
+        std::vector<double> durations((size_t) numFiles);
+        std::vector<double> weights((size_t) numFiles);
+        double totalWeight = 0.0;
+
+        for (int f = 0; f < numFiles; ++f)
+        {
+            durations[(size_t) f] = getAppearanceDuration(clip, getFile(clip, f));
+            const double weight = f == 0 ? clip.weight : clip.variants[(size_t) f - 1].weight;
+            weights[(size_t) f] = durations[(size_t) f] > 0.0 ? juce::jmax(0.0, weight) : 0.0;
+            totalWeight += weights[(size_t) f];
+        }
+
+        if (totalWeight <= 0.0)
+            continue;
+
+        juce::Random random(clip.jitterSeed != 0 ? clip.jitterSeed : juce::Random::getSystemRandom().nextInt64());
+        const double jitter = juce::jmax(0.0, clip.jitterSecs);
+        const bool repeats = clip.frequencySecs > 0.0;
+
+        std::vector<Appearance> clipAppearances;
+        double previousEnd = std::numeric_limits<double>::lowest();
+
+        for (juce::int64 k = 0;; ++k)
+        {
+            const double nominal = clip.startTimeSecs + (repeats ? (double) k * clip.frequencySecs : 0.0);
+            if (nominal - jitter > totalDuration)
+                break;
+
+            // Drawn for every nominal appearance, kept or not, so a seed always gives the same schedule
+            const double offset = jitter > 0.0 ? (random.nextDouble() * 2.0 - 1.0) * jitter : 0.0;
+            const int variant = pickVariant(random, weights, totalWeight);
+
+            const double start = juce::jmax(0.0, nominal + offset);
+            const double end = start + durations[(size_t) variant];
+
+            if (nominal + offset >= -tolerance && end <= totalDuration + tolerance && start >= previousEnd - tolerance
+                && isInsideWindow(clip, start, end)
+                && (clip.maxConcurrent <= 0 || findPeakOverlap(accepted, longest, start, end) < clip.maxConcurrent))
+            {
+                clipAppearances.push_back({ start, durations[(size_t) variant], c, variant });
+                previousEnd = end;
+            }
+
+            if (!repeats)
+                break;
+        }
+
+        for (const double duration : durations)
+            longest = juce::jmax(longest, duration);
+
+        std::vector<Appearance> merged;
+        merged.reserve(accepted.size() + clipAppearances.size());
+        std::merge(accepted.begin(), accepted.end(), clipAppearances.begin(), clipAppearances.end(), std::back_inserter(merged),
+                   [](const Appearance& a, const Appearance& b) { return a.start < b.start; });
+        accepted.swap(merged);
+    }
+
+    return accepted;
+}
+
+juce::File OverlaySchedule::getFile(const RenderTypes::OverlayClipInfo& clip, int variant)
+{
+    return variant <= 0 ? clip.file : clip.variants[(size_t) variant - 1].file;
+}
+
+juce::String OverlaySchedule::describe(const RenderTypes::OverlayClipInfo& clip)
+{
+    if (!clip.hasSchedule())
+        return {};
+
+    juce::String text;
+    text << "jitter=" << juce::String(clip.jitterSecs, 6)
+         << ",seed=" << (clip.jitterSeed != 0 ? juce::String(clip.jitterSeed) : "random-" + juce::Uuid().toString());
+
+    for (const auto& window : clip.activeWindows)
+        text << ",window=" << juce::String(window.getStart(), 6) << "-" << juce::String(window.getEnd(), 6);
+
+    text << ",weight=" << juce::String(clip.weight, 6);
+    for (const auto& variant : clip.variants)
+        text << ",variant=" << variant.file.getFullPathName() << ":" << juce::String(variant.weight, 6);
+
+    text << ",max=" << clip.maxConcurrent;
+    return text;
+}
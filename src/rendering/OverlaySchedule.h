@@ -0,0 +1,54 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RenderTypes.h"
+#include <functional>
+#include <vector>
+
+/**
+ * Compiles the scheduling rules of a render's overlay clips into one list of
+ * appearances, sorted by start time.
+ *
+ * A clip's nominal appearances start at startTimeSecs and repeat every
+ * frequencySecs. Each one is moved by a random jitter and shows one of the
+ * clip's files, picked by weight. It is kept only if it lies whole inside the
+ * timeline and inside one of the clip's active windows, starts after the
+ * clip's previous appearance has ended, and wouldn't put more overlays on
+ * screen than the clip's maxConcurrent allows. Clips earlier in the list win
+ * concurrency conflicts.
+ *
+ * The result is a plain interval list that the overlay pass draws directly,
+ * so a varied schedule writes no per-appearance files and costs no more to
+ * render than a regular one.
+ */
+class OverlaySchedule
+{
+public:
+    /** One appearance of one overlay file. */
+    struct Appearance
+    {
+        double start = 0.0;
+        double duration = 0.0;
+        int clip = 0;           // index into the overlay clips
+        int variant = 0;        // 0 for the clip's file, i + 1 for its variants[i]
+
+        double getEnd() const { return start + duration; }
+    };
+
+    /** Seconds one appearance of a clip's file lasts, or 0 if the file can't be shown. */
+    using DurationLookup = std::function<double(const RenderTypes::OverlayClipInfo& clip, const juce::File& file)>;
+
+    /** Compiles the appearances of all clips that lie inside [0, totalDuration]. */
+    static std::vector<Appearance> compile(const std::vector<RenderTypes::OverlayClipInfo>& clips,
+                                           double totalDuration,
+                                           const DurationLookup& getAppearanceDuration);
+
+    /** The file a variant of a clip shows. */
+    static juce::File getFile(const RenderTypes::OverlayClipInfo& clip, int variant);
+
+    /**
+     * Describes a clip's scheduling rules for cache recipes; empty for a plain
+     * fixed-frequency clip. Unseeded jitter makes the description unique, since
+     * no two renders of it give the same schedule.
+     */
+    static juce::String describe(const RenderTypes::OverlayClipInfo& clip);
+};
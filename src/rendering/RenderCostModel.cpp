@@ -0,0 +1,154 @@
+#include "RenderCostModel.h"
+#include <algorithm>
+
+namespace
+{
+    // Frames times megapixels, the unit of work the fitted lines are in
+    double getWork(double frames, int width, int height)
+    {
+        const double pixels = (width > 0 && height > 0) ? (double) width * height : 1920.0 * 1080.0;
+        return frames * pixels / 1.0e6;
+    }
+
+    juce::String makeKey(const juce::String& stage, const juce::String& encoder, const juce::String& preset)
+    {
+        juce::String key = stage;
+        if (encoder.isNotEmpty() || preset.isNotEmpty())
+            key << "|" << encoder;
+        if (preset.isNotEmpty())
+            key << "|" << preset;
+        return key;
+    }
+}
+
+void RenderCostModel::Fit::add(double work, double seconds)
+{
+    n += 1.0;
+    sumX += work;
+    sumY += seconds;
+    sumXX += work * work;
+    sumXY += work * seconds;
+}
+
+double RenderCostModel::Fit::predict(double work) const
+{
+    if (n <= 0.0 || sumX <= 0.0)
+        return -1.0;
+
+    // With a few samples or one size of step, the overhead can't be told from the rate
+    const double denominator = n * sumXX - sumX * sumX;
+    if (n >= 3.0 && denominator > 1.0e-9 * n * sumXX)
+    {
+        const double rate = (n * sumXY - sumX * sumY) / denominator;
+        const double overhead = (sumY - rate * sumX) / n;
+        if (rate > 0.0 && overhead >= 0.0)
+            return overhead + rate * work;
+    }
+
+    return work * sumY / sumX;
+}
+
+//==============================================================================
+void RenderCostModel::fit(const juce::File& logsRoot, int maxSessions)
+{
+    fits.clear();
+    numSamples = 0;
+
+    auto sessions = logsRoot.findChildFiles(juce::File::findDirectories, false, "render_*");
+
+    // Session directories are timestamped; read the newest first
+    std::sort(sessions.begin(), sessions.end(),
+              [](const juce::File& a, const juce::File& b) { return a.getFileName() > b.getFileName(); });
+
+    int sessionsRead = 0;
+    for (const auto& session : sessions)
+    {
+        if (sessionsRead >= maxSessions)
+            break;
+
+        const juce::File recordsFile = session.getChildFile("ffmpeg").getChildFile("commands.jsonl");
+        if (!recordsFile.existsAsFile())
+            continue;
+
+        juce::StringArray lines;
+        recordsFile.readLines(lines);
+
+        for (const auto& line : lines)
+        {
+            RenderTelemetry::CommandRecord record;
+            if (line.isNotEmpty() && RenderTelemetry::recordFromJSON(juce::JSON::parse(line), record))
+                addSample(record);
+        }
+
+        ++sessionsRead;
+    }
+}
+
+void RenderCostModel::addSample(const RenderTelemetry::CommandRecord& record)
+{
+    if (record.exitCode != 0 || record.cancelled || record.wallSeconds <= 0.0 || record.stage.isEmpty())
+        return;
+
+    // Timings from other hardware would only blur the fit
+    if (record.machine.isNotEmpty() && record.machine != RenderTelemetry::getMachineId())
+        return;
+
+    // FFmpeg's fps= is frames over elapsed time, so together they give the frame count
+    const double frames = record.encoderFps > 0.0 ? record.encoderFps * record.wallSeconds
+                                                  : record.mediaSeconds * 30.0;
+    const double work = getWork(frames, record.outputWidth, record.outputHeight);
+    if (work <= 0.0)
+        return;
+
+    const juce::String preset = findOption(record.command, "-preset");
+    fits[makeKey(record.stage, record.encoder, preset)].add(work, record.wallSeconds);
+    if (preset.isNotEmpty())
+        fits[makeKey(record.stage, record.encoder, {})].add(work, record.wallSeconds);
+    if (record.encoder.isNotEmpty())
+        fits[record.stage].add(work, record.wallSeconds);
+
+    ++numSamples;
+}
+
+double RenderCostModel::predictSeconds(const Step& step) const
+{
+    const double work = getWork(step.mediaSeconds * step.framesPerSecond, step.width, step.height);
+
+    // The most specific line with history wins
+    for (const auto& key : { makeKey(step.stage, step.encoder, step.preset),
+                             makeKey(step.stage, step.encoder, {}),
+                             step.stage })
+    {
+        auto fitted = fits.find(key);
+        if (fitted != fits.end())
+            return fitted->second.predict(work);
+    }
+
+    return -1.0;
+}
+
+juce::String RenderCostModel::describe() const
+{
+    juce::String text;
+    text << "Cost model: " << numSamples << " timed commands\n";
+
+    for (const auto& [key, fitted] : fits)
+        text << "  " << key.paddedRight(' ', 36) << juce::String((int) fitted.n).paddedLeft(' ', 6) << " samples, "
+             << juce::String(fitted.predict(getWork(30.0, 1920, 1080)), 2) << " s per second of 1080p30\n";
+
+    return text;
+}
+
+juce::String RenderCostModel::findOption(const juce::String& arguments, const juce::String& option)
+{
+    juce::StringArray tokens;
+    tokens.addTokens(arguments, " ", "\"");
+    tokens.removeEmptyStrings();
+
+    juce::String value;
+    for (int i = 0; i + 1 < tokens.size(); ++i)
+        if (tokens[i] == option)
+            value = tokens[i + 1];
+
+    return value;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RenderTelemetry.h"
+#include <map>
+
+/**
+ * Predicts the wall time of a render step from the timings of earlier sessions.
+ *
+ * Every successful command in the commands.jsonl files of recent render sessions
+ * on this machine becomes one sample: its work is frames times megapixels, its
+ * cost the wall seconds it took. A line (fixed overhead plus seconds per
+ * megapixel-frame) is fitted per step, encoder and preset, so that resolution,
+ * frame rate, duration, preset and hardware all show up in the prediction.
+ *
+ * The render graph uses the predictions as task costs, which weights its
+ * progress, orders its ready queue by critical path and gives the estimate
+ * logged before a render starts. Steps without history get -1, and the caller
+ * keeps its fixed guess.
+ */
+class RenderCostModel
+{
+public:
+    /** What is known about a step before it runs. */
+    struct Step
+    {
+        juce::String stage;         // RenderGraph task type name, as the telemetry records it
+        juce::String encoder;       // -c:v of the step
+        juce::String preset;        // -preset of the step, if any
+        int width = 1920;
+        int height = 1080;
+        double framesPerSecond = 30.0;
+        double mediaSeconds = 0.0;
+    };
+
+    /**
+     * Fits the model to the most recent sessions under logsRoot (render_* directories
+     * with an ffmpeg/commands.jsonl), keeping only commands run on this machine.
+     */
+    void fit(const juce::File& logsRoot, int maxSessions = 20);
+
+    /** Adds one finished command; fit() calls this for each record it reads. */
+    void addSample(const RenderTelemetry::CommandRecord& record);
+
+    /** Predicted wall seconds of the step, or -1 if no similar step has been timed. */
+    double predictSeconds(const Step& step) const;
+
+    int getNumSamples() const { return numSamples; }
+
+    /** Lists the fitted lines, for the render log. */
+    juce::String describe() const;
+
+    /** Returns the value of the last occurrence of an option (e.g. "-preset") in FFmpeg arguments. */
+    static juce::String findOption(const juce::String& arguments, const juce::String& option);
+
+private:
+    struct Fit
+    {
+        // Sums for a least-squares line through (work, seconds)
+        double n = 0.0, sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+
+        void add(double work, double seconds);
+        double predict(double work) const;
+    };
+
+    std::map<juce::String, Fit> fits;     // "stage|encoder|preset", "stage|encoder" and "stage"
+    int numSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderCostModel)
+};
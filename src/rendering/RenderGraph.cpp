@@ -0,0 +1,283 @@
+#include "RenderGraph.h"
+#include <algorithm>
+
+namespace
+{
+    // Paths are compared as written; every task builds them from the same temp directory
+    juce::String getFileKey(const juce::File& file)
+    {
+        return file.getFullPathName();
+    }
+
+    void addUnique(std::vector<int>& ids, int id)
+    {
+        if (std::find(ids.begin(), ids.end(), id) == ids.end())
+            ids.push_back(id);
+    }
+}
+
+//==============================================================================
+int RenderGraph::addTask(TaskType type,
+                         const juce::String& name,
+                         const juce::Array<juce::File>& inputs,
+                         const juce::Array<juce::File>& outputs,
+                         double estimatedSeconds,
+                         std::function<bool()> run)
+{
+    Task task;
+    task.id = (int) tasks.size();
+    task.type = type;
+    task.name = name;
+    task.inputs = inputs;
+    task.outputs = outputs;
+    task.estimatedSeconds = juce::jmax(0.0, estimatedSeconds);
+    task.run = std::move(run);
+
+    tasks.push_back(std::move(task));
+    resolved = false;
+    return tasks.back().id;
+}
+
+void RenderGraph::addDependency(int taskId, int dependsOnTaskId)
+{
+    extraDependencies.emplace_back(taskId, dependsOnTaskId);
+    resolved = false;
+}
+
+void RenderGraph::setRecipe(int taskId, const juce::String& recipe)
+{
+    tasks[(size_t) taskId].recipe = recipe;
+}
+
+void RenderGraph::setOutputBytes(int taskId, juce::int64 bytes)
+{
+    tasks[(size_t) taskId].outputBytes = juce::jmax((juce::int64) 0, bytes);
+}
+
+void RenderGraph::setTaskRunner(int taskId, TaskState state, double estimatedSeconds, std::function<bool()> run)
+{
+    Task& task = tasks[(size_t) taskId];
+    task.state = state;
+    task.estimatedSeconds = juce::jmax(0.0, estimatedSeconds);
+    task.run = std::move(run);
+}
+
+bool RenderGraph::resolveDependencies(juce::String& error)
+{
+    producers.clear();
+
+    for (auto& task : tasks)
+    {
+        task.dependencies.clear();
+        task.dependents.clear();
+
+        for (const auto& output : task.outputs)
+        {
+            auto [it, inserted] = producers.emplace(getFileKey(output), task.id);
+            if (!inserted)
+            {
+                error = output.getFileName() + " is written by both '" + tasks[(size_t) it->second].name
+                        + "' and '" + task.name + "'";
+                return false;
+            }
+        }
+    }
+
+    for (auto& task : tasks)
+    {
+        for (const auto& input : task.inputs)
+        {
+            auto producer = producers.find(getFileKey(input));
+            if (producer != producers.end() && producer->second != task.id)
+                addUnique(task.dependencies, producer->second);
+        }
+    }
+
+    for (const auto& [taskId, dependsOn] : extraDependencies)
+    {
+        if (taskId < 0 || taskId >= getNumTasks() || dependsOn < 0 || dependsOn >= getNumTasks() || taskId == dependsOn)
+        {
+            error = "Invalid dependency " + juce::String(taskId) + " -> " + juce::String(dependsOn);
+            return false;
+        }
+
+        addUnique(tasks[(size_t) taskId].dependencies, dependsOn);
+    }
+
+    for (const auto& task : tasks)
+        for (int dependency : task.dependencies)
+            tasks[(size_t) dependency].dependents.push_back(task.id);
+
+    // Kahn's algorithm; anything left over is part of a cycle
+    std::vector<int> pending(tasks.size());
+    std::vector<int> ready;
+    topologicalOrder.clear();
+
+    for (const auto& task : tasks)
+    {
+        pending[(size_t) task.id] = (int) task.dependencies.size();
+        if (pending[(size_t) task.id] == 0)
+            ready.push_back(task.id);
+    }
+
+    while (!ready.empty())
+    {
+        const int taskId = ready.back();
+        ready.pop_back();
+        topologicalOrder.push_back(taskId);
+
+        for (int dependent : tasks[(size_t) taskId].dependents)
+            if (--pending[(size_t) dependent] == 0)
+                ready.push_back(dependent);
+    }
+
+    if (topologicalOrder.size() != tasks.size())
+    {
+        for (const auto& task : tasks)
+        {
+            if (pending[(size_t) task.id] > 0)
+            {
+                error = "Dependency cycle through '" + task.name + "'";
+                break;
+            }
+        }
+        return false;
+    }
+
+    resolved = true;
+    return true;
+}
+
+int RenderGraph::getProducer(const juce::File& file) const
+{
+    auto producer = producers.find(getFileKey(file));
+    return producer != producers.end() ? producer->second : -1;
+}
+
+//==============================================================================
+std::vector<double> RenderGraph::getRanks() const
+{
+    jassert(resolved);
+    std::vector<double> ranks(tasks.size(), 0.0);
+
+    for (auto it = topologicalOrder.rbegin(); it != topologicalOrder.rend(); ++it)
+    {
+        const Task& task = tasks[(size_t) *it];
+        double longestAfter = 0.0;
+
+        for (int dependent : task.dependents)
+            longestAfter = juce::jmax(longestAfter, ranks[(size_t) dependent]);
+
+        ranks[(size_t) task.id] = task.estimatedSeconds + longestAfter;
+    }
+
+    return ranks;
+}
+
+std::vector<int> RenderGraph::getCriticalPath() const
+{
+    std::vector<int> path;
+    if (!resolved || tasks.empty())
+        return path;
+
+    const auto ranks = getRanks();
+
+    int current = -1;
+    for (const auto& task : tasks)
+        if (task.dependencies.empty() && (current < 0 || ranks[(size_t) task.id] > ranks[(size_t) current]))
+            current = task.id;
+
+    while (current >= 0)
+    {
+        path.push_back(current);
+
+        int next = -1;
+        for (int dependent : tasks[(size_t) current].dependents)
+            if (next < 0 || ranks[(size_t) dependent] > ranks[(size_t) next])
+                next = dependent;
+
+        current = next;
+    }
+
+    return path;
+}
+
+double RenderGraph::getTotalEstimatedSeconds() const
+{
+    double total = 0.0;
+    for (const auto& task : tasks)
+        total += task.estimatedSeconds;
+    return total;
+}
+
+juce::String RenderGraph::describe() const
+{
+    juce::String text;
+
+    if (!resolved)
+        return "Render graph has not been resolved\n";
+
+    const auto criticalPath = getCriticalPath();
+    double criticalSeconds = 0.0;
+    for (int taskId : criticalPath)
+        criticalSeconds += tasks[(size_t) taskId].estimatedSeconds;
+
+    int numEdges = 0;
+    for (const auto& task : tasks)
+        numEdges += (int) task.dependencies.size();
+
+    const double serialSeconds = getTotalEstimatedSeconds();
+
+    text << "Render graph: " << getNumTasks() << " tasks, " << numEdges << " dependencies\n";
+    text << "Estimated work: " << juce::String(serialSeconds, 1) << " s serial, "
+         << juce::String(criticalSeconds, 1) << " s critical path";
+    if (criticalSeconds > 0.0)
+        text << " (parallel speedup at most " << juce::String(serialSeconds / criticalSeconds, 2) << "x)";
+    text << "\n\n";
+
+    for (int taskId : topologicalOrder)
+    {
+        const Task& task = tasks[(size_t) taskId];
+
+        juce::StringArray dependencyIds;
+        for (int dependency : task.dependencies)
+            dependencyIds.add("#" + juce::String(dependency));
+
+        const bool critical = std::find(criticalPath.begin(), criticalPath.end(), taskId) != criticalPath.end();
+
+        text << (critical ? "* " : "  ")
+             << juce::String("#" + juce::String(taskId)).paddedRight(' ', 5)
+             << getTaskTypeName(task.type).paddedRight(' ', 12)
+             << task.name.paddedRight(' ', 44)
+             << juce::String(task.estimatedSeconds, 1).paddedLeft(' ', 8) << " s"
+             << "  <- " << (dependencyIds.isEmpty() ? juce::String("-") : dependencyIds.joinIntoString(" "))
+             << (task.state == TaskState::Restore ? "  [cached]" : task.state == TaskState::Skip ? "  [skipped]" : "")
+             << "\n";
+    }
+
+    text << "\nCritical path:\n";
+    for (int taskId : criticalPath)
+        text << "  " << getTaskTypeName(tasks[(size_t) taskId].type) << " " << tasks[(size_t) taskId].name
+             << " (" << juce::String(tasks[(size_t) taskId].estimatedSeconds, 1) << " s)\n";
+
+    return text;
+}
+
+juce::String RenderGraph::getTaskTypeName(TaskType type)
+{
+    switch (type)
+    {
+        case TaskType::Conform:    return "conform";
+        case TaskType::ExtractIn:  return "extract-in";
+        case TaskType::ExtractOut: return "extract-out";
+        case TaskType::Xfade:      return "xfade";
+        case TaskType::Body:       return "body";
+        case TaskType::Concat:     return "concat";
+        case TaskType::Trim:       return "trim";
+        case TaskType::Overlay:    return "overlay";
+        case TaskType::Encode:     return "encode";
+        case TaskType::Mux:        return "mux";
+    }
+
+    return {};
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <map>
+#include <vector>
+
+/**
+ * A render expressed as a DAG of typed tasks.
+ *
+ * Each task names the files it reads and writes; resolveDependencies() turns
+ * those into edges (a task depends on whichever task produces one of its
+ * inputs). Files nobody produces - source clips, the rendered audio - are
+ * treated as external inputs.
+ *
+ * Every task carries an estimated cost in seconds. The costs give each task a
+ * rank (the longest path from it to the end of the graph), which is used both
+ * for the critical path report and as the scheduling priority in
+ * RenderGraphScheduler.
+ */
+class RenderGraph
+{
+public:
+    enum class TaskType
+    {
+        Conform,        // source clip -> conformed clip
+        ExtractIn,      // first n seconds of a clip, for the crossfade into it
+        ExtractOut,     // last n seconds of a clip, for the crossfade out of it
+        Xfade,          // xfade of an out/in pair
+        Body,           // clip with its crossfade portions cut off
+        Concat,         // concat demuxer joins
+        Trim,           // cutting sequences to length or into variants
+        Overlay,        // overlay pass over the assembled sequence
+        Encode,         // delivery encode of one piece of the output
+        Mux             // final encode with audio
+    };
+
+    /** How a task takes part in the run. */
+    enum class TaskState
+    {
+        Run,            // produce the outputs
+        Restore,        // copy the outputs out of the IntermediateCache
+        Skip            // nothing downstream needs the outputs
+    };
+
+    struct Task
+    {
+        int id = -1;
+        TaskType type = TaskType::Conform;
+        juce::String name;
+        juce::Array<juce::File> inputs;
+        juce::Array<juce::File> outputs;
+        double estimatedSeconds = 0.0;
+        std::function<bool()> run;
+        juce::String recipe;            // everything besides the inputs that decides the outputs; empty = not cacheable
+        juce::int64 outputBytes = 0;    // predicted size of all outputs together, for DiskBudget
+        TaskState state = TaskState::Run;
+
+        std::vector<int> dependencies;  // filled in by resolveDependencies()
+        std::vector<int> dependents;
+    };
+
+    RenderGraph() = default;
+
+    /**
+     * Adds a task to the graph.
+     *
+     * @return The task's id
+     */
+    int addTask(TaskType type,
+                const juce::String& name,
+                const juce::Array<juce::File>& inputs,
+                const juce::Array<juce::File>& outputs,
+                double estimatedSeconds,
+                std::function<bool()> run);
+
+    /** Adds an ordering constraint that isn't expressed through files. */
+    void addDependency(int taskId, int dependsOnTaskId);
+
+    /** Describes the task's parameters for IntermediateCache keys. */
+    void setRecipe(int taskId, const juce::String& recipe);
+
+    /** Records how much disk space the task's outputs are expected to take. */
+    void setOutputBytes(int taskId, juce::int64 bytes);
+
+    /** Replaces how a task is run, e.g. with a cache restore, or skips it. */
+    void setTaskRunner(int taskId, TaskState state, double estimatedSeconds, std::function<bool()> run);
+
+    /**
+     * Builds the edges from the tasks' files and checks the result is a DAG.
+     *
+     * @param error Receives a description of the problem on failure
+     * @return      false if two tasks write the same file or there is a cycle
+     */
+    bool resolveDependencies(juce::String& error);
+
+    int getNumTasks() const { return (int) tasks.size(); }
+    const Task& getTask(int taskId) const { return tasks[(size_t) taskId]; }
+
+    /** Returns the task ids in dependency order; valid once resolved. */
+    const std::vector<int>& getTopologicalOrder() const { return topologicalOrder; }
+
+    /** Returns the id of the task that writes the file, or -1 for external inputs. */
+    int getProducer(const juce::File& file) const;
+
+    /** Returns each task's rank: its own cost plus the most expensive path after it. */
+    std::vector<double> getRanks() const;
+
+    /** Returns the task ids along the most expensive path through the graph. */
+    std::vector<int> getCriticalPath() const;
+
+    /** Returns the sum of all task costs, i.e. the estimated time to run it serially. */
+    double getTotalEstimatedSeconds() const;
+
+    /** Describes every task, its dependencies and the critical path, for dry runs. */
+    juce::String describe() const;
+
+    static juce::String getTaskTypeName(TaskType type);
+
+private:
+    std::vector<Task> tasks;
+    std::vector<std::pair<int, int>> extraDependencies;    // (task, depends on)
+    std::map<juce::String, int> producers;                 // output path -> task, valid once resolved
+    std::vector<int> topologicalOrder;                     // valid once resolved
+    bool resolved = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderGraph)
+};
@@ -0,0 +1,204 @@
+#include "RenderGraphScheduler.h"
+#include <algorithm>
+#include <thread>
+
+RenderGraphScheduler::RenderGraphScheduler(int workers)
+    : numWorkers(juce::jmax(1, workers))
+{
+    for (int i = 0; i < numWorkers; ++i)
+        queues.push_back(std::make_unique<WorkerQueue>());
+}
+
+RenderGraphScheduler::~RenderGraphScheduler() = default;
+
+//==============================================================================
+bool RenderGraphScheduler::run(const RenderGraph& graphToRun)
+{
+    graph = &graphToRun;
+    ranks = graph->getRanks();
+    pendingDependencies = std::make_unique<std::atomic<int>[]>((size_t) graph->getNumTasks());
+    tasksRemaining.store(graph->getNumTasks());
+    stopped.store(false);
+    failed.store(false);
+    completedSeconds = 0.0;
+    totalSeconds = graph->getTotalEstimatedSeconds();
+
+    for (auto& queue : queues)
+        queue->tasks.clear();
+
+    std::vector<int> sources;
+    for (int taskId = 0; taskId < graph->getNumTasks(); ++taskId)
+    {
+        const int dependencies = (int) graph->getTask(taskId).dependencies.size();
+        pendingDependencies[(size_t) taskId].store(dependencies);
+        if (dependencies == 0)
+            sources.push_back(taskId);
+    }
+
+    // Deal the initial tasks out highest rank first, so every worker starts on critical work
+    std::sort(sources.begin(), sources.end(), [this](int a, int b) { return ranks[(size_t) a] > ranks[(size_t) b]; });
+
+    std::vector<std::vector<int>> initial((size_t) numWorkers);
+    for (size_t i = 0; i < sources.size(); ++i)
+        initial[i % (size_t) numWorkers].push_back(sources[i]);
+
+    for (int worker = 0; worker < numWorkers; ++worker)
+        pushReady(worker, initial[(size_t) worker]);
+
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+
+    if (logCallback)
+        logCallback("Running render graph: " + juce::String(graph->getNumTasks()) + " tasks on "
+                    + juce::String(numWorkers) + " worker" + (numWorkers == 1 ? "" : "s"));
+
+    std::vector<std::thread> threads;
+    for (int worker = 0; worker < numWorkers; ++worker)
+        threads.emplace_back([this, worker] { workerLoop(worker); });
+
+    for (auto& thread : threads)
+        thread.join();
+
+    const bool succeeded = !stopped.load() && tasksRemaining.load() == 0;
+
+    if (logCallback)
+        logCallback("Render graph " + juce::String(succeeded ? "finished" : "stopped") + " after "
+                    + juce::String((juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0, 1) + " s");
+
+    graph = nullptr;
+    return succeeded;
+}
+
+//==============================================================================
+void RenderGraphScheduler::workerLoop(int worker)
+{
+    while (!stopped.load() && tasksRemaining.load() > 0)
+    {
+        int taskId = -1;
+
+        if (popLocal(worker, taskId) || steal(worker, taskId))
+        {
+            if (cancellationCheck && cancellationCheck())
+            {
+                stopped.store(true);
+                workAvailable.signal();
+                break;
+            }
+
+            runTask(worker, taskId);
+            continue;
+        }
+
+        // Nothing ready anywhere; a completing task signals when it readies more
+        workAvailable.wait(20);
+    }
+
+    // Pass the wake-up on so every worker notices the run is over
+    workAvailable.signal();
+}
+
+bool RenderGraphScheduler::popLocal(int worker, int& taskId)
+{
+    auto& queue = *queues[(size_t) worker];
+    const juce::ScopedLock sl(queue.lock);
+
+    if (queue.tasks.empty())
+        return false;
+
+    taskId = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool RenderGraphScheduler::steal(int worker, int& taskId)
+{
+    for (int offset = 1; offset < numWorkers; ++offset)
+    {
+        auto& queue = *queues[(size_t) ((worker + offset) % numWorkers)];
+        const juce::ScopedLock sl(queue.lock);
+
+        if (!queue.tasks.empty())
+        {
+            taskId = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RenderGraphScheduler::pushReady(int worker, std::vector<int> taskIds)
+{
+    if (taskIds.empty())
+        return;
+
+    // Lowest rank first, so the owner pops the highest-ranked task next
+    std::sort(taskIds.begin(), taskIds.end(), [this](int a, int b) { return ranks[(size_t) a] < ranks[(size_t) b]; });
+
+    {
+        auto& queue = *queues[(size_t) worker];
+        const juce::ScopedLock sl(queue.lock);
+        for (int taskId : taskIds)
+            queue.tasks.push_back(taskId);
+    }
+
+    workAvailable.signal();
+}
+
+void RenderGraphScheduler::runTask(int worker, int taskId)
+{
+    const RenderGraph::Task& task = graph->getTask(taskId);
+
+    bool succeeded = false;
+    try {
+        succeeded = task.state == RenderGraph::TaskState::Skip || (task.run != nullptr && task.run());
+    }
+    catch (const std::exception& e) {
+        if (logCallback)
+            logCallback("EXCEPTION: " + task.name + ": " + juce::String(e.what()));
+    }
+    catch (...) {
+        if (logCallback)
+            logCallback("EXCEPTION: Unknown error in " + task.name);
+    }
+
+    if (!succeeded)
+    {
+        stopped.store(true);
+
+        if (!failed.exchange(true))
+        {
+            if (logCallback && !(cancellationCheck && cancellationCheck()))
+                logCallback("ERROR: Render graph task failed: " + RenderGraph::getTaskTypeName(task.type) + " " + task.name);
+
+            if (failureCallback)
+                failureCallback();
+        }
+
+        workAvailable.signal();
+        return;
+    }
+
+    std::vector<int> nowReady;
+    for (int dependent : task.dependents)
+        if (pendingDependencies[(size_t) dependent].fetch_sub(1) == 1)
+            nowReady.push_back(dependent);
+
+    tasksRemaining.fetch_sub(1);
+    pushReady(worker, std::move(nowReady));
+
+    double fraction = 1.0;
+    {
+        const juce::ScopedLock sl(progressLock);
+        completedSeconds += task.estimatedSeconds;
+        if (totalSeconds > 0.0)
+            fraction = juce::jlimit(0.0, 1.0, completedSeconds / totalSeconds);
+    }
+
+    if (progressCallback)
+        progressCallback(fraction);
+
+    // The last task may have no dependents; make sure sleeping workers see the run is done
+    if (tasksRemaining.load() == 0)
+        workAvailable.signal();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RenderGraph.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Runs a resolved RenderGraph on a pool of worker threads.
+ *
+ * Each worker owns a deque of ready tasks. A worker pushes the tasks its
+ * completion made ready onto its own deque and pops from the back, so it
+ * carries on with the clip it just worked on (its inputs are still in the page
+ * cache). An idle worker steals from the front of another worker's deque.
+ * Ready tasks are queued in rank order, so whatever lies on the critical path
+ * is started first.
+ *
+ * The first failure (or a cancellation) stops new tasks from starting; tasks
+ * already running are left to finish or be killed by the failure callback.
+ */
+class RenderGraphScheduler
+{
+public:
+    explicit RenderGraphScheduler(int numWorkers);
+    ~RenderGraphScheduler();
+
+    void setLogCallback(std::function<void(const juce::String&)> callback) { logCallback = std::move(callback); }
+
+    /** Polled before each task starts; returning true stops the run. */
+    void setCancellationCheck(std::function<bool()> check) { cancellationCheck = std::move(check); }
+
+    /** Called with the fraction (0..1) of the estimated work that has completed. */
+    void setProgressCallback(std::function<void(double)> callback) { progressCallback = std::move(callback); }
+
+    /** Called once, on the worker thread, when the first task fails. */
+    void setFailureCallback(std::function<void()> callback) { failureCallback = std::move(callback); }
+
+    /**
+     * Runs every task in the graph, blocking until they have finished or the run
+     * has been stopped.
+     *
+     * @return true if every task succeeded
+     */
+    bool run(const RenderGraph& graph);
+
+    int getNumWorkers() const { return numWorkers; }
+
+private:
+    struct WorkerQueue
+    {
+        juce::CriticalSection lock;
+        std::deque<int> tasks;
+    };
+
+    void workerLoop(int worker);
+    bool popLocal(int worker, int& taskId);
+    bool steal(int worker, int& taskId);
+    void pushReady(int worker, std::vector<int> taskIds);
+    void runTask(int worker, int taskId);
+
+    const int numWorkers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    // Per-run state
+    const RenderGraph* graph = nullptr;
+    std::vector<double> ranks;
+    std::unique_ptr<std::atomic<int>[]> pendingDependencies;
+    std::atomic<int> tasksRemaining { 0 };
+    std::atomic<bool> stopped { false };
+    std::atomic<bool> failed { false };
+    juce::WaitableEvent workAvailable;
+
+    juce::CriticalSection progressLock;
+    double completedSeconds = 0.0;
+    double totalSeconds = 0.0;
+
+    std::function<void(const juce::String&)> logCallback;
+    std::function<bool()> cancellationCheck;
+    std::function<void(double)> progressCallback;
+    std::function<void()> failureCallback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderGraphScheduler)
+};
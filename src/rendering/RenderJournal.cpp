@@ -0,0 +1,224 @@
+#include "RenderJournal.h"
+#include "IntermediateCache.h"
+
+namespace
+{
+    // Bump when the journal layout changes so old journals are ignored
+    constexpr int journalVersion = 1;
+}
+
+RenderJournal::RenderJournal(const juce::File& workingDirectory)
+    : journalFile(workingDirectory.getChildFile(fileName))
+{
+}
+
+bool RenderJournal::load()
+{
+    if (!journalFile.existsAsFile())
+        return false;
+
+    const juce::var json = juce::JSON::parse(journalFile.loadFileAsString());
+    if (!json.isObject() || (int) json.getProperty("version", 0) != journalVersion)
+        return false;
+
+    const juce::ScopedLock sl(lock);
+    renderKey = json.getProperty("renderKey", juce::String()).toString();
+    settings = json.getProperty("settings", juce::var());
+    finished = (bool) json.getProperty("finished", false);
+    steps.clear();
+
+    if (auto* entries = json.getProperty("steps", juce::var()).getArray())
+    {
+        for (const auto& entry : *entries)
+        {
+            Step step;
+            step.recipe = entry.getProperty("recipe", juce::String()).toString();
+            step.outputs = entry.getProperty("outputs", juce::var());
+            steps[entry.getProperty("name", juce::String()).toString()] = step;
+        }
+    }
+
+    return renderKey.isNotEmpty();
+}
+
+void RenderJournal::begin(const juce::String& key, const juce::var& renderSettings)
+{
+    {
+        const juce::ScopedLock sl(lock);
+        renderKey = key;
+        settings = renderSettings;
+        finished = false;
+        steps.clear();
+    }
+
+    save();
+}
+
+juce::String RenderJournal::getRenderKey() const
+{
+    const juce::ScopedLock sl(lock);
+    return renderKey;
+}
+
+juce::var RenderJournal::getSettings() const
+{
+    const juce::ScopedLock sl(lock);
+    return settings;
+}
+
+int RenderJournal::getNumSteps() const
+{
+    const juce::ScopedLock sl(lock);
+    return (int) steps.size();
+}
+
+bool RenderJournal::isFinished() const
+{
+    const juce::ScopedLock sl(lock);
+    return finished;
+}
+
+//==============================================================================
+void RenderJournal::recordStep(const juce::String& name, const juce::String& recipe, const juce::Array<juce::File>& outputs)
+{
+    // Hash outside the lock; render graph workers finish steps concurrently
+    const juce::File directory = getWorkingDirectory();
+    juce::Array<juce::var> entries;
+    for (const auto& output : outputs)
+    {
+        if (!output.existsAsFile())
+            continue;
+
+        auto* entry = new juce::DynamicObject();
+        juce::var entryVar(entry);
+        // Relative inside the working directory, which may be moved; the delivered file is absolute
+        entry->setProperty("file", output.isAChildOf(directory) ? output.getRelativePathFrom(directory)
+                                                                 : output.getFullPathName());
+        entry->setProperty("size", output.getSize());
+        entry->setProperty("hash", IntermediateCache::hashFileContent(output));
+        entries.add(entryVar);
+    }
+
+    {
+        const juce::ScopedLock sl(lock);
+        Step step;
+        step.recipe = recipe;
+        step.outputs = entries;
+        step.verified = true;
+        steps[name] = step;
+    }
+
+    save();
+}
+
+bool RenderJournal::isStepValid(const juce::String& name, const juce::String& recipe)
+{
+    juce::var outputs;
+    {
+        const juce::ScopedLock sl(lock);
+        auto step = steps.find(name);
+        if (step == steps.end() || step->second.recipe != recipe)
+            return false;
+
+        if (step->second.verified)
+            return true;
+
+        outputs = step->second.outputs;
+    }
+
+    const juce::File directory = getWorkingDirectory();
+    if (auto* entries = outputs.getArray())
+    {
+        for (const auto& entry : *entries)
+        {
+            const juce::File file = directory.getChildFile(entry.getProperty("file", juce::String()).toString());
+
+            if (!file.existsAsFile()
+                || file.getSize() != (juce::int64) entry.getProperty("size", -1)
+                || IntermediateCache::hashFileContent(file) != entry.getProperty("hash", juce::String()).toString())
+            {
+                if (logCallback)
+                    logCallback("Journal: " + name + " must be redone, " + file.getFileName() + " is missing or changed");
+                return false;
+            }
+        }
+    }
+
+    const juce::ScopedLock sl(lock);
+    steps[name].verified = true;
+    return true;
+}
+
+void RenderJournal::markFinished()
+{
+    {
+        const juce::ScopedLock sl(lock);
+        finished = true;
+    }
+
+    save();
+}
+
+//==============================================================================
+void RenderJournal::save() const
+{
+    auto* root = new juce::DynamicObject();
+    juce::var rootVar(root);
+
+    {
+        const juce::ScopedLock sl(lock);
+        root->setProperty("version", journalVersion);
+        root->setProperty("renderKey", renderKey);
+        root->setProperty("settings", settings);
+        root->setProperty("finished", finished);
+        root->setProperty("updatedAt", juce::Time::getCurrentTime().toMilliseconds());
+
+        juce::Array<juce::var> entries;
+        for (const auto& [name, step] : steps)
+        {
+            auto* entry = new juce::DynamicObject();
+            juce::var entryVar(entry);
+            entry->setProperty("name", name);
+            entry->setProperty("recipe", step.recipe);
+            entry->setProperty("outputs", step.outputs);
+            entries.add(entryVar);
+        }
+        root->setProperty("steps", entries);
+
+        // Written aside and moved over, so a crash mid-write keeps the last checkpoint
+        const juce::File partial = journalFile.getSiblingFile(journalFile.getFileName() + ".partial");
+        if (partial.replaceWithText(juce::JSON::toString(rootVar)))
+            partial.moveFileTo(journalFile);
+    }
+}
+
+juce::File RenderJournal::findResumable(const juce::File& baseDirectory, const juce::String& key)
+{
+    juce::File best;
+    juce::int64 bestTime = 0;
+
+    for (const auto& directory : baseDirectory.findChildFiles(juce::File::findDirectories, false))
+    {
+        const juce::File file = directory.getChildFile(fileName);
+        if (!file.existsAsFile())
+            continue;
+
+        const juce::var json = juce::JSON::parse(file.loadFileAsString());
+        if (!json.isObject()
+            || (int) json.getProperty("version", 0) != journalVersion
+            || (bool) json.getProperty("finished", false))
+            continue;
+
+        if (key.isNotEmpty() && json.getProperty("renderKey", juce::String()).toString() != key)
+            continue;
+
+        const juce::int64 updatedAt = (juce::int64) json.getProperty("updatedAt", 0);
+        if (best == juce::File() || updatedAt > bestTime)
+        {
+            best = directory;
+            bestTime = updatedAt;
+        }
+    }
+
+    return best;
+}
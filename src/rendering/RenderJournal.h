@@ -0,0 +1,78 @@
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <map>
+
+/**
+ * Checkpoint record of one render, kept in its working directory.
+ *
+ * The journal holds the render's key and settings, then one entry per
+ * completed step (the audio track, each render graph task) with its recipe and
+ * the size and content hash of every file it wrote. It is rewritten after each
+ * step through a temporary file, so a crash leaves the previous version intact.
+ *
+ * When the same render is started again, or resumed from the command line,
+ * the working directory is reused and a step counts as done only if its
+ * recipe matches and its files still hash the same.
+ */
+class RenderJournal
+{
+public:
+    static constexpr const char* fileName = "render_journal.json";
+
+    explicit RenderJournal(const juce::File& workingDirectory);
+
+    void setLogCallback(std::function<void(const juce::String&)> callback) { logCallback = std::move(callback); }
+
+    const juce::File& getFile() const { return journalFile; }
+    juce::File getWorkingDirectory() const { return journalFile.getParentDirectory(); }
+
+    /** Reads the journal on disk; false if there is none or it can't be parsed. */
+    bool load();
+
+    /** Starts a fresh journal for a render, forgetting any recorded steps. */
+    void begin(const juce::String& renderKey, const juce::var& settings);
+
+    juce::String getRenderKey() const;
+    juce::var getSettings() const;
+    int getNumSteps() const;
+    bool isFinished() const;
+
+    /** Hashes the step's outputs and records it as done. */
+    void recordStep(const juce::String& step, const juce::String& recipe, const juce::Array<juce::File>& outputs);
+
+    /** True if the step was recorded with this recipe and all its outputs are unchanged. */
+    bool isStepValid(const juce::String& step, const juce::String& recipe = {});
+
+    /** Marks the render as delivered, so its directory is no longer resumable. */
+    void markFinished();
+
+    /**
+     * Looks through the working directories under baseDirectory for an
+     * unfinished journal with the given key, or the most recent unfinished one
+     * if the key is empty. Returns the directory, or an invalid File.
+     */
+    static juce::File findResumable(const juce::File& baseDirectory, const juce::String& renderKey);
+
+private:
+    struct Step
+    {
+        juce::String recipe;
+        juce::var outputs;      // array of { file, size, hash }
+        bool verified = false;  // outputs checked against disk since load()
+    };
+
+    void save() const;
+
+    juce::File journalFile;
+
+    mutable juce::CriticalSection lock;
+    juce::String renderKey;
+    juce::var settings;
+    bool finished = false;
+    std::map<juce::String, Step> steps;
+
+    std::function<void(const juce::String&)> logCallback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderJournal)
+};
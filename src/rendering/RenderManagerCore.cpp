@@ -1,4 +1,6 @@
 #include "RenderManagerCore.h"
+#include "EncoderCapabilities.h"
+#include "KeyframeIndex.h"
 
 namespace
 {
@@ -35,6 +37,151 @@ namespace
         return fallback;
     }
     
+    juce::File getTempBaseDirectory()
+    {
+        // In the build folder instead of AppData/Local/Temp
+        juce::File projectRoot = juce::File::getSpecialLocation(juce::File::currentApplicationFile)
+                                   .getParentDirectory(); // this should be the build dir
+        return projectRoot.getChildFile("AmbientRender_Debug");
+    }
+    
+    juce::var videoClipsToVar(const std::vector<RenderTypes::VideoClipInfo>& clips)
+    {
+        juce::Array<juce::var> result;
+        for (const auto& clip : clips)
+        {
+            auto* object = new juce::DynamicObject();
+            juce::var objectVar(object);
+            object->setProperty("file", clip.file.getFullPathName());
+            object->setProperty("startTime", clip.startTime);
+            object->setProperty("duration", clip.duration);
+            object->setProperty("crossfade", clip.crossfade);
+            object->setProperty("isIntroClip", clip.isIntroClip);
+            result.add(objectVar);
+        }
+        return result;
+    }
+    
+    std::vector<RenderTypes::VideoClipInfo> videoClipsFromVar(const juce::var& value)
+    {
+        std::vector<RenderTypes::VideoClipInfo> clips;
+        if (auto* entries = value.getArray())
+        {
+            for (const auto& entry : *entries)
+            {
+                RenderTypes::VideoClipInfo clip;
+                clip.file = juce::File(entry.getProperty("file", juce::String()).toString());
+                clip.startTime = (double) entry.getProperty("startTime", 0.0);
+                clip.duration = (double) entry.getProperty("duration", 0.0);
+                clip.crossfade = (double) entry.getProperty("crossfade", 0.0);
+                clip.isIntroClip = (bool) entry.getProperty("isIntroClip", false);
+                clips.push_back(clip);
+            }
+        }
+        return clips;
+    }
+    
+    juce::var overlayClipsToVar(const std::vector<RenderTypes::OverlayClipInfo>& clips)
+    {
+        juce::Array<juce::var> result;
+        for (const auto& clip : clips)
+        {
+            auto* object = new juce::DynamicObject();
+            juce::var objectVar(object);
+            object->setProperty("file", clip.file.getFullPathName());
+            object->setProperty("duration", clip.duration);
+            object->setProperty("frequencySecs", clip.frequencySecs);
+            object->setProperty("startTimeSecs", clip.startTimeSecs);
+            object->setProperty("jitterSecs", clip.jitterSecs);
+            object->setProperty("jitterSeed", clip.jitterSeed);
+            object->setProperty("weight", clip.weight);
+            object->setProperty("maxConcurrent", clip.maxConcurrent);
+
+            juce::Array<juce::var> windows;
+            for (const auto& window : clip.activeWindows)
+                windows.add(juce::Array<juce::var> { window.getStart(), window.getEnd() });
+            object->setProperty("activeWindows", windows);
+
+            juce::Array<juce::var> variants;
+            for (const auto& variant : clip.variants)
+            {
+                auto* variantObject = new juce::DynamicObject();
+                juce::var variantVar(variantObject);
+                variantObject->setProperty("file", variant.file.getFullPathName());
+                variantObject->setProperty("weight", variant.weight);
+                variants.add(variantVar);
+            }
+            object->setProperty("variants", variants);
+            result.add(objectVar);
+        }
+        return result;
+    }
+    
+    std::vector<RenderTypes::OverlayClipInfo> overlayClipsFromVar(const juce::var& value)
+    {
+        std::vector<RenderTypes::OverlayClipInfo> clips;
+        if (auto* entries = value.getArray())
+        {
+            for (const auto& entry : *entries)
+            {
+                RenderTypes::OverlayClipInfo clip;
+                clip.file = juce::File(entry.getProperty("file", juce::String()).toString());
+                clip.duration = (double) entry.getProperty("duration", 0.0);
+                clip.frequencySecs = (double) entry.getProperty("frequencySecs", 0.0);
+                clip.startTimeSecs = (double) entry.getProperty("startTimeSecs", 0.0);
+                clip.jitterSecs = (double) entry.getProperty("jitterSecs", 0.0);
+                clip.jitterSeed = (juce::int64) entry.getProperty("jitterSeed", 0);
+                clip.weight = (double) entry.getProperty("weight", 1.0);
+                clip.maxConcurrent = (int) entry.getProperty("maxConcurrent", 0);
+
+                if (auto* windows = entry.getProperty("activeWindows", juce::var()).getArray())
+                    for (const auto& window : *windows)
+                        if (window.size() == 2)
+                            clip.activeWindows.emplace_back((double) window[0], (double) window[1]);
+
+                if (auto* variants = entry.getProperty("variants", juce::var()).getArray())
+                {
+                    for (const auto& variant : *variants)
+                    {
+                        RenderTypes::OverlayVariant entryVariant;
+                        entryVariant.file = juce::File(variant.getProperty("file", juce::String()).toString());
+                        entryVariant.weight = (double) variant.getProperty("weight", 1.0);
+                        clip.variants.push_back(entryVariant);
+                    }
+                }
+                clips.push_back(clip);
+            }
+        }
+        return clips;
+    }
+    
+    // The settings plus the size and modification time of every source; a render
+    // can only be resumed by one with the same key. Whether audio sources were
+    // attached is left out, so a headless resume matches the render it continues.
+    juce::String computeRenderKey(const juce::var& settings)
+    {
+        juce::StringArray parts;
+        if (auto* object = settings.getDynamicObject())
+            for (const auto& property : object->getProperties())
+                if (property.name.toString() != "hasAudio")
+                    parts.add(property.name.toString() + "=" + juce::JSON::toString(property.value, true));
+        
+        for (const juce::String list : { "introClips", "loopClips", "overlayClips" })
+        {
+            if (auto* entries = settings.getProperty(list, juce::var()).getArray())
+            {
+                for (const auto& entry : *entries)
+                {
+                    const juce::File source(entry.getProperty("file", juce::String()).toString());
+                    parts.add(juce::String(source.getSize()) + ":"
+                              + juce::String(source.getLastModificationTime().toMilliseconds()));
+                }
+            }
+        }
+        
+        return juce::SHA256(parts.joinIntoString("\n").toUTF8()).toHexString();
+    }
+    
     juce::File createTimestampedDirectory(const juce::String& prefix)
     {
         juce::File logsRoot = ensureLogsRoot();
@@ -114,9 +261,13 @@ RenderManagerCore::RenderManagerCore(BinauralAudioSource* binauralSource, FilePl
       noiseSource(noiseSource),
       state(RenderState::Idle),
       progress(0.0),
-      shouldCancel(false),
       useNvidiaAcceleration(false),
-      audioOnly(false)
+      audioOnly(false),
+      dryRun(juce::SystemStats::getEnvironmentVariable("FFLUCE_DRY_RUN", "0") != "0"),
+      renderEngine(juce::SystemStats::getEnvironmentVariable("FFLUCE_RENDER_ENGINE", {}).equalsIgnoreCase("filtergraph")
+                       ? RenderTypes::RenderEngine::FilterGraph
+                       : RenderTypes::RenderEngine::FileBased),
+      resumeEnabled(juce::SystemStats::getEnvironmentVariable("FFLUCE_RESUME", "1") != "0")
 {
     // Create component instances
     ffmpegExecutor = std::make_unique<FFmpegExecutor>();
@@ -124,6 +275,13 @@ RenderManagerCore::RenderManagerCore(BinauralAudioSource* binauralSource, FilePl
     overlayProcessor = std::make_unique<OverlayProcessor>(ffmpegExecutor.get());
     timelineAssembler = std::make_unique<TimelineAssembler>(ffmpegExecutor.get(), overlayProcessor.get());
     audioRenderer = std::make_unique<AudioRenderer>(binauralSource, filePlayer, noiseSource);
+    
+    intermediateCache = std::make_unique<IntermediateCache>();
+    timelineAssembler->setIntermediateCache(intermediateCache.get());
+    overlayProcessor->setIntermediateCache(intermediateCache.get());
+    
+    costModel = std::make_unique<RenderCostModel>();
+    timelineAssembler->setCostModel(costModel.get());
 }
 
 RenderManagerCore::~RenderManagerCore()
@@ -248,8 +406,27 @@ bool RenderManagerCore::startRendering(
     while (isThreadRunning())
         juce::Thread::sleep(100);
     
+    // Everything the output depends on, kept in the journal so the render can be resumed
+    auto* settingsObject = new juce::DynamicObject();
+    juce::var renderSettings(settingsObject);
+    settingsObject->setProperty("outputFile", outputFile.getFullPathName());
+    settingsObject->setProperty("introClips", videoClipsToVar(introClips));
+    settingsObject->setProperty("loopClips", videoClipsToVar(loopClips));
+    settingsObject->setProperty("overlayClips", overlayClipsToVar(overlayClips));
+    settingsObject->setProperty("totalDuration", totalDuration);
+    settingsObject->setProperty("fadeInDuration", fadeInDuration);
+    settingsObject->setProperty("fadeOutDuration", fadeOutDuration);
+    settingsObject->setProperty("useNvidiaAcceleration", useNvidiaAcceleration);
+    settingsObject->setProperty("audioOnly", audioOnly);
+    settingsObject->setProperty("hasAudio", binauralSource != nullptr || filePlayer != nullptr);
+    settingsObject->setProperty("tempNvidiaParams", tempNvidiaParams);
+    settingsObject->setProperty("tempCpuParams", tempCpuParams);
+    settingsObject->setProperty("finalNvidiaParams", finalNvidiaParams);
+    settingsObject->setProperty("finalCpuParams", finalCpuParams);
+    const juce::String renderKey = computeRenderKey(renderSettings);
+    
     // Create working directories
-    if (!createWorkingDirectories())
+    if (!createWorkingDirectories(renderKey))
     {
         juce::String errorMessage = "Failed to create working directories";
         // DISABLED UI TEXT: if (statusCallback) statusCallback(errorMessage);
@@ -271,13 +448,12 @@ bool RenderManagerCore::startRendering(
         const juce::String timestamp = juce::Time::getCurrentTime().toString(true, false);
         const juce::String stampedMessage = timestamp + ": " + message;
         
+        // Render graph workers log concurrently, so both files are written under the lock
+        juce::ScopedLock lock(logWriteLock);
+        if (renderSessionLogStream && renderSessionLogStream->openedOk())
         {
-            juce::ScopedLock lock(logWriteLock);
-            if (renderSessionLogStream && renderSessionLogStream->openedOk())
-            {
-                renderSessionLogStream->writeText(stampedMessage + "\n", false, false, nullptr);
-                renderSessionLogStream->flush();
-            }
+            renderSessionLogStream->writeText(stampedMessage + "\n", false, false, nullptr);
+            renderSessionLogStream->flush();
         }
         
         // Also mirror into temp directory log for legacy workflows
@@ -302,6 +478,8 @@ bool RenderManagerCore::startRendering(
     logFunction("Overlay clips: " + juce::String(overlayClips.size()));
     logFunction("Using NVIDIA acceleration: " + juce::String(useNvidiaAcceleration ? "yes" : "no"));
     logFunction("Audio only: " + juce::String(audioOnly ? "yes" : "no"));
+    logFunction("Dry run: " + juce::String(dryRun ? "yes" : "no"));
+    logFunction("Render engine: " + juce::String(renderEngine == RenderTypes::RenderEngine::FilterGraph ? "filtergraph" : "file-based"));
     
     // Set null log callbacks for all components except progress tracking
     ffmpegExecutor->setLogCallback(logFunction); // Set to our safe function
@@ -309,6 +487,34 @@ bool RenderManagerCore::startRendering(
     timelineAssembler->setLogCallback(logFunction);  // Set to our safe function
     overlayProcessor->setLogCallback(logFunction);  // Set to our safe function
     audioRenderer->setLogCallback(logFunction);  // Set to our safe function
+    intermediateCache->setLogCallback(logFunction);
+    
+    if (intermediateCache->isEnabled())
+        logFunction("Intermediate cache: " + intermediateCache->getDirectory().getFullPathName() + " ("
+                    + juce::File::descriptionOfSizeInBytes(intermediateCache->getTotalSize()) + " of "
+                    + juce::File::descriptionOfSizeInBytes(intermediateCache->getSizeBudget()) + ")");
+    else
+        logFunction("Intermediate cache: disabled");
+    
+    // The sessions before this one are the training data for its estimates
+    costModel->fit(ensureLogsRoot());
+    logFunction(costModel->describe());
+    
+    renderJournal = std::make_unique<RenderJournal>(tempDirectory);
+    renderJournal->setLogCallback(logFunction);
+    
+    if (resumingRender && renderJournal->load() && renderJournal->getRenderKey() == renderKey)
+    {
+        logFunction("Resuming interrupted render in " + tempDirectory.getFullPathName() + " ("
+                    + juce::String(renderJournal->getNumSteps()) + " steps journaled)");
+    }
+    else
+    {
+        if (resumingRender)
+            logFunction("WARNING: Settings or sources changed since the interrupted render; starting over");
+        resumingRender = false;
+        renderJournal->begin(renderKey, renderSettings);
+    }
     
     // Store parameters
     this->outputFile = outputFile;
@@ -333,6 +539,19 @@ bool RenderManagerCore::startRendering(
     for (auto& c : this->introClips) sanitizeClip(c);
     for (auto& c : this->loopClips)  sanitizeClip(c);
 
+    // The startup capability probe only decides whether NVENC works, so a broken NVENC
+    // isn't tried per clip and retried on the CPU after each failure. Its short 720p test
+    // encode says nothing about speed at the final settings, so a working NVENC is kept.
+    if (!audioOnly && useNvidiaAcceleration)
+    {
+        const auto capabilities = EncoderCapabilities::getInstance().getReport(ffmpegExecutor->getFFmpegPath());
+        if (!capabilities.isWorking("h264_nvenc"))
+        {
+            logFunction("WARNING: NVENC requested but the capability probe found it not working; using libx264");
+            useNvidiaAcceleration = false;
+        }
+    }
+
     this->useNvidiaAcceleration = useNvidiaAcceleration;
     this->audioOnly = audioOnly;
     this->tempNvidiaParams = tempNvidiaParams;
@@ -347,14 +566,23 @@ bool RenderManagerCore::startRendering(
                                        tempCpuParams,
                                        finalNvidiaParams,
                                        finalCpuParams);
+    timelineAssembler->setDryRun(dryRun);
+    timelineAssembler->setRenderEngine(renderEngine);
+    timelineAssembler->setRenderJournal(dryRun ? nullptr : renderJournal.get());
                                        
     // Log that we're using the new video assembly algorithm
     if (logFunction)
         logFunction("Using the new video assembly algorithm from video_assembly_explained.md");
     
-    // Reset progress and state
+    // Reset progress and state; every component gets the new render's token
     progress = 0.0;
-    shouldCancel = false;
+    cancellationToken = CancellationToken::create();
+    ffmpegExecutor->setCancellationToken(cancellationToken);
+    audioRenderer->setCancellationToken(cancellationToken);
+
+    // GPU/thread downgrades learned during the last render shouldn't carry over
+    ffmpegExecutor->getFallbackPolicy().reset();
+
     renderStartTime = juce::Time::getCurrentTime();
     
     // Update state
@@ -369,12 +597,73 @@ bool RenderManagerCore::startRendering(
     return true;
 }
 
+bool RenderManagerCore::resumeRendering(const juce::File& target,
+                                        std::function<void(const juce::String&)> statusCallback,
+                                        std::function<void(double)> progressCallback)
+{
+    juce::File directory = target.getFileName() == RenderJournal::fileName ? target.getParentDirectory() : target;
+    if (directory == juce::File())
+        directory = RenderJournal::findResumable(getTempBaseDirectory(), {});
+    
+    RenderJournal journal(directory);
+    if (directory == juce::File() || !journal.load())
+    {
+        juce::Logger::writeToLog("RENDER ERROR: No interrupted render to resume"
+                                 + (directory == juce::File() ? juce::String() : " in " + directory.getFullPathName()));
+        return false;
+    }
+    
+    if (journal.isFinished())
+    {
+        juce::Logger::writeToLog("RENDER ERROR: The render in " + directory.getFullPathName() + " already finished");
+        return false;
+    }
+    
+    const juce::var settings = journal.getSettings();
+    
+    if (computeRenderKey(settings) != journal.getRenderKey())
+    {
+        juce::Logger::writeToLog("RENDER ERROR: Source clips changed since the render in " + directory.getFullPathName()
+                                 + " was interrupted; it can't be resumed");
+        return false;
+    }
+    
+    // Audio comes from the live sources, which a headless resume doesn't have
+    if ((bool) settings.getProperty("hasAudio", false) && binauralSource == nullptr && filePlayer == nullptr
+        && !journal.isStepValid("audio"))
+    {
+        juce::Logger::writeToLog("RENDER ERROR: The interrupted render has no finished audio track to resume with");
+        return false;
+    }
+    
+    resumeDirectory = directory;
+    const bool started = startRendering(juce::File(settings.getProperty("outputFile", juce::String()).toString()),
+                                        videoClipsFromVar(settings.getProperty("introClips", juce::var())),
+                                        videoClipsFromVar(settings.getProperty("loopClips", juce::var())),
+                                        overlayClipsFromVar(settings.getProperty("overlayClips", juce::var())),
+                                        (double) settings.getProperty("totalDuration", 0.0),
+                                        (double) settings.getProperty("fadeInDuration", 0.0),
+                                        (double) settings.getProperty("fadeOutDuration", 0.0),
+                                        statusCallback,
+                                        progressCallback,
+                                        (bool) settings.getProperty("useNvidiaAcceleration", false),
+                                        (bool) settings.getProperty("audioOnly", false),
+                                        settings.getProperty("tempNvidiaParams", juce::String()).toString(),
+                                        settings.getProperty("tempCpuParams", juce::String()).toString(),
+                                        settings.getProperty("finalNvidiaParams", juce::String()).toString(),
+                                        settings.getProperty("finalCpuParams", juce::String()).toString());
+    resumeDirectory = juce::File();
+    return started;
+}
+
 void RenderManagerCore::cancelRendering()
 {
-    // Set cancellation flag
-    shouldCancel = true;
+    // Cancelling the token kills the running FFmpeg process group and stops
+    // every loop in the pipeline at its next check
+    if (cancellationToken != nullptr)
+        cancellationToken->cancel();
     
-    // Cancel any FFmpeg processes
+    // Also covers a command started outside a render
     ffmpegExecutor->cancelCurrentCommand();
     
     // Stop timer
@@ -385,6 +674,33 @@ void RenderManagerCore::cancelRendering()
 }
 
 void RenderManagerCore::run()
+{
+    runRenderPipeline();
+    KeyframeIndex::clearCache();
+    
+    // Every FFmpeg process is reaped by the time the pipeline returns, so this is cancel-to-idle
+    if (isCancelled() && logFunction)
+    {
+        const double latencyMs = cancellationToken->getMillisecondsSinceCancel();
+        logFunction((latencyMs > CancellationToken::idleLatencyBudgetMs ? "WARNING: " : "")
+                    + juce::String("Cancel-to-idle latency: ") + juce::String(latencyMs, 0) + " ms"
+                    + " (budget " + juce::String(CancellationToken::idleLatencyBudgetMs, 0) + " ms)");
+    }
+    
+    writeTimingReport();
+}
+
+void RenderManagerCore::writeTimingReport()
+{
+    if (!ffmpegExecutor || !renderSessionDirectory.isDirectory())
+        return;
+    
+    juce::File reportFile = renderSessionDirectory.getChildFile("timing_report.txt");
+    if (ffmpegExecutor->getTelemetry().writeTimingReport(reportFile) && logFunction)
+        logFunction("Timing report written to: " + reportFile.getFullPathName());
+}
+
+void RenderManagerCore::runRenderPipeline()
 {
     // Main render thread execution
     bool success = false;
@@ -393,6 +709,28 @@ void RenderManagerCore::run()
     juce::File audioFile;
     std::vector<juce::File> tempVideoFiles;
     
+    // A dry run only plans the timeline, so skip straight to the assembler
+    if (dryRun && !audioOnly)
+    {
+        updateState(RenderState::AssemblingTimeline, "Planning render (dry run)...");
+        
+        success = timelineAssembler->assembleTimeline(introClips,
+                                                     loopClips,
+                                                     overlayClips,
+                                                     tempDirectory.getChildFile("audio.wav"),
+                                                     totalDuration,
+                                                     tempDirectory,
+                                                     outputFile,
+                                                     fadeInDuration,
+                                                     fadeOutDuration);
+        
+        if (success)
+            updateState(RenderState::Completed, "Dry run completed: render plan written to render_graph.txt");
+        else
+            updateState(RenderState::Failed, "Failed to plan render");
+        return;
+    }
+    
     try
     {
         // Step 1: Render Audio Track
@@ -433,6 +771,9 @@ void RenderManagerCore::run()
             
             if (!success)
             {
+                if (isCancelled())
+                    return;
+                
                 if (logFunction)
                     logFunction("Failed to render audio track");
                 updateState(RenderState::Failed, "Failed to render audio track");
@@ -442,6 +783,17 @@ void RenderManagerCore::run()
             if (logFunction)
                 logFunction("Audio track rendered successfully: " + audioFile.getFullPathName() + 
                            " (" + juce::String(audioFile.getSize() / 1024 / 1024) + " MB)");
+            
+            renderJournal->recordStep("audio", {}, { audioFile });
+        }
+        else if (resumingRender && renderJournal->isStepValid("audio"))
+        {
+            // A headless resume has no audio sources; the interrupted render left the track behind
+            audioFile = tempDirectory.getChildFile("audio.wav");
+            success = true;
+            
+            if (logFunction)
+                logFunction("Reusing the audio track of the interrupted render: " + audioFile.getFullPathName());
         }
         else
         {
@@ -473,11 +825,13 @@ void RenderManagerCore::run()
                         " -vn -c:a " + (outputExtension == ".mp3" ? "libmp3lame -q:a 2" : "aac -b:a 320k") +
                         " \"" + outputFile.getFullPathName() + "\"";
                     
+                    ffmpegExecutor->setTelemetryStage("audio_export");
                     success = ffmpegExecutor->executeCommand(audioCommand, 0.8, 1.0);
                 }
                 
                 if (success)
                 {
+                    renderJournal->markFinished();
                     if (logFunction)
                         logFunction("Audio-only output created successfully: " + outputFile.getFullPathName());
                     updateState(RenderState::Completed, "Audio-only rendering completed in " + getElapsedTimeString());
@@ -500,7 +854,8 @@ void RenderManagerCore::run()
         }
         
         // Step 2: Process Video Clips
-        if (!shouldCancel)
+        // Its outputs only feed step 3's checks; a resumed render goes straight to the timeline
+        if (!isCancelled() && !resumingRender)
         {
             updateState(RenderState::ProcessingClips, "Processing video clips...");
             
@@ -512,7 +867,7 @@ void RenderManagerCore::run()
                 
                 for (size_t i = 0; i < introClips.size(); i++)
                 {
-                    if (shouldCancel) break;
+                    if (isCancelled()) break;
                     
                     const auto& clip = introClips[i];
                     juce::File outputFile = tempDirectory.getChildFile("intro_clip_" + juce::String(i) + ".mp4");
@@ -550,7 +905,7 @@ void RenderManagerCore::run()
                 
                 for (size_t i = 0; i < loopClips.size(); i++)
                 {
-                    if (shouldCancel) break;
+                    if (isCancelled()) break;
                     
                     const auto& clip = loopClips[i];
                     juce::File outputFile = tempDirectory.getChildFile("loop_clip_" + juce::String(i) + ".mp4");
@@ -588,13 +943,13 @@ void RenderManagerCore::run()
     }
     
     // Step 3: Render Crossfades
-    if (success && !shouldCancel) {
+    if (success && !isCancelled()) {
         updateState(RenderState::RenderingCrossfades, "Rendering crossfades between clips...");
         
         if (!audioOnly && tempVideoFiles.size() > 0) {
             if (introClips.size() > 0) {
                 for (size_t i = 0; i < introClips.size() - 1; i++) {
-                    if (shouldCancel) break;
+                    if (isCancelled()) break;
                     
                     // Safety check for index
                     if (i >= tempVideoFiles.size() || i + 1 >= tempVideoFiles.size()) {
@@ -618,7 +973,7 @@ void RenderManagerCore::run()
             
             if (loopClips.size() > 0) {
                 for (size_t i = 0; i < loopClips.size() - 1; i++) {
-                    if (shouldCancel) break;
+                    if (isCancelled()) break;
 
                     size_t fromIndex = introClips.size() + i;
                     size_t toIndex = introClips.size() + i + 1;
@@ -635,7 +990,7 @@ void RenderManagerCore::run()
                 }
 
                 // Create loop_from_loop_sequence_x crossfade (last loop to first loop)
-                if (loopClips.size() > 0 && !shouldCancel) {
+                if (loopClips.size() > 0 && !isCancelled()) {
                     size_t lastLoopIndex = introClips.size() + loopClips.size() - 1;
                     size_t firstLoopIndex = introClips.size();
 
@@ -687,7 +1042,7 @@ void RenderManagerCore::run()
     }
     
     // Step 4: Assemble Timeline
-    if (!shouldCancel)
+    if (!isCancelled())
     {
         updateState(RenderState::AssemblingTimeline, "Assembling final timeline...");
 
@@ -703,18 +1058,22 @@ void RenderManagerCore::run()
 
         if (!success)
         {
-            updateState(RenderState::Failed, "Failed to assemble timeline");
+            if (isCancelled())
+                updateState(RenderState::Cancelled, "Rendering cancelled by user");
+            else
+                updateState(RenderState::Failed, "Failed to assemble timeline");
             return;
         }
     }
     
     // Finalize
-    if (shouldCancel)
+    if (isCancelled())
     {
         updateState(RenderState::Cancelled, "Rendering cancelled by user");
     }
     else if (success)
     {
+        renderJournal->markFinished();
         renderEndTime = juce::Time::getCurrentTime();
         updateState(RenderState::Completed, "Rendering completed in " + getElapsedTimeString());
     }
@@ -769,12 +1128,29 @@ void RenderManagerCore::updateState(RenderState newState, const juce::String& st
         logFunction("State changed to: " + juce::String(static_cast<int>(newState)) + " - " + statusMessage);
 }
 
-bool RenderManagerCore::createWorkingDirectories()
+bool RenderManagerCore::createWorkingDirectories(const juce::String& renderKey)
 {
-    // Create temporary directory in the build folder instead of AppData/Local/Temp
-    juce::File projectRoot = juce::File::getSpecialLocation(juce::File::currentApplicationFile)
-                               .getParentDirectory(); // this should be the build dir
-    juce::File tempBaseDir = projectRoot.getChildFile("AmbientRender_Debug");
+    juce::File tempBaseDir = getTempBaseDirectory();
+    
+    // Pick up an interrupted render of the same settings where it stopped
+    resumingRender = false;
+    juce::File resumable = resumeDirectory;
+    if (resumable == juce::File() && resumeEnabled && !dryRun)
+        resumable = RenderJournal::findResumable(tempBaseDir, renderKey);
+    
+    if (resumable.isDirectory()) {
+        if (logFunction)
+            logFunction("Reusing the working directory of an interrupted render: " + resumable.getFullPathName());
+        
+        // Only the directory being resumed survives
+        for (const auto& child : tempBaseDir.findChildFiles(juce::File::findFilesAndDirectories, false))
+            if (child != resumable)
+                child.deleteRecursively();
+        
+        tempDirectory = resumable;
+        resumingRender = true;
+        return true;
+    }
     
     // DRASTIC CHANGE: Force clean all previous render directories
     if (tempBaseDir.exists()) {
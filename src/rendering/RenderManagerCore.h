@@ -9,6 +9,10 @@
 #include "TimelineAssembler.h"
 #include "OverlayProcessor.h"
 #include "AudioRenderer.h"
+#include "CancellationToken.h"
+#include "IntermediateCache.h"
+#include "RenderJournal.h"
+#include "RenderCostModel.h"
 
 /**
  * Core render manager that coordinates the entire rendering pipeline.
@@ -53,9 +57,40 @@ public:
         const juce::String& finalNvidiaParams = "",
         const juce::String& finalCpuParams = "");
     
+    /**
+     * Continues a render that crashed or was cancelled, with the settings in its
+     * journal. Steps whose outputs are still intact are not redone; the audio
+     * track has to be among them unless this manager has audio sources.
+     * @param target A working directory or its render_journal.json, or an invalid
+     *               File for the most recently interrupted render
+     */
+    bool resumeRendering(const juce::File& target,
+                         std::function<void(const juce::String&)> statusCallback,
+                         std::function<void(double)> progressCallback);
+    
     /** Cancels the current rendering process. */
     void cancelRendering();
     
+    /**
+     * When set, the next render only plans the timeline: the task graph and its
+     * critical path are logged and written to render_graph.txt, and no audio or
+     * video is rendered. Defaults to on when FFLUCE_DRY_RUN is set.
+     */
+    void setDryRun(bool shouldDryRun) { dryRun = shouldDryRun; }
+    
+    /**
+     * Selects the engine the next render's video timeline goes through. Defaults to
+     * the filtergraph engine when FFLUCE_RENDER_ENGINE is "filtergraph".
+     */
+    void setRenderEngine(RenderTypes::RenderEngine engine) { renderEngine = engine; }
+    
+    /**
+     * When enabled (the default, unless FFLUCE_RESUME is "0"), starting a render whose
+     * settings and sources match an interrupted one picks up in its working directory
+     * instead of starting over.
+     */
+    void setResumeEnabled(bool shouldResume) { resumeEnabled = shouldResume; }
+    
     /** Returns the current state of the rendering process. */
     RenderState getState() const { return state; }
     
@@ -73,14 +108,26 @@ private:
     /** Thread run method that orchestrates the entire rendering process. */
     void run() override;
     
+    /** Runs the render steps; called from run(). */
+    void runRenderPipeline();
+    
+    /** Writes the FFmpeg timing report for the finished session into the log directory. */
+    void writeTimingReport();
+    
+    /** Returns true once the current render has been cancelled. */
+    bool isCancelled() const { return cancellationToken != nullptr && cancellationToken->isCancelled(); }
+    
     /** Timer callback to check for progress updates from FFmpeg. */
     void timerCallback() override;
     
     /** Updates the current state and notifies the status callback. */
     void updateState(RenderState newState, const juce::String& statusMessage);
     
-    /** Creates working directories for temporary files. */
-    bool createWorkingDirectories();
+    /**
+     * Creates the working directory for temporary files, or reuses the one of an
+     * interrupted render with the same key.
+     */
+    bool createWorkingDirectories(const juce::String& renderKey);
     
     /** Cleans up all temporary files after rendering. */
     void cleanup();
@@ -98,6 +145,15 @@ private:
     std::unique_ptr<OverlayProcessor> overlayProcessor;
     std::unique_ptr<AudioRenderer> audioRenderer;
     
+    // Intermediates kept between renders, shared by the assembler and overlay processor
+    std::unique_ptr<IntermediateCache> intermediateCache;
+    
+    // Completed steps of the current render, kept in its working directory
+    std::unique_ptr<RenderJournal> renderJournal;
+    
+    // Task durations predicted from earlier sessions' telemetry, refitted for every render
+    std::unique_ptr<RenderCostModel> costModel;
+    
     // Audio sources
     BinauralAudioSource* binauralSource;
     FilePlayerAudioSource* filePlayer;
@@ -123,9 +179,14 @@ private:
     // State tracking
     RenderState state;
     std::atomic<double> progress;
-    std::atomic<bool> shouldCancel;
+    CancellationToken::Ptr cancellationToken;   // new token per render, shared with every component
     bool useNvidiaAcceleration;
     bool audioOnly;
+    bool dryRun;
+    RenderTypes::RenderEngine renderEngine;
+    bool resumeEnabled;
+    bool resumingRender = false;    // the working directory came from an interrupted render
+    juce::File resumeDirectory;     // set by resumeRendering() for the next createWorkingDirectories()
     juce::String currentStatusMessage;
     
     // Quality preset encoding parameters
@@ -0,0 +1,295 @@
+#include "RenderTelemetry.h"
+#include <algorithm>
+#include <map>
+
+namespace
+{
+    juce::String formatSeconds(double seconds)
+    {
+        return juce::String(seconds, 1) + " s";
+    }
+
+    juce::String formatBytes(juce::int64 bytes)
+    {
+        return bytes >= 0 ? juce::File::descriptionOfSizeInBytes(bytes) : juce::String("n/a");
+    }
+
+    bool appendText(const juce::File& file, const juce::String& text)
+    {
+        juce::FileOutputStream stream(file, 4096);
+        return stream.openedOk() && stream.writeText(text, false, false, nullptr);
+    }
+}
+
+//==============================================================================
+RenderTelemetry::RenderTelemetry() {}
+
+RenderTelemetry::~RenderTelemetry()
+{
+    endSession();
+}
+
+void RenderTelemetry::beginSession(const juce::File& directory)
+{
+    endSession();
+
+    if (!directory.isDirectory())
+        return;
+
+    const juce::ScopedLock sl(lock);
+
+    sessionDirectory = directory;
+    recordsFile = directory.getChildFile("commands.jsonl");
+    traceFile = directory.getChildFile("trace.json");
+    sessionStart = juce::Time::getCurrentTime();
+
+    recordsFile.deleteFile();
+    traceFile.deleteFile();
+
+    // The array format lets a viewer open the trace without its closing bracket,
+    // so events are appended as they arrive and an interrupted render's trace still loads
+    auto* meta = new juce::DynamicObject();
+    juce::var metaEvent(meta);
+    auto* metaArgs = new juce::DynamicObject();
+    metaArgs->setProperty("name", "FFLUCE render");
+    meta->setProperty("name", "process_name");
+    meta->setProperty("ph", "M");
+    meta->setProperty("pid", 1);
+    meta->setProperty("args", juce::var(metaArgs));
+
+    appendText(traceFile, "[\n" + juce::JSON::toString(metaEvent, true));
+}
+
+void RenderTelemetry::endSession()
+{
+    const juce::ScopedLock sl(lock);
+
+    if (sessionDirectory != juce::File())
+        appendText(traceFile, "\n]\n");
+
+    sessionDirectory = juce::File();
+    recordsFile = juce::File();
+    traceFile = juce::File();
+    records.clear();
+    laneEndTimes.clear();
+}
+
+//==============================================================================
+void RenderTelemetry::addRecord(const CommandRecord& record)
+{
+    const juce::ScopedLock sl(lock);
+
+    if (sessionDirectory == juce::File())
+        return;
+
+    records.push_back(record);
+
+    appendText(recordsFile, juce::JSON::toString(recordToJSON(record), true) + "\n");
+    appendTraceEvent(record, assignTraceLane(record));
+}
+
+std::vector<RenderTelemetry::CommandRecord> RenderTelemetry::getRecords() const
+{
+    const juce::ScopedLock sl(lock);
+    return records;
+}
+
+int RenderTelemetry::assignTraceLane(const CommandRecord& record)
+{
+    // Records arrive in finishing order, so a lane is free for this command if
+    // everything already placed on it ended before this command started.
+    const juce::int64 startMs = record.startTime.toMilliseconds();
+    const juce::int64 endMs = startMs + (juce::int64) (record.wallSeconds * 1000.0);
+
+    for (size_t lane = 0; lane < laneEndTimes.size(); ++lane)
+    {
+        if (laneEndTimes[lane] <= startMs)
+        {
+            laneEndTimes[lane] = endMs;
+            return (int) lane + 1;
+        }
+    }
+
+    laneEndTimes.push_back(endMs);
+    return (int) laneEndTimes.size();
+}
+
+juce::String RenderTelemetry::getMachineId()
+{
+    return juce::SystemStats::getComputerName() + "/" + juce::SystemStats::getCpuModel()
+           + "/" + juce::String(juce::SystemStats::getNumCpus());
+}
+
+//==============================================================================
+juce::var RenderTelemetry::recordToJSON(const CommandRecord& record)
+{
+    auto* object = new juce::DynamicObject();
+    juce::var json(object);
+
+    object->setProperty("index", record.index);
+    object->setProperty("stage", record.stage);
+    object->setProperty("start", record.startTime.toISO8601(true));
+    object->setProperty("startMs", record.startTime.toMilliseconds());
+    object->setProperty("wallSeconds", record.wallSeconds);
+    object->setProperty("userCpuSeconds", record.userCpuSeconds);
+    object->setProperty("systemCpuSeconds", record.systemCpuSeconds);
+    object->setProperty("peakRssKb", record.peakResidentKb);
+    object->setProperty("bytesRead", record.bytesRead);
+    object->setProperty("bytesWritten", record.bytesWritten);
+    object->setProperty("outputFile", record.outputFile.getFullPathName());
+    object->setProperty("outputBytes", record.outputBytes);
+    object->setProperty("encoder", record.encoder);
+    object->setProperty("encoderFps", record.encoderFps);
+    object->setProperty("encoderSpeed", record.encoderSpeed);
+    object->setProperty("mediaSeconds", record.mediaSeconds);
+    object->setProperty("width", record.outputWidth);
+    object->setProperty("height", record.outputHeight);
+    object->setProperty("exitCode", record.exitCode);
+    object->setProperty("cancelled", record.cancelled);
+    object->setProperty("machine", record.machine);
+    object->setProperty("command", record.command);
+
+    return json;
+}
+
+bool RenderTelemetry::recordFromJSON(const juce::var& json, CommandRecord& record)
+{
+    if (!json.isObject())
+        return false;
+
+    record.index = (int) json.getProperty("index", 0);
+    record.stage = json.getProperty("stage", juce::String()).toString();
+    record.startTime = juce::Time((juce::int64) json.getProperty("startMs", 0));
+    record.wallSeconds = (double) json.getProperty("wallSeconds", 0.0);
+    record.userCpuSeconds = (double) json.getProperty("userCpuSeconds", -1.0);
+    record.systemCpuSeconds = (double) json.getProperty("systemCpuSeconds", -1.0);
+    record.peakResidentKb = (juce::int64) json.getProperty("peakRssKb", -1);
+    record.bytesRead = (juce::int64) json.getProperty("bytesRead", -1);
+    record.bytesWritten = (juce::int64) json.getProperty("bytesWritten", -1);
+    record.outputFile = juce::File(json.getProperty("outputFile", juce::String()).toString());
+    record.outputBytes = (juce::int64) json.getProperty("outputBytes", -1);
+    record.encoder = json.getProperty("encoder", juce::String()).toString();
+    record.encoderFps = (double) json.getProperty("encoderFps", 0.0);
+    record.encoderSpeed = (double) json.getProperty("encoderSpeed", 0.0);
+    record.mediaSeconds = (double) json.getProperty("mediaSeconds", 0.0);
+    record.outputWidth = (int) json.getProperty("width", 0);
+    record.outputHeight = (int) json.getProperty("height", 0);
+    record.exitCode = (int) json.getProperty("exitCode", 0);
+    record.cancelled = (bool) json.getProperty("cancelled", false);
+    record.machine = json.getProperty("machine", juce::String()).toString();
+    record.command = json.getProperty("command", juce::String()).toString();
+
+    return record.wallSeconds > 0.0;
+}
+
+//==============================================================================
+void RenderTelemetry::appendTraceEvent(const CommandRecord& record, int lane) const
+{
+    auto* event = new juce::DynamicObject();
+    juce::var eventVar(event);
+
+    const juce::String stage = record.stage.isNotEmpty() ? record.stage : juce::String("ffmpeg");
+    event->setProperty("name", stage + ": " + record.outputFile.getFileName());
+    event->setProperty("cat", stage);
+    event->setProperty("ph", "X");
+    event->setProperty("ts", (double) (record.startTime.toMilliseconds() - sessionStart.toMilliseconds()) * 1000.0);
+    event->setProperty("dur", record.wallSeconds * 1.0e6);
+    event->setProperty("pid", 1);
+    event->setProperty("tid", lane);
+    event->setProperty("args", recordToJSON(record));
+
+    appendText(traceFile, ",\n" + juce::JSON::toString(eventVar, true));
+}
+
+//==============================================================================
+bool RenderTelemetry::writeTimingReport(const juce::File& destination) const
+{
+    const juce::ScopedLock sl(lock);
+
+    struct StageTotals
+    {
+        int commands = 0;
+        double wallSeconds = 0.0;
+        double cpuSeconds = 0.0;
+        juce::int64 outputBytes = 0;
+    };
+
+    std::map<juce::String, StageTotals> stages;
+    double totalWall = 0.0;
+    double totalCpu = 0.0;
+    int failed = 0;
+    int cancelled = 0;
+
+    for (const auto& record : records)
+    {
+        auto& totals = stages[record.stage.isNotEmpty() ? record.stage : juce::String("(unlabelled)")];
+        const double cpu = juce::jmax(0.0, record.userCpuSeconds) + juce::jmax(0.0, record.systemCpuSeconds);
+
+        ++totals.commands;
+        totals.wallSeconds += record.wallSeconds;
+        totals.cpuSeconds += cpu;
+        totals.outputBytes += juce::jmax((juce::int64) 0, record.outputBytes);
+
+        totalWall += record.wallSeconds;
+        totalCpu += cpu;
+
+        if (record.cancelled)
+            ++cancelled;
+        else if (record.exitCode != 0)
+            ++failed;
+    }
+
+    juce::String report;
+    report << "FFLUCE render timing report\n";
+    report << "Generated: " << juce::Time::getCurrentTime().toString(true, true) << "\n";
+    report << "Session: " << sessionDirectory.getFullPathName() << "\n\n";
+    report << "Commands:        " << (int) records.size() << " (failed: " << failed << ", cancelled: " << cancelled << ")\n";
+    report << "FFmpeg wall time: " << formatSeconds(totalWall) << "\n";
+    report << "FFmpeg CPU time:  " << formatSeconds(totalCpu) << "\n\n";
+
+    std::vector<std::pair<juce::String, StageTotals>> sortedStages(stages.begin(), stages.end());
+    std::sort(sortedStages.begin(), sortedStages.end(),
+              [](const auto& a, const auto& b) { return a.second.wallSeconds > b.second.wallSeconds; });
+
+    report << "Time per stage:\n";
+    for (const auto& [stage, totals] : sortedStages)
+    {
+        const double share = totalWall > 0.0 ? 100.0 * totals.wallSeconds / totalWall : 0.0;
+        report << "  " << stage.paddedRight(' ', 28)
+               << juce::String(totals.commands).paddedLeft(' ', 5) << " cmds"
+               << formatSeconds(totals.wallSeconds).paddedLeft(' ', 12)
+               << (juce::String(share, 1) + "%").paddedLeft(' ', 8)
+               << ("cpu " + formatSeconds(totals.cpuSeconds)).paddedLeft(' ', 16)
+               << "  out " << formatBytes(totals.outputBytes) << "\n";
+    }
+
+    std::vector<const CommandRecord*> slowest;
+    for (const auto& record : records)
+        slowest.push_back(&record);
+
+    std::sort(slowest.begin(), slowest.end(),
+              [](const CommandRecord* a, const CommandRecord* b) { return a->wallSeconds > b->wallSeconds; });
+
+    report << "\nSlowest commands:\n";
+    for (size_t i = 0; i < slowest.size() && i < 10; ++i)
+    {
+        const auto& record = *slowest[i];
+        report << "  " << juce::String::formatted("#%03d", record.index)
+               << "  " << formatSeconds(record.wallSeconds).paddedLeft(' ', 10)
+               << "  " << record.stage.paddedRight(' ', 24)
+               << record.outputFile.getFileName();
+
+        if (record.encoder.isNotEmpty())
+            report << "  [" << record.encoder << "]";
+        if (record.encoderFps > 0.0)
+            report << "  fps=" << juce::String(record.encoderFps, 1);
+        if (record.encoderSpeed > 0.0)
+            report << "  speed=" << juce::String(record.encoderSpeed, 2) << "x";
+        if (record.peakResidentKb > 0)
+            report << "  rss=" << formatBytes(record.peakResidentKb * 1024);
+
+        report << "\n";
+    }
+
+    return destination.replaceWithText(report);
+}
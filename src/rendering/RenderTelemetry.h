@@ -0,0 +1,94 @@
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+
+/**
+ * Collects a structured record for every FFmpeg command run during a render
+ * session and writes them out in two forms:
+ *
+ * - commands.jsonl: one JSON object per command, appended as commands finish
+ * - trace.json:     a Chrome trace (chrome://tracing / Perfetto) of the session, in
+ *                   the array format, appended the same way and closed by endSession()
+ *
+ * A plain-text timing report summarising where the time went can be written
+ * once the render has finished.
+ */
+class RenderTelemetry
+{
+public:
+    /** Everything we know about a single FFmpeg invocation. */
+    struct CommandRecord
+    {
+        int index = 0;
+        juce::String stage;              // pipeline step that issued the command
+        juce::String command;
+        juce::String encoder;            // value of the last -c:v, if any
+        juce::File outputFile;
+        juce::Time startTime;
+        double wallSeconds = 0.0;
+        double userCpuSeconds = -1.0;    // -1 when unavailable on this platform
+        double systemCpuSeconds = -1.0;
+        juce::int64 peakResidentKb = -1;
+        juce::int64 bytesRead = -1;
+        juce::int64 bytesWritten = -1;
+        juce::int64 outputBytes = -1;
+        double encoderFps = 0.0;         // last fps= reported by FFmpeg
+        double encoderSpeed = 0.0;       // last speed= reported by FFmpeg
+        double mediaSeconds = 0.0;       // last time= reported by FFmpeg
+        int outputWidth = 0;
+        int outputHeight = 0;
+        int exitCode = 0;
+        bool cancelled = false;
+        juce::String machine;            // getMachineId() of the computer that ran it
+    };
+
+    RenderTelemetry();
+    ~RenderTelemetry();
+
+    /**
+     * Starts a new session. Records are written into the given directory.
+     * Passing an invalid directory ends the current session.
+     */
+    void beginSession(const juce::File& directory);
+
+    /** Closes the trace and stops writing records. */
+    void endSession();
+
+    /** Adds a finished command to the session and updates the output files. */
+    void addRecord(const CommandRecord& record);
+
+    /** Returns a copy of the records collected in the current session. */
+    std::vector<CommandRecord> getRecords() const;
+
+    /**
+     * Writes a human-readable summary of the session: totals, time per stage
+     * and the slowest commands.
+     *
+     * @param destination The file to write
+     * @return            true if the report was written
+     */
+    bool writeTimingReport(const juce::File& destination) const;
+
+    /** Converts a record into the JSON object written to commands.jsonl. */
+    static juce::var recordToJSON(const CommandRecord& record);
+
+    /** Rebuilds a record from a line of commands.jsonl. */
+    static bool recordFromJSON(const juce::var& json, CommandRecord& record);
+
+    /** Identifies this computer's hardware, so timings from other machines can be told apart. */
+    static juce::String getMachineId();
+
+private:
+    void appendTraceEvent(const CommandRecord& record, int lane) const;
+    int assignTraceLane(const CommandRecord& record);
+
+    mutable juce::CriticalSection lock;
+    juce::File sessionDirectory;
+    juce::File recordsFile;
+    juce::File traceFile;
+    juce::Time sessionStart;
+    std::vector<CommandRecord> records;
+    std::vector<juce::int64> laneEndTimes;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderTelemetry)
+};
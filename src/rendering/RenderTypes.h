@@ -1,5 +1,6 @@
 #pragma once
 #include <JuceHeader.h>
+#include <vector>
 
 // Forward declarations
 class RenderManagerCore;
@@ -20,6 +21,13 @@ namespace RenderTypes
         bool isIntroClip { false }; // Whether this is an intro clip (vs loop clip)
     };
     
+    /** Another file an overlay can show instead of its main one */
+    struct OverlayVariant
+    {
+        juce::File file;
+        double weight { 1.0 };  // Relative chance of being picked for an appearance
+    };
+    
     /** Information about an overlay clip to be rendered */
     struct OverlayClipInfo
     {
@@ -27,6 +35,26 @@ namespace RenderTypes
         double duration;        // Duration of the overlay clip
         double frequencySecs;   // How often the overlay appears (in seconds)
         double startTimeSecs;   // When the first overlay should appear (in seconds from start)
+        
+        // Scheduling rules; the defaults give the plain fixed-frequency schedule (see OverlaySchedule)
+        double jitterSecs { 0.0 };                  // Each appearance moves by up to this much either way
+        juce::int64 jitterSeed { 0 };               // Seeds the jitter and variant choice; 0 = different every render
+        std::vector<juce::Range<double>> activeWindows;  // Appearances must lie inside one; empty = anywhere
+        double weight { 1.0 };                      // Chance of showing file, relative to the variants
+        std::vector<OverlayVariant> variants;       // Other files each appearance may show instead
+        int maxConcurrent { 0 };                    // Left out where more overlays would be on screen; 0 = no limit
+        
+        bool hasSchedule() const
+        {
+            return jitterSecs > 0.0 || !activeWindows.empty() || !variants.empty() || maxConcurrent > 0;
+        }
+    };
+    
+    /** How the video timeline is rendered */
+    enum class RenderEngine
+    {
+        FileBased,      // render graph of lossless intermediates (the default)
+        FilterGraph     // one FFmpeg filtergraph; falls back to FileBased when it can't
     };
     
     /** Represents the current status of the render process */
@@ -1,4 +1,9 @@
 #include "TimelineAssembler.h"
+#include "EncoderCapabilities.h"
+#include "RenderGraphScheduler.h"
+#include "FilterGraphRenderer.h"
+#include "OverlaySchedule.h"
+#include <map>
 
 namespace
 {
@@ -58,6 +63,87 @@ namespace
             result += " " + extras;
         return result.trim();
     }
+
+    // Conform command: loops the source if it is shorter than the clip, then cuts it to length
+    juce::String buildConformCommand(const juce::String& ffmpegPath,
+                                     const juce::File& source,
+                                     const juce::File& destination,
+                                     double clipDuration,
+                                     double safeStartTime,
+                                     double effectiveSourceDuration,
+                                     const juce::String& encodingParams,
+                                     const juce::String& inputFlags)
+    {
+        juce::String cmd = ffmpegPath + " -y";
+
+        if (inputFlags.isNotEmpty())
+            cmd += " " + inputFlags;
+
+        if (clipDuration > effectiveSourceDuration + 0.1)
+        {
+            int loopCount = (int)std::ceil(clipDuration / effectiveSourceDuration);
+            cmd += " -stream_loop " + juce::String(loopCount - 1) +
+                   " -i \"" + source.getFullPathName() + "\"";
+        }
+        else
+        {
+            cmd += " -i \"" + source.getFullPathName() + "\"";
+        }
+
+        if (safeStartTime > 0.001)
+            cmd += " -ss " + juce::String(safeStartTime);
+
+        cmd += " -t " + juce::String(clipDuration) +
+               " " + encodingParams +
+               " -pix_fmt yuv420p -an \"" + destination.getFullPathName() + "\"";
+
+        return cmd;
+    }
+
+    // Estimated wall-clock seconds of a task, used until the cost model has fitted its kind
+    double getDefaultTaskSeconds(RenderGraph::TaskType type, double mediaSeconds)
+    {
+        double factor = 0.25;   // lossless ultrafast intermediates
+
+        switch (type)
+        {
+            case RenderGraph::TaskType::Conform:    factor = 0.30; break;   // decode + scale of the source
+            case RenderGraph::TaskType::Xfade:      factor = 0.40; break;   // two decodes into one encode
+            case RenderGraph::TaskType::Overlay:    factor = 1.00; break;
+            case RenderGraph::TaskType::Encode:     factor = 0.80; break;   // delivery encoder
+            case RenderGraph::TaskType::Mux:        factor = 0.80; break;   // delivery encoder + loudnorm
+            case RenderGraph::TaskType::ExtractIn:
+            case RenderGraph::TaskType::ExtractOut:
+            case RenderGraph::TaskType::Body:
+            case RenderGraph::TaskType::Concat:
+            case RenderGraph::TaskType::Trim:       break;
+        }
+
+        return juce::jmax(0.0, mediaSeconds) * factor;
+    }
+
+    // FFLUCE_RENDER_JOBS overrides the worker count; otherwise one worker per four
+    // cores, since each FFmpeg job is itself multithreaded
+    int getDefaultParallelJobs()
+    {
+        const int requested = juce::SystemStats::getEnvironmentVariable("FFLUCE_RENDER_JOBS", {}).getIntValue();
+        if (requested > 0)
+            return requested;
+
+        return juce::jlimit(1, 4, juce::SystemStats::getNumCpus() / 4);
+    }
+
+    // Outputs of one batched crossfade command; bounds its command line and open encoders
+    constexpr size_t maxCrossfadesPerCommand = 32;
+
+    // Labels the calling thread's commands with a task type for the timing report
+    struct ScopedTelemetryStage
+    {
+        ScopedTelemetryStage(FFmpegExecutor& e, const juce::String& stage) : executor(e) { executor.setTelemetryStage(stage); }
+        ~ScopedTelemetryStage() { executor.setTelemetryStage({}); }
+
+        FFmpegExecutor& executor;
+    };
 }
 
 TimelineAssembler::TimelineAssembler(FFmpegExecutor* ffmpegExecutor, OverlayProcessor* overlayProcessor)
@@ -68,7 +154,12 @@ TimelineAssembler::TimelineAssembler(FFmpegExecutor* ffmpegExecutor, OverlayProc
       tempCpuParams("-c:v libx264 -preset ultrafast -qp 0"),  // Lossless H.264
       finalNvidiaParams("-preset p5 -b:v 20M -maxrate 25M -bufsize 40M"),  // Higher quality final output
       finalCpuParams("-preset medium -crf 18 -bufsize 20M"),  // Better quality for CPU encoding
-      losslessParams("-c:v libx264 -preset ultrafast -qp 0")  // Lossless intermediate encoding
+      losslessParams(IntermediateFormat::getDefault().codecArgs),  // Lossless intermediate encoding
+      intermediateFormat(IntermediateFormat::getDefault()),
+      maxParallelJobs(getDefaultParallelJobs()),
+      encodeOnce(juce::SystemStats::getEnvironmentVariable("FFLUCE_ENCODE_ONCE", "1") != "0"),
+      smartCut(juce::SystemStats::getEnvironmentVariable("FFLUCE_SMART_CUT", "1") != "0"),
+      cudaFilters(juce::SystemStats::getEnvironmentVariable("FFLUCE_CUDA_FILTERS", "1") != "0")
 {
 }
 
@@ -110,18 +201,6 @@ bool TimelineAssembler::assembleTimeline(const std::vector<RenderTypes::VideoCli
                                       double fadeOutDuration)
 {
     try {
-        auto setProgressSlice = [&](double start, double end, double estSeconds)
-        {
-            if (ffmpegExecutor)
-                ffmpegExecutor->setExternalProgressWindow(start, end, estSeconds);
-        };
-
-        auto clearProgressSlice = [&]()
-        {
-            if (ffmpegExecutor)
-                ffmpegExecutor->clearExternalProgressWindow();
-        };
-
         // Store fade durations for final muxing
         this->fadeInDuration = fadeInDuration;
         this->fadeOutDuration = fadeOutDuration;
@@ -139,64 +218,103 @@ bool TimelineAssembler::assembleTimeline(const std::vector<RenderTypes::VideoCli
         
         // Store the total duration for access in other methods
         this->totalDuration = targetDuration;
+        manifest.clear();
         
-        // Step 1: Conform clips
-        setProgressSlice(0.00, 0.10, targetDuration);
-        if (!conformInputClips(introClips, loopClips, tempDirectory)) {
-            clearProgressSlice();
-            return false;
-        }
-        clearProgressSlice();
-
-        // Step 2: Generate crossfades
-        setProgressSlice(0.10, 0.25, targetDuration);
-        if (!generateCrossfadeComponents(introClips, loopClips, tempDirectory)) {
-            clearProgressSlice();
-            return false;
-        }
-        clearProgressSlice();
-
-        // Step 3: Assemble intro sequence
-        setProgressSlice(0.25, 0.35, targetDuration);
-        if (!assembleIntroSequence(introClips, tempDirectory)) {
-            clearProgressSlice();
-            return false;
+        if (renderEngine == RenderTypes::RenderEngine::FilterGraph)
+        {
+            bool handled = false;
+            const bool succeeded = renderWithFilterGraph(introClips, loopClips, overlayClips, audioFile,
+                                                         targetDuration, tempDirectory, outputFile, handled);
+            if (handled)
+                return succeeded;
         }
-        clearProgressSlice();
-
-        // Step 4: Assemble loop sequence
-        setProgressSlice(0.35, 0.55, targetDuration);
-        if (!assembleLoopSequence(introClips, loopClips, tempDirectory)) {
-            clearProgressSlice();
+        
+        selectIntermediateFormat(targetDuration, tempDirectory);
+        configureDiskBudget(loopClips.empty() ? introClips : loopClips);
+        registerClips("intro", introClips, tempDirectory);
+        registerClips("loop", loopClips, tempDirectory);
+        
+        // Plan steps 1-7 as a task graph; independent clips and crossfades then run side by side
+        RenderGraph graph;
+        buildRenderGraph(graph, introClips, loopClips, overlayClips, audioFile, targetDuration, tempDirectory, outputFile);
+        
+        juce::String graphError;
+        if (!graph.resolveDependencies(graphError)) {
+            if (logCallback) logCallback("ERROR: Invalid render graph: " + graphError);
             return false;
         }
-        clearProgressSlice();
-
-        // Step 5: Final loop assembly
-        setProgressSlice(0.55, 0.65, targetDuration);
-        if (!finalLoopSequenceAssembly(tempDirectory, introClips, loopClips)) {
-            clearProgressSlice();
-            return false;
+        
+        if (renderJournal != nullptr)
+            applyRenderJournal(graph);
+        
+        if (intermediateCache != nullptr && intermediateCache->isEnabled())
+            applyIntermediateCache(graph);
+        
+        // Find out now, not hours in, whether the intermediates fit on disk
+        juce::String diskError;
+        const bool fitsOnDisk = diskBudget.plan(graph, tempDirectory, diskError);
+        
+        // Serial work spread over the workers, but never quicker than the critical path
+        double criticalSeconds = 0.0;
+        for (int taskId : graph.getCriticalPath())
+            criticalSeconds += graph.getTask(taskId).estimatedSeconds;
+        const double estimatedSeconds = juce::jmax(criticalSeconds, graph.getTotalEstimatedSeconds() / juce::jmax(1, maxParallelJobs));
+        
+        const juce::String estimate = "Estimated render time: " + juce::RelativeTime::seconds(estimatedSeconds).getDescription()
+            + " with " + juce::String(maxParallelJobs) + " workers ("
+            + (costModel != nullptr && costModel->getNumSamples() > 0 ? "fitted to " + juce::String(costModel->getNumSamples()) + " timed commands"
+                                                                       : juce::String("no timing history yet")) + ")\n";
+        
+        const juce::String plan = graph.describe() + "\n" + estimate + "\n" + diskBudget.describe();
+        if (logCallback) logCallback(plan);
+        
+        if (!fitsOnDisk && logCallback)
+            logCallback("ERROR: Not enough disk space: " + diskError);
+        
+        if (dryRun || !fitsOnDisk)
+            diskBudget.cleanupSpills();
+        
+        if (dryRun) {
+            juce::File planFile = tempDirectory.getChildFile("render_graph.txt");
+            planFile.replaceWithText(plan);
+            if (logCallback) logCallback("Dry run: render graph written to " + planFile.getFullPathName() + ", nothing was rendered");
+            return true;
         }
-        clearProgressSlice();
-
-        // Step 6: Process overlays
-        setProgressSlice(0.65, 0.90, targetDuration);
-        if (!calculateFinalAssemblyAndProcessOverlays(overlayClips, targetDuration, tempDirectory)) {
-            clearProgressSlice();
+        
+        if (!fitsOnDisk)
             return false;
-        }
-        clearProgressSlice();
         
-        // Step 7: Mux final output
-        setProgressSlice(0.90, 1.00, targetDuration);
-        if (!muxFinalOutput(audioFile, tempDirectory, outputFile)) {
-            clearProgressSlice();
+        if (renderJournal != nullptr)
+            recordToRenderJournal(graph);
+        
+        diskBudget.attach(graph);
+        
+        if (isCancelled()) {
+            if (logCallback) logCallback("Timeline assembly cancelled");
             return false;
         }
-        clearProgressSlice();
-
-        return true;
+        
+        RenderGraphScheduler scheduler(maxParallelJobs);
+        scheduler.setLogCallback(logCallback);
+        scheduler.setCancellationCheck([this] { return isCancelled(); });
+        scheduler.setProgressCallback([this](double fraction) { ffmpegExecutor->reportProgress(fraction); });
+        
+        // One failed task fails the render; don't leave its siblings encoding
+        scheduler.setFailureCallback([this] { ffmpegExecutor->cancelExecution(); });
+        
+        // Per-command progress is meaningless with several commands running at once
+        ffmpegExecutor->setCommandProgressEnabled(false);
+        const bool succeeded = scheduler.run(graph);
+        ffmpegExecutor->setCommandProgressEnabled(true);
+        diskBudget.cleanupSpills();
+        
+        if (intermediateCache != nullptr && intermediateCache->isEnabled())
+            intermediateCache->evictToBudget();
+        
+        if (!succeeded && isCancelled() && logCallback)
+            logCallback("Timeline assembly cancelled");
+        
+        return succeeded;
     }
     catch (const std::exception& e) {
         if (logCallback)
@@ -217,187 +335,709 @@ bool TimelineAssembler::conformInputClips(const std::vector<RenderTypes::VideoCl
 {
     if (logCallback) logCallback("Conforming input clips to defined durations...");
 
-    auto buildCommand = [](FFmpegExecutor* executor,
-                           const juce::File& source,
-                           const juce::File& destination,
-                           double clipDuration,
-                           double safeStartTime,
-                           double effectiveSourceDuration,
-                           const juce::String& encodingParams) -> juce::String
+    manifest.clear();
+    registerClips("intro", introClips, tempDirectory);
+    registerClips("loop", loopClips, tempDirectory);
+
+    for (size_t i = 0; i < introClips.size(); ++i)
     {
-        juce::String cmd = executor->getFFmpegPath() + " -y";
+        const auto& clip = introClips[i];
+        juce::File outputFile = tempDirectory.getChildFile("intro_" + juce::String(i) + intermediateFormat.extension);
 
-        if (clipDuration > effectiveSourceDuration + 0.1)
+        if (isCancelled())
+            return false;
+
+        if (!conformClip(clip, outputFile, "intro_" + juce::String(i)))
         {
-            int loopCount = (int)std::ceil(clipDuration / effectiveSourceDuration);
-            cmd += " -stream_loop " + juce::String(loopCount - 1) +
-                   " -i \"" + source.getFullPathName() + "\"";
+            if (logCallback) logCallback("ERROR: Failed to conform intro clip " + juce::String(i));
+            return false;
         }
-        else
+
+        if (logCallback) logCallback("Conformed intro_" + juce::String(i) + ": " + juce::String(clip.duration) + "s");
+    }
+
+    for (size_t i = 0; i < loopClips.size(); ++i)
+    {
+        const auto& clip = loopClips[i];
+        juce::File outputFile = tempDirectory.getChildFile("loop_" + juce::String(i) + intermediateFormat.extension);
+
+        if (isCancelled())
+            return false;
+
+        if (!conformClip(clip, outputFile, "loop_" + juce::String(i)))
         {
-            cmd += " -i \"" + source.getFullPathName() + "\"";
+            if (logCallback) logCallback("ERROR: Failed to conform loop clip " + juce::String(i));
+            return false;
         }
 
-        if (safeStartTime > 0.001)
-            cmd += " -ss " + juce::String(safeStartTime);
+        if (logCallback) logCallback("Conformed loop_" + juce::String(i) + ": " + juce::String(clip.duration) + "s (from file: " + clip.file.getFileName() + ")");
+    }
 
-        cmd += " -t " + juce::String(clipDuration) +
-               " " + encodingParams +
-               " -pix_fmt yuv420p -an \"" + destination.getFullPathName() + "\"";
+    return true;
+}
 
-        return cmd;
-    };
+bool TimelineAssembler::conformClip(const RenderTypes::VideoClipInfo& clip,
+                                    const juce::File& outputFile,
+                                    const juce::String& label)
+{
+    const juce::File& inputFile = clip.file;
 
-    auto ensureCodecParam = [&](const juce::String& params, bool nvenc) -> juce::String
-    {
-        juce::StringArray tokens;
-        tokens.addTokens(params, " ", "\"'");
-        tokens.trim();
-        tokens.removeEmptyStrings();
+    if (!inputFile.existsAsFile()) {
+        if (logCallback) logCallback("ERROR: Input file not found: " + inputFile.getFullPathName());
+        return false;
+    }
 
-        juce::StringArray filtered;
-        for (int i = 0; i < tokens.size(); ++i)
-        {
-            juce::String token = tokens[i];
+    const double sourceDuration = ffmpegExecutor->getFileDuration(inputFile);
 
-            auto skipOptionWithValue = [&](const juce::String& opt)
-            {
-                if (token == opt || token.startsWith(opt + "="))
-                {
-                    if (token == opt && i + 1 < tokens.size())
-                        ++i;
-                    return true;
-                }
-                return false;
-            };
+    // Clamp start time to a sensible range within the clip
+    double safeStartTime = 0.0;
+    if (std::isfinite(clip.startTime) && clip.startTime > 0.0 && clip.startTime < sourceDuration - 0.001)
+        safeStartTime = clip.startTime;
+    else if (logCallback && clip.startTime != 0.0)
+        logCallback("WARNING: Invalid startTime " + juce::String(clip.startTime) + " corrected to 0.0");
 
-            // Strip codec, profile, level, pix_fmt, movflags, audio disable flags; we control these explicitly
-            if (token == "-c:v" || token.startsWith("-c:v"))
-            {
-                if (token == "-c:v" && i + 1 < tokens.size())
-                    ++i;
-                continue;
-            }
-
-            if (skipOptionWithValue("-profile") ||
-                skipOptionWithValue("-profile:v") ||
-                skipOptionWithValue("-level") ||
-                skipOptionWithValue("-level:v") ||
-                skipOptionWithValue("-pix_fmt") ||
-                skipOptionWithValue("-movflags") ||
-                skipOptionWithValue("-an"))
-            {
-                continue;
-            }
+    // Clamp requested duration to the available range
+    double requestedDuration = clip.duration;
+    if (!std::isfinite(requestedDuration) || requestedDuration <= 0.0 || requestedDuration > sourceDuration)
+        requestedDuration = sourceDuration;
 
-            filtered.add(token);
-        }
+    const double effectiveSourceDuration = juce::jmax(0.0, sourceDuration - safeStartTime);
 
-        juce::String result = "-c:v " + juce::String(nvenc ? "h264_nvenc" : "libx264");
-        const juce::String extras = filtered.joinIntoString(" ");
-        if (extras.isNotEmpty())
-            result += " " + extras;
-        return result.trim();
-    };
+    if (requestedDuration > effectiveSourceDuration) {
+        if (logCallback)
+            logCallback("WARNING: Requested duration " + juce::String(clip.duration) + " exceeds available " +
+                        juce::String(effectiveSourceDuration) + ", clamping.");
+        requestedDuration = effectiveSourceDuration;
+    }
 
-    auto conformClip = [&](const RenderTypes::VideoClipInfo& clip,
-                           const juce::File& inputFile,
-                           const juce::File& outputFile,
-                           const juce::String& label) -> bool
+    if (logCallback)
     {
-        if (!inputFile.existsAsFile()) {
-            if (logCallback) logCallback("ERROR: Input file not found: " + inputFile.getFullPathName());
-            return false;
-        }
+        logCallback("  - Source duration: " + juce::String(sourceDuration) + "s");
+        logCallback("  - Effective source duration (after start time): " + juce::String(effectiveSourceDuration) + "s");
+        logCallback("  - Target duration: " + juce::String(requestedDuration) + "s");
+    }
 
-        const double sourceDuration = ffmpegExecutor->getFileDuration(inputFile);
+    // The temp encoder settings are H.264 ones; other intermediate formats have their own
+    auto buildAttempt = [&](const FallbackPolicy::JobOptions& options)
+    {
+        const juce::String& preset = options.useGpuEncoder ? tempNvidiaParams : tempCpuParams;
+        juce::String params = intermediateFormat.isH264() ? sanitizeEncodingString(preset, options.useGpuEncoder, preset)
+                                                          : losslessParams;
+        if (options.getOutputFlags().isNotEmpty())
+            params += " " + options.getOutputFlags();
+
+        return buildConformCommand(ffmpegExecutor->getFFmpegPath(), inputFile, outputFile, requestedDuration,
+                                   safeStartTime, effectiveSourceDuration, params, options.getInputFlags());
+    };
 
-        // Clamp start time to a sensible range within the clip
-        double safeStartTime = 0.0;
-        if (std::isfinite(clip.startTime) && clip.startTime > 0.0 && clip.startTime < sourceDuration - 0.001)
-            safeStartTime = clip.startTime;
-        else if (logCallback && clip.startTime != 0.0)
-            logCallback("WARNING: Invalid startTime " + juce::String(clip.startTime) + " corrected to 0.0");
+    if (!ffmpegExecutor->executeWithFallback(buildAttempt, useNvidiaAcceleration && intermediateFormat.isH264(), outputFile,
+                                             "Conform " + label, 0.0, 1.0))
+        return false;
+    
+    // The one probe of this clip; every later step reads the measured length from the manifest
+    manifest.setDuration(outputFile, ffmpegExecutor->getFileDuration(outputFile));
+    return true;
+}
 
-        // Clamp requested duration to the available range
-        double requestedDuration = clip.duration;
-        if (!std::isfinite(requestedDuration) || requestedDuration <= 0.0 || requestedDuration > sourceDuration)
-            requestedDuration = sourceDuration;
+void TimelineAssembler::registerClips(const juce::String& type, const std::vector<RenderTypes::VideoClipInfo>& clips,
+                                      const juce::File& tempDirectory)
+{
+    for (size_t i = 0; i < clips.size(); ++i)
+    {
+        IntermediateManifest::Clip clip;
+        clip.type = type;
+        clip.index = (int) i;
+        clip.file = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
+        clip.crossfadeIn = i > 0 ? clips[i - 1].crossfade : 0.0;
+        clip.crossfadeOut = i + 1 < clips.size() ? clips[i].crossfade : 0.0;
+        manifest.addClip(clip);
+    }
+}
 
-        const double effectiveSourceDuration = juce::jmax(0.0, sourceDuration - safeStartTime);
+double TimelineAssembler::getIntermediateDuration(const juce::File& file)
+{
+    const double known = manifest.getDuration(file);
+    if (known > 0.0)
+        return known;
+    
+    // Restored from the cache or journal, or written by a step that can't tell its length
+    const double probed = ffmpegExecutor->getFileDuration(file);
+    manifest.setDuration(file, probed);
+    return probed;
+}
 
-        if (requestedDuration > effectiveSourceDuration) {
-            if (logCallback)
-                logCallback("WARNING: Requested duration " + juce::String(clip.duration) + " exceeds available " +
-                            juce::String(effectiveSourceDuration) + ", clamping.");
-            requestedDuration = effectiveSourceDuration;
+void TimelineAssembler::buildRenderGraph(RenderGraph& graph,
+                                         const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                                         const std::vector<RenderTypes::VideoClipInfo>& loopClips,
+                                         const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
+                                         const juce::File& audioFile,
+                                         double targetDuration,
+                                         const juce::File& tempDirectory,
+                                         const juce::File& outputFile)
+{
+    using TaskType = RenderGraph::TaskType;
+    
+    auto temp = [&](const juce::String& name) { return tempDirectory.getChildFile(name); };
+    
+    auto addTask = [&](TaskType type, const juce::String& name,
+                       const juce::Array<juce::File>& inputs, const juce::Array<juce::File>& outputs,
+                       double mediaSeconds, std::function<bool()> work)
+    {
+        const juce::String stage = RenderGraph::getTaskTypeName(type);
+        const int taskId = graph.addTask(type, name, inputs, outputs, estimateTaskSeconds(type, mediaSeconds),
+                                         [this, stage, work = std::move(work)]
+                                         {
+                                             const ScopedTelemetryStage label(*ffmpegExecutor, stage);
+                                             return work();
+                                         });
+        
+        // Muxing is cheap for its length, but the output is the whole timeline
+        graph.setOutputBytes(taskId, diskBudget.predictBytes(type, type == TaskType::Mux ? targetDuration : mediaSeconds));
+        return taskId;
+    };
+    
+    // Recipes name every parameter besides the input files that decides a task's
+    // outputs, so IntermediateCache can tell when a cached result is still valid
+    const juce::String baseRecipe = "ffmpeg=" + ffmpegExecutor->getFFmpegPath() + ";lossless=" + losslessParams;
+    auto cacheAs = [&](int taskId, const juce::String& parameters) { graph.setRecipe(taskId, baseRecipe + ";" + parameters); };
+    
+    auto joinCrossfades = [](const std::vector<RenderTypes::VideoClipInfo>& clips)
+    {
+        juce::StringArray crossfades;
+        for (const auto& clip : clips)
+            crossfades.add(juce::String(clip.crossfade, 6));
+        return crossfades.joinIntoString(",");
+    };
+    
+    // Steps 1 and 2 for one clip list; collects everything buildRawSequence may read
+    auto addClipTasks = [&](const juce::String& type, const std::vector<RenderTypes::VideoClipInfo>& clips,
+                            juce::Array<juce::File>& components)
+    {
+        for (size_t i = 0; i < clips.size(); ++i)
+        {
+            const juce::String name = type + "_" + juce::String(i);
+            const juce::File conformed = temp(name + intermediateFormat.extension);
+            const RenderTypes::VideoClipInfo& clip = clips[i];
+            
+            cacheAs(addTask(TaskType::Conform, name, { clip.file }, { conformed }, clip.duration,
+                            [this, &clip, conformed, name] { return conformClip(clip, conformed, name); }),
+                    "start=" + juce::String(clip.startTime, 6) + ";duration=" + juce::String(clip.duration, 6)
+                        + ";params=" + (!intermediateFormat.isH264() ? losslessParams
+                                        : useNvidiaAcceleration ? tempNvidiaParams : tempCpuParams));
+            components.add(conformed);
         }
-
-        if (logCallback)
+        
+        // Every transition of the list comes from one batched command
+        juce::Array<juce::File> crossfadedClips, transitions;
+        double crossfadeSeconds = 0.0;
+        
+        for (size_t i = 0; i + 1 < clips.size(); ++i)
         {
-            logCallback("  - Source duration: " + juce::String(sourceDuration) + "s");
-            logCallback("  - Effective source duration (after start time): " + juce::String(effectiveSourceDuration) + "s");
-            logCallback("  - Target duration: " + juce::String(requestedDuration) + "s");
+            const double crossfade = clips[i].crossfade;
+            if (crossfade <= 0.001)
+                continue;
+            
+            const juce::String fromName = type + "_" + juce::String(i);
+            const juce::String toName = type + "_" + juce::String(i + 1);
+            const juce::File from = temp(fromName + intermediateFormat.extension);
+            const juce::File to = temp(toName + intermediateFormat.extension);
+            const juce::File transition = temp(fromName + "_to_" + juce::String(i + 1) + "_x" + intermediateFormat.extension);
+            const juce::File bodyCutOut = temp(fromName + "_body_cut_out" + intermediateFormat.extension);
+            const juce::File bodyCutIn = temp(toName + "_body_cut_in" + intermediateFormat.extension);
+            
+            const juce::String crossfadeRecipe = "crossfade=" + juce::String(crossfade, 6);
+            
+            crossfadedClips.addIfNotAlreadyThere(from);
+            crossfadedClips.addIfNotAlreadyThere(to);
+            transitions.add(transition);
+            crossfadeSeconds += crossfade;
+            
+            cacheAs(addTask(TaskType::Body, bodyCutOut.getFileNameWithoutExtension(), { from }, { bodyCutOut }, clips[i].duration - crossfade,
+                            [=, this] { return extractBodySegment(from, bodyCutOut.getFileName(), 0.0, crossfade, true, tempDirectory); }),
+                    crossfadeRecipe + ";cut=end");
+            cacheAs(addTask(TaskType::Body, bodyCutIn.getFileNameWithoutExtension(), { to }, { bodyCutIn }, clips[i + 1].duration - crossfade,
+                            [=, this] { return extractBodySegment(to, bodyCutIn.getFileName(), 0.0, crossfade, false, tempDirectory); }),
+                    crossfadeRecipe + ";cut=start");
+            components.addArray({ transition, bodyCutOut, bodyCutIn });
+            
+            // A clip with crossfades on both sides also needs both ends cut off
+            if (i + 2 < clips.size() && clips[i + 1].crossfade > 0.001)
+            {
+                const double nextCrossfade = clips[i + 1].crossfade;
+                const juce::File middle = temp(toName + "_body_cut_in_cut_out" + intermediateFormat.extension);
+                
+                cacheAs(addTask(TaskType::Body, middle.getFileNameWithoutExtension(), { to }, { middle },
+                                clips[i + 1].duration - crossfade - nextCrossfade,
+                                [=, this] { return createMiddleClipBodySegment(type, i + 1, crossfade, nextCrossfade, tempDirectory); }),
+                        crossfadeRecipe + ";next=" + juce::String(nextCrossfade, 6));
+                components.add(middle);
+            }
         }
+        
+        if (!transitions.isEmpty())
+        {
+            cacheAs(addTask(TaskType::Xfade, type + "_crossfades", crossfadedClips, transitions, crossfadeSeconds,
+                            [=, this, &clips] { return generateBatchedCrossfades(type, clips, tempDirectory); }),
+                    "crossfades=" + joinCrossfades(clips));
+        }
+    };
+    
+    const double introDuration = calculateIntroDuration(introClips);
+    const double loopDuration = calculateLoopDuration(loopClips);
+    
+    // Steps 1-3 for the intro
+    if (!introClips.empty())
+    {
+        juce::Array<juce::File> components;
+        addClipTasks("intro", introClips, components);
+        
+        const juce::File raw = temp("intro_sequence_raw" + intermediateFormat.extension);
+        cacheAs(addTask(TaskType::Concat, "intro_sequence_raw", components, { raw }, introDuration,
+                        [=, this, &introClips] { return buildRawSequence("intro", introClips, tempDirectory, raw); }),
+                "crossfades=" + joinCrossfades(introClips));
+        cacheAs(addTask(TaskType::Trim, "intro_sequence", { raw },
+                        { temp("intro_sequence" + intermediateFormat.extension), temp("loop_from_intro_sequence_x_out" + intermediateFormat.extension) }, introDuration,
+                        [=, this, &introClips] { return finishIntroSequence(introClips, tempDirectory); }),
+                "tail=" + juce::String(introClips.back().crossfade, 6));
+    }
+    
+    // Steps 1, 2 and 4 for the loop; both variant extractions read the raw sequence at once
+    if (!loopClips.empty())
+    {
+        juce::Array<juce::File> components;
+        addClipTasks("loop", loopClips, components);
+        
+        const juce::File raw = temp("loop_sequence_raw" + intermediateFormat.extension);
+        cacheAs(addTask(TaskType::Concat, "loop_sequence_raw", components, { raw }, loopDuration,
+                        [=, this, &loopClips] { return buildRawSequence("loop", loopClips, tempDirectory, raw); }),
+                "crossfades=" + joinCrossfades(loopClips));
+        
+        for (const juce::String variant : { "intro_based", "loop_based" })
+        {
+            const juce::Array<juce::File> outputs = variant == "intro_based"
+                ? juce::Array<juce::File> { temp("loop_from_intro_sequence_x_in" + intermediateFormat.extension), temp("loop_from_intro_body_cut_in_cut_out" + intermediateFormat.extension) }
+                : juce::Array<juce::File> { temp("loop_from_loop_sequence_x_out" + intermediateFormat.extension), temp("loop_from_loop_sequence_x_in" + intermediateFormat.extension),
+                                            temp("loop_from_loop_body_cut_in_cut_out" + intermediateFormat.extension) };
+            
+            cacheAs(addTask(TaskType::Trim, "loop_variants_" + variant, { raw }, outputs, loopDuration,
+                            [=, this, &introClips, &loopClips] { return extractLoopVariants(raw, tempDirectory, variant, introClips, loopClips); }),
+                    "variant=" + variant + ";intro=" + joinCrossfades(introClips) + ";loop=" + joinCrossfades(loopClips));
+        }
+    }
+    
+    // Step 5
+    const juce::File loopFromIntroSequence = temp("loop_from_intro_sequence" + intermediateFormat.extension);
+    const juce::File loopFromLoopSequence = temp("loop_from_loop_sequence" + intermediateFormat.extension);
+    const double sequenceCrossfades = (introClips.empty() ? 0.0 : introClips.back().crossfade)
+                                    + (loopClips.empty() ? 0.0 : loopClips.back().crossfade);
+    
+    cacheAs(addTask(TaskType::Xfade, "sequence_crossfades",
+                    { temp("loop_from_intro_sequence_x_out" + intermediateFormat.extension), temp("loop_from_intro_sequence_x_in" + intermediateFormat.extension),
+                      temp("loop_from_loop_sequence_x_out" + intermediateFormat.extension), temp("loop_from_loop_sequence_x_in" + intermediateFormat.extension) },
+                    { temp("loop_from_intro_sequence_x" + intermediateFormat.extension), temp("loop_from_loop_sequence_x" + intermediateFormat.extension) }, sequenceCrossfades,
+                    [=, this, &introClips, &loopClips] { return generateInterpolatedCrossfades(tempDirectory, introClips, loopClips); }),
+            "intro=" + joinCrossfades(introClips) + ";loop=" + joinCrossfades(loopClips));
+    cacheAs(addTask(TaskType::Concat, "loop_sequences",
+                    { temp("loop_from_intro_sequence_x" + intermediateFormat.extension), temp("loop_from_intro_body_cut_in_cut_out" + intermediateFormat.extension),
+                      temp("loop_from_loop_sequence_x" + intermediateFormat.extension), temp("loop_from_loop_body_cut_in_cut_out" + intermediateFormat.extension) },
+                    { loopFromIntroSequence, loopFromLoopSequence }, 2.0 * loopDuration,
+                    [=, this] { return assembleFinalLoopSequences(tempDirectory); }),
+            "final_loop_sequences");
+    
+    // Steps 6 and 7 without re-encoding the repeats: every piece of the timeline is
+    // delivery-encoded once and the loop body is repeated by stream copy. Only worth it
+    // once the body repeats; overlays touch every repeat, so they keep the full encode.
+    if (encodeOnce && overlayClips.empty() && !loopClips.empty() && targetDuration > introDuration + 3.0 * loopDuration)
+    {
+        const juce::String encodeRecipe = "final=" + getFinalVideoEncodeArgs();
+        const juce::File introSequence = temp("intro_sequence" + intermediateFormat.extension);
+        juce::Array<juce::File> sequences { loopFromIntroSequence, loopFromLoopSequence };
+        juce::Array<juce::File> pieces;
+        
+        // The fade-in lands on whichever piece comes first
+        if (!introClips.empty())
+        {
+            sequences.insert(0, introSequence);
+            pieces.add(temp("final_intro.mp4"));
+            cacheAs(addTask(TaskType::Encode, "final_intro", { introSequence }, { pieces.getLast() }, introDuration,
+                            [=, this] { return encodeFinalPiece(introSequence, temp("final_intro.mp4"), fadeInDuration); }),
+                    encodeRecipe + ";fade_in=" + juce::String(fadeInDuration, 6));
+        }
+        
+        const double loopFromIntroFadeIn = introClips.empty() ? fadeInDuration : 0.0;
+        pieces.add(temp("final_loop_from_intro.mp4"));
+        cacheAs(addTask(TaskType::Encode, "final_loop_from_intro", { loopFromIntroSequence }, { pieces.getLast() }, loopDuration,
+                        [=, this] { return encodeFinalPiece(loopFromIntroSequence, temp("final_loop_from_intro.mp4"), loopFromIntroFadeIn); }),
+                encodeRecipe + ";fade_in=" + juce::String(loopFromIntroFadeIn, 6));
+        
+        pieces.add(temp("final_loop_body.mp4"));
+        cacheAs(addTask(TaskType::Encode, "final_loop_body", { loopFromLoopSequence }, { pieces.getLast() }, loopDuration,
+                        [=, this] { return encodeFinalPiece(loopFromLoopSequence, temp("final_loop_body.mp4"), 0.0); }),
+                encodeRecipe);
+        
+        // The tail is cut from the last few loop bodies, so it needs every sequence's length
+        pieces.add(temp("final_tail.mp4"));
+        cacheAs(addTask(TaskType::Encode, "final_tail", sequences, { pieces.getLast() }, loopDuration + fadeOutDuration,
+                        [=, this] { return encodeFinalTail(targetDuration, tempDirectory); }),
+                encodeRecipe + ";target=" + juce::String(targetDuration, 6) + ";fade_out=" + juce::String(fadeOutDuration, 6));
+        
+        // Video is stream copied; only the audio is encoded. The sequences are inputs too,
+        // for the full encode it falls back to if the measured lengths don't allow a copy.
+        juce::Array<juce::File> muxInputs = pieces;
+        muxInputs.addArray(sequences);
+        muxInputs.add(audioFile);
+        
+        addTask(TaskType::Mux, outputFile.getFileName(), muxInputs, { outputFile }, 0.1 * targetDuration,
+                [=, this] { return muxEncodedPieces(audioFile, targetDuration, tempDirectory, outputFile); });
+        return;
+    }
+    
+    // Step 6. Building the final sequence deletes the clip intermediates, which is
+    // safe because it transitively depends on every task that reads them.
+    const juce::File withoutOverlays = temp("output_sequence_without_overlays" + intermediateFormat.extension);
+    const juce::File withOverlays = temp("output_sequence_with_overlays" + intermediateFormat.extension);
+    
+    cacheAs(addTask(TaskType::Concat, "output_sequence_without_overlays",
+                    { temp("intro_sequence" + intermediateFormat.extension), loopFromIntroSequence, loopFromLoopSequence }, { withoutOverlays }, targetDuration,
+                    [=, this] { return buildFinalSequence(targetDuration, tempDirectory); }),
+            "target=" + juce::String(targetDuration, 6));
+    
+    juce::File finalVideo = withoutOverlays;
+    if (!overlayClips.empty())
+    {
+        // The overlaid copy keeps its own name; muxFinalOutput prefers it when present
+        juce::Array<juce::File> inputs { withoutOverlays };
+        juce::String overlayRecipe = "target=" + juce::String(targetDuration, 6)
+                                   + ";params=" + losslessParams;
+        for (const auto& overlay : overlayClips)
+        {
+            inputs.add(overlay.file);
+            for (const auto& variant : overlay.variants)
+                inputs.add(variant.file);
 
-        juce::String primaryParams = ensureCodecParam(useNvidiaAcceleration ? tempNvidiaParams : tempCpuParams,
-                                                      useNvidiaAcceleration);
-        juce::String command = buildCommand(ffmpegExecutor, inputFile, outputFile, requestedDuration, safeStartTime, effectiveSourceDuration, primaryParams);
+            overlayRecipe << ";overlay=" << juce::String(overlay.startTimeSecs, 6) << "," << juce::String(overlay.frequencySecs, 6)
+                          << "," << juce::String(overlay.duration, 6);
 
-        if (!ffmpegExecutor->executeCommand(command, 0.0, 1.0))
+            const auto schedule = OverlaySchedule::describe(overlay);
+            if (schedule.isNotEmpty())
+                overlayRecipe << "," << schedule;
+        }
+        
+        cacheAs(addTask(TaskType::Overlay, "output_sequence_with_overlays", inputs, { withOverlays }, targetDuration,
+                        [=, this, &overlayClips] { return applyOverlays(withoutOverlays, overlayClips, withOverlays); }),
+                overlayRecipe);
+        finalVideo = withOverlays;
+    }
+    
+    // Step 7. The output isn't an intermediate, so it has no recipe and is never cached.
+    // Long renders encode keyframe-aligned segments side by side and join them by stream copy.
+    const int segments = getFinalSegmentCount(targetDuration);
+    if (segments > 1)
+    {
+        juce::Array<juce::File> muxInputs { finalVideo, audioFile };
+        const juce::String segmentRecipe = "final=" + getFinalVideoEncodeArgs() + ";segments=" + juce::String(segments)
+                                         + ";fade_in=" + juce::String(fadeInDuration, 6) + ";fade_out=" + juce::String(fadeOutDuration, 6);
+        const auto source = std::make_shared<SegmentSource>();
+        source->targetDuration = targetDuration;
+        
+        for (int k = 0; k < segments; ++k)
         {
-            if (useNvidiaAcceleration)
-            {
-                if (logCallback) logCallback("WARNING: NVENC conform failed for " + label + ", retrying with CPU preset");
-                juce::String fallbackParams = ensureCodecParam(tempCpuParams, false);
-                juce::String fallbackCommand = buildCommand(ffmpegExecutor, inputFile, outputFile, requestedDuration, safeStartTime, effectiveSourceDuration, fallbackParams);
-                if (!ffmpegExecutor->executeCommand(fallbackCommand, 0.0, 1.0))
-                {
-                    if (logCallback) logCallback("ERROR: CPU fallback also failed for " + label);
-                    return false;
-                }
-            }
-            else
-            {
-                if (logCallback) logCallback("ERROR: Failed to conform " + label);
-                return false;
-            }
+            const juce::File segment = getFinalSegmentFile(tempDirectory, k);
+            cacheAs(addTask(TaskType::Encode, segment.getFileNameWithoutExtension(), { finalVideo }, { segment }, targetDuration / segments,
+                            [=, this] { return encodeFinalSegment(finalVideo, *source, k, segments, tempDirectory); }),
+                    segmentRecipe + ";index=" + juce::String(k));
+            muxInputs.add(segment);
         }
+        
+        addTask(TaskType::Mux, outputFile.getFileName(), muxInputs, { outputFile }, 0.1 * targetDuration,
+                [=, this] { return muxFinalSegments(audioFile, finalVideo, *source, segments, tempDirectory, outputFile); });
+        return;
+    }
+    
+    addTask(TaskType::Mux, outputFile.getFileName(), { finalVideo, audioFile }, { outputFile }, targetDuration,
+            [=, this] { return muxFinalOutput(audioFile, tempDirectory, outputFile); });
+}
 
+void TimelineAssembler::selectIntermediateFormat(double targetDuration, const juce::File& tempDirectory)
+{
+    const auto report = EncoderCapabilities::getInstance().getReport(ffmpegExecutor->getFFmpegPath());
+    
+    juce::String reason;
+    intermediateFormat = IntermediateFormat::choose(report, targetDuration, tempDirectory, reason);
+    losslessParams = intermediateFormat.codecArgs;
+    
+    if (logCallback)
+        logCallback("Intermediate format: " + intermediateFormat.name + " (" + intermediateFormat.extension.substring(1)
+                    + ", " + reason + ")");
+}
+
+void TimelineAssembler::configureDiskBudget(const std::vector<RenderTypes::VideoClipInfo>& clips)
+{
+    FFmpegExecutor::VideoStreamInfo info;
+    if (!clips.empty())
+        info = ffmpegExecutor->getVideoStreamInfo(clips.front().file);
+    
+    const double width = info.width > 0 ? info.width : 1920.0;
+    const double height = info.height > 0 ? info.height : 1080.0;
+    const double fps = info.fps > 0.0 ? info.fps : 30.0;
+    
+    // The cost model scales task estimates by the same geometry
+    sourceGeometry.width = (int) width;
+    sourceGeometry.height = (int) height;
+    sourceGeometry.fps = fps;
+    
+    // The probe measured 1080p; without a measurement assume half of raw 4:2:0
+    const auto report = EncoderCapabilities::getInstance().getReport(ffmpegExecutor->getFFmpegPath());
+    const auto* measured = report.findIntermediate(intermediateFormat.name);
+    const double bytesPerFrame = measured != nullptr && measured->working && measured->bytesPerFrame > 0.0
+        ? measured->bytesPerFrame * (width * height) / (1920.0 * 1080.0)
+        : 0.5 * width * height * 1.5;
+    
+    // CRF encodes have no bitrate to read; assume the NVENC preset's ceiling
+    const double bitsPerSecond = DiskBudget::parseBitrate(useNvidiaAcceleration ? finalNvidiaParams : finalCpuParams);
+    
+    diskBudget.setLogCallback(logCallback);
+    diskBudget.setRates(bytesPerFrame * fps, (bitsPerSecond > 0.0 ? bitsPerSecond : 25.0e6) / 8.0);
+}
+
+bool TimelineAssembler::renderWithFilterGraph(const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                                              const std::vector<RenderTypes::VideoClipInfo>& loopClips,
+                                              const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
+                                              const juce::File& audioFile,
+                                              double targetDuration,
+                                              const juce::File& tempDirectory,
+                                              const juce::File& outputFile,
+                                              bool& handled)
+{
+    handled = false;
+    
+    FilterGraphRenderer renderer(ffmpegExecutor);
+    renderer.setLogCallback(logCallback);
+    
+    FilterGraphRenderer::Settings settings;
+    settings.videoEncodeArgs = getFinalVideoEncodeArgs();
+    settings.audioFilter = buildFinalAudioFilter(targetDuration);
+    settings.fadeInDuration = fadeInDuration;
+    settings.fadeOutDuration = fadeOutDuration;
+    
+    // The GPU profile only where the probe ran the CUDA filters into NVENC; a machine
+    // without an NVIDIA GPU fails that probe and gets the CPU filters
+    if (useNvidiaAcceleration && cudaFilters)
+    {
+        const auto report = EncoderCapabilities::getInstance().getReport(ffmpegExecutor->getFFmpegPath());
+        settings.cudaFilters = report.cudaFilters;
+        if (!report.cudaFilters && logCallback)
+            logCallback("CUDA filter profile unavailable (" + report.cudaFailureReason + "); using the CPU filters");
+    }
+    
+    auto useCpuProfile = [&]
+    {
+        settings.cudaFilters = false;
+        settings.videoEncodeArgs = getFinalVideoEncodeArgs();
+    };
+    
+    // NVENC takes the CUDA frames as they are; asking for a software pixel format would download them
+    if (settings.cudaFilters)
+        settings.videoEncodeArgs = settings.videoEncodeArgs.replace(" -pix_fmt yuv420p", "");
+    
+    juce::String reason;
+    bool compiled = renderer.compile(introClips, loopClips, overlayClips, audioFile, targetDuration, settings, outputFile, reason);
+    
+    if (!compiled && settings.cudaFilters) {
+        if (logCallback) logCallback("WARNING: CUDA filtergraph not used (" + reason + "); using the CPU filters");
+        useCpuProfile();
+        compiled = renderer.compile(introClips, loopClips, overlayClips, audioFile, targetDuration, settings, outputFile, reason);
+    }
+    
+    if (!compiled) {
+        if (logCallback) logCallback("WARNING: Single-pass filtergraph not used (" + reason + "); using the file-based pipeline");
+        return false;
+    }
+    
+    const juce::String plan = renderer.describe();
+    if (logCallback) logCallback(plan);
+    
+    if (dryRun) {
+        juce::File planFile = tempDirectory.getChildFile("render_filtergraph.txt");
+        planFile.replaceWithText(plan);
+        if (logCallback) logCallback("Dry run: filtergraph written to " + planFile.getFullPathName() + ", nothing was rendered");
+        handled = true;
         return true;
-    };
+    }
+    
+    bool succeeded = renderer.run(tempDirectory);
+    
+    // A driver or decoder the probe didn't cover gets the same graph on the CPU first
+    if (!succeeded && settings.cudaFilters && !isCancelled())
+    {
+        if (logCallback) logCallback("WARNING: CUDA filtergraph render failed; retrying with the CPU filters");
+        outputFile.deleteFile();
+        useCpuProfile();
+        succeeded = renderer.compile(introClips, loopClips, overlayClips, audioFile, targetDuration, settings, outputFile, reason)
+                    && renderer.run(tempDirectory);
+    }
+    
+    if (succeeded) {
+        handled = true;
+        return true;
+    }
+    
+    // A cancelled render stays cancelled; anything else gets another go the long way
+    if (isCancelled()) {
+        handled = true;
+        return false;
+    }
+    
+    if (logCallback) logCallback("WARNING: Single-pass filtergraph render failed; using the file-based pipeline");
+    outputFile.deleteFile();
+    return false;
+}
 
-    for (size_t i = 0; i < introClips.size(); ++i)
+double TimelineAssembler::estimateTaskSeconds(RenderGraph::TaskType type, double mediaSeconds) const
+{
+    if (costModel != nullptr)
     {
-        const auto& clip = introClips[i];
-        juce::File inputFile = clip.file;
-        juce::File outputFile = tempDirectory.getChildFile("intro_" + juce::String(i) + ".mp4");
+        // Delivery encodes use the final encoder; everything else writes intermediates
+        const bool delivery = type == RenderGraph::TaskType::Encode || type == RenderGraph::TaskType::Mux;
+        const juce::String params = delivery ? (useNvidiaAcceleration ? finalNvidiaParams : finalCpuParams) : losslessParams;
+        
+        RenderCostModel::Step step;
+        step.stage = RenderGraph::getTaskTypeName(type);
+        step.encoder = delivery ? juce::String(useNvidiaAcceleration ? "h264_nvenc" : "libx264")
+                                : RenderCostModel::findOption(params, "-c:v");
+        step.preset = RenderCostModel::findOption(params, "-preset");
+        step.width = sourceGeometry.width;
+        step.height = sourceGeometry.height;
+        step.framesPerSecond = sourceGeometry.fps;
+        step.mediaSeconds = juce::jmax(0.0, mediaSeconds);
+        
+        const double predicted = costModel->predictSeconds(step);
+        if (predicted >= 0.0)
+            return predicted;
+    }
+    
+    return getDefaultTaskSeconds(type, mediaSeconds);
+}
 
-        if (!conformClip(clip, inputFile, outputFile, "intro_" + juce::String(i)))
-        {
-            if (logCallback) logCallback("ERROR: Failed to conform intro clip " + juce::String(i));
-            return false;
+void TimelineAssembler::applyIntermediateCache(RenderGraph& graph)
+{
+    const auto keys = intermediateCache->computeKeys(graph);
+    const auto& order = graph.getTopologicalOrder();
+    std::vector<bool> needed((size_t) graph.getNumTasks(), false);
+    int restored = 0;
+    int skipped = 0;
+    
+    // Walk back from the output: a task whose outputs are cached is restored instead of
+    // run, and whatever only fed it is skipped. Only the invalidated suffix is rendered.
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        const int taskId = *it;
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        
+        if (task.dependents.empty())
+            needed[(size_t) taskId] = true;
+        
+        if (!needed[(size_t) taskId]) {
+            graph.setTaskRunner(taskId, RenderGraph::TaskState::Skip, 0.0, nullptr);
+            ++skipped;
+            continue;
         }
-
-        if (logCallback) logCallback("Conformed intro_" + juce::String(i) + ": " + juce::String(clip.duration) + "s");
+        
+        // Already kept from an interrupted run of this render
+        if (task.state == RenderGraph::TaskState::Restore)
+            continue;
+        
+        const juce::String key = keys[(size_t) taskId];
+        const juce::Array<juce::File> outputs = task.outputs;
+        
+        if (intermediateCache->contains(key)) {
+            graph.setTaskRunner(taskId, RenderGraph::TaskState::Restore, 0.0,
+                                [this, key, outputs] { return intermediateCache->restore(key, outputs); });
+            ++restored;
+            continue;
+        }
+        
+        if (key.isNotEmpty()) {
+            auto run = task.run;
+            graph.setTaskRunner(taskId, RenderGraph::TaskState::Run, task.estimatedSeconds,
+                                [this, key, outputs, run]
+                                {
+                                    if (!run())
+                                        return false;
+                                    intermediateCache->store(key, outputs);
+                                    return true;
+                                });
+        }
+        
+        for (int dependency : task.dependencies)
+            needed[(size_t) dependency] = true;
     }
+    
+    if (logCallback)
+        logCallback("Intermediate cache (" + intermediateCache->getDirectory().getFullPathName() + "): "
+                    + juce::String(restored) + " tasks restored, " + juce::String(skipped) + " skipped");
+}
 
-    for (size_t i = 0; i < loopClips.size(); ++i)
+void TimelineAssembler::applyRenderJournal(RenderGraph& graph)
+{
+    const auto& order = graph.getTopologicalOrder();
+    std::vector<bool> needed((size_t) graph.getNumTasks(), false);
+    int kept = 0;
+    int skipped = 0;
+    
+    // The same walk as the cache, but the outputs are still in place: nothing to restore
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
     {
-        const auto& clip = loopClips[i];
-        juce::File inputFile = clip.file;
-        juce::File outputFile = tempDirectory.getChildFile("loop_" + juce::String(i) + ".mp4");
-
-        if (!conformClip(clip, inputFile, outputFile, "loop_" + juce::String(i)))
-        {
-            if (logCallback) logCallback("ERROR: Failed to conform loop clip " + juce::String(i));
-            return false;
+        const int taskId = *it;
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        
+        if (task.dependents.empty())
+            needed[(size_t) taskId] = true;
+        
+        if (!needed[(size_t) taskId]) {
+            graph.setTaskRunner(taskId, RenderGraph::TaskState::Skip, 0.0, nullptr);
+            ++skipped;
+            continue;
         }
-
-        if (logCallback) logCallback("Conformed loop_" + juce::String(i) + ": " + juce::String(clip.duration) + "s (from file: " + clip.file.getFileName() + ")");
+        
+        if (renderJournal->isStepValid(task.name, task.recipe)) {
+            graph.setTaskRunner(taskId, RenderGraph::TaskState::Restore, 0.0, [] { return true; });
+            ++kept;
+            continue;
+        }
+        
+        for (int dependency : task.dependencies)
+            needed[(size_t) dependency] = true;
     }
+    
+    if (logCallback && kept > 0)
+        logCallback("Resuming from " + renderJournal->getFile().getFullPathName() + ": "
+                    + juce::String(kept) + " tasks already done, " + juce::String(skipped) + " skipped");
+}
 
-    return true;
+void TimelineAssembler::recordToRenderJournal(RenderGraph& graph)
+{
+    for (int taskId = 0; taskId < graph.getNumTasks(); ++taskId)
+    {
+        const RenderGraph::Task& task = graph.getTask(taskId);
+        if (task.state == RenderGraph::TaskState::Skip)
+            continue;
+        
+        // Restored from the cache counts as done too; kept ones are journaled already
+        auto run = task.run;
+        const juce::String name = task.name;
+        const juce::String recipe = task.recipe;
+        const juce::Array<juce::File> outputs = task.outputs;
+        graph.setTaskRunner(taskId, task.state, task.estimatedSeconds,
+                            [this, run, name, recipe, outputs]
+                            {
+                                if (!run())
+                                    return false;
+                                if (!renderJournal->isStepValid(name, recipe))
+                                    renderJournal->recordStep(name, recipe, outputs);
+                                return true;
+                            });
+    }
 }
 
 // STEP 2: Generate Crossfade Components Between Clips
@@ -407,44 +1047,36 @@ bool TimelineAssembler::generateCrossfadeComponents(const std::vector<RenderType
 {
     if (logCallback) logCallback("Generating crossfade components between clips...");
     
-    // Generate intro crossfades (if more than one intro clip)
-    if (introClips.size() > 1) {
-        for (size_t i = 0; i < introClips.size() - 1; i++) {
-            if (introClips[i].crossfade > 0.001) {
-                // Generate crossfade segments and transition
-                if (!generateCrossfadeForClipPair("intro", i, i+1, introClips[i], introClips[i+1], tempDirectory)) {
-                    return false;
-                }
-                
-                // For middle clips (clips that have crossfades on both sides), 
-                // create the body_cut_in_cut_out segment
-                if (i + 1 < introClips.size() - 1 && introClips[i+1].crossfade > 0.001) {
-                    // Clip at index i+1 is a middle clip - create body_cut_in_cut_out
-                    if (!createMiddleClipBodySegment("intro", i+1, introClips[i].crossfade, introClips[i+1].crossfade, tempDirectory)) {
-                        return false;
-                    }
-                }
-            }
-        }
-    }
-    
-    // Generate loop crossfades (if more than one loop clip)
-    if (loopClips.size() > 1) {
-        for (size_t i = 0; i < loopClips.size() - 1; i++) {
-            if (loopClips[i].crossfade > 0.001) {
-                // Generate crossfade segments and transition
-                if (!generateCrossfadeForClipPair("loop", i, i+1, loopClips[i], loopClips[i+1], tempDirectory)) {
+    for (const auto* list : { &introClips, &loopClips })
+    {
+        const juce::String type = list == &introClips ? "intro" : "loop";
+        const auto& clips = *list;
+        
+        // All transitions of the list in batched commands, then the bodies around them
+        if (!generateBatchedCrossfades(type, clips, tempDirectory))
+            return false;
+        
+        for (size_t i = 0; i + 1 < clips.size(); i++) {
+            if (isCancelled())
+                return false;
+            
+            const double crossfade = clips[i].crossfade;
+            if (crossfade <= 0.001)
+                continue;
+            
+            const juce::File fromClipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
+            const juce::File toClipFile = tempDirectory.getChildFile(type + "_" + juce::String(i + 1) + intermediateFormat.extension);
+            
+            if (!extractBodySegment(fromClipFile, type + "_" + juce::String(i) + "_body_cut_out" + intermediateFormat.extension,
+                                    0.0, crossfade, true, tempDirectory)
+                || !extractBodySegment(toClipFile, type + "_" + juce::String(i + 1) + "_body_cut_in" + intermediateFormat.extension,
+                                       0.0, crossfade, false, tempDirectory))
+                return false;
+            
+            // Clips with crossfades on both sides also need the body_cut_in_cut_out segment
+            if (i + 2 < clips.size() && clips[i + 1].crossfade > 0.001) {
+                if (!createMiddleClipBodySegment(type, i + 1, crossfade, clips[i + 1].crossfade, tempDirectory))
                     return false;
-                }
-                
-                // For middle clips (clips that have crossfades on both sides), 
-                // create the body_cut_in_cut_out segment
-                if (i + 1 < loopClips.size() - 1 && loopClips[i+1].crossfade > 0.001) {
-                    // Clip at index i+1 is a middle clip - create body_cut_in_cut_out
-                    if (!createMiddleClipBodySegment("loop", i+1, loopClips[i].crossfade, loopClips[i+1].crossfade, tempDirectory)) {
-                        return false;
-                    }
-                }
             }
         }
     }
@@ -466,14 +1098,21 @@ bool TimelineAssembler::assembleIntroSequence(const std::vector<RenderTypes::Vid
     if (logCallback) logCallback("Assembling intro sequence...");
     
     // Build intro_sequence_raw by concatenating components
-    juce::File introSequenceRaw = tempDirectory.getChildFile("intro_sequence_raw.mp4");
+    juce::File introSequenceRaw = tempDirectory.getChildFile("intro_sequence_raw" + intermediateFormat.extension);
     if (!buildRawSequence("intro", introClips, tempDirectory, introSequenceRaw)) {
         return false;
     }
     
+    return finishIntroSequence(introClips, tempDirectory);
+}
+
+bool TimelineAssembler::finishIntroSequence(const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                                            const juce::File& tempDirectory)
+{
     // Trim the final crossfade to create intro_sequence
-    juce::File introSequence = tempDirectory.getChildFile("intro_sequence.mp4");
-    juce::File loopFromIntroSequenceXOut = tempDirectory.getChildFile("loop_from_intro_sequence_x_out.mp4");
+    juce::File introSequenceRaw = tempDirectory.getChildFile("intro_sequence_raw" + intermediateFormat.extension);
+    juce::File introSequence = tempDirectory.getChildFile("intro_sequence" + intermediateFormat.extension);
+    juce::File loopFromIntroSequenceXOut = tempDirectory.getChildFile("loop_from_intro_sequence_x_out" + intermediateFormat.extension);
     
     double lastCrossfadeDuration = introClips.back().crossfade;
     
@@ -517,7 +1156,7 @@ bool TimelineAssembler::assembleLoopSequence(const std::vector<RenderTypes::Vide
     if (logCallback) logCallback("Assembling loop sequence...");
     
     // Build loop_sequence_raw
-    juce::File loopSequenceRaw = tempDirectory.getChildFile("loop_sequence_raw.mp4");
+    juce::File loopSequenceRaw = tempDirectory.getChildFile("loop_sequence_raw" + intermediateFormat.extension);
     if (!buildRawSequence("loop", loopClips, tempDirectory, loopSequenceRaw)) {
         return false;
     }
@@ -553,10 +1192,15 @@ bool TimelineAssembler::finalLoopSequenceAssembly(const juce::File& tempDirector
         return false;
     }
     
+    return assembleFinalLoopSequences(tempDirectory);
+}
+
+bool TimelineAssembler::assembleFinalLoopSequences(const juce::File& tempDirectory)
+{
     // Assemble loop_from_intro_sequence
-    juce::File loopFromIntroSequenceX = tempDirectory.getChildFile("loop_from_intro_sequence_x.mp4");
-    juce::File loopFromIntroBodyCutInCutOut = tempDirectory.getChildFile("loop_from_intro_body_cut_in_cut_out.mp4");
-    juce::File loopFromIntroSequence = tempDirectory.getChildFile("loop_from_intro_sequence.mp4");
+    juce::File loopFromIntroSequenceX = tempDirectory.getChildFile("loop_from_intro_sequence_x" + intermediateFormat.extension);
+    juce::File loopFromIntroBodyCutInCutOut = tempDirectory.getChildFile("loop_from_intro_body_cut_in_cut_out" + intermediateFormat.extension);
+    juce::File loopFromIntroSequence = tempDirectory.getChildFile("loop_from_intro_sequence" + intermediateFormat.extension);
     
     // Check if intro crossfade was actually created (crossfade duration > 0)
     if (loopFromIntroSequenceX.existsAsFile()) {
@@ -575,9 +1219,9 @@ bool TimelineAssembler::finalLoopSequenceAssembly(const juce::File& tempDirector
     }
     
     // Assemble final loop_from_loop_sequence: [crossfade] + [body]
-    juce::File loopFromLoopSequenceX = tempDirectory.getChildFile("loop_from_loop_sequence_x.mp4");
-    juce::File loopFromLoopBodyCutInCutOut = tempDirectory.getChildFile("loop_from_loop_body_cut_in_cut_out.mp4");
-    juce::File loopFromLoopSequence = tempDirectory.getChildFile("loop_from_loop_sequence.mp4");
+    juce::File loopFromLoopSequenceX = tempDirectory.getChildFile("loop_from_loop_sequence_x" + intermediateFormat.extension);
+    juce::File loopFromLoopBodyCutInCutOut = tempDirectory.getChildFile("loop_from_loop_body_cut_in_cut_out" + intermediateFormat.extension);
+    juce::File loopFromLoopSequence = tempDirectory.getChildFile("loop_from_loop_sequence" + intermediateFormat.extension);
 
     if (loopFromLoopSequenceX.existsAsFile()) {
         // Normal case: crossfade exists, concatenate crossfade + body
@@ -609,42 +1253,51 @@ bool TimelineAssembler::calculateFinalAssemblyAndProcessOverlays(const std::vect
 {
     if (logCallback) logCallback("Calculating final assembly and processing overlays...");
     
-    auto deleteIfExists = [&](const juce::File& file, const juce::String& label)
-    {
-        if (file.existsAsFile())
-        {
-            if (logCallback) logCallback("Deleting " + label + ": " + file.getFileName());
-            file.deleteFile();
-        }
-    };
+    if (!buildFinalSequence(targetDuration, tempDirectory))
+        return false;
     
-    auto cleanupClipIntermediates = [&]()
-    {
-        for (juce::DirectoryIterator it(tempDirectory, false, "*.mp4", juce::File::findFiles); it.next();)
-        {
-            const juce::String name = it.getFile().getFileName();
-            
-            // Drop heavy clip-level intermediates once final sequences exist
-            const bool isLoopClip = name.startsWith("loop_") && !name.startsWith("loop_from_");
-            const bool isPreparedClip = name.startsWith("loop_clip_") || name.startsWith("intro_clip_");
-            const bool isRawSequence = name == "loop_sequence_raw.mp4" || name == "intro_sequence_raw.mp4";
-            
-            if (isLoopClip || isPreparedClip || isRawSequence)
-                deleteIfExists(it.getFile(), "intermediate clip");
+    // Apply overlays if they exist
+    if (!overlayClips.empty()) {
+        juce::File outputSequenceWithoutOverlays = tempDirectory.getChildFile("output_sequence_without_overlays" + intermediateFormat.extension);
+        juce::File outputSequenceWithOverlays = tempDirectory.getChildFile("output_sequence_with_overlays" + intermediateFormat.extension);
+        if (!applyOverlays(outputSequenceWithoutOverlays, overlayClips, outputSequenceWithOverlays)) {
+            return false;
         }
-    };
+        
+        if (outputSequenceWithOverlays.existsAsFile()) {
+            outputSequenceWithoutOverlays.deleteFile();
+            outputSequenceWithOverlays.moveFileTo(outputSequenceWithoutOverlays);
+        }
+    }
     
+    if (logCallback) logCallback("Final assembly and overlay processing completed");
+    return true;
+}
+
+bool TimelineAssembler::buildFinalSequence(double targetDuration, const juce::File& tempDirectory)
+{
     // Measure sequence durations
-    juce::File introSequence = tempDirectory.getChildFile("intro_sequence.mp4");
-    juce::File loopFromIntroSequence = tempDirectory.getChildFile("loop_from_intro_sequence.mp4");
-    juce::File loopFromLoopSequence = tempDirectory.getChildFile("loop_from_loop_sequence.mp4");
+    juce::File introSequence = tempDirectory.getChildFile("intro_sequence" + intermediateFormat.extension);
+    juce::File loopFromIntroSequence = tempDirectory.getChildFile("loop_from_intro_sequence" + intermediateFormat.extension);
+    juce::File loopFromLoopSequence = tempDirectory.getChildFile("loop_from_loop_sequence" + intermediateFormat.extension);
     
-    double introSeqDuration = introSequence.existsAsFile() ? ffmpegExecutor->getFileDuration(introSequence) : 0.0;
-    double loopFromIntroDuration = loopFromIntroSequence.existsAsFile() ? ffmpegExecutor->getFileDuration(loopFromIntroSequence) : 0.0;
-    double loopFromLoopDuration = loopFromLoopSequence.existsAsFile() ? ffmpegExecutor->getFileDuration(loopFromLoopSequence) : 0.0;
+    double introSeqDuration = introSequence.existsAsFile() ? getIntermediateDuration(introSequence) : 0.0;
+    double loopFromIntroDuration = loopFromIntroSequence.existsAsFile() ? getIntermediateDuration(loopFromIntroSequence) : 0.0;
+    double loopFromLoopDuration = loopFromLoopSequence.existsAsFile() ? getIntermediateDuration(loopFromLoopSequence) : 0.0;
     
     // Free clip-level intermediates now that we have the assembled sequences
-    cleanupClipIntermediates();
+    for (juce::DirectoryIterator it(tempDirectory, false, "*" + intermediateFormat.extension, juce::File::findFiles); it.next();)
+    {
+        const juce::String name = it.getFile().getFileName();
+        
+        // Drop heavy clip-level intermediates once final sequences exist
+        const bool isLoopClip = name.startsWith("loop_") && !name.startsWith("loop_from_");
+        const bool isPreparedClip = name.startsWith("loop_clip_") || name.startsWith("intro_clip_");
+        const bool isRawSequence = name == "loop_sequence_raw" + intermediateFormat.extension || name == "intro_sequence_raw" + intermediateFormat.extension;
+        
+        if (isLoopClip || isPreparedClip || isRawSequence)
+            deleteIfExists(it.getFile(), "intermediate clip");
+    }
     
     // Calculate repetition count
     double remainingDuration = targetDuration - introSeqDuration - loopFromIntroDuration;
@@ -658,37 +1311,20 @@ bool TimelineAssembler::calculateFinalAssemblyAndProcessOverlays(const std::vect
         logCallback("Loop repetitions needed: " + juce::String(x));
     }
     
-    // Build provisional final sequence
-    juce::File provisionalSequence = tempDirectory.getChildFile("provisional_sequence.mp4");
-    if (!buildProvisionalSequence(introSequence, loopFromIntroSequence, loopFromLoopSequence, x, provisionalSequence)) {
-        return false;
-    }
-    
-    // Trim to exact duration
-    juce::File outputSequenceWithoutOverlays = tempDirectory.getChildFile("output_sequence_without_overlays.mp4");
-    if (!trimToExactDuration(provisionalSequence, outputSequenceWithoutOverlays, targetDuration)) {
-        return false;
-    }
-    
-    // Provisional sequence is huge; delete once the trimmed version exists
-    deleteIfExists(provisionalSequence, "provisional sequence");
-    deleteIfExists(tempDirectory.getChildFile("provisional_concat.txt"), "provisional concat list");
-    
-    // Apply overlays if they exist
-    if (!overlayClips.empty()) {
-        juce::File outputSequenceWithOverlays = tempDirectory.getChildFile("output_sequence_with_overlays.mp4");
-        if (!applyOverlays(outputSequenceWithoutOverlays, overlayClips, outputSequenceWithOverlays)) {
-            return false;
-        }
-        
-        if (outputSequenceWithOverlays.existsAsFile()) {
-            outputSequenceWithoutOverlays.deleteFile();
-            outputSequenceWithOverlays.moveFileTo(outputSequenceWithoutOverlays);
-        }
+    // Concatenate straight to the exact duration; no full-length provisional copy to trim
+    juce::File outputSequenceWithoutOverlays = tempDirectory.getChildFile("output_sequence_without_overlays" + intermediateFormat.extension);
+    return concatenateToDuration(introSequence, loopFromIntroSequence, loopFromLoopSequence, x, targetDuration,
+                                 { introSeqDuration, loopFromIntroDuration, loopFromLoopDuration },
+                                 outputSequenceWithoutOverlays);
+}
+
+void TimelineAssembler::deleteIfExists(const juce::File& file, const juce::String& label)
+{
+    if (file.existsAsFile())
+    {
+        if (logCallback) logCallback("Deleting " + label + ": " + file.getFileName());
+        file.deleteFile();
     }
-    
-    if (logCallback) logCallback("Final assembly and overlay processing completed");
-    return true;
 }
 
 // STEP 7: Mux Final Output
@@ -699,9 +1335,9 @@ bool TimelineAssembler::muxFinalOutput(const juce::File& audioFile,
     if (logCallback) logCallback("Muxing final output...");
     
     // Determine which video sequence to use
-    juce::File videoSequence = tempDirectory.getChildFile("output_sequence_with_overlays.mp4");
+    juce::File videoSequence = tempDirectory.getChildFile("output_sequence_with_overlays" + intermediateFormat.extension);
     if (!videoSequence.existsAsFile()) {
-        videoSequence = tempDirectory.getChildFile("output_sequence_without_overlays.mp4");
+        videoSequence = tempDirectory.getChildFile("output_sequence_without_overlays" + intermediateFormat.extension);
     }
     
     if (!videoSequence.existsAsFile()) {
@@ -846,83 +1482,576 @@ bool TimelineAssembler::muxFinalOutput(const juce::File& audioFile,
     
     
     if (!ffmpegExecutor->executeCommand(command, 0.0, 1.0)) {
-        if (logCallback)
-            logCallback("ERROR: Failed to mux final output");
+        if (logCallback)
+            logCallback("ERROR: Failed to mux final output");
+        return false;
+    }
+    
+    // Delete temporary video sequence files
+    tempDirectory.getChildFile("output_sequence_with_overlays" + intermediateFormat.extension).deleteFile();
+    tempDirectory.getChildFile("output_sequence_without_overlays" + intermediateFormat.extension).deleteFile();
+    
+    if (logCallback) logCallback("Final output muxed successfully: " + outputFile.getFullPathName());
+    return true;
+}
+
+//==============================================================================
+// Encode-once final output
+TimelineAssembler::LoopRepetitionPlan TimelineAssembler::planLoopRepetition(double targetDuration, const juce::File& tempDirectory)
+{
+    LoopRepetitionPlan plan;
+    
+    const juce::File introSequence = tempDirectory.getChildFile("intro_sequence" + intermediateFormat.extension);
+    plan.introSeconds = introSequence.existsAsFile() ? getIntermediateDuration(introSequence) : 0.0;
+    plan.loopFromIntroSeconds = getIntermediateDuration(tempDirectory.getChildFile("loop_from_intro_sequence" + intermediateFormat.extension));
+    plan.bodySeconds = getIntermediateDuration(tempDirectory.getChildFile("loop_from_loop_sequence" + intermediateFormat.extension));
+    
+    const double bodiesStart = plan.introSeconds + plan.loopFromIntroSeconds;
+    const double firstPieceSeconds = plan.introSeconds > 0.0 ? plan.introSeconds : plan.loopFromIntroSeconds;
+    const double fadeOut = juce::jmax(0.0, fadeOutDuration);
+    
+    if (plan.loopFromIntroSeconds <= 0.0 || plan.bodySeconds <= 0.0) {
+        plan.reason = "the loop sequences could not be measured";
+        return plan;
+    }
+    
+    if (fadeInDuration > firstPieceSeconds) {
+        plan.reason = "the fade-in is longer than the first sequence";
+        return plan;
+    }
+    
+    // Same repeat count as buildFinalSequence
+    const int repetitions = (int) std::ceil((targetDuration - bodiesStart) / plan.bodySeconds);
+    
+    // Everything from the body the fade-out starts in onwards goes into the tail
+    const double fadeOutStart = targetDuration - fadeOut;
+    if (repetitions < 1 || fadeOutStart < bodiesStart) {
+        plan.reason = "the fade-out reaches back past the loop bodies";
+        return plan;
+    }
+    
+    plan.copiedBodies = juce::jlimit(0, repetitions - 1, (int) std::floor((fadeOutStart - bodiesStart) / plan.bodySeconds));
+    plan.tailBodies = repetitions - plan.copiedBodies;
+    plan.tailSeconds = targetDuration - bodiesStart - plan.copiedBodies * plan.bodySeconds;
+    plan.valid = plan.tailSeconds > 0.0;
+    
+    if (!plan.valid)
+        plan.reason = "the tail would be empty";
+    
+    return plan;
+}
+
+juce::String TimelineAssembler::getFinalVideoEncodeArgs() const
+{
+    // Closed GOPs so every piece starts with a keyframe and nothing refers across a join;
+    // identical settings for every piece so the concat demuxer can copy them back to back
+    return (useNvidiaAcceleration ? finalNvidiaParams : finalCpuParams)
+           + " -flags +cgop -pix_fmt yuv420p"
+           + (useNvidiaAcceleration ? " -profile:v high" : " -profile:v high -level 4.0");
+}
+
+juce::String TimelineAssembler::buildFinalAudioFilter(double videoDuration) const
+{
+    juce::StringArray filters;
+    
+    if (fadeInDuration > 0.001)
+        filters.add("afade=in:st=0:d=" + juce::String(fadeInDuration));
+    
+    if (fadeOutDuration > 0.001)
+        filters.add("afade=out:st=" + juce::String(juce::jmax(0.0, videoDuration - fadeOutDuration), 6)
+                    + ":d=" + juce::String(fadeOutDuration, 6));
+    
+    filters.add("loudnorm=I=-14:TP=-1:LRA=11");
+    return filters.joinIntoString(",");
+}
+
+bool TimelineAssembler::encodeFinalPiece(const juce::File& inputFile, const juce::File& outputFile, double fadeInSeconds)
+{
+    if (!inputFile.existsAsFile()) {
+        if (logCallback) logCallback("ERROR: Missing sequence for final encode: " + inputFile.getFileName());
+        return false;
+    }
+    
+    juce::String command = ffmpegExecutor->getFFmpegPath() + " -y -i \"" + inputFile.getFullPathName() + "\"";
+    if (fadeInSeconds > 0.001)
+        command += " -vf \"fade=in:st=0:d=" + juce::String(fadeInSeconds) + "\"";
+    command += " " + getFinalVideoEncodeArgs() + " -an \"" + outputFile.getFullPathName() + "\"";
+    
+    if (!ffmpegExecutor->executeCommand(command, 0.0, 1.0)) {
+        if (logCallback) logCallback("ERROR: Failed to encode " + outputFile.getFileName());
+        return false;
+    }
+    
+    return true;
+}
+
+bool TimelineAssembler::encodeFinalTail(double targetDuration, const juce::File& tempDirectory)
+{
+    const LoopRepetitionPlan plan = planLoopRepetition(targetDuration, tempDirectory);
+    
+    // muxEncodedPieces sees the same plan and falls back to the full encode
+    if (!plan.valid)
+        return true;
+    
+    const juce::File loopFromLoopSequence = tempDirectory.getChildFile("loop_from_loop_sequence" + intermediateFormat.extension);
+    const juce::File tailList = tempDirectory.getChildFile("final_tail_concat.txt");
+    const juce::File tail = tempDirectory.getChildFile("final_tail.mp4");
+    
+    juce::String list;
+    for (int i = 0; i < plan.tailBodies; ++i)
+        list << "file '" << loopFromLoopSequence.getFullPathName().replace("\\", "/") << "'\n";
+    
+    if (!tailList.replaceWithText(list)) {
+        if (logCallback) logCallback("ERROR: Failed to create tail concat file");
+        return false;
+    }
+    
+    juce::String command = ffmpegExecutor->getFFmpegPath() + " -y -f concat -safe 0 -i \"" + tailList.getFullPathName() + "\""
+                           + " -t " + juce::String(plan.tailSeconds, 6);
+    if (fadeOutDuration > 0.001)
+        command += " -vf \"fade=out:st=" + juce::String(juce::jmax(0.0, plan.tailSeconds - fadeOutDuration), 6)
+                   + ":d=" + juce::String(fadeOutDuration, 6) + "\"";
+    command += " " + getFinalVideoEncodeArgs() + " -an \"" + tail.getFullPathName() + "\"";
+    
+    const bool succeeded = ffmpegExecutor->executeCommand(command, 0.0, 1.0);
+    tailList.deleteFile();
+    
+    if (!succeeded) {
+        if (logCallback) logCallback("ERROR: Failed to encode the final tail");
+        return false;
+    }
+    
+    return true;
+}
+
+bool TimelineAssembler::muxEncodedPieces(const juce::File& audioFile, double targetDuration,
+                                         const juce::File& tempDirectory, const juce::File& outputFile)
+{
+    const LoopRepetitionPlan plan = planLoopRepetition(targetDuration, tempDirectory);
+    const juce::File introPiece = tempDirectory.getChildFile("final_intro.mp4");
+    const juce::File loopFromIntroPiece = tempDirectory.getChildFile("final_loop_from_intro.mp4");
+    const juce::File bodyPiece = tempDirectory.getChildFile("final_loop_body.mp4");
+    const juce::File tailPiece = tempDirectory.getChildFile("final_tail.mp4");
+    
+    auto deletePieces = [&]
+    {
+        for (const auto& piece : { introPiece, loopFromIntroPiece, bodyPiece, tailPiece })
+            deleteIfExists(piece, "encoded piece");
+    };
+    
+    if (!plan.valid || !tailPiece.existsAsFile())
+    {
+        if (logCallback) logCallback("WARNING: Can't stream copy the loop repeats (" + plan.reason + "); encoding the full timeline");
+        deletePieces();
+        
+        return buildFinalSequence(targetDuration, tempDirectory)
+            && muxFinalOutput(audioFile, tempDirectory, outputFile);
+    }
+    
+    if (logCallback)
+        logCallback("Encode once: " + juce::String(plan.copiedBodies) + " loop bodies stream copied, "
+                    + juce::String(plan.tailSeconds, 1) + " s tail re-encoded");
+    
+    const juce::File videoList = tempDirectory.getChildFile("final_video_concat.txt");
+    juce::String list;
+    auto addPiece = [&list](const juce::File& piece) { list << "file '" << piece.getFullPathName().replace("\\", "/") << "'\n"; };
+    
+    if (introPiece.existsAsFile())
+        addPiece(introPiece);
+    addPiece(loopFromIntroPiece);
+    for (int i = 0; i < plan.copiedBodies; ++i)
+        addPiece(bodyPiece);
+    addPiece(tailPiece);
+    
+    if (!videoList.replaceWithText(list)) {
+        if (logCallback) logCallback("ERROR: Failed to create final concat file");
+        return false;
+    }
+    
+    const bool succeeded = muxVideoList(videoList, audioFile, targetDuration, outputFile);
+    videoList.deleteFile();
+    deletePieces();
+    return succeeded;
+}
+
+bool TimelineAssembler::muxVideoList(const juce::File& videoList, const juce::File& audioFile,
+                                     double duration, const juce::File& outputFile)
+{
+    // The video is already delivery-encoded; only the audio goes through an encoder
+    const juce::String command = ffmpegExecutor->getFFmpegPath() +
+        " -y -f concat -safe 0 -i \"" + videoList.getFullPathName() + "\"" +
+        " -i \"" + audioFile.getFullPathName() + "\"" +
+        " -map 0:v -map 1:a -c:v copy" +
+        " -af \"" + buildFinalAudioFilter(duration) + "\"" +
+        " -c:a aac -ar 48000 -b:a 384k" +  // YouTube recommended: 48kHz, 384kbps for stereo
+        " -t " + juce::String(duration, 6) +
+        " -movflags +faststart" +
+        " \"" + outputFile.getFullPathName() + "\"";
+    
+    if (!ffmpegExecutor->executeCommand(command, 0.0, 1.0)) {
+        if (logCallback) logCallback("ERROR: Failed to mux final output");
+        return false;
+    }
+    
+    if (logCallback) logCallback("Final output muxed successfully: " + outputFile.getFullPathName());
+    return true;
+}
+
+//==============================================================================
+// Segment-parallel final encode
+int TimelineAssembler::getFinalSegmentCount(double targetDuration) const
+{
+    int segments = juce::SystemStats::getEnvironmentVariable("FFLUCE_ENCODE_SEGMENTS", {}).getIntValue();
+    
+    if (segments <= 0)
+    {
+        // One libx264 process stops scaling at about 16 threads. NVENC sessions are
+        // limited on consumer cards, and two keep one engine busy while the other drains.
+        segments = useNvidiaAcceleration ? 2 : juce::SystemStats::getNumCpus() / 16;
+        segments = juce::jmin(segments, maxParallelJobs);
+    }
+    
+    // Short renders aren't worth the extra keyframes and processes
+    constexpr double minimumSegmentSeconds = 300.0;
+    return juce::jlimit(1, 64, juce::jmin(segments, (int) (targetDuration / minimumSegmentSeconds)));
+}
+
+juce::File TimelineAssembler::getFinalSegmentFile(const juce::File& tempDirectory, int index) const
+{
+    // Delivery-encoded H.264, joined into the MP4 output by stream copy like the final pieces
+    return tempDirectory.getChildFile("final_segment_" + juce::String(index) + ".mp4");
+}
+
+bool TimelineAssembler::measureSegmentSource(const juce::File& videoSequence, SegmentSource& source)
+{
+    const juce::ScopedLock sl(source.lock);
+    if (!source.measured)
+    {
+        source.measured = true;
+        // The header gives the rate; the planner's duration gives the length, so the
+        // sequence is never read end to end just to plan the segments
+        source.fps = ffmpegExecutor->getVideoStreamInfo(videoSequence).fps;
+        source.totalFrames = (int) std::round(source.targetDuration * source.fps);
+    }
+    
+    if (source.fps <= 0.0 || source.totalFrames <= 0) {
+        if (logCallback) logCallback("ERROR: Could not measure " + videoSequence.getFileName() + " for a segmented encode");
+        return false;
+    }
+    return true;
+}
+
+std::vector<int> TimelineAssembler::planSegmentBoundaries(int totalFrames, int segments, double fps) const
+{
+    std::vector<int> boundaries { 0 };
+    
+    // Fades are filtered with segment-local times, so each has to fall inside one segment
+    const int fadeInEnd = (int) std::ceil(juce::jmax(0.0, fadeInDuration) * fps);
+    const int fadeOutStart = totalFrames - (int) std::ceil(juce::jmax(0.0, fadeOutDuration) * fps);
+    
+    for (int k = 1; k < segments && fadeInEnd <= fadeOutStart; ++k)
+    {
+        const int boundary = juce::jlimit(fadeInEnd, fadeOutStart, (int) ((juce::int64) totalFrames * k / segments));
+        if (boundary > boundaries.back() && boundary < totalFrames)
+            boundaries.push_back(boundary);
+    }
+    
+    boundaries.push_back(totalFrames);
+    return boundaries;
+}
+
+bool TimelineAssembler::encodeFinalSegment(const juce::File& videoSequence, SegmentSource& source, int index, int segments,
+                                           const juce::File& tempDirectory)
+{
+    if (!measureSegmentSource(videoSequence, source))
+        return false;
+    
+    const double fps = source.fps;
+    const int totalFrames = source.totalFrames;
+    
+    // Every segment task plans the same boundaries; fades may have merged some segments
+    const std::vector<int> boundaries = planSegmentBoundaries(totalFrames, segments, fps);
+    const juce::File segment = getFinalSegmentFile(tempDirectory, index);
+    const int numPlanned = (int) boundaries.size() - 1;
+    
+    if (index >= numPlanned)
+        return true;
+    
+    const int firstFrame = boundaries[(size_t) index];
+    const int numFrames = boundaries[(size_t) index + 1] - firstFrame;
+    const double startSeconds = firstFrame / fps;
+    
+    juce::StringArray filters;
+    if (index == 0 && fadeInDuration > 0.001)
+        filters.add("fade=in:st=0:d=" + juce::String(fadeInDuration));
+    if (index == numPlanned - 1 && fadeOutDuration > 0.001)
+        filters.add("fade=out:st=" + juce::String(juce::jmax(0.0, totalFrames / fps - fadeOutDuration - startSeconds), 6)
+                    + ":d=" + juce::String(fadeOutDuration, 6));
+    
+    // Seek half a frame early: the accurate seek keeps frames at or after the seek point,
+    // so rounding can't drop the first frame or repeat the previous segment's last one
+    juce::String command = ffmpegExecutor->getFFmpegPath() + " -y";
+    if (firstFrame > 0)
+        command += " -ss " + juce::String((firstFrame - 0.5) / fps, 6);
+    command += " -i \"" + videoSequence.getFullPathName() + "\"";
+    // The planned length can be a frame off the rendered one, so the last segment runs to the end
+    const bool isLast = index == numPlanned - 1;
+    if (!isLast)
+        command += " -frames:v " + juce::String(numFrames);
+    if (filters.size() > 0)
+        command += " -vf \"" + filters.joinIntoString(",") + "\"";
+    command += " " + getFinalVideoEncodeArgs();
+    if (!useNvidiaAcceleration)
+        command += " -threads " + juce::String(juce::jmax(1, juce::SystemStats::getNumCpus() / numPlanned));
+    command += " -an \"" + segment.getFullPathName() + "\"";
+    
+    if (!ffmpegExecutor->executeCommand(command, 0.0, 1.0)) {
+        if (logCallback) logCallback("ERROR: Failed to encode " + segment.getFileName());
         return false;
     }
     
-    // Delete temporary video sequence files
-    tempDirectory.getChildFile("output_sequence_with_overlays.mp4").deleteFile();
-    tempDirectory.getChildFile("output_sequence_without_overlays.mp4").deleteFile();
+    // A count that times out (-1) skips the check rather than failing the render
+    const int encodedFrames = ffmpegExecutor->getVideoFrameCount(segment);
+    if (encodedFrames >= 0 && std::abs(encodedFrames - numFrames) > (isLast ? 1 : 0)) {
+        if (logCallback) logCallback("ERROR: " + segment.getFileName() + " has " + juce::String(encodedFrames)
+                                     + " frames, expected " + juce::String(numFrames));
+        return false;
+    }
     
-    if (logCallback) logCallback("Final output muxed successfully: " + outputFile.getFullPathName());
     return true;
 }
 
-bool TimelineAssembler::generateCrossfadeForClipPair(const juce::String& type, size_t fromIndex, size_t toIndex,
-                                                    const RenderTypes::VideoClipInfo& fromClip, const RenderTypes::VideoClipInfo& toClip,
-                                                    const juce::File& tempDirectory)
+bool TimelineAssembler::muxFinalSegments(const juce::File& audioFile, const juce::File& videoSequence, SegmentSource& source,
+                                         int segments, const juce::File& tempDirectory, const juce::File& outputFile)
 {
-    double crossfadeDuration = fromClip.crossfade;
+    if (!measureSegmentSource(videoSequence, source))
+        return false;
     
-    if (crossfadeDuration <= 0.001) {
-        if (logCallback) logCallback("No crossfade needed (duration = " + juce::String(crossfadeDuration) + "s)");
-        return true; // No crossfade needed
-    }
+    const double fps = source.fps;
+    int totalFrames = source.totalFrames;
+    bool segmentsCounted = true;
     
-    // Get source clips - these are individual conformed clips
-    juce::File fromClipFile = tempDirectory.getChildFile(type + "_" + juce::String(fromIndex) + ".mp4");
-    juce::File toClipFile = tempDirectory.getChildFile(type + "_" + juce::String(toIndex) + ".mp4");
+    const std::vector<int> boundaries = planSegmentBoundaries(totalFrames, segments, fps);
+    const juce::File videoList = tempDirectory.getChildFile("final_segments_concat.txt");
+    juce::Array<juce::File> segmentFiles;
+    juce::String list;
+    int joinedFrames = 0;
     
-    if (logCallback) {
-        logCallback("  - From clip: " + fromClipFile.getFileName());
-        logCallback("  - To clip: " + toClipFile.getFileName());
+    for (size_t i = 0; i + 1 < boundaries.size(); ++i)
+    {
+        const juce::File segment = getFinalSegmentFile(tempDirectory, (int) i);
+        segmentFiles.add(segment);
+        list << "file '" << segment.getFullPathName().replace("\\", "/") << "'\n";
+        
+        const int segmentFrames = ffmpegExecutor->getVideoFrameCount(segment);
+        segmentsCounted = segmentsCounted && segmentFrames >= 0;
+        joinedFrames += juce::jmax(0, segmentFrames);
     }
     
-    if (!fromClipFile.existsAsFile() || !toClipFile.existsAsFile()) {
-        if (logCallback) logCallback("ERROR: Source clips not found for crossfade");
+    // Each segment was checked against its own range; this catches ranges that overlap or leave gaps.
+    // The last segment runs to the end, so the join may differ from the plan by that one frame.
+    const bool verified = segmentsCounted;
+    if (verified && std::abs(joinedFrames - totalFrames) > 1) {
+        if (logCallback) logCallback("ERROR: Encoded segments hold " + juce::String(joinedFrames) + " frames, "
+                                     + videoSequence.getFileName() + " was planned with " + juce::String(totalFrames));
         return false;
     }
     
-    // Extract crossfade-out segment from fromClip (last n seconds)
-    juce::File fromXOut = tempDirectory.getChildFile(type + "_" + juce::String(fromIndex) + "_x_out.mp4");
-    double fromActualDuration = ffmpegExecutor->getFileDuration(fromClipFile);
-    double fromStartTime = fromActualDuration - crossfadeDuration;
+    // The segments' own counts give the joined length
+    if (segmentsCounted)
+        totalFrames = joinedFrames;
     
-    if (logCallback) {
-        logCallback("  - From clip actual duration: " + juce::String(fromActualDuration) + "s");
-        logCallback("  - From start time calculation: " + juce::String(fromActualDuration) + " - " + juce::String(crossfadeDuration) + " = " + juce::String(fromStartTime) + "s");
+    if (logCallback) logCallback(juce::String(verified ? "Segment boundaries verified: " : "Segment boundaries not verified: ")
+                                 + juce::String(segmentFiles.size()) + " segments, " + juce::String(totalFrames) + " frames");
+    
+    if (!videoList.replaceWithText(list)) {
+        if (logCallback) logCallback("ERROR: Failed to create final concat file");
+        return false;
     }
     
-    // Use lossless for all intermediate encoding
-    juce::String encodingParams = losslessParams;
-    juce::String extractFromCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + fromClipFile.getFullPathName() + "\"" +
-        " -ss " + juce::String(fromStartTime) +
-        " -t " + juce::String(crossfadeDuration) +
-        " " + losslessParams +  // Use lossless encoding for intermediate files
-        " -an \"" + fromXOut.getFullPathName() + "\"";
+    const bool succeeded = muxVideoList(videoList, audioFile, totalFrames / fps, outputFile);
+    
+    videoList.deleteFile();
+    for (const auto& segment : segmentFiles)
+        deleteIfExists(segment, "encoded segment");
+    
+    if (succeeded) {
+        tempDirectory.getChildFile("output_sequence_with_overlays" + intermediateFormat.extension).deleteFile();
+        tempDirectory.getChildFile("output_sequence_without_overlays" + intermediateFormat.extension).deleteFile();
+    }
+    
+    return succeeded;
+}
+
+bool TimelineAssembler::generateBatchedCrossfades(const juce::String& type, const std::vector<RenderTypes::VideoClipInfo>& clips,
+                                                  const juce::File& tempDirectory)
+{
+    auto clipFile = [&](size_t i) { return tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension); };
+    auto transitionName = [&](size_t i) { return type + "_" + juce::String(i) + "_to_" + juce::String(i + 1) + "_x" + intermediateFormat.extension; };
+    
+    // Index of the clip each crossfade leaves
+    std::vector<size_t> pairs;
+    for (size_t i = 0; i + 1 < clips.size(); ++i)
+        if (clips[i].crossfade > 0.001)
+            pairs.push_back(i);
+    
+    for (size_t first = 0; first < pairs.size(); first += maxCrossfadesPerCommand)
+    {
+        if (isCancelled())
+            return false;
+        
+        const std::vector<size_t> batch(pairs.begin() + (long) first,
+                                        pairs.begin() + (long) juce::jmin(pairs.size(), first + maxCrossfadesPerCommand));
+        
+        // Each clip is read once: its head feeds the crossfade into it, its tail the one out of it
+        std::map<size_t, std::pair<bool, bool>> parts;     // clip -> (head needed, tail needed)
+        for (size_t i : batch)
+        {
+            parts[i].second = true;
+            parts[i + 1].first = true;
+        }
+        
+        juce::StringArray inputs, filters;
+        bool probed = true;
+        for (const auto& [clip, needs] : parts)
+        {
+            const juce::File file = clipFile(clip);
+            const double headSeconds = clip > 0 ? clips[clip - 1].crossfade : 0.0;
+            const double tailSeconds = clips[clip].crossfade;
+            const double duration = getIntermediateDuration(file);
+            const juce::String input = "[" + juce::String(inputs.size()) + ":v]";
+            const juce::String head = "[in" + juce::String(clip) + "]";
+            const juce::String tail = "[out" + juce::String(clip) + "]";
+            
+            if (duration <= tailSeconds && needs.second)
+                probed = false;
+            
+            // Clips at the edges of the batch only decode the part they give
+            if (needs.first && needs.second)
+            {
+                inputs.add("-i \"" + file.getFullPathName() + "\"");
+                filters.add(input + "split=2[h" + juce::String(clip) + "][t" + juce::String(clip) + "]");
+                filters.add("[h" + juce::String(clip) + "]trim=duration=" + juce::String(headSeconds, 6) + ",setpts=PTS-STARTPTS" + head);
+                filters.add("[t" + juce::String(clip) + "]trim=start=" + juce::String(duration - tailSeconds, 6) + ",setpts=PTS-STARTPTS" + tail);
+            }
+            else if (needs.second)
+            {
+                inputs.add("-ss " + juce::String(duration - tailSeconds, 6) + " -i \"" + file.getFullPathName() + "\"");
+                filters.add(input + "trim=duration=" + juce::String(tailSeconds, 6) + ",setpts=PTS-STARTPTS" + tail);
+            }
+            else
+            {
+                inputs.add("-t " + juce::String(headSeconds, 6) + " -i \"" + file.getFullPathName() + "\"");
+                filters.add(input + "trim=duration=" + juce::String(headSeconds, 6) + ",setpts=PTS-STARTPTS" + head);
+            }
+        }
+        
+        juce::String outputs;
+        for (size_t i : batch)
+        {
+            const double crossfade = clips[i].crossfade;
+            filters.add("[out" + juce::String(i) + "][in" + juce::String(i + 1) + "]xfade=transition=fade:duration="
+                        + juce::String(crossfade) + ":offset=0[x" + juce::String(i) + "]");
+            outputs += " -map \"[x" + juce::String(i) + "]\" -t " + juce::String(crossfade) + " -pix_fmt yuv420p " + losslessParams
+                       + " -an \"" + tempDirectory.getChildFile(transitionName(i)).getFullPathName() + "\"";
+        }
+        
+        const juce::File script = tempDirectory.getChildFile(type + "_crossfades_" + juce::String(first / maxCrossfadesPerCommand) + ".txt");
+        bool succeeded = probed && script.replaceWithText(filters.joinIntoString(";\n"));
+        
+        if (succeeded)
+        {
+            if (logCallback)
+                logCallback("Generating " + juce::String((int) batch.size()) + " " + type + " crossfades from "
+                            + juce::String(inputs.size()) + " clips in one command");
+            
+            succeeded = ffmpegExecutor->executeCommand(ffmpegExecutor->getFFmpegPath() + " -y " + inputs.joinIntoString(" ")
+                                                       + " -filter_complex_script \"" + script.getFullPathName() + "\"" + outputs,
+                                                       0.0, 1.0);
+            script.deleteFile();
+        }
+        
+        for (size_t i : batch)
+        {
+            const juce::File transition = tempDirectory.getChildFile(transitionName(i));
+            if (succeeded && transition.existsAsFile())
+            {
+                manifest.setDuration(transition, clips[i].crossfade);
+                continue;
+            }
+            
+            // One pair at a time, with generateCrossfadeTransition's normalization if the clips don't match
+            if (logCallback) logCallback("WARNING: Batched crossfade failed for " + transition.getFileName() + ", generating it on its own");
+            
+            const double crossfade = clips[i].crossfade;
+            const juce::File xOut = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_x_out" + intermediateFormat.extension);
+            const juce::File xIn = tempDirectory.getChildFile(type + "_" + juce::String(i + 1) + "_x_in" + intermediateFormat.extension);
+            
+            const bool generated = extractCrossfadeOutSegment(clipFile(i), xOut.getFileName(), 0.0, crossfade, tempDirectory)
+                                && extractCrossfadeInSegment(clipFile(i + 1), xIn.getFileName(), crossfade, tempDirectory)
+                                && generateCrossfadeTransition(xOut, xIn, transition.getFileName(), crossfade, tempDirectory);
+            xOut.deleteFile();
+            xIn.deleteFile();
+            
+            if (!generated)
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+bool TimelineAssembler::extractCrossfadeOutSegment(const juce::File& inputClip,
+                                                   const juce::String& outputName,
+                                                   double clipDuration,
+                                                   double crossfadeDuration,
+                                                   const juce::File& tempDirectory)
+{
+    if (clipDuration <= 0.0)
+        clipDuration = getIntermediateDuration(inputClip);
     
-    if (!ffmpegExecutor->executeCommand(extractFromCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to extract crossfade-out segment");
+    juce::File xOut = tempDirectory.getChildFile(outputName);
+    double startTime = clipDuration - crossfadeDuration;
+    
+    if (logCallback) {
+        logCallback("  - " + inputClip.getFileName() + " actual duration: " + juce::String(clipDuration) + "s");
+        logCallback("  - Crossfade-out start: " + juce::String(clipDuration) + " - " + juce::String(crossfadeDuration) + " = " + juce::String(startTime) + "s");
+    }
+    
+    if (!executeTrimWithFallback(inputClip, xOut, startTime, crossfadeDuration, "extracting " + outputName)) {
+        if (logCallback) logCallback("ERROR: Failed to extract crossfade-out segment " + outputName);
         return false;
     }
     
-    // 2. Extract crossfade-in segment from toClip (first n seconds)
-    juce::File toXIn = tempDirectory.getChildFile(type + "_" + juce::String(toIndex) + "_x_in.mp4");
-    juce::String extractToCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + toClipFile.getFullPathName() + "\"" +
-        " -t " + juce::String(crossfadeDuration) +
-        " " + losslessParams +  // Use lossless encoding for intermediate files
-        " -an \"" + toXIn.getFullPathName() + "\"";
+    return true;
+}
+
+bool TimelineAssembler::extractCrossfadeInSegment(const juce::File& inputClip,
+                                                  const juce::String& outputName,
+                                                  double crossfadeDuration,
+                                                  const juce::File& tempDirectory)
+{
+    juce::File xIn = tempDirectory.getChildFile(outputName);
     
-    if (!ffmpegExecutor->executeCommand(extractToCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to extract crossfade-in segment");
+    if (!executeTrimWithFallback(inputClip, xIn, 0.0, crossfadeDuration, "extracting " + outputName)) {
+        if (logCallback) logCallback("ERROR: Failed to extract crossfade-in segment " + outputName);
         return false;
     }
     
-    // 3. Create crossfade transition between the segments (FIXED XFADE with compatibility check)
-    juce::File crossfadeFile = tempDirectory.getChildFile(type + "_" + juce::String(fromIndex) + "_to_" + juce::String(toIndex) + "_x.mp4");
+    return true;
+}
+
+bool TimelineAssembler::generateCrossfadeTransition(const juce::File& fromXOut,
+                                                    const juce::File& toXIn,
+                                                    const juce::String& outputName,
+                                                    double crossfadeDuration,
+                                                    const juce::File& tempDirectory)
+{
+    // Use lossless for all intermediate encoding
+    juce::String encodingParams = losslessParams;
+    
+    // FIXED XFADE with compatibility check
+    juce::File crossfadeFile = tempDirectory.getChildFile(outputName);
     
     // FIRST ATTEMPT: Try direct crossfade
     juce::String crossfadeCommand = ffmpegExecutor->getFFmpegPath() +
@@ -942,12 +2071,13 @@ bool TimelineAssembler::generateCrossfadeForClipPair(const juce::String& type, s
         if (logCallback) logCallback("CROSSFADE FAILED - attempting format normalization and retry...");
         
         // FALLBACK: Normalize both inputs to exact same format and try again
-        juce::File normalizedFromXOut = tempDirectory.getChildFile(type + "_" + juce::String(fromIndex) + "_x_out_normalized.mp4");
-        juce::File normalizedToXIn = tempDirectory.getChildFile(type + "_" + juce::String(toIndex) + "_x_in_normalized.mp4");
+        juce::File normalizedFromXOut = tempDirectory.getChildFile(fromXOut.getFileNameWithoutExtension() + "_normalized" + intermediateFormat.extension);
+        juce::File normalizedToXIn = tempDirectory.getChildFile(toXIn.getFileNameWithoutExtension() + "_normalized" + intermediateFormat.extension);
 
-        // Capture source stream details so normalization preserves their native characteristics.
-        const auto fromInfo = ffmpegExecutor->getVideoStreamInfo(fromClipFile);
-        const auto toInfo = ffmpegExecutor->getVideoStreamInfo(toClipFile);
+        // Capture stream details so normalization preserves their native characteristics.
+        // The segments were cut losslessly from the clips, so they share the clips' geometry and rate.
+        const auto fromInfo = ffmpegExecutor->getVideoStreamInfo(fromXOut);
+        const auto toInfo = ffmpegExecutor->getVideoStreamInfo(toXIn);
 
         int targetWidth = fromInfo.width > 0 ? fromInfo.width : toInfo.width;
         int targetHeight = fromInfo.height > 0 ? fromInfo.height : toInfo.height;
@@ -1037,53 +2167,37 @@ bool TimelineAssembler::generateCrossfadeForClipPair(const juce::String& type, s
         if (logCallback) logCallback("Crossfade succeeded on first attempt");
     }
     
-    // 4. Create body segments (clips with crossfade portions removed)
-    // From clip: remove last n seconds to create body_cut_out
-    juce::File fromBodyCutOut = tempDirectory.getChildFile(type + "_" + juce::String(fromIndex) + "_body_cut_out.mp4");
-    double fromBodyDuration = fromActualDuration - crossfadeDuration;
-    
-    if (logCallback)
-        logCallback("  - From body duration after trim: " + juce::String(fromBodyDuration) + "s");
-    
-    if (fromBodyDuration <= 0.001)
-    {
-        if (logCallback) logCallback("WARNING: from-body duration too small (" + juce::String(fromBodyDuration) + "s); clamping to 0.1s");
-        fromBodyDuration = 0.1;
-    }
-    
-    if (!executeTrimWithFallback(fromClipFile,
-                                 fromBodyCutOut,
-                                 0.0,
-                                 fromBodyDuration,
-                                 "creating from-body segment for " + type + "_" + juce::String(fromIndex)))
-        return false;
+    return true;
+}
+
+bool TimelineAssembler::extractBodySegment(const juce::File& inputClip,
+                                           const juce::String& outputName,
+                                           double clipDuration,
+                                           double crossfadeDuration,
+                                           bool cutFromEnd,
+                                           const juce::File& tempDirectory)
+{
+    if (clipDuration <= 0.0)
+        clipDuration = getIntermediateDuration(inputClip);
     
-    // To clip: remove first n seconds to create body_cut_in
-    juce::File toBodyCutIn = tempDirectory.getChildFile(type + "_" + juce::String(toIndex) + "_body_cut_in.mp4");
-    double toActualDuration = ffmpegExecutor->getFileDuration(toClipFile);
-    double toBodyDuration = toActualDuration - crossfadeDuration;
+    // cutFromEnd drops the last n seconds (body_cut_out), otherwise the first n seconds (body_cut_in)
+    juce::File bodyFile = tempDirectory.getChildFile(outputName);
+    double bodyDuration = clipDuration - crossfadeDuration;
     
     if (logCallback)
-    {
-        logCallback("  - To clip actual duration: " + juce::String(toActualDuration) + "s");
-        logCallback("  - To body duration after trim: " + juce::String(toBodyDuration) + "s");
-    }
+        logCallback("  - " + outputName + " duration after trim: " + juce::String(bodyDuration) + "s");
     
-    if (toBodyDuration <= 0.001)
+    if (bodyDuration <= 0.001)
     {
-        if (logCallback) logCallback("WARNING: to-body duration too small (" + juce::String(toBodyDuration) + "s); clamping to 0.1s");
-        toBodyDuration = 0.1;
+        if (logCallback) logCallback("WARNING: body duration too small (" + juce::String(bodyDuration) + "s); clamping to 0.1s");
+        bodyDuration = 0.1;
     }
     
-    if (!executeTrimWithFallback(toClipFile,
-                                 toBodyCutIn,
-                                 crossfadeDuration,
-                                 toBodyDuration,
-                                 "creating to-body segment for " + type + "_" + juce::String(toIndex)))
-        return false;
-
-    if (logCallback) logCallback("Created crossfade: " + crossfadeFile.getFileName() + " (" + juce::String(crossfadeDuration) + "s)");
-    return true;
+    return executeTrimWithFallback(inputClip,
+                                   bodyFile,
+                                   cutFromEnd ? 0.0 : crossfadeDuration,
+                                   bodyDuration,
+                                   "creating " + outputName);
 }
 
 bool TimelineAssembler::createMiddleClipBodySegment(const juce::String& type, size_t clipIndex, 
@@ -1092,13 +2206,13 @@ bool TimelineAssembler::createMiddleClipBodySegment(const juce::String& type, si
 {
     if (logCallback) logCallback("Creating middle clip body segment for " + type + "_" + juce::String(clipIndex));
     
-    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(clipIndex) + ".mp4");
+    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(clipIndex) + intermediateFormat.extension);
     if (!clipFile.existsAsFile()) {
         if (logCallback) logCallback("ERROR: Source clip not found for middle body segment");
         return false;
     }
     
-    double actualDuration = ffmpegExecutor->getFileDuration(clipFile);
+    double actualDuration = getIntermediateDuration(clipFile);
     double bodyDuration = actualDuration - prevCrossfadeDuration - nextCrossfadeDuration;
     
     if (bodyDuration <= 0.1) {
@@ -1106,7 +2220,7 @@ bool TimelineAssembler::createMiddleClipBodySegment(const juce::String& type, si
         bodyDuration = 0.1; // Minimum duration
     }
     
-    juce::File outputFile = tempDirectory.getChildFile(type + "_" + juce::String(clipIndex) + "_body_cut_in_cut_out.mp4");
+    juce::File outputFile = tempDirectory.getChildFile(type + "_" + juce::String(clipIndex) + "_body_cut_in_cut_out" + intermediateFormat.extension);
     juce::String description = "creating middle clip body segment for " + type + "_" + juce::String(clipIndex);
     if (!executeTrimWithFallback(clipFile,
                                  outputFile,
@@ -1130,21 +2244,14 @@ bool TimelineAssembler::generateIntroToLoopCrossfade(const RenderTypes::VideoCli
         return true; // No crossfade needed
     }
     
-    // Get source conformed clips
-    // Find the last intro clip index
-    size_t lastIntroIndex = 0;
-    for (size_t i = 10; i > 0; i--) { // Check up to 10 clips
-        juce::File testFile = tempDirectory.getChildFile("intro_" + juce::String(i-1) + ".mp4");
-        if (testFile.existsAsFile()) {
-            lastIntroIndex = i-1;
-            break;
-        }
-    }
+    // Source conformed clips, as registered in the manifest
+    IntermediateManifest::Clip lastIntro, firstLoop;
+    const bool registered = manifest.getLastClip("intro", lastIntro) && manifest.findClip("loop", 0, firstLoop);
     
-    juce::File lastIntroFile = tempDirectory.getChildFile("intro_" + juce::String(lastIntroIndex) + ".mp4");
-    juce::File firstLoopFile = tempDirectory.getChildFile("loop_0.mp4");
+    juce::File lastIntroFile = lastIntro.file;
+    juce::File firstLoopFile = firstLoop.file;
     
-    if (!lastIntroFile.existsAsFile() || !firstLoopFile.existsAsFile()) {
+    if (!registered || !lastIntroFile.existsAsFile() || !firstLoopFile.existsAsFile()) {
         if (logCallback) logCallback("ERROR: Source conformed clips not found for intro-to-loop crossfade");
         if (logCallback) logCallback("  Last intro clip (" + lastIntroFile.getFileName() + ") exists: " + (lastIntroFile.existsAsFile() ? "yes" : "no"));
         if (logCallback) logCallback("  First loop clip (" + firstLoopFile.getFileName() + ") exists: " + (firstLoopFile.existsAsFile() ? "yes" : "no"));
@@ -1155,37 +2262,18 @@ bool TimelineAssembler::generateIntroToLoopCrossfade(const RenderTypes::VideoCli
     juce::String encodingParams = losslessParams;
     
     // Extract last n seconds from last intro clip for crossfade-out
-    juce::File introXOut = tempDirectory.getChildFile("intro_to_loop_x_out.mp4");
-    double introDuration = ffmpegExecutor->getFileDuration(lastIntroFile);
-    double introStartTime = introDuration - crossfadeDuration;
-    
-    juce::String extractIntroCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + lastIntroFile.getFullPathName() + "\"" +
-        " -ss " + juce::String(introStartTime) +
-        " -t " + juce::String(crossfadeDuration) +
-        " " + encodingParams +  // Lossless encoding already includes codec
-        " -an \"" + introXOut.getFullPathName() + "\"";
-    
-    if (!ffmpegExecutor->executeCommand(extractIntroCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to extract intro crossfade-out segment");
+    juce::File introXOut = tempDirectory.getChildFile("intro_to_loop_x_out" + intermediateFormat.extension);
+    if (!extractCrossfadeOutSegment(lastIntroFile, introXOut.getFileName(), getIntermediateDuration(lastIntroFile),
+                                    crossfadeDuration, tempDirectory))
         return false;
-    }
     
     // Extract first n seconds from first loop clip for crossfade-in
-    juce::File loopXIn = tempDirectory.getChildFile("intro_to_loop_x_in.mp4");
-    juce::String extractLoopCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + firstLoopFile.getFullPathName() + "\"" +
-        " -t " + juce::String(crossfadeDuration) +
-        " " + encodingParams +  // Lossless encoding already includes codec
-        " -an \"" + loopXIn.getFullPathName() + "\"";
-    
-    if (!ffmpegExecutor->executeCommand(extractLoopCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to extract loop crossfade-in segment");
+    juce::File loopXIn = tempDirectory.getChildFile("intro_to_loop_x_in" + intermediateFormat.extension);
+    if (!extractCrossfadeInSegment(firstLoopFile, loopXIn.getFileName(), crossfadeDuration, tempDirectory))
         return false;
-    }
     
     // Create the crossfade transition (FIXED XFADE)
-    juce::File crossfadeFile = tempDirectory.getChildFile("intro_to_loop_x.mp4");
+    juce::File crossfadeFile = tempDirectory.getChildFile("intro_to_loop_x" + intermediateFormat.extension);
     juce::String crossfadeCommand = ffmpegExecutor->getFFmpegPath() +
         " -y -i \"" + introXOut.getFullPathName() + "\"" +
         " -i \"" + loopXIn.getFullPathName() + "\"" +
@@ -1214,21 +2302,14 @@ bool TimelineAssembler::generateLoopToLoopCrossfade(const RenderTypes::VideoClip
         return true; // No crossfade needed
     }
     
-    // Get source conformed clips
-    size_t lastLoopIndex = 0;
-    // Find the last loop clip index by checking which files exist
-    for (size_t i = 10; i > 0; i--) { // Check up to 10 clips
-        juce::File testFile = tempDirectory.getChildFile("loop_" + juce::String(i-1) + ".mp4");
-        if (testFile.existsAsFile()) {
-            lastLoopIndex = i-1;
-            break;
-        }
-    }
+    // Source conformed clips, as registered in the manifest
+    IntermediateManifest::Clip lastLoop, firstLoop;
+    const bool registered = manifest.getLastClip("loop", lastLoop) && manifest.findClip("loop", 0, firstLoop);
     
-    juce::File lastLoopFile = tempDirectory.getChildFile("loop_" + juce::String(lastLoopIndex) + ".mp4");
-    juce::File firstLoopFile = tempDirectory.getChildFile("loop_0.mp4");
+    juce::File lastLoopFile = lastLoop.file;
+    juce::File firstLoopFile = firstLoop.file;
     
-    if (!lastLoopFile.existsAsFile() || !firstLoopFile.existsAsFile()) {
+    if (!registered || !lastLoopFile.existsAsFile() || !firstLoopFile.existsAsFile()) {
         if (logCallback) logCallback("ERROR: Source files not found for loop-to-loop crossfade");
         return false;
     }
@@ -1237,37 +2318,18 @@ bool TimelineAssembler::generateLoopToLoopCrossfade(const RenderTypes::VideoClip
     juce::String encodingParams = losslessParams;
     
     // Extract last n seconds from last loop clip for crossfade-out
-    juce::File loopXOut = tempDirectory.getChildFile("loop_to_loop_x_out.mp4");
-    double lastLoopDuration = ffmpegExecutor->getFileDuration(lastLoopFile);
-    double lastLoopStartTime = lastLoopDuration - crossfadeDuration;
-    
-    juce::String extractLastCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + lastLoopFile.getFullPathName() + "\"" +
-        " -ss " + juce::String(lastLoopStartTime) +
-        " -t " + juce::String(crossfadeDuration) +
-        " " + encodingParams +  // Lossless encoding already includes codec
-        " -an \"" + loopXOut.getFullPathName() + "\"";
-    
-    if (!ffmpegExecutor->executeCommand(extractLastCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to extract last loop crossfade-out segment");
+    juce::File loopXOut = tempDirectory.getChildFile("loop_to_loop_x_out" + intermediateFormat.extension);
+    if (!extractCrossfadeOutSegment(lastLoopFile, loopXOut.getFileName(), getIntermediateDuration(lastLoopFile),
+                                    crossfadeDuration, tempDirectory))
         return false;
-    }
     
     // Extract first n seconds from first loop clip for crossfade-in
-    juce::File loopXIn = tempDirectory.getChildFile("loop_to_loop_x_in.mp4");
-    juce::String extractFirstCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + firstLoopFile.getFullPathName() + "\"" +
-        " -t " + juce::String(crossfadeDuration) +
-        " " + encodingParams +  // Lossless encoding already includes codec
-        " -an \"" + loopXIn.getFullPathName() + "\"";
-    
-    if (!ffmpegExecutor->executeCommand(extractFirstCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to extract first loop crossfade-in segment");
+    juce::File loopXIn = tempDirectory.getChildFile("loop_to_loop_x_in" + intermediateFormat.extension);
+    if (!extractCrossfadeInSegment(firstLoopFile, loopXIn.getFileName(), crossfadeDuration, tempDirectory))
         return false;
-    }
     
     // Create the crossfade transition (FIXED XFADE)
-    juce::File crossfadeFile = tempDirectory.getChildFile("loop_to_loop_x.mp4");
+    juce::File crossfadeFile = tempDirectory.getChildFile("loop_to_loop_x" + intermediateFormat.extension);
     juce::String crossfadeCommand = ffmpegExecutor->getFFmpegPath() +
         " -y -i \"" + loopXOut.getFullPathName() + "\"" +
         " -i \"" + loopXIn.getFullPathName() + "\"" +
@@ -1305,7 +2367,7 @@ bool TimelineAssembler::buildRawSequence(const juce::String& type, const std::ve
     
     if (clips.size() == 1) {
         // Simple case: single clip, just copy the conformed clip
-        juce::File sourceFile = tempDirectory.getChildFile(type + "_0.mp4");
+        juce::File sourceFile = tempDirectory.getChildFile(type + "_0" + intermediateFormat.extension);
         if (!sourceFile.existsAsFile()) {
             if (logCallback) logCallback("ERROR: Source file not found: " + sourceFile.getFileName());
             return false;
@@ -1342,21 +2404,21 @@ bool TimelineAssembler::buildRawSequence(const juce::String& type, const std::ve
         if (i == 0) {
             // First clip: use body_cut_out if crossfade exists, otherwise use full clip
             if (clips[i].crossfade > 0.001) {
-                juce::File bodyFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_out.mp4");
+                juce::File bodyFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_out" + intermediateFormat.extension);
                 if (bodyFile.existsAsFile()) {
-                    double fileDuration = ffmpegExecutor->getFileDuration(bodyFile);
+                    double fileDuration = getIntermediateDuration(bodyFile);
                     if (logCallback) logCallback("  Adding: " + bodyFile.getFileName() + " (duration: " + juce::String(fileDuration) + "s)");
                     concatStream.writeText("file '" + bodyFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 } else {
                     // Fallback to original clip if body segment not found
-                    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + ".mp4");
-                    double fileDuration = ffmpegExecutor->getFileDuration(clipFile);
+                    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
+                    double fileDuration = getIntermediateDuration(clipFile);
                     if (logCallback) logCallback("  Adding (fallback): " + clipFile.getFileName() + " (duration: " + juce::String(fileDuration) + "s)");
                     concatStream.writeText("file '" + clipFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 }
             } else {
                 // No crossfade, use full clip
-                juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + ".mp4");
+                juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
                 if (logCallback) logCallback("  Adding (no crossfade): " + clipFile.getFileName());
                 concatStream.writeText("file '" + clipFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
             }
@@ -1364,7 +2426,7 @@ bool TimelineAssembler::buildRawSequence(const juce::String& type, const std::ve
         } else if (i == clips.size() - 1) {
             // Last clip: add crossfade transition first, then body_cut_in
             if (clips[i-1].crossfade > 0.001) {
-                juce::File crossfadeFile = tempDirectory.getChildFile(type + "_" + juce::String(i-1) + "_to_" + juce::String(i) + "_x.mp4");
+                juce::File crossfadeFile = tempDirectory.getChildFile(type + "_" + juce::String(i-1) + "_to_" + juce::String(i) + "_x" + intermediateFormat.extension);
                 if (crossfadeFile.existsAsFile()) {
                     if (logCallback) logCallback("  Adding crossfade: " + crossfadeFile.getFileName());
                     concatStream.writeText("file '" + crossfadeFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
@@ -1373,19 +2435,19 @@ bool TimelineAssembler::buildRawSequence(const juce::String& type, const std::ve
             
             // Add the remaining part of last clip (after crossfade removal)
             if (clips[i-1].crossfade > 0.001) {
-                juce::File bodyFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_in.mp4");
+                juce::File bodyFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_in" + intermediateFormat.extension);
                 if (bodyFile.existsAsFile()) {
                     if (logCallback) logCallback("  Adding last body: " + bodyFile.getFileName());
                     concatStream.writeText("file '" + bodyFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 } else {
                     // Fallback to original clip
-                    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + ".mp4");
+                    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
                     if (logCallback) logCallback("  Adding last fallback: " + clipFile.getFileName());
                     concatStream.writeText("file '" + clipFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 }
             } else {
                 // No crossfade, use full clip
-                juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + ".mp4");
+                juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
                 if (logCallback) logCallback("  Adding last full clip: " + clipFile.getFileName());
                 concatStream.writeText("file '" + clipFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
             }
@@ -1393,35 +2455,35 @@ bool TimelineAssembler::buildRawSequence(const juce::String& type, const std::ve
         } else {
             // Middle clips: add crossfade transition first, then body_cut_in_cut_out
             if (clips[i-1].crossfade > 0.001) {
-                juce::File crossfadeFile = tempDirectory.getChildFile(type + "_" + juce::String(i-1) + "_to_" + juce::String(i) + "_x.mp4");
+                juce::File crossfadeFile = tempDirectory.getChildFile(type + "_" + juce::String(i-1) + "_to_" + juce::String(i) + "_x" + intermediateFormat.extension);
                 if (crossfadeFile.existsAsFile()) {
-                    double fileDuration = ffmpegExecutor->getFileDuration(crossfadeFile);
+                    double fileDuration = getIntermediateDuration(crossfadeFile);
                     if (logCallback) logCallback("  Adding crossfade: " + crossfadeFile.getFileName() + " (duration: " + juce::String(fileDuration) + "s)");
                     concatStream.writeText("file '" + crossfadeFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 }
             }
             
             // For middle clips, use body_cut_in_cut_out (both ends trimmed) if available
-            juce::File bodyFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_in_cut_out.mp4");
+            juce::File bodyFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_in_cut_out" + intermediateFormat.extension);
             if (bodyFile.existsAsFile()) {
                 // Perfect! Use the properly trimmed middle segment
                 if (logCallback) logCallback("  Adding middle body: " + bodyFile.getFileName());
                 concatStream.writeText("file '" + bodyFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
             } else if (clips[i-1].crossfade > 0.001) {
                 // Fallback: use body_cut_in (only beginning trimmed)
-                juce::File fallbackFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_in.mp4");
+                juce::File fallbackFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + "_body_cut_in" + intermediateFormat.extension);
                 if (fallbackFile.existsAsFile()) {
                     if (logCallback) logCallback("  Adding body fallback: " + fallbackFile.getFileName());
                     concatStream.writeText("file '" + fallbackFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 } else {
                     // Last resort: use original clip
-                    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + ".mp4");
+                    juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
                     if (logCallback) logCallback("  Adding original (last resort): " + clipFile.getFileName());
                     concatStream.writeText("file '" + clipFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
                 }
             } else {
                 // No crossfade, use full clip
-                juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + ".mp4");
+                juce::File clipFile = tempDirectory.getChildFile(type + "_" + juce::String(i) + intermediateFormat.extension);
                 if (logCallback) logCallback("  Adding full clip (no crossfade): " + clipFile.getFileName());
                 concatStream.writeText("file '" + clipFile.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
             }
@@ -1445,7 +2507,7 @@ bool TimelineAssembler::trimFinalCrossfade(const juce::File& inputFile, const ju
     if (logCallback) logCallback("Trimming final crossfade of " + juce::String(crossfadeDuration) + "s");
     
     // Get the duration of the input file
-    double inputDuration = ffmpegExecutor->getFileDuration(inputFile);
+    double inputDuration = getIntermediateDuration(inputFile);
     if (inputDuration <= 0) {
         if (logCallback) logCallback("ERROR: Could not get duration of input file");
         return false;
@@ -1505,15 +2567,12 @@ bool TimelineAssembler::extractLoopVariants(const juce::File& loopSequenceRaw, c
         return false;
     }
     
-    double rawDuration = ffmpegExecutor->getFileDuration(loopSequenceRaw);
+    double rawDuration = getIntermediateDuration(loopSequenceRaw);
     if (rawDuration <= 0) {
         if (logCallback) logCallback("ERROR: Could not get duration of loop sequence raw");
         return false;
     }
     
-    // Use lossless for all intermediate encoding
-    juce::String encodingParams = losslessParams;
-    
     if (variantType == "intro_based") {
         // For Intro-Based: Remove first crossfade segment (matching last intro clip's crossfade duration)
         double introCrossfadeDuration = introClips.empty() ? 0.0 : introClips.back().crossfade;
@@ -1524,20 +2583,16 @@ bool TimelineAssembler::extractLoopVariants(const juce::File& loopSequenceRaw, c
         double actualLoopCrossfade = (loopClips.size() > 1) ? (loopClips.empty() ? 0.0 : loopClips.back().crossfade) : 0.0;
         
         // Extract loop_from_intro_sequence_x_in (first n seconds)
-        juce::File loopFromIntroXIn = tempDirectory.getChildFile("loop_from_intro_sequence_x_in.mp4");
-        juce::String extractXInCommand = ffmpegExecutor->getFFmpegPath() +
-            " -y -i \"" + loopSequenceRaw.getFullPathName() + "\"" +
-            " -t " + juce::String(actualIntroCrossfade) +
-            " " + encodingParams +  // Lossless encoding already includes codec
-            " -an \"" + loopFromIntroXIn.getFullPathName() + "\"";
+        juce::File loopFromIntroXIn = tempDirectory.getChildFile("loop_from_intro_sequence_x_in" + intermediateFormat.extension);
         
-        if (!ffmpegExecutor->executeCommand(extractXInCommand, 0.0, 1.0)) {
+        if (!executeTrimWithFallback(loopSequenceRaw, loopFromIntroXIn, 0.0, actualIntroCrossfade,
+                                     "extracting loop_from_intro_sequence_x_in")) {
             if (logCallback) logCallback("ERROR: Failed to extract loop_from_intro_sequence_x_in");
             return false;
         }
         
         // Extract loop_from_intro_body_cut_in_cut_out (remaining part after removing first n seconds AND last loop crossfade seconds)
-        juce::File loopFromIntroBody = tempDirectory.getChildFile("loop_from_intro_body_cut_in_cut_out.mp4");
+        juce::File loopFromIntroBody = tempDirectory.getChildFile("loop_from_intro_body_cut_in_cut_out" + intermediateFormat.extension);
         
         double bodyDuration = rawDuration - actualIntroCrossfade - actualLoopCrossfade;  // Cut off BOTH ends!
         
@@ -1550,14 +2605,8 @@ bool TimelineAssembler::extractLoopVariants(const juce::File& loopSequenceRaw, c
                 return false;
             }
         } else {
-            juce::String extractBodyCommand = ffmpegExecutor->getFFmpegPath() +
-                " -y -i \"" + loopSequenceRaw.getFullPathName() + "\"" +
-                " -ss " + juce::String(actualIntroCrossfade) +
-                " -t " + juce::String(bodyDuration) +
-                " " + encodingParams +  // Lossless encoding already includes codec
-                " -an \"" + loopFromIntroBody.getFullPathName() + "\"";
-            
-            if (!ffmpegExecutor->executeCommand(extractBodyCommand, 0.0, 1.0)) {
+            if (!executeTrimWithFallback(loopSequenceRaw, loopFromIntroBody, actualIntroCrossfade, bodyDuration,
+                                         "extracting loop_from_intro_body")) {
                 if (logCallback) logCallback("ERROR: Failed to extract loop_from_intro_body");
                 return false;
             }
@@ -1567,59 +2616,37 @@ bool TimelineAssembler::extractLoopVariants(const juce::File& loopSequenceRaw, c
         double loopCrossfadeDuration = loopClips.empty() ? 0.0 : loopClips.back().crossfade;
 
         // Extract X_OUT (last N seconds of loop sequence for fade out)
-        juce::File loopFromLoopXOut = tempDirectory.getChildFile("loop_from_loop_sequence_x_out.mp4");
+        juce::File loopFromLoopXOut = tempDirectory.getChildFile("loop_from_loop_sequence_x_out" + intermediateFormat.extension);
         double xOutStartTime = rawDuration - loopCrossfadeDuration;
-        juce::String extractXOutCommand = ffmpegExecutor->getFFmpegPath() +
-            " -y" +                                                    // Overwrite output file
-            " -i \"" + loopSequenceRaw.getFullPathName() + "\"" +      // Input: concatenated loop sequence
-            " -ss " + juce::String(xOutStartTime) +                    // Seek to start position
-            " -t " + juce::String(loopCrossfadeDuration) +             // Extract for crossfade duration
-            " " + losslessParams +                                     // Use lossless encoding for intermediate files
-            " -an" +                                                   // No audio
-            " \"" + loopFromLoopXOut.getFullPathName() + "\"";         // Output: fade out source
-        
-        if (!ffmpegExecutor->executeCommand(extractXOutCommand, 0.0, 1.0)) {
+        
+        if (!executeTrimWithFallback(loopSequenceRaw, loopFromLoopXOut, xOutStartTime, loopCrossfadeDuration,
+                                     "extracting loop_from_loop_sequence_x_out")) {
             if (logCallback) logCallback("ERROR: Failed to extract X_OUT for loop-to-loop crossfade");
             return false;
         }
         
         // Extract X_IN (first N seconds for fade in)
-        juce::File loopFromLoopXIn = tempDirectory.getChildFile("loop_from_loop_sequence_x_in.mp4");
-        
-        // FFmpeg command: Extract first N seconds of loop_sequence_raw.mp4
-        juce::String extractXInCommand = ffmpegExecutor->getFFmpegPath() +
-            " -y" +                                                    // Overwrite output file
-            " -i \"" + loopSequenceRaw.getFullPathName() + "\"" +      // Input: concatenated loop sequence (same as X_OUT!)
-            " -t " + juce::String(loopCrossfadeDuration) +             // Extract for crossfade duration from start
-            " " + losslessParams +                                     // Use lossless encoding for intermediate files
-            " -an" +                                                   // No audio
-            " \"" + loopFromLoopXIn.getFullPathName() + "\"";          // Output: fade in destination
-        
-        if (!ffmpegExecutor->executeCommand(extractXInCommand, 0.0, 1.0)) {
+        juce::File loopFromLoopXIn = tempDirectory.getChildFile("loop_from_loop_sequence_x_in" + intermediateFormat.extension);
+        
+        // Extract first N seconds of loop_sequence_raw (the same input as X_OUT)
+        if (!executeTrimWithFallback(loopSequenceRaw, loopFromLoopXIn, 0.0, loopCrossfadeDuration,
+                                     "extracting loop_from_loop_sequence_x_in")) {
             if (logCallback) logCallback("ERROR: Failed to extract X_IN for loop-to-loop crossfade");
             return false;
         }
         
         // STEP 3: Extract BODY - the middle part with crossfade portions removed from both ends
         // This ensures no content duplication when crossfade is prepended to body
-        juce::File loopFromLoopBody = tempDirectory.getChildFile("loop_from_loop_body_cut_in_cut_out.mp4");
+        juce::File loopFromLoopBody = tempDirectory.getChildFile("loop_from_loop_body_cut_in_cut_out" + intermediateFormat.extension);
         double bodyDuration = rawDuration - loopCrossfadeDuration; // Only remove start, keep full end for overlap
         if (bodyDuration < 0.1) {
             if (logCallback) logCallback("WARNING: Body duration too short after removing crossfades from both ends");
             bodyDuration = 0.1; // Minimum duration to prevent errors
         }
         
-        // Extract body with start cut off, but keep full end
-        juce::String extractBodyCommand = ffmpegExecutor->getFFmpegPath() +
-            " -y" +                                                    // Overwrite output file
-            " -i \"" + loopSequenceRaw.getFullPathName() + "\"" +      // Input: concatenated loop sequence (same as X_OUT and X_IN!)
-            " -ss " + juce::String(loopCrossfadeDuration) +            // Skip first N seconds (will be replaced by crossfade)
-            " -t " + juce::String(bodyDuration) +                      // Extract middle portion only
-            " " + losslessParams +                                     // Use lossless encoding for intermediate files
-            " -an" +                                                   // No audio  
-            " \"" + loopFromLoopBody.getFullPathName() + "\"";         // Output: body with ends cut off
-        
-        if (!ffmpegExecutor->executeCommand(extractBodyCommand, 0.0, 1.0)) {
+        // Extract body with start cut off (it is replaced by the crossfade), but keep full end
+        if (!executeTrimWithFallback(loopSequenceRaw, loopFromLoopBody, loopCrossfadeDuration, bodyDuration,
+                                     "extracting loop_from_loop_body")) {
             if (logCallback) logCallback("ERROR: Failed to extract BODY for loop-to-loop sequence");
             return false;
         }
@@ -1639,9 +2666,9 @@ bool TimelineAssembler::generateInterpolatedCrossfades(const juce::File& tempDir
     juce::String encodingParams = losslessParams;
     
     // Generate loop_from_intro_sequence_x crossfade
-    juce::File introXOut = tempDirectory.getChildFile("loop_from_intro_sequence_x_out.mp4");
-    juce::File introXIn = tempDirectory.getChildFile("loop_from_intro_sequence_x_in.mp4");
-    juce::File introLoopCrossfade = tempDirectory.getChildFile("loop_from_intro_sequence_x.mp4");
+    juce::File introXOut = tempDirectory.getChildFile("loop_from_intro_sequence_x_out" + intermediateFormat.extension);
+    juce::File introXIn = tempDirectory.getChildFile("loop_from_intro_sequence_x_in" + intermediateFormat.extension);
+    juce::File introLoopCrossfade = tempDirectory.getChildFile("loop_from_intro_sequence_x" + intermediateFormat.extension);
     
     if (introXOut.existsAsFile() && introXIn.existsAsFile()) {
         // Use EXACT crossfade duration from intro clip data (intro-to-loop crossfade)
@@ -1674,9 +2701,9 @@ bool TimelineAssembler::generateInterpolatedCrossfades(const juce::File& tempDir
     }
     
     // Loop-to-loop crossfade: transition from end of last loop to beginning of first loop
-    juce::File loopXOut = tempDirectory.getChildFile("loop_from_loop_sequence_x_out.mp4");
-    juce::File loopXIn = tempDirectory.getChildFile("loop_from_loop_sequence_x_in.mp4");
-    juce::File loopLoopCrossfade = tempDirectory.getChildFile("loop_from_loop_sequence_x.mp4");
+    juce::File loopXOut = tempDirectory.getChildFile("loop_from_loop_sequence_x_out" + intermediateFormat.extension);
+    juce::File loopXIn = tempDirectory.getChildFile("loop_from_loop_sequence_x_in" + intermediateFormat.extension);
+    juce::File loopLoopCrossfade = tempDirectory.getChildFile("loop_from_loop_sequence_x" + intermediateFormat.extension);
 
     if (loopXOut.existsAsFile() && loopXIn.existsAsFile()) {
         double crossfadeDuration = loopClips.empty() ? 0.0 : loopClips.back().crossfade;
@@ -1796,90 +2823,79 @@ bool TimelineAssembler::concatenateWithCrossfade(const juce::File& crossfadeFile
     return true;
 }
 
-bool TimelineAssembler::buildProvisionalSequence(const juce::File& introSeq, const juce::File& loopFromIntro,
-                                                const juce::File& loopFromLoop, int repetitions, const juce::File& outputFile)
+bool TimelineAssembler::concatenateToDuration(const juce::File& introSeq, const juce::File& loopFromIntro,
+                                             const juce::File& loopFromLoop, int repetitions, double targetDuration,
+                                             const std::array<double, 3>& durations, const juce::File& outputFile)
 {
-    if (logCallback) logCallback("Building provisional sequence with " + juce::String(repetitions) + " loop repetitions");
+    if (logCallback) logCallback("Building final sequence with " + juce::String(repetitions) + " loop repetitions");
     
-    // More complex case: concatenate intro + loops
-    juce::Array<juce::File> sequencesToConcatenate;
+    struct Entry
+    {
+        juce::File file;
+        double duration;
+    };
+    
+    std::vector<Entry> entries;
     
     if (introSeq.existsAsFile()) {
-        sequencesToConcatenate.add(introSeq);
+        entries.push_back({ introSeq, durations[0] });
     }
     
     if (loopFromIntro.existsAsFile()) {
-        sequencesToConcatenate.add(loopFromIntro);
+        entries.push_back({ loopFromIntro, durations[1] });
     }
     
     // Add loop repetitions
     for (int i = 0; i < repetitions && loopFromLoop.existsAsFile(); i++) {
-        sequencesToConcatenate.add(loopFromLoop);
+        entries.push_back({ loopFromLoop, durations[2] });
     }
     
-    if (sequencesToConcatenate.size() == 0) {
-        if (logCallback) logCallback("ERROR: No sequences found for provisional sequence");
+    if (entries.empty()) {
+        if (logCallback) logCallback("ERROR: No sequences found for final sequence");
         return false;
     }
     
-    if (sequencesToConcatenate.size() == 1) {
-        // Single sequence, just copy
-        if (!sequencesToConcatenate[0].copyFileTo(outputFile)) {
-            if (logCallback) logCallback("ERROR: Failed to copy single sequence");
-            return false;
+    // Write the list up to the entry the target duration ends in, and end that entry
+    // there with an outpoint. The concat itself then produces the exact duration.
+    juce::File concatFile = outputFile.getSiblingFile("final_sequence_concat.txt");
+    juce::String list;
+    double listedDuration = 0.0;
+    int listedEntries = 0;
+    
+    for (const auto& entry : entries) {
+        list << "file '" << entry.file.getFullPathName().replace("\\", "/") << "'\n";
+        ++listedEntries;
+        
+        if (targetDuration > 0.0 && listedDuration + entry.duration >= targetDuration - 0.001) {
+            const double outpoint = targetDuration - listedDuration;
+            if (outpoint < entry.duration - 0.001)
+                list << "outpoint " << juce::String(outpoint, 6) << "\n";
+            listedDuration = targetDuration;
+            break;
         }
-        if (logCallback) logCallback("Provisional sequence created from single sequence");
-        return true;
+        
+        listedDuration += entry.duration;
     }
     
-    // Multiple sequences, concatenate them
-    juce::File concatFile = outputFile.getSiblingFile("provisional_concat.txt");
-    juce::FileOutputStream concatStream(concatFile);
-    if (!concatStream.openedOk()) {
-        if (logCallback) logCallback("ERROR: Failed to create provisional concat file");
+    if (!concatFile.replaceWithText(list)) {
+        if (logCallback) logCallback("ERROR: Failed to create final sequence concat file");
         return false;
     }
     
-    for (const auto& seq : sequencesToConcatenate) {
-        concatStream.writeText("file '" + seq.getFullPathName().replace("\\", "/") + "'\n", false, false, nullptr);
-    }
-    concatStream.flush();
-    
     // Execute concat command
-    if (!executeConcatWithFallback(concatFile, outputFile, "concatenating provisional sequences", 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to concatenate provisional sequences");
-        return false;
-    }
-
+    const bool succeeded = executeConcatWithFallback(concatFile, outputFile, "concatenating final sequence", 0.0, 1.0);
+    
     // Cleanup the temporary concat file to save disk space
     if (concatFile.existsAsFile())
         concatFile.deleteFile();
     
-    if (logCallback) logCallback("Provisional sequence created from " + juce::String(sequencesToConcatenate.size()) + " sequences");
-    return true;
-}
-
-bool TimelineAssembler::trimToExactDuration(const juce::File& inputFile, const juce::File& outputFile, double duration)
-{
-    if (logCallback) logCallback("Trimming to exact duration: " + juce::String(duration) + "s");
-    
-    if (!inputFile.existsAsFile()) {
-        if (logCallback) logCallback("ERROR: Input file does not exist for duration trimming");
-        return false;
-    }
-    
-    juce::String trimCommand = ffmpegExecutor->getFFmpegPath() +
-        " -y -i \"" + inputFile.getFullPathName() + "\"" +
-        " -to " + juce::String(duration, 6) +
-        " -c:v copy -an -fflags +genpts -copyts -avoid_negative_ts make_zero" +
-        " \"" + outputFile.getFullPathName() + "\"";
-    
-    if (!ffmpegExecutor->executeCommand(trimCommand, 0.0, 1.0)) {
-        if (logCallback) logCallback("ERROR: Failed to trim to exact duration");
+    if (!succeeded) {
+        if (logCallback) logCallback("ERROR: Failed to concatenate final sequence");
         return false;
     }
     
-    if (logCallback) logCallback("Successfully trimmed to " + juce::String(duration) + "s");
+    if (logCallback) logCallback("Final sequence created from " + juce::String(listedEntries) + " sequences, "
+                                 + juce::String(listedDuration, 3) + "s");
     return true;
 }
 
@@ -1905,8 +2921,10 @@ bool TimelineAssembler::applyOverlays(const juce::File& inputFile, const std::ve
     // Get the temporary directory from the input file's parent
     juce::File tempDirectory = inputFile.getParentDirectory();
     
-    // Call the overlay processor with the total duration
-    return overlayProcessor->processOverlays(inputFile, overlayClips, totalDuration, tempDirectory, outputFile);
+    // The overlaid sequence is an intermediate like the one it is drawn over, so the
+    // spans without overlays can be stream copied from it; step 7 does the delivery encode
+    return overlayProcessor->processOverlays(inputFile, overlayClips, totalDuration, tempDirectory, outputFile,
+                                             &intermediateFormat);
 }
 
 // Existing methods (legacy compatibility)
@@ -2015,34 +3033,28 @@ bool TimelineAssembler::executeConcatWithFallback(const juce::File& concatList,
                                                   double progressStart,
                                                   double progressEnd)
 {
-    juce::String commandBase = ffmpegExecutor->getFFmpegPath() +
-        " -y -f concat -safe 0" +
-        " -i \"" + concatList.getFullPathName() + "\"" +
-        " " + losslessParams;
-    
-    juce::String primaryCommand = commandBase +
-        " -an \"" + outputFile.getFullPathName() + "\"";
-    
-    juce::String fallbackCommand = commandBase +
-        " -pix_fmt yuv420p -vsync cfr -fflags +genpts -reset_timestamps 1 -avoid_negative_ts make_zero -movflags +faststart -threads 1" +
-        " -an \"" + outputFile.getFullPathName() + "\"";
-    
-    if (ffmpegExecutor->executeCommand(primaryCommand, progressStart, progressEnd))
-        return true;
-    
-    if (logCallback) logCallback("WARNING: " + description + " failed; retrying with compatibility settings");
-    
-    if (outputFile.existsAsFile())
-        outputFile.deleteFile();
-    
-    if (!ffmpegExecutor->executeCommand(fallbackCommand, progressStart, progressEnd))
+    auto buildCommand = [&](const FallbackPolicy::JobOptions& options)
     {
-        if (logCallback) logCallback("ERROR: " + description + " failed after retry");
-        return false;
-    }
-    
-    if (logCallback) logCallback("Retry succeeded for " + description);
-    return true;
+        juce::String command = ffmpegExecutor->getFFmpegPath() + " -y -f concat -safe 0";
+
+        if (options.tolerantDecode)
+            command += " " + options.getInputFlags();
+
+        command += " -i \"" + concatList.getFullPathName() + "\"" +
+                   " " + losslessParams;
+
+        if (options.tolerantDecode)
+            command += " -pix_fmt yuv420p -reset_timestamps 1 " + intermediateFormat.muxerArgs;
+
+        if (options.getOutputFlags().isNotEmpty())
+            command += " " + options.getOutputFlags();
+
+        command += " -an \"" + outputFile.getFullPathName() + "\"";
+        return command;
+    };
+
+    // The intermediates never use the GPU encoder, whatever their format
+    return ffmpegExecutor->executeWithFallback(buildCommand, false, outputFile, description, progressStart, progressEnd);
 }
 
 bool TimelineAssembler::executeTrimWithFallback(const juce::File& inputFile,
@@ -2051,13 +3063,27 @@ bool TimelineAssembler::executeTrimWithFallback(const juce::File& inputFile,
                                                 double durationSeconds,
                                                 const juce::String& description)
 {
-    auto buildCommand = [&](bool seekBeforeInput, bool includeExtras)
+    // The manifest records what was produced; a cut can come out a frame off the request
+    double producedDuration = 0.0;
+    if (smartCut && executeSmartTrim(inputFile, outputFile, startSeconds, durationSeconds, producedDuration))
+    {
+        manifest.setDuration(outputFile, producedDuration);
+        return true;
+    }
+    
+    auto buildCommand = [&](const FallbackPolicy::JobOptions& options)
     {
         juce::String command = ffmpegExecutor->getFFmpegPath() + " -y";
         
+        // Tolerant attempts seek on the input side, which skips damaged data before the cut
+        const bool seekBeforeInput = options.tolerantDecode;
+        
         if (seekBeforeInput && startSeconds > 0.0)
             command += " -ss " + juce::String(startSeconds, 6);
         
+        if (options.tolerantDecode)
+            command += " " + options.getInputFlags();
+        
         command += " -i \"" + inputFile.getFullPathName() + "\"";
         
         if (!seekBeforeInput && startSeconds > 0.0)
@@ -2066,28 +3092,109 @@ bool TimelineAssembler::executeTrimWithFallback(const juce::File& inputFile,
         command += " -t " + juce::String(durationSeconds, 6) +
                    " " + losslessParams;
         
-        if (includeExtras)
-            command += " -pix_fmt yuv420p -vsync cfr -fflags +genpts -err_detect ignore_err -threads 1 -movflags +faststart";
+        if (options.tolerantDecode)
+            command += " -pix_fmt yuv420p " + intermediateFormat.muxerArgs;
+        
+        if (options.getOutputFlags().isNotEmpty())
+            command += " " + options.getOutputFlags();
         
         command += " -an \"" + outputFile.getFullPathName() + "\"";
         return command;
     };
     
-    if (ffmpegExecutor->executeCommand(buildCommand(false, false), 0.0, 1.0))
-        return true;
+    if (!ffmpegExecutor->executeWithFallback(buildCommand, false, outputFile, description, 0.0, 1.0))
+        return false;
+    
+    // A failed probe leaves the length unrecorded, so getIntermediateDuration() probes it later
+    producedDuration = ffmpegExecutor->getFileDuration(outputFile);
+    if (producedDuration > 0.0)
+        manifest.setDuration(outputFile, producedDuration);
+    return true;
+}
+
+bool TimelineAssembler::executeSmartTrim(const juce::File& inputFile,
+                                         const juce::File& outputFile,
+                                         double startSeconds,
+                                         double durationSeconds,
+                                         double& producedDuration)
+{
+    // Copied and re-encoded parts only join up if they share the codec settings
+    if (!inputFile.hasFileExtension(intermediateFormat.extension) || isCancelled())
+        return false;
+    
+    const auto index = KeyframeIndex::forFile(*ffmpegExecutor, inputFile);
+    KeyframeIndex::Cut cut;
+    if (index == nullptr || !index->planCut(startSeconds, durationSeconds, cut))
+        return false;
     
-    if (logCallback) logCallback("WARNING: " + description + " failed; retrying with compatibility settings");
+    // Seek a little past a keyframe when copying, so the demuxer can't land on the one before,
+    // and a little before a frame when encoding, so the accurate seek keeps it
+    const double slack = 0.25 * index->getFrameDuration();
+    const juce::String ffmpeg = ffmpegExecutor->getFFmpegPath();
+    const juce::String input = " -i \"" + inputFile.getFullPathName() + "\"";
     
-    if (outputFile.existsAsFile())
-        outputFile.deleteFile();
+    auto partFile = [&](const juce::String& part)
+    {
+        return outputFile.getSiblingFile(outputFile.getFileNameWithoutExtension() + "_smartcut_" + part + intermediateFormat.extension);
+    };
     
-    if (!ffmpegExecutor->executeCommand(buildCommand(true, true), 0.0, 1.0))
+    auto encodePart = [&](double seconds, int frames, const juce::File& file)
     {
-        if (logCallback) logCallback("ERROR: " + description + " failed after retry");
+        return ffmpegExecutor->executeCommand(ffmpeg + " -y -ss " + juce::String(juce::jmax(0.0, seconds - slack), 6) + input
+                                              + " -frames:v " + juce::String(frames) + " " + losslessParams
+                                              + " -an \"" + file.getFullPathName() + "\"", 0.0, 1.0);
+    };
+    
+    const bool onlyCopy = cut.headFrames == 0 && cut.tailFrames == 0;
+    const juce::File head = partFile("head");
+    const juce::File middle = onlyCopy ? outputFile : partFile("copy");
+    const juce::File tail = partFile("tail");
+    const juce::File list = partFile("list").withFileExtension(".txt");
+    
+    bool succeeded = ffmpegExecutor->executeCommand(ffmpeg + " -y -ss " + juce::String(cut.copyStartTime + slack, 6) + input
+                                                    + " -frames:v " + juce::String(cut.copyFrames)
+                                                    + " -c copy -avoid_negative_ts make_zero " + intermediateFormat.muxerArgs
+                                                    + " -an \"" + middle.getFullPathName() + "\"", 0.0, 1.0);
+    
+    if (succeeded && cut.headFrames > 0)
+        succeeded = encodePart(cut.startTime, cut.headFrames, head);
+    
+    if (succeeded && cut.tailFrames > 0)
+        succeeded = encodePart(cut.copyEndTime, cut.tailFrames, tail);
+    
+    if (succeeded && !onlyCopy) {
+        juce::String entries;
+        for (const auto& part : { head, middle, tail })
+            if (part.existsAsFile())
+                entries << "file '" << part.getFullPathName().replace("\\", "/") << "'\n";
+        
+        succeeded = list.replaceWithText(entries)
+                    && ffmpegExecutor->executeCommand(ffmpeg + " -y -f concat -safe 0 -i \"" + list.getFullPathName() + "\""
+                                                      + " -c copy " + intermediateFormat.muxerArgs
+                                                      + " -an \"" + outputFile.getFullPathName() + "\"", 0.0, 1.0);
+    }
+    
+    for (const auto& part : { head, tail, list })
+        part.deleteFile();
+    if (!onlyCopy)
+        middle.deleteFile();
+    
+    // A join that came out short or long means the parts didn't fit together
+    const double expected = cut.getNumFrames() * index->getFrameDuration();
+    producedDuration = succeeded ? ffmpegExecutor->getFileDuration(outputFile) : 0.0;
+    if (succeeded && std::abs(producedDuration - expected) > 1.5 * index->getFrameDuration())
+        succeeded = false;
+    
+    if (!succeeded) {
+        outputFile.deleteFile();
+        if (logCallback && !isCancelled())
+            logCallback("WARNING: Smart cut of " + inputFile.getFileName() + " failed; re-encoding the whole cut");
         return false;
     }
     
-    if (logCallback) logCallback("Retry succeeded for " + description);
+    if (logCallback)
+        logCallback("Smart cut " + outputFile.getFileName() + ": " + juce::String(cut.copyFrames) + " frames copied, "
+                    + juce::String(cut.headFrames + cut.tailFrames) + " re-encoded");
     return true;
 }
 
@@ -2117,6 +3224,11 @@ double TimelineAssembler::calculateLoopDuration(const std::vector<RenderTypes::V
     return duration;
 }
 
+bool TimelineAssembler::isCancelled() const
+{
+    return ffmpegExecutor != nullptr && ffmpegExecutor->isCancellationRequested();
+}
+
 bool TimelineAssembler::isNvencAvailable(const juce::String& context)
 {
     if (!ffmpegExecutor) {
@@ -2125,10 +3237,12 @@ bool TimelineAssembler::isNvencAvailable(const juce::String& context)
         return false;
     }
     
-    bool available = ffmpegExecutor->isNVENCAvailable();
+    const auto report = EncoderCapabilities::getInstance().getReport(ffmpegExecutor->getFFmpegPath());
+    bool available = report.isWorking("h264_nvenc");
     if (logCallback) {
         logCallback("[" + context + "] NVENC availability check: " + 
-                   (available ? "AVAILABLE" : "NOT AVAILABLE"));
+                   (available ? "AVAILABLE (" + juce::String(report.getFramesPerSecond("h264_nvenc"), 1) + " fps in probe)"
+                              : "NOT AVAILABLE"));
     }
     
     return available;
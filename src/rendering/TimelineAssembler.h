@@ -3,6 +3,15 @@
 #include "RenderTypes.h"
 #include "FFmpegExecutor.h"
 #include "OverlayProcessor.h"
+#include "RenderGraph.h"
+#include "IntermediateCache.h"
+#include "IntermediateFormat.h"
+#include "DiskBudget.h"
+#include "RenderJournal.h"
+#include "KeyframeIndex.h"
+#include "RenderCostModel.h"
+#include "IntermediateManifest.h"
+#include <array>
 
 /**
  * Handles the assembly of the final timeline, including
@@ -40,8 +49,72 @@ public:
                           const juce::String& finalNvidiaEncodingParams,
                           const juce::String& finalCpuEncodingParams);
     
+    /**
+     * Sets how many FFmpeg jobs may run at once while assembling the timeline.
+     * Defaults to FFLUCE_RENDER_JOBS, or one job per four cores (at most four).
+     * @param numJobs The number of worker threads, at least 1
+     */
+    void setMaxParallelJobs(int numJobs) { maxParallelJobs = juce::jmax(1, numJobs); }
+    
+    /**
+     * In a dry run assembleTimeline() only plans the render: it logs the task graph
+     * and its critical path and writes them to render_graph.txt in the temp directory.
+     */
+    void setDryRun(bool shouldDryRun) { dryRun = shouldDryRun; }
+    
+    /**
+     * Sets the cache that intermediates are restored from and stored to, so a
+     * re-render only redoes the tasks whose inputs or settings changed.
+     * @param cache The cache to use, or nullptr to render everything
+     */
+    void setIntermediateCache(IntermediateCache* cache) { intermediateCache = cache; }
+    
+    /**
+     * Sets the journal that completed tasks are recorded in. Tasks it already holds,
+     * with their outputs unchanged in the temp directory, are not run again.
+     * @param journal The journal of this render, or nullptr to keep none
+     */
+    void setRenderJournal(RenderJournal* journal) { renderJournal = journal; }
+    
+    /**
+     * Sets the model that predicts each task's wall time from past sessions. Tasks it
+     * has no history for keep a fixed guess proportional to their media length.
+     */
+    void setCostModel(const RenderCostModel* model) { costModel = model; }
+    
+    /**
+     * When enabled (the default, unless FFLUCE_ENCODE_ONCE is "0"), a render without
+     * overlays encodes the intro, the loop from the intro and one loop body once each,
+     * repeats the body by stream copy and only re-encodes the faded tail. Encode time
+     * then barely depends on the target duration.
+     */
+    void setEncodeOnce(bool shouldEncodeOnce) { encodeOnce = shouldEncodeOnce; }
+    
+    /**
+     * When enabled (the default, unless FFLUCE_SMART_CUT is "0"), trims of intermediates
+     * stream copy the whole GOPs inside the cut and only re-encode the partial ones at
+     * its edges, as found by a KeyframeIndex of the input.
+     */
+    void setSmartCut(bool shouldSmartCut) { smartCut = shouldSmartCut; }
+    
+    /**
+     * Selects how the timeline is rendered. The filtergraph engine decodes and encodes
+     * every frame once, and falls back to the file-based pipeline when the timeline
+     * exceeds its limits or its command fails.
+     */
+    void setRenderEngine(RenderTypes::RenderEngine engine) { renderEngine = engine; }
+    
+    /**
+     * When enabled (the default, unless FFLUCE_CUDA_FILTERS is "0"), the filtergraph engine
+     * renders with NVENC on the CUDA filter profile, keeping frames on the GPU, wherever the
+     * capability probe found the CUDA filters working. Otherwise it uses the CPU filters.
+     */
+    void setCudaFilters(bool shouldUseCudaFilters) { cudaFilters = shouldUseCudaFilters; }
+    
     /**
      * Assembles the final timeline.
+     * The steps below are planned as a RenderGraph and run on a RenderGraphScheduler,
+     * so independent clips and crossfades are encoded in parallel.
      * @param introClips Information about the intro clips
      * @param loopClips Information about the loop clips
      * @param overlayClips Information about overlay clips
@@ -193,6 +266,17 @@ public:
                                  double durationSeconds,
                                  const juce::String& description);
     
+    /**
+     * Cuts an intermediate by copying its whole GOPs and re-encoding the partial ones.
+     * producedDuration receives the probed length of the cut.
+     * @return false if the cut can't be done that way; outputFile is then left alone
+     */
+    bool executeSmartTrim(const juce::File& inputFile,
+                          const juce::File& outputFile,
+                          double startSeconds,
+                          double durationSeconds,
+                          double& producedDuration);
+    
 private:
     // Helper method to check if a crossfade should exist based on the clip settings
     bool shouldHaveCrossfade(const std::vector<RenderTypes::VideoClipInfo>& clips, size_t index) const {
@@ -267,10 +351,120 @@ private:
     // Helper method to check if NVENC is available on this system
     bool isNvencAvailable(const juce::String& context);
     
+    // Returns true once the render this assembler works for has been cancelled
+    bool isCancelled() const;
+    
+    /** Adds every step of the assembly to the graph as tasks with their input and output files. */
+    void buildRenderGraph(RenderGraph& graph,
+                          const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                          const std::vector<RenderTypes::VideoClipInfo>& loopClips,
+                          const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
+                          const juce::File& audioFile,
+                          double targetDuration,
+                          const juce::File& tempDirectory,
+                          const juce::File& outputFile);
+    
+    /** Picks the intermediate codec and container for this render (see IntermediateFormat). */
+    void selectIntermediateFormat(double targetDuration, const juce::File& tempDirectory);
+    
+    /** Sets the DiskBudget's size predictions from the clips' resolution and the chosen formats. */
+    void configureDiskBudget(const std::vector<RenderTypes::VideoClipInfo>& clips);
+    
+    /**
+     * Renders the timeline with a FilterGraphRenderer.
+     * @param handled Set to false when the file-based pipeline should render it instead
+     */
+    bool renderWithFilterGraph(const std::vector<RenderTypes::VideoClipInfo>& introClips,
+                               const std::vector<RenderTypes::VideoClipInfo>& loopClips,
+                               const std::vector<RenderTypes::OverlayClipInfo>& overlayClips,
+                               const juce::File& audioFile,
+                               double targetDuration,
+                               const juce::File& tempDirectory,
+                               const juce::File& outputFile,
+                               bool& handled);
+    
+    /** Predicted wall seconds of a task, from the cost model when it has seen similar ones. */
+    double estimateTaskSeconds(RenderGraph::TaskType type, double mediaSeconds) const;
+    
+    /** Restores cached tasks, skips the ones only they needed, and stores what the rest produce. */
+    void applyIntermediateCache(RenderGraph& graph);
+    
+    /** Keeps the outputs of tasks the journal holds, and skips the ones only they needed. */
+    void applyRenderJournal(RenderGraph& graph);
+    
+    /** Makes every task that still runs record itself in the journal once it succeeds. */
+    void recordToRenderJournal(RenderGraph& graph);
+    
+    // Conforms one source clip to its defined duration (step 1)
+    bool conformClip(const RenderTypes::VideoClipInfo& clip, const juce::File& outputFile, const juce::String& label);
+    
+    /** Registers the conformed clips of one list in the manifest, in timeline order. */
+    void registerClips(const juce::String& type, const std::vector<RenderTypes::VideoClipInfo>& clips, const juce::File& tempDirectory);
+    
+    /** Length of an intermediate from the manifest, probing (and recording) it only if unknown. */
+    double getIntermediateDuration(const juce::File& file);
+    
+    // Second halves of steps 3 and 5, and the parts of step 6, runnable as separate tasks
+    bool finishIntroSequence(const std::vector<RenderTypes::VideoClipInfo>& introClips, const juce::File& tempDirectory);
+    bool assembleFinalLoopSequences(const juce::File& tempDirectory);
+    bool buildFinalSequence(double targetDuration, const juce::File& tempDirectory);
+    void deleteIfExists(const juce::File& file, const juce::String& label);
+    
+    /** Where the repeated loop body ends and the re-encoded tail begins. */
+    struct LoopRepetitionPlan
+    {
+        bool valid = false;
+        juce::String reason;            // why the timeline can't be stream copied
+        double introSeconds = 0.0;
+        double loopFromIntroSeconds = 0.0;
+        double bodySeconds = 0.0;
+        int copiedBodies = 0;           // loop bodies repeated by stream copy
+        int tailBodies = 0;             // loop bodies the tail is cut from
+        double tailSeconds = 0.0;
+    };
+    
+    // Encode-once final output: pieces encoded once, joined by stream copy
+    LoopRepetitionPlan planLoopRepetition(double targetDuration, const juce::File& tempDirectory);
+    juce::String getFinalVideoEncodeArgs() const;
+    juce::String buildFinalAudioFilter(double videoDuration) const;
+    bool encodeFinalPiece(const juce::File& inputFile, const juce::File& outputFile, double fadeInSeconds);
+    bool encodeFinalTail(double targetDuration, const juce::File& tempDirectory);
+    bool muxEncodedPieces(const juce::File& audioFile, double targetDuration,
+                          const juce::File& tempDirectory, const juce::File& outputFile);
+    bool muxVideoList(const juce::File& videoList, const juce::File& audioFile, double duration, const juce::File& outputFile);
+    
+    /**
+     * Frame count and rate of the sequence a segmented encode splits. The sequence is
+     * written by an earlier task, so whichever segment task runs first measures it and
+     * the others and the mux reuse the numbers.
+     */
+    struct SegmentSource
+    {
+        juce::CriticalSection lock;
+        bool measured = false;
+        double targetDuration = 0.0;    // set by the planner; the sequence is rendered to this length
+        int totalFrames = 0;
+        double fps = 0.0;
+    };
+    
+    // Segment-parallel final encode: frame ranges encoded concurrently, joined by stream copy
+    int getFinalSegmentCount(double targetDuration) const;
+    juce::File getFinalSegmentFile(const juce::File& tempDirectory, int index) const;
+    bool measureSegmentSource(const juce::File& videoSequence, SegmentSource& source);
+    std::vector<int> planSegmentBoundaries(int totalFrames, int segments, double fps) const;
+    bool encodeFinalSegment(const juce::File& videoSequence, SegmentSource& source, int index, int segments,
+                            const juce::File& tempDirectory);
+    bool muxFinalSegments(const juce::File& audioFile, const juce::File& videoSequence, SegmentSource& source, int segments,
+                          const juce::File& tempDirectory, const juce::File& outputFile);
+    
     // Helper methods for algorithm implementation
-    bool generateCrossfadeForClipPair(const juce::String& type, size_t fromIndex, size_t toIndex,
-                                     const RenderTypes::VideoClipInfo& fromClip, const RenderTypes::VideoClipInfo& toClip,
-                                     const juce::File& tempDirectory);
+    /**
+     * Writes every type_i_to_j_x transition of a clip list with one FFmpeg command per
+     * batch of crossfades, each conformed clip decoded once. Pairs the batch fails on
+     * are redone one at a time through generateCrossfadeTransition().
+     */
+    bool generateBatchedCrossfades(const juce::String& type, const std::vector<RenderTypes::VideoClipInfo>& clips,
+                                   const juce::File& tempDirectory);
     bool createMiddleClipBodySegment(const juce::String& type, size_t clipIndex, 
                                    double prevCrossfadeDuration, double nextCrossfadeDuration, 
                                    const juce::File& tempDirectory);
@@ -293,9 +487,9 @@ public:
 private:
     bool concatenateTwoFiles(const juce::File& file1, const juce::File& file2, const juce::File& outputFile);
     bool concatenateWithCrossfade(const juce::File& crossfadeFile, const juce::File& sequenceFile, const juce::File& outputFile);
-    bool buildProvisionalSequence(const juce::File& introSeq, const juce::File& loopFromIntro,
-                                 const juce::File& loopFromLoop, int repetitions, const juce::File& outputFile);
-    bool trimToExactDuration(const juce::File& inputFile, const juce::File& outputFile, double duration);
+    bool concatenateToDuration(const juce::File& introSeq, const juce::File& loopFromIntro,
+                               const juce::File& loopFromLoop, int repetitions, double targetDuration,
+                               const std::array<double, 3>& durations, const juce::File& outputFile);
     bool applyOverlays(const juce::File& inputFile, const std::vector<RenderTypes::OverlayClipInfo>& overlayClips, const juce::File& outputFile);
 
     // FFmpeg executor for running commands
@@ -312,6 +506,9 @@ private:
     juce::String finalCpuParams;
     juce::String losslessParams;
     
+    // Codec and container of the intermediates; losslessParams holds its codec arguments
+    IntermediateFormat intermediateFormat;
+    
     // Store total duration for access in all methods
     double totalDuration;
     
@@ -319,6 +516,39 @@ private:
     double fadeInDuration;
     double fadeOutDuration;
     
+    // Worker threads for the render graph, and whether to only plan it
+    int maxParallelJobs;
+    bool dryRun = false;
+    
+    // Encode the repeated loop body once and stream copy it (see setEncodeOnce)
+    bool encodeOnce;
+    
+    // Copy whole GOPs when trimming intermediates (see setSmartCut)
+    bool smartCut;
+    
+    // Keep filtergraph frames on the GPU when NVENC is used (see setCudaFilters)
+    bool cudaFilters;
+    
+    RenderTypes::RenderEngine renderEngine = RenderTypes::RenderEngine::FileBased;
+    
+    // Predicts scratch space, spills to other volumes and deletes intermediates early
+    DiskBudget diskBudget;
+    
+    // Owned by RenderManagerCore
+    IntermediateCache* intermediateCache = nullptr;
+    
+    // Checkpoints of this render, for resuming it; owned by RenderManagerCore
+    RenderJournal* renderJournal = nullptr;
+    
+    // Task cost predictions from past sessions; owned by RenderManagerCore
+    const RenderCostModel* costModel = nullptr;
+    
+    // Clips and intermediate durations produced by this render
+    IntermediateManifest manifest;
+    
+    // Size and frame rate of the source clips, probed by configureDiskBudget()
+    FFmpegExecutor::VideoStreamInfo sourceGeometry;
+    
     // Log callback
     std::function<void(const juce::String&)> logCallback;
     
@@ -1,6 +1,7 @@
 #include "YoutubeStreamer.h"
 #include "../rendering/FFmpegExecutor.h"
 #include "../rendering/OverlayProcessor.h"
+#include "../rendering/EncoderCapabilities.h"
 #include "../core/ProcessManager.h"
 
 YoutubeStreamer::YoutubeStreamer() : juce::Thread("YoutubeStreamer")
@@ -182,7 +183,8 @@ bool YoutubeStreamer::setupFFmpegPipeline()
     if (command.isEmpty())
         return false;
 
-    ffmpegProcess = std::make_unique<juce::ChildProcess>();
+    // Stream job policy keeps the live encode ahead of any offline render running alongside
+    ffmpegProcess = std::make_unique<FFmpegProcess>(ProcessManager::JobClass::Stream, "YoutubeStreamer FFmpeg");
 
     if (!ffmpegProcess->start(command))
         return false;
@@ -192,8 +194,6 @@ bool YoutubeStreamer::setupFFmpegPipeline()
     if (!ffmpegProcess->isRunning())
         return false;
 
-    ProcessManager::getInstance().registerProcess(ffmpegProcess.get(), "YoutubeStreamer FFmpeg");
-
     juce::MessageManager::callAsync([this]() {
         if (onStatusUpdate)
             onStatusUpdate("Infinite streaming started - intro->loop sequence");
@@ -206,8 +206,6 @@ void YoutubeStreamer::cleanupFFmpegPipeline()
 {
     if (ffmpegProcess)
     {
-        ProcessManager::getInstance().unregisterProcess(ffmpegProcess.get());
-
         if (ffmpegProcess->isRunning())
         {
             ffmpegProcess->kill();
@@ -356,23 +354,10 @@ bool YoutubeStreamer::createStreamingSequences(const juce::File& tempDir)
         overlayProcessor = std::make_unique<OverlayProcessor>(ffmpegExecutor.get());
         timelineAssembler = std::make_unique<TimelineAssembler>(ffmpegExecutor.get(), overlayProcessor.get());
 
-        // Test NVENC availability
-        bool shouldUseNVENC = true;
-        juce::ChildProcess nvencTest;
-        juce::String testCommand = ffmpegExecutor->getFFmpegPath() + " -f lavfi -i testsrc=duration=1:size=320x240:rate=1 -c:v h264_nvenc -f null -";
-
-        if (nvencTest.start(testCommand))
-        {
-            bool nvencResult = nvencTest.waitForProcessToFinish(5000);
-            juce::String nvencOutput = UTF8String::readAllProcessOutput(&nvencTest);
-
-            if (!nvencResult || nvencOutput.contains("Unknown encoder") || nvencOutput.contains("not available"))
-                shouldUseNVENC = false;
-        }
-        else
-        {
-            shouldUseNVENC = false;
-        }
+        // NVENC availability comes from the cached capability probe
+        const bool shouldUseNVENC = EncoderCapabilities::getInstance()
+                                        .getReport(ffmpegExecutor->getFFmpegPath())
+                                        .isWorking("h264_nvenc");
 
         const int targetBitrate = streamingBitrate > 0 ? streamingBitrate : 9000;
         const int peakBitrate = juce::roundToInt(targetBitrate * 1.1);
@@ -99,7 +99,7 @@ private:
     int platform{1};      // 1=YouTube, 2=Twitch, 3=Custom
     int streamingBitrate{2500}; // Default 2.5 Mbps
     bool streamingUseNVENC{ true };
-    std::unique_ptr<juce::ChildProcess> ffmpegProcess;
+    std::unique_ptr<FFmpegProcess> ffmpegProcess;   // runs under the Stream job policy
     
     // Thread state
     juce::String pendingRtmpKey;
@@ -0,0 +1,82 @@
+#include <JuceHeader.h>
+#include "AlphaCompositor.h"
+#include <algorithm>
+#include <vector>
+
+class AlphaCompositorTests : public juce::UnitTest
+{
+public:
+    AlphaCompositorTests() : juce::UnitTest("AlphaCompositor", "Rendering") {}
+
+    void runTest() override
+    {
+        beginTest("Opaque and transparent pixels");
+        {
+            std::vector<juce::uint8> frame(AlphaCompositor::YuvFrame::getSize(4, 4), 50);
+            std::vector<juce::uint8> overlay(4 * 4 * 4, 255);
+            AlphaCompositor::YuvFrame yuv { frame.data(), 4, 4 };
+
+            // Transparent black leaves the frame alone
+            std::vector<juce::uint8> clear(4 * 4 * 4, 0);
+            AlphaCompositor::blend(yuv, { clear.data(), 4, 4 }, 0, 0);
+            expect(std::all_of(frame.begin(), frame.end(), [](juce::uint8 b) { return b == 50; }));
+
+            // Opaque white is limited-range white
+            AlphaCompositor::blend(yuv, { overlay.data(), 4, 4 }, 0, 0);
+            expectEquals((int) yuv.getY()[0], 235);
+            expectEquals((int) yuv.getU()[0], 128);
+            expectEquals((int) yuv.getV()[0], 128);
+        }
+
+        beginTest("AVX2 kernels match the scalar loop");
+        {
+            if (!AlphaCompositor::hasVectorKernels())
+            {
+                logMessage("No AVX2 on this CPU; only the scalar loop runs");
+                return;
+            }
+
+            juce::Random random(0x5eed);
+
+            // Every width up to three vector blocks, so each tail length is covered, plus wider ones
+            std::vector<int> widths;
+            for (int w = 1; w <= 48; ++w)
+                widths.push_back(w);
+            widths.insert(widths.end(), { 63, 65, 127, 401 });
+
+            for (const int width : widths)
+            {
+                const int height = 1 + random.nextInt(7);
+                const int frameWidth = width + 2 + random.nextInt(9);
+                const int frameHeight = height + 2 + random.nextInt(5);
+                const int x = random.nextInt(frameWidth - width + 1);
+                const int y = random.nextInt(frameHeight - height + 1);
+
+                std::vector<juce::uint8> overlay((size_t) width * (size_t) height * 4);
+                random.fillBitsRandomly(overlay.data(), overlay.size());
+
+                // Fully opaque and fully transparent pixels take their own branches
+                for (size_t i = 0; i < overlay.size() / 4; i += 5)
+                    overlay[i * 4 + 3] = random.nextBool() ? 255 : 0;
+                AlphaCompositor::premultiply(overlay.data(), overlay.size() / 4);
+
+                std::vector<juce::uint8> scalar(AlphaCompositor::YuvFrame::getSize(frameWidth, frameHeight));
+                random.fillBitsRandomly(scalar.data(), scalar.size());
+                auto vector = scalar;
+
+                AlphaCompositor::YuvFrame scalarFrame { scalar.data(), frameWidth, frameHeight };
+                AlphaCompositor::YuvFrame vectorFrame { vector.data(), frameWidth, frameHeight };
+                const AlphaCompositor::OverlayFrame sprite { overlay.data(), width, height };
+
+                AlphaCompositor::setVectorKernelsEnabled(false);
+                AlphaCompositor::blend(scalarFrame, sprite, x, y);
+                AlphaCompositor::setVectorKernelsEnabled(true);
+                AlphaCompositor::blend(vectorFrame, sprite, x, y);
+
+                expect(scalar == vector, "width " + juce::String(width) + " at " + juce::String(x) + "," + juce::String(y));
+            }
+        }
+    }
+};
+
+static AlphaCompositorTests alphaCompositorTests;
@@ -0,0 +1,91 @@
+#include <JuceHeader.h>
+#include "CancellationToken.h"
+#include "FFmpegExecutor.h"
+#include <atomic>
+#include <thread>
+
+/**
+ * Holds cancel-to-idle latency to CancellationToken::idleLatencyBudgetMs: from
+ * cancel() until the running process has been killed and reaped. A long sleep
+ * stands in for an FFmpeg job, so no FFmpeg binary is needed.
+ */
+class CancellationTests : public juce::UnitTest
+{
+public:
+    CancellationTests() : juce::UnitTest("Cancellation", "Rendering") {}
+
+    void runTest() override
+    {
+       #if JUCE_WINDOWS
+        logMessage("Uses POSIX sleep; skipped on Windows");
+       #else
+        beginTest("Cancelling kills the running command within the budget");
+        {
+            FFmpegExecutor executor;
+            auto token = CancellationToken::create();
+            executor.setCancellationToken(token);
+
+            std::atomic<bool> finished { false };
+            bool succeeded = true;
+            double latencyMs = 0.0;
+
+            std::thread render([&]
+            {
+                succeeded = executor.executeCommand("sleep 30");
+                latencyMs = token->getMillisecondsSinceCancel();
+                finished = true;
+            });
+
+            // Long enough for the process to be running when the cancel arrives
+            juce::Thread::sleep(300);
+            expect(!finished, "the command ended before it was cancelled");
+
+            token->cancel();
+            render.join();
+
+            expect(!succeeded, "a cancelled command reported success");
+            expect(latencyMs <= CancellationToken::idleLatencyBudgetMs,
+                   "cancel-to-idle took " + juce::String(latencyMs, 0) + " ms");
+        }
+
+        beginTest("Registered processes are killed within the budget");
+        {
+            FFmpegExecutor executor;
+            auto token = CancellationToken::create();
+            executor.setCancellationToken(token);
+
+            FFmpegProcess decoder(ProcessManager::JobClass::Render, "Cancellation test");
+            const FFmpegExecutor::ScopedProcessRegistration registration(executor, decoder);
+            expect(decoder.start("sleep 30"));
+            expect(decoder.isRunning());
+
+            token->cancel();
+
+            // isRunning() reaps the process once it has exited
+            const double deadline = juce::Time::getMillisecondCounterHiRes() + 10000.0;
+            while (decoder.isRunning() && juce::Time::getMillisecondCounterHiRes() < deadline)
+                juce::Thread::sleep(1);
+
+            const double latencyMs = token->getMillisecondsSinceCancel();
+            expect(!decoder.isRunning(), "the registered process survived the cancel");
+            expect(registration.wasCancelled());
+            expect(latencyMs <= CancellationToken::idleLatencyBudgetMs,
+                   "cancel-to-idle took " + juce::String(latencyMs, 0) + " ms");
+        }
+
+        beginTest("Nothing starts once the token is cancelled");
+        {
+            FFmpegExecutor executor;
+            auto token = CancellationToken::create();
+            executor.setCancellationToken(token);
+            token->cancel();
+
+            const double start = juce::Time::getMillisecondCounterHiRes();
+            expect(!executor.executeCommand("sleep 30"));
+            expect(juce::Time::getMillisecondCounterHiRes() - start < CancellationToken::idleLatencyBudgetMs);
+        }
+       #endif
+    }
+};
+
+static CancellationTests cancellationTests;
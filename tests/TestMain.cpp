@@ -0,0 +1,15 @@
+#include <JuceHeader.h>
+
+// Runs every registered juce::UnitTest; the exit code tells ctest whether any failed
+int main()
+{
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runAllTests();
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        if (runner.getResult(i)->failures > 0)
+            return 1;
+
+    return 0;
+}